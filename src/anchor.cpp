@@ -1,9 +1,11 @@
 #include "anchor.h"
+#include "graph.h"
 
 Anchor::Anchor(string this_id)
 {
   id = this_id;
   num = 1;
+  retired_from = NULL;
 }
 
 
@@ -25,7 +27,7 @@ Link* Anchor::get_direct_Link(Anchor *other_anchor)
     if ((*it)->anchor_list.size() != 2) {
       continue;
     }
-    std::list<Anchor*>::iterator anchor_it = (*it)->anchor_list.begin(); 
+    anchor_path::iterator anchor_it = (*it)->anchor_list.begin(); 
     Anchor *anchor1 = (*anchor_it);
     anchor_it++;
     Anchor *anchor2 = (*anchor_it);
@@ -70,7 +72,7 @@ uint Anchor::minimize(bool debug)
         strand1 = -1;
       }
       for (std::list<Link*>::iterator p_link2 = this->links.begin(); p_link2 != p_link1 and !merge_event; p_link2++) {
-        if ((*p_link2)->tags.size() != (*p_link1)->tags.size()) {
+        if (!(*p_link1)->may_concatenate_with(*p_link2)) {
           continue;
         }
         short strand2;
@@ -99,10 +101,14 @@ uint Anchor::minimize(bool debug)
 
 /*!
     \fn Anchor::add_Link(Link *link)
-    Add a new Link at the end of the Anchor.links list
+    Add a new Link at the end of the Anchor.links list. An Anchor moved out of the Graph by
+    Graph::compact() goes back to it.
  */
 void Anchor::add_Link(Link *link)
 {
+  if (retired_from) {
+    retired_from->restore_Anchor(this);
+  }
   this->links.push_back(link);
 }
 
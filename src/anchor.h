@@ -12,6 +12,8 @@
 #include "link.h"
 using namespace std;
 
+typedef class Graph Graph;
+
 //! Defines each vertex in the Graph
 
 class Anchor{
@@ -32,6 +34,7 @@ public:
     uint num; //!< the number of times this Anchor has been found in the input file
     std::list<Link*> links; //!< list of Link objects starting or ending in this Anchor
     std::set<std::string*> species; //!< sorted set of unique species in which this Anchor has been found
+    Graph *retired_from; //!< set while this Anchor has no links and is out of the Graph (see Graph::compact)
 
   protected:
 };
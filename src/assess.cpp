@@ -0,0 +1,686 @@
+#include "assess.h"
+#include "index.h"
+#include "input.h"
+#include "stats.h"
+#include "threads.h"
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <cstdlib>
+
+using namespace std;
+
+assess_species::assess_species()
+{
+  has_gaps = false;
+  has_repeats = false;
+  has_genes = false;
+  has_pseudogenes = false;
+  duplicated_length = 0;
+  n50 = 0;
+  num_genes = 0;
+  num_pseudogenes = 0;
+  gene_coverage none = {0, 0, 0, 0};
+  gene_results = none;
+  pseudogene_results = none;
+}
+
+
+struct sort_intervals {
+  bool operator()(const assess_interval &a, const assess_interval &b) const {
+    if (a.start != b.start) {
+      return a.start < b.start;
+    }
+    return a.end < b.end;
+  }
+};
+
+
+//! Chromosome names in natural order: numbers first, by value, then the rest alphabetically
+struct sort_chr_names {
+  bool operator()(const string &a, const string &b) const {
+    bool a_is_number = (!a.empty() and a.find_first_not_of("0123456789") == string::npos);
+    bool b_is_number = (!b.empty() and b.find_first_not_of("0123456789") == string::npos);
+    if (a_is_number and b_is_number) {
+      return strtoull(a.c_str(), NULL, 10) < strtoull(b.c_str(), NULL, 10);
+    } else if (a_is_number != b_is_number) {
+      return a_is_number;
+    }
+    return a < b;
+  }
+};
+
+
+/*!
+    \fn merge_intervals(interval_list &intervals)
+    Sorts the intervals and joins the ones that overlap or touch each other
+ */
+static void merge_intervals(interval_list &intervals)
+{
+  if (intervals.empty()) {
+    return;
+  }
+  sort(intervals.begin(), intervals.end(), sort_intervals());
+  uint last = 0;
+  for (uint a = 1; a < intervals.size(); a++) {
+    if (intervals[a].start <= (unsigned long long)intervals[last].end + 1) {
+      if (intervals[a].end > intervals[last].end) {
+        intervals[last].end = intervals[a].end;
+      }
+    } else {
+      intervals[++last] = intervals[a];
+    }
+  }
+  intervals.resize(last + 1);
+}
+
+
+/*!
+    \fn get_length(interval_list &merged)
+ */
+static unsigned long long get_length(interval_list &merged)
+{
+  unsigned long long length = 0;
+  for (interval_list::iterator it = merged.begin(); it != merged.end(); it++) {
+    length += it->end - it->start + 1;
+  }
+
+  return length;
+}
+
+
+/*!
+    \fn get_length_outside(interval_list &merged, interval_list &others)
+    Length of the merged intervals not covered by the other ones (also merged), in one sweep over both lists
+ */
+static unsigned long long get_length_outside(interval_list &merged, interval_list &others)
+{
+  unsigned long long length = 0;
+  interval_list::iterator p_other = others.begin();
+  for (interval_list::iterator it = merged.begin(); it != merged.end(); it++) {
+    unsigned long long position = it->start; // first bp not counted yet
+    while (p_other != others.end() and p_other->end < it->start) {
+      p_other++;
+    }
+    for (interval_list::iterator p_next = p_other; p_next != others.end() and p_next->start <= it->end; p_next++) {
+      if (p_next->start > position) {
+        length += p_next->start - position;
+      }
+      if ((unsigned long long)p_next->end + 1 > position) {
+        position = (unsigned long long)p_next->end + 1;
+      }
+    }
+    if (position <= it->end) {
+      length += it->end - position + 1;
+    }
+  }
+
+  return length;
+}
+
+
+/*!
+    \fn count_genes(interval_list &regions, interval_list &merged, interval_list &genes, gene_coverage &results)
+    The genes and the regions are sorted by start, so one sweep finds the longest reach of the
+    regions starting before each gene (to know whether one region covers it all) and the part of
+    the union of the regions that overlaps it.
+ */
+static void count_genes(interval_list &regions, interval_list &merged, interval_list &genes, gene_coverage &results)
+{
+  sort(genes.begin(), genes.end(), sort_intervals());
+  interval_list::iterator p_region = regions.begin();
+  interval_list::iterator p_merged = merged.begin();
+  unsigned int max_end = 0;
+  for (interval_list::iterator p_gene = genes.begin(); p_gene != genes.end(); p_gene++) {
+    while (p_region != regions.end() and p_region->start <= p_gene->start) {
+      if (p_region->end > max_end) {
+        max_end = p_region->end;
+      }
+      p_region++;
+    }
+    if (max_end >= p_gene->end) {
+      results.fully++;
+      continue;
+    }
+    while (p_merged != merged.end() and p_merged->end < p_gene->start) {
+      p_merged++;
+    }
+    unsigned long long covered = 0;
+    for (interval_list::iterator it = p_merged; it != merged.end() and it->start <= p_gene->end; it++) {
+      covered += min(it->end, p_gene->end) - max(it->start, p_gene->start) + 1;
+    }
+    if (covered == 0) {
+      results.uncovered++;
+    } else if (covered == (unsigned long long)p_gene->end - p_gene->start + 1) {
+      results.broken++;
+    } else {
+      results.partially++;
+    }
+  }
+}
+
+
+/*!
+    \fn assess_one_species(assess_species &this_species)
+ */
+static void assess_one_species(assess_species &this_species)
+{
+  vector<string> chrs;
+  for (map<string, unsigned long long>::iterator it = this_species.chr_lengths.begin();
+      it != this_species.chr_lengths.end(); it++) {
+    chrs.push_back(it->first);
+  }
+  for (intervals_per_chr::iterator it = this_species.regions.begin(); it != this_species.regions.end(); it++) {
+    if (!this_species.chr_lengths.count(it->first)) {
+      chrs.push_back(it->first);
+    }
+  }
+  sort(chrs.begin(), chrs.end(), sort_chr_names());
+
+  vector<uint> lengths;
+  unsigned long long total_length = 0;
+  interval_list empty;
+  for (vector<string>::iterator p_chr = chrs.begin(); p_chr != chrs.end(); p_chr++) {
+    interval_list &regions = this_species.regions.count(*p_chr) ? this_species.regions[*p_chr] : empty;
+    for (interval_list::iterator it = regions.begin(); it != regions.end(); it++) {
+      lengths.push_back(it->end - it->start + 1);
+      total_length += it->end - it->start + 1;
+    }
+    sort(regions.begin(), regions.end(), sort_intervals());
+    interval_list merged = regions;
+    merge_intervals(merged);
+
+    chr_coverage this_coverage;
+    this_coverage.chr = *p_chr;
+    this_coverage.length = this_species.chr_lengths.count(*p_chr) ? this_species.chr_lengths[*p_chr] : 0;
+    this_coverage.covered = get_length(merged);
+    this_coverage.has_regions = !regions.empty();
+    this_coverage.gaps = 0;
+    this_coverage.repeats = 0;
+    interval_list gaps;
+    if (this_species.gaps.count(*p_chr)) {
+      gaps = this_species.gaps[*p_chr];
+      merge_intervals(gaps);
+      this_coverage.gaps = get_length_outside(gaps, merged);
+    }
+    if (this_species.repeats.count(*p_chr)) {
+      interval_list repeats = this_species.repeats[*p_chr];
+      merge_intervals(repeats);
+      interval_list covered_or_gap = merged;
+      covered_or_gap.insert(covered_or_gap.end(), gaps.begin(), gaps.end());
+      merge_intervals(covered_or_gap);
+      this_coverage.repeats = get_length_outside(repeats, covered_or_gap);
+    }
+    this_species.coverage.push_back(this_coverage);
+  }
+  if (!get_n50(lengths, total_length, this_species.n50)) {
+    this_species.n50 = 0;
+  }
+
+  for (int pseudogenes = 0; pseudogenes < 2; pseudogenes++) {
+    intervals_per_chr &genes = pseudogenes ? this_species.pseudogenes : this_species.genes;
+    gene_coverage &results = pseudogenes ? this_species.pseudogene_results : this_species.gene_results;
+    unsigned long &num_genes = pseudogenes ? this_species.num_pseudogenes : this_species.num_genes;
+    for (intervals_per_chr::iterator it = genes.begin(); it != genes.end(); it++) {
+      num_genes += it->second.size();
+      interval_list &regions = this_species.regions.count(it->first) ? this_species.regions[it->first] : empty;
+      interval_list merged = regions;
+      merge_intervals(merged);
+      count_genes(regions, merged, it->second, results);
+    }
+  }
+}
+
+
+//! Body of the parallel loop of Assessment::assess(): one species per call
+struct assess_species_worker {
+  vector<assess_species*> *species;
+
+  void operator()(unsigned long index) {
+    assess_one_species(*(*species)[index]);
+  }
+};
+
+
+Assessment::Assessment()
+{
+  num_blocks = 0;
+  duplications = 0;
+  multispecies_duplications = 0;
+  recent_duplications = 0;
+  single_species_duplications = 0;
+}
+
+
+Assessment::~Assessment()
+{
+}
+
+
+/*!
+    \fn Assessment::get_species(string name)
+ */
+assess_species& Assessment::get_species(string name)
+{
+  assess_species &this_species = species[name];
+  this_species.name = name;
+
+  return this_species;
+}
+
+
+/*!
+    \fn Assessment::add_block(map<string, unsigned int> &copies, map<string, unsigned long long> &lengths)
+ */
+void Assessment::add_block(map<string, unsigned int> &copies, map<string, unsigned long long> &lengths)
+{
+  if (copies.empty()) {
+    return;
+  }
+  num_blocks++;
+  unsigned int duplicated_species = 0;
+  for (map<string, unsigned int>::iterator it = copies.begin(); it != copies.end(); it++) {
+    if (it->second > 1) {
+      duplicated_species++;
+      get_species(it->first).duplicated_length += lengths[it->first];
+    }
+  }
+  if (duplicated_species == 0) {
+    return;
+  }
+  duplications++;
+  if (copies.size() == 1) {
+    single_species_duplications++;
+  } else if (duplicated_species == 1) {
+    recent_duplications++;
+  } else {
+    multispecies_duplications++;
+  }
+}
+
+
+/*!
+    \fn Assessment::read_blocks(char *filename)
+    Reads the output of enredo (or of queryblocks): a "block" line followed by one line per
+    region and an empty line.
+ */
+bool Assessment::read_blocks(char *filename)
+{
+  InputStream in;
+  if (!in.open(filename)) {
+    cerr << "Cannot open file " << filename << endl;
+    return false;
+  }
+  map<string, unsigned int> copies;
+  map<string, unsigned long long> lengths;
+  bool in_block = false;
+  string line;
+  while (in.getline(line)) {
+    if (line.empty()) {
+      add_block(copies, lengths);
+      copies.clear();
+      lengths.clear();
+      in_block = false;
+      continue;
+    } else if (line[0] == '#') {
+      continue;
+    } else if (line.compare(0, 5, "block") == 0) {
+      add_block(copies, lengths);
+      copies.clear();
+      lengths.clear();
+      in_block = true;
+      continue;
+    }
+    string species_name, chr;
+    assess_interval this_interval;
+    int strand;
+    if (!in_block or !parse_block_region(line, species_name, chr, this_interval.start, this_interval.end, strand) or
+        this_interval.end < this_interval.start) {
+      cerr << "Wrong line in " << filename << ": <" << line << ">" << endl;
+      return false;
+    }
+    get_species(species_name).regions[chr].push_back(this_interval);
+    copies[species_name]++;
+    lengths[species_name] += this_interval.end - this_interval.start + 1;
+  }
+  add_block(copies, lengths);
+  if (in.error) {
+    cerr << "Cannot read file " << filename << endl;
+    return false;
+  }
+
+  return true;
+}
+
+
+/*!
+    \fn Assessment::read_sizes(string species, char *filename)
+ */
+bool Assessment::read_sizes(string species, char *filename)
+{
+  InputStream in;
+  if (!in.open(filename)) {
+    cerr << "Cannot open file " << filename << endl;
+    return false;
+  }
+  assess_species &this_species = get_species(species);
+  string line;
+  while (in.getline(line)) {
+    if (line.empty() or line[0] == '#') {
+      continue;
+    }
+    istringstream fields(line);
+    string chr;
+    unsigned long long length;
+    if (!(fields >> chr >> length)) {
+      cerr << "Wrong line in " << filename << ": <" << line << ">" << endl;
+      return false;
+    }
+    this_species.chr_lengths[chr] = length;
+  }
+  if (in.error) {
+    cerr << "Cannot read file " << filename << endl;
+    return false;
+  }
+
+  return true;
+}
+
+
+/*!
+    \fn get_biotype(string &attributes)
+    Value of the biotype, gene_biotype or gene_type attribute, in GFF3 (key=value) or GTF (key "value") format
+ */
+static string get_biotype(string &attributes)
+{
+  size_t key = attributes.find("biotype");
+  size_t key_length = 7;
+  if (key == string::npos) {
+    key = attributes.find("gene_type");
+    key_length = 9;
+  }
+  if (key == string::npos) {
+    return "";
+  }
+  size_t value_start = attributes.find_first_not_of("= \"", key + key_length);
+  if (value_start == string::npos) {
+    return "";
+  }
+  size_t value_end = attributes.find_first_of(";\"", value_start);
+
+  return attributes.substr(value_start, (value_end == string::npos) ? string::npos : value_end - value_start);
+}
+
+
+/*!
+    \fn Assessment::read_annotation(string species, char *filename, annotation_type type)
+    Files with .gff or .gtf in their name are read as GFF (1-based), the rest as BED (0-based, end
+    excluded). All the features of a BED file are used. In a GFF file, gaps and repeats are all the
+    features, genes are the "gene" features and pseudogenes the "pseudogene" ones or the "gene"
+    ones with a pseudogene biotype, so the same file can be used for both.
+ */
+bool Assessment::read_annotation(string species, char *filename, annotation_type type)
+{
+  InputStream in;
+  if (!in.open(filename)) {
+    cerr << "Cannot open file " << filename << endl;
+    return false;
+  }
+  string name = filename;
+  bool is_gff = (name.find(".gff") != string::npos or name.find(".gtf") != string::npos);
+  assess_species &this_species = get_species(species);
+  intervals_per_chr *intervals;
+  if (type == ASSESS_GAPS) {
+    intervals = &this_species.gaps;
+    this_species.has_gaps = true;
+  } else if (type == ASSESS_REPEATS) {
+    intervals = &this_species.repeats;
+    this_species.has_repeats = true;
+  } else if (type == ASSESS_GENES) {
+    intervals = &this_species.genes;
+    this_species.has_genes = true;
+  } else {
+    intervals = &this_species.pseudogenes;
+    this_species.has_pseudogenes = true;
+  }
+
+  string line;
+  while (in.getline(line)) {
+    if (line.empty() or line[0] == '#' or line.compare(0, 5, "track") == 0 or line.compare(0, 7, "browser") == 0) {
+      if (is_gff and line == "##FASTA") {
+        break;
+      }
+      continue;
+    }
+    string chr;
+    assess_interval this_interval;
+    if (is_gff) {
+      vector<string> fields;
+      istringstream line_stream(line);
+      string field;
+      while (getline(line_stream, field, '\t')) {
+        fields.push_back(field);
+      }
+      if (fields.size() < 8 or fields[3].find_first_not_of("0123456789") != string::npos or
+          fields[4].find_first_not_of("0123456789") != string::npos) {
+        cerr << "Wrong line in " << filename << ": <" << line << ">" << endl;
+        return false;
+      }
+      if (type == ASSESS_GENES or type == ASSESS_PSEUDOGENES) {
+        string biotype = (fields.size() > 8) ? get_biotype(fields[8]) : "";
+        bool is_pseudogene = (fields[2] == "pseudogene" or
+            (fields[2] == "gene" and biotype.find("pseudogene") != string::npos));
+        if ((type == ASSESS_GENES and (fields[2] != "gene" or is_pseudogene)) or
+            (type == ASSESS_PSEUDOGENES and !is_pseudogene)) {
+          continue;
+        }
+      }
+      chr = fields[0];
+      this_interval.start = strtoul(fields[3].c_str(), NULL, 10);
+      this_interval.end = strtoul(fields[4].c_str(), NULL, 10);
+    } else {
+      istringstream fields(line);
+      unsigned int start, end;
+      if (!(fields >> chr >> start >> end)) {
+        cerr << "Wrong line in " << filename << ": <" << line << ">" << endl;
+        return false;
+      }
+      this_interval.start = start + 1;
+      this_interval.end = end;
+    }
+    if (this_interval.end < this_interval.start) {
+      cerr << "Wrong line in " << filename << ": <" << line << ">" << endl;
+      return false;
+    }
+    (*intervals)[chr].push_back(this_interval);
+  }
+  if (in.error) {
+    cerr << "Cannot read file " << filename << endl;
+    return false;
+  }
+
+  return true;
+}
+
+
+/*!
+    \fn Assessment::assess()
+ */
+void Assessment::assess(void)
+{
+  vector<assess_species*> all_species;
+  for (map<string, assess_species>::iterator it = species.begin(); it != species.end(); it++) {
+    it->second.coverage.clear();
+    all_species.push_back(&it->second);
+  }
+  assess_species_worker worker;
+  worker.species = &all_species;
+  parallel_for(all_species.size(), worker);
+}
+
+
+/*!
+    \fn print_percentage(ostream &out, unsigned long long value, unsigned long long total)
+    Prints " -" when the total is not known
+ */
+static void print_percentage(ostream &out, unsigned long long value, unsigned long long total)
+{
+  if (total == 0) {
+    out << "    -";
+  } else {
+    out << setw(5) << 100.0 * value / total;
+  }
+}
+
+
+/*!
+    \fn Assessment::print(ostream &out)
+ */
+void Assessment::print(ostream &out)
+{
+  ios_base::fmtflags current_flags = out.flags();
+  streamsize current_precision = out.precision();
+  out << fixed;
+  print_coverage(out);
+  print_n50(out);
+  print_duplications(out);
+  print_gene_coverage(out, false);
+  print_gene_coverage(out, true);
+  out.flags(current_flags);
+  out.precision(current_precision);
+}
+
+
+/*!
+    \fn Assessment::print_coverage(ostream &out)
+    Only the chromosomes with blocks are listed, but the total of each species includes all the
+    chromosomes in its sizes file. Percentages are not printed ("-") if the lengths are not known.
+ */
+void Assessment::print_coverage(ostream &out)
+{
+  out << "############################################################" << endl
+      << "# GENOMIC COVERAGE" << endl
+      << "############################################################" << endl;
+  for (map<string, assess_species>::iterator p_species = species.begin(); p_species != species.end(); p_species++) {
+    assess_species &this_species = p_species->second;
+    bool detailed = (this_species.has_gaps or this_species.has_repeats);
+    if (detailed) {
+      out << "Species name              : CHR --  %COV --  %GAP --  %REP -- %REST --  COVERED (bp)" << endl;
+    } else {
+      out << "Species name              : CHR --  %COV -- %UNCV --  COVERED (bp)" << endl;
+    }
+    chr_coverage total;
+    total.chr = "ALL";
+    total.length = 0;
+    total.covered = 0;
+    total.gaps = 0;
+    total.repeats = 0;
+    total.has_regions = true;
+    unsigned long long total_covered_with_length = 0;
+    for (uint a = 0; a <= this_species.coverage.size(); a++) {
+      chr_coverage &this_coverage = (a < this_species.coverage.size()) ? this_species.coverage[a] : total;
+      if (a < this_species.coverage.size()) {
+        total.covered += this_coverage.covered;
+        if (this_coverage.length) {
+          total.length += this_coverage.length;
+          total_covered_with_length += this_coverage.covered;
+          total.gaps += this_coverage.gaps;
+          total.repeats += this_coverage.repeats;
+        }
+        if (!this_coverage.has_regions) {
+          continue;
+        }
+      }
+      unsigned long long covered = (a < this_species.coverage.size()) ? this_coverage.covered :
+          total_covered_with_length;
+      out << left << setw(25) << this_species.name << right << " : " << setw(3) << this_coverage.chr << " -- "
+          << setprecision(2);
+      print_percentage(out, covered, this_coverage.length);
+      out << " -- ";
+      if (detailed) {
+        print_percentage(out, this_coverage.gaps, this_coverage.length);
+        out << " -- ";
+        print_percentage(out, this_coverage.repeats, this_coverage.length);
+        out << " -- ";
+      }
+      print_percentage(out, this_coverage.length - covered - this_coverage.gaps - this_coverage.repeats,
+          this_coverage.length);
+      out << " -- " << setw(13) << this_coverage.covered << endl;
+    }
+    out << endl;
+  }
+}
+
+
+/*!
+    \fn Assessment::print_n50(ostream &out)
+ */
+void Assessment::print_n50(ostream &out)
+{
+  out << "############################################################" << endl
+      << "# N50 STATS" << endl
+      << "############################################################" << endl;
+  for (map<string, assess_species>::iterator it = species.begin(); it != species.end(); it++) {
+    out << left << setw(25) << it->first << right << " : N50 = " << setw(10) << it->second.n50 << endl;
+  }
+  out << endl;
+}
+
+
+/*!
+    \fn Assessment::print_duplications(ostream &out)
+    Without a species tree, the duplications in several species cannot be split into ancient
+    and others as in assess_graph.pl.
+ */
+void Assessment::print_duplications(ostream &out)
+{
+  out << "############################################################" << endl
+      << "# DUPLICATIONS" << endl
+      << "############################################################" << endl;
+  out << "Found " << duplications << " duplications in " << num_blocks << " blocks" << endl;
+  for (map<string, assess_species>::iterator it = species.begin(); it != species.end(); it++) {
+    if (it->second.duplicated_length) {
+      out << " Duplications on " << it->first << " span " << it->second.duplicated_length << " bp" << endl;
+    }
+  }
+  out << endl;
+  out << "Found " << multispecies_duplications << " duplications in several species" << endl;
+  out << "Found " << recent_duplications << " recent duplications" << endl;
+  out << "Found " << single_species_duplications << " species-specific duplicated regions" << endl;
+  out << endl;
+}
+
+
+/*!
+    \fn Assessment::print_gene_coverage(ostream &out, bool pseudogenes)
+    Only for the species with an annotation file of this kind
+ */
+void Assessment::print_gene_coverage(ostream &out, bool pseudogenes)
+{
+  string biotype = pseudogenes ? "pseudogene" : "protein_coding";
+  bool header_is_printed = false;
+  for (map<string, assess_species>::iterator it = species.begin(); it != species.end(); it++) {
+    assess_species &this_species = it->second;
+    if ((pseudogenes and !this_species.has_pseudogenes) or (!pseudogenes and !this_species.has_genes)) {
+      continue;
+    }
+    if (!header_is_printed) {
+      out << "############################################################" << endl
+          << "# GENE COVERAGE (" << biotype << ")" << endl
+          << "############################################################" << endl;
+      header_is_printed = true;
+    }
+    unsigned long num_genes = pseudogenes ? this_species.num_pseudogenes : this_species.num_genes;
+    gene_coverage &results = pseudogenes ? this_species.pseudogene_results : this_species.gene_results;
+    out << " + " << this_species.name << " has " << num_genes << " " << biotype << " genes" << endl;
+    out << setprecision(1)
+        << "  " << results.fully << " (" << (num_genes ? 100.0 * results.fully / num_genes : 0.0) << "%) fully covered; "
+        << results.broken << " (" << (num_genes ? 100.0 * results.broken / num_genes : 0.0) << "%) broken; "
+        << results.partially << " (" << (num_genes ? 100.0 * results.partially / num_genes : 0.0) << "%) partially; "
+        << results.uncovered << " (" << (num_genes ? 100.0 * results.uncovered / num_genes : 0.0) << "%) missing"
+        << endl;
+  }
+  if (header_is_printed) {
+    out << endl;
+  }
+}
@@ -0,0 +1,114 @@
+#ifndef ASSESS_H
+#define ASSESS_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+
+//! A region of a chromosome (1-based, both ends included)
+
+struct assess_interval {
+  unsigned int start;
+  unsigned int end;
+};
+
+typedef std::vector<assess_interval> interval_list;
+typedef std::map<std::string, interval_list> intervals_per_chr;
+
+//! Kinds of annotation files (see Assessment::read_annotation)
+enum annotation_type {
+  ASSESS_GAPS,
+  ASSESS_REPEATS,
+  ASSESS_GENES,
+  ASSESS_PSEUDOGENES
+};
+
+//! Number of genes by how much of them is covered by the regions of the blocks
+
+struct gene_coverage {
+  unsigned long fully; //!< by one single region
+  unsigned long broken; //!< by several regions together
+  unsigned long partially;
+  unsigned long uncovered;
+};
+
+//! Coverage of one chromosome by the regions of the blocks
+
+struct chr_coverage {
+  std::string chr;
+  unsigned long long length; //!< 0 if not known
+  unsigned long long covered;
+  unsigned long long gaps; //!< not covered and in an assembly gap
+  unsigned long long repeats; //!< not covered and in a repeat (but not in a gap)
+  bool has_regions;
+};
+
+//! The regions of the blocks, the annotations and the results of one species
+
+struct assess_species {
+  assess_species();
+
+  std::string name;
+  std::map<std::string, unsigned long long> chr_lengths;
+  intervals_per_chr regions; //!< of the blocks
+  intervals_per_chr gaps;
+  intervals_per_chr repeats;
+  intervals_per_chr genes;
+  intervals_per_chr pseudogenes;
+  bool has_gaps; //!< set when an annotation file of this kind has been read
+  bool has_repeats;
+  bool has_genes;
+  bool has_pseudogenes;
+  unsigned long long duplicated_length; //!< of the regions in blocks with several regions of this species
+
+  // Results of Assessment::assess()
+  std::vector<chr_coverage> coverage; //!< in order of chromosome name
+  unsigned int n50;
+  unsigned long num_genes;
+  unsigned long num_pseudogenes;
+  gene_coverage gene_results;
+  gene_coverage pseudogene_results;
+};
+
+//! Coverage, N50, duplication and gene coverage stats of the blocks of an enredo output file
+
+/*!
+    This is the offline version of tools/assess_graph.pl: the blocks are read from an enredo output
+    file and the chromosome lengths, assembly gaps, repeats, genes and pseudogenes from local files
+    instead of Ensembl databases. All the stats are computed with sweeps over the sorted regions,
+    one species per thread.
+ */
+class Assessment{
+public:
+    Assessment();
+
+    ~Assessment();
+    //! Reads the blocks of an enredo output file
+    bool read_blocks(char *filename);
+    //! Reads the length of the chromosomes of a species (chr and length columns, like a .fai or chrom.sizes file)
+    bool read_sizes(std::string species, char *filename);
+    //! Reads an annotation file of a species, in BED or GFF/GTF format (from the file name)
+    bool read_annotation(std::string species, char *filename, annotation_type type);
+    //! Computes the stats of all the species
+    void assess(void);
+    //! Prints the stats in the same sections as assess_graph.pl
+    void print(std::ostream &out);
+
+    std::map<std::string, assess_species> species;
+    unsigned long num_blocks;
+    unsigned long duplications; //!< blocks with several regions of the same species
+    unsigned long multispecies_duplications; //!< with several regions of more than one species
+    unsigned long recent_duplications; //!< with several regions of one species and regions of other species
+    unsigned long single_species_duplications; //!< with regions of one species only
+
+  protected:
+    assess_species &get_species(std::string name);
+    void add_block(std::map<std::string, unsigned int> &copies, std::map<std::string, unsigned long long> &lengths);
+    void print_coverage(std::ostream &out);
+    void print_n50(std::ostream &out);
+    void print_duplications(std::ostream &out);
+    void print_gene_coverage(std::ostream &out, bool pseudogenes);
+};
+
+#endif
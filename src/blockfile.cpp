@@ -0,0 +1,426 @@
+#include "blockfile.h"
+#include <cstring>
+#include <cerrno>
+
+using namespace std;
+
+#define BLOCK_FILE_MAGIC "ENREDOBB"
+//! Limit for the size of the strings and blocks read, to reject corrupted files early
+#define BLOCK_FILE_MAX_RECORD (1ULL << 32)
+
+static void append_uint(string &buffer, unsigned long long value, int bytes)
+{
+  for (int a = 0; a < bytes; a++) {
+    buffer += (char)((value >> (8 * a)) & 0xff);
+  }
+}
+
+static void append_string(string &buffer, const string &value)
+{
+  append_uint(buffer, value.size(), 4);
+  buffer += value;
+}
+
+static unsigned long long get_uint(const string &buffer, unsigned long long &position, int bytes)
+{
+  unsigned long long value = 0;
+  for (int a = 0; a < bytes; a++) {
+    value |= (unsigned long long)(unsigned char)buffer[position + a] << (8 * a);
+  }
+  position += bytes;
+
+  return value;
+}
+
+
+/*!
+    \fn binary_block::clear()
+ */
+void binary_block::clear(void)
+{
+  anchors.clear();
+  sequences.clear();
+  starts.clear();
+  ends.clear();
+  strands.clear();
+}
+
+
+BlockFileWriter::BlockFileWriter()
+{
+  file = NULL;
+  num_blocks = 0;
+  error = false;
+}
+
+
+BlockFileWriter::~BlockFileWriter()
+{
+  if (file) {
+    close();
+  }
+}
+
+
+/*!
+    \fn BlockFileWriter::open(const string &filename, const string &text_header)
+ */
+bool BlockFileWriter::open(const string &filename, const string &text_header)
+{
+  file = fopen(filename.c_str(), "wb");
+  if (!file) {
+    cerr << "Cannot open file " << filename << ": " << strerror(errno) << endl;
+    return false;
+  }
+  this->text_header = text_header;
+  num_blocks = 0;
+  error = false;
+
+  return true;
+}
+
+
+/*!
+    \fn BlockFileWriter::write_header(const vector<string> &species, const vector<block_file_sequence> &sequences)
+ */
+bool BlockFileWriter::write_header(const vector<string> &species, const vector<block_file_sequence> &sequences)
+{
+  buffer.assign(BLOCK_FILE_MAGIC, 8);
+  append_uint(buffer, BLOCK_FILE_VERSION, 4);
+  append_string(buffer, text_header);
+  append_uint(buffer, species.size(), 4);
+  for (uint a = 0; a < species.size(); a++) {
+    append_string(buffer, species[a]);
+  }
+  append_uint(buffer, sequences.size(), 4);
+  for (uint a = 0; a < sequences.size(); a++) {
+    append_uint(buffer, sequences[a].species, 4);
+    append_string(buffer, sequences[a].chr);
+  }
+  if (fwrite(buffer.data(), 1, buffer.size(), file) != buffer.size()) {
+    error = true;
+  }
+
+  return !error;
+}
+
+
+/*!
+    \fn BlockFileWriter::write_block(const binary_block &block)
+    The whole record is built in memory first, so it takes one single write.
+ */
+bool BlockFileWriter::write_block(const binary_block &block)
+{
+  buffer.clear();
+  append_uint(buffer, 0, 4); // size of the record, set below
+  append_uint(buffer, block.anchors.size(), 4);
+  append_uint(buffer, block.sequences.size(), 4);
+  for (vector<string>::const_iterator it = block.anchors.begin(); it != block.anchors.end(); it++) {
+    append_uint(buffer, it->size(), 4);
+  }
+  for (vector<string>::const_iterator it = block.anchors.begin(); it != block.anchors.end(); it++) {
+    buffer += *it;
+  }
+  for (uint a = 0; a < block.sequences.size(); a++) {
+    append_uint(buffer, block.sequences[a], 4);
+  }
+  for (uint a = 0; a < block.starts.size(); a++) {
+    append_uint(buffer, block.starts[a], 4);
+  }
+  for (uint a = 0; a < block.ends.size(); a++) {
+    append_uint(buffer, block.ends[a], 4);
+  }
+  for (uint a = 0; a < block.strands.size(); a++) {
+    buffer += (char)block.strands[a];
+  }
+  unsigned long long size = buffer.size() - 4;
+  for (int a = 0; a < 4; a++) {
+    buffer[a] = (char)((size >> (8 * a)) & 0xff);
+  }
+  if (fwrite(buffer.data(), 1, buffer.size(), file) != buffer.size()) {
+    error = true;
+  }
+  num_blocks++;
+
+  return !error;
+}
+
+
+/*!
+    \fn BlockFileWriter::close()
+ */
+bool BlockFileWriter::close(void)
+{
+  if (!file) {
+    return false;
+  }
+  buffer.clear();
+  append_uint(buffer, 0, 4);
+  append_uint(buffer, num_blocks, 8);
+  if (fwrite(buffer.data(), 1, buffer.size(), file) != buffer.size()) {
+    error = true;
+  }
+  if (fclose(file) != 0) {
+    error = true;
+  }
+  file = NULL;
+  if (error) {
+    cerr << "Cannot write the binary block file" << endl;
+  }
+
+  return !error;
+}
+
+
+BlockFileReader::BlockFileReader()
+{
+  file = NULL;
+  num_blocks = 0;
+  error = false;
+}
+
+
+BlockFileReader::~BlockFileReader()
+{
+  close();
+}
+
+
+/*!
+    \fn BlockFileReader::read_bytes(unsigned long long size)
+    Reads the next size bytes of the file in the buffer
+ */
+bool BlockFileReader::read_bytes(unsigned long long size)
+{
+  if (!file or size > BLOCK_FILE_MAX_RECORD) {
+    return false;
+  }
+  buffer.resize(size);
+  if (size and fread(&buffer[0], 1, size, file) != size) {
+    return false;
+  }
+
+  return true;
+}
+
+
+/*!
+    \fn BlockFileReader::open(const string &filename)
+ */
+bool BlockFileReader::open(const string &filename)
+{
+  close();
+  this->filename = filename;
+  if (filename == "-") {
+    file = stdin;
+  } else {
+    file = fopen(filename.c_str(), "rb");
+  }
+  if (!file) {
+    cerr << "Cannot open file " << filename << ": " << strerror(errno) << endl;
+    return false;
+  }
+  num_blocks = 0;
+  error = true;
+  species.clear();
+  sequences.clear();
+
+  unsigned long long position = 0;
+  if (!read_bytes(16) or buffer.compare(0, 8, BLOCK_FILE_MAGIC) != 0) {
+    cerr << "Not a binary block file: " << filename << endl;
+    return false;
+  }
+  position = 8;
+  if (get_uint(buffer, position, 4) != BLOCK_FILE_VERSION) {
+    cerr << "Wrong version of the binary block file " << filename << endl;
+    return false;
+  }
+  unsigned long long size = get_uint(buffer, position, 4);
+  if (!read_bytes(size + 4)) {
+    cerr << "Wrong binary block file " << filename << endl;
+    return false;
+  }
+  text_header = buffer.substr(0, size);
+  position = size;
+  unsigned long long num_species = get_uint(buffer, position, 4);
+  for (unsigned long long a = 0; a < num_species; a++) {
+    if (!read_bytes(4)) {
+      cerr << "Wrong binary block file " << filename << endl;
+      return false;
+    }
+    position = 0;
+    size = get_uint(buffer, position, 4);
+    if (!read_bytes(size)) {
+      cerr << "Wrong binary block file " << filename << endl;
+      return false;
+    }
+    species.push_back(buffer);
+  }
+  if (!read_bytes(4)) {
+    cerr << "Wrong binary block file " << filename << endl;
+    return false;
+  }
+  position = 0;
+  unsigned long long num_sequences = get_uint(buffer, position, 4);
+  for (unsigned long long a = 0; a < num_sequences; a++) {
+    block_file_sequence this_sequence;
+    if (!read_bytes(8)) {
+      cerr << "Wrong binary block file " << filename << endl;
+      return false;
+    }
+    position = 0;
+    this_sequence.species = get_uint(buffer, position, 4);
+    size = get_uint(buffer, position, 4);
+    if (this_sequence.species >= species.size() or !read_bytes(size)) {
+      cerr << "Wrong binary block file " << filename << endl;
+      return false;
+    }
+    this_sequence.chr = buffer;
+    sequences.push_back(this_sequence);
+  }
+  error = false;
+
+  return true;
+}
+
+
+/*!
+    \fn BlockFileReader::close()
+ */
+void BlockFileReader::close(void)
+{
+  if (file and file != stdin) {
+    fclose(file);
+  }
+  file = NULL;
+}
+
+
+/*!
+    \fn BlockFileReader::next_block(binary_block &block)
+    At the end of the file, the number of blocks read is checked against the one written, so a
+    truncated file is an error.
+ */
+bool BlockFileReader::next_block(binary_block &block)
+{
+  if (!file or error) {
+    return false;
+  }
+  unsigned long long position = 0;
+  if (!read_bytes(4)) {
+    cerr << "Unexpected end of file in " << filename << endl;
+    error = true;
+    return false;
+  }
+  unsigned long long size = get_uint(buffer, position, 4);
+  if (size == 0) {
+    position = 0;
+    if (!read_bytes(8) or get_uint(buffer, position, 8) != num_blocks) {
+      cerr << "Wrong number of blocks in " << filename << endl;
+      error = true;
+    }
+    close();
+    return false;
+  }
+  if (size < 8 or !read_bytes(size)) {
+    cerr << "Unexpected end of file in " << filename << endl;
+    error = true;
+    return false;
+  }
+
+  position = 0;
+  unsigned long long num_anchors = get_uint(buffer, position, 4);
+  unsigned long long num_regions = get_uint(buffer, position, 4);
+  if (8 + num_anchors * 4 + num_regions * 13 > size) {
+    cerr << "Wrong block in " << filename << endl;
+    error = true;
+    return false;
+  }
+  block.clear();
+  block.anchors.resize(num_anchors);
+  unsigned long long ids_position = position + num_anchors * 4;
+  for (unsigned long long a = 0; a < num_anchors; a++) {
+    unsigned long long length = get_uint(buffer, position, 4);
+    if (ids_position + length > size) {
+      cerr << "Wrong block in " << filename << endl;
+      error = true;
+      return false;
+    }
+    block.anchors[a].assign(buffer, ids_position, length);
+    ids_position += length;
+  }
+  position = ids_position;
+  if (position + num_regions * 13 != size) {
+    cerr << "Wrong block in " << filename << endl;
+    error = true;
+    return false;
+  }
+  block.sequences.resize(num_regions);
+  block.starts.resize(num_regions);
+  block.ends.resize(num_regions);
+  block.strands.resize(num_regions);
+  for (unsigned long long a = 0; a < num_regions; a++) {
+    block.sequences[a] = get_uint(buffer, position, 4);
+    if (block.sequences[a] >= sequences.size()) {
+      cerr << "Wrong block in " << filename << endl;
+      error = true;
+      return false;
+    }
+  }
+  for (unsigned long long a = 0; a < num_regions; a++) {
+    block.starts[a] = get_uint(buffer, position, 4);
+  }
+  for (unsigned long long a = 0; a < num_regions; a++) {
+    block.ends[a] = get_uint(buffer, position, 4);
+  }
+  for (unsigned long long a = 0; a < num_regions; a++) {
+    block.strands[a] = (signed char)buffer[position++];
+  }
+  num_blocks++;
+
+  return true;
+}
+
+
+/*!
+    \fn BlockFileReader::next_block(enredo_block &block)
+ */
+bool BlockFileReader::next_block(enredo_block &block)
+{
+  if (!next_block(columns)) {
+    return false;
+  }
+  block.anchors.swap(columns.anchors);
+  block.regions.resize(columns.sequences.size());
+  for (uint a = 0; a < columns.sequences.size(); a++) {
+    block_file_sequence &this_sequence = sequences[columns.sequences[a]];
+    block.regions[a].species = species[this_sequence.species];
+    block.regions[a].chr = this_sequence.chr;
+    block.regions[a].start = columns.starts[a];
+    block.regions[a].end = columns.ends[a];
+    block.regions[a].strand = columns.strands[a];
+  }
+
+  return true;
+}
+
+
+/*!
+    \fn BlockFileReader::print_block(const binary_block &block, ostream &out)
+    Same output as Link::print()
+ */
+void BlockFileReader::print_block(const binary_block &block, ostream &out)
+{
+  out << "block";
+  for (vector<string>::const_iterator it = block.anchors.begin(); it != block.anchors.end(); it++) {
+    out << " - " << *it;
+  }
+  out << "  (made of " << block.sequences.size() << " genomic regions)\n";
+  for (uint a = 0; a < block.sequences.size(); a++) {
+    block_file_sequence &this_sequence = sequences[block.sequences[a]];
+    out << species[this_sequence.species] << ":" << this_sequence.chr << ":" << block.starts[a] << ":"
+        << block.ends[a] << " [" << (int)block.strands[a] << "] l=" << (block.ends[a] - block.starts[a] + 1)
+        << "\n";
+  }
+  out << "\n";
+}
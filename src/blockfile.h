@@ -0,0 +1,106 @@
+#ifndef BLOCKFILE_H
+#define BLOCKFILE_H
+
+/**
+	Binary format for the enredo blocks, with a streaming reader and writer. Like libenredo.h, this
+	header is installed and only depends on it.
+*/
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "libenredo.h"
+
+//! Version of the format of the binary block files
+#define BLOCK_FILE_VERSION 1
+
+//! A chromosome in the dictionary of a binary block file
+
+struct block_file_sequence {
+  unsigned int species; //!< index in the species dictionary
+  std::string chr;
+};
+
+//! One block of a binary block file, with its regions by columns
+
+/*!
+    Region i is on sequences[i] (an index in the sequence dictionary of the file) from starts[i] to
+    ends[i], on strands[i] (1, -1 or 0 if unknown).
+ */
+struct binary_block {
+  std::vector<std::string> anchors;
+  std::vector<unsigned int> sequences;
+  std::vector<unsigned int> starts;
+  std::vector<unsigned int> ends;
+  std::vector<signed char> strands;
+
+  void clear(void);
+};
+
+/*!
+    A binary block file is made of:
+      - A header: "ENREDOBB", the version, the text header of the enredo output (the comment lines
+        with the parameters), the species dictionary and the sequence dictionary (species index and
+        chromosome name).
+      - One record per block: its size in bytes, the number of anchors and regions, the length of
+        each anchor id followed by the ids, and the columns of sequences, starts, ends and strands.
+      - A last record with size 0 followed by the number of blocks.
+    Numbers are little-endian: 4 bytes each except the strands (1 byte) and the number of blocks
+    (8 bytes). Strings are written as their length (4 bytes) and their characters.
+ */
+class BlockFileWriter{
+public:
+    BlockFileWriter();
+
+    ~BlockFileWriter();
+    //! Creates the file. The text header is kept for write_header()
+    bool open(const std::string &filename, const std::string &text_header = "");
+    //! Sets the dictionaries and writes the header. Must be called once, before the first block
+    bool write_header(const std::vector<std::string> &species, const std::vector<block_file_sequence> &sequences);
+    //! Appends a block
+    bool write_block(const binary_block &block);
+    //! Writes the end of the file. Returns false if anything could not be written
+    bool close(void);
+
+    unsigned long long num_blocks;
+
+  protected:
+    FILE *file;
+    std::string text_header;
+    std::string buffer;
+    bool error;
+};
+
+//! Reads a binary block file one block at a time
+
+class BlockFileReader{
+public:
+    BlockFileReader();
+
+    ~BlockFileReader();
+    //! Opens the file ("-" for STDIN) and reads its header and dictionaries
+    bool open(const std::string &filename);
+    //! Reads the next block. Returns false at the end of the file or on error (see error)
+    bool next_block(binary_block &block);
+    //! Same, with the names of the species and chromosomes in each region
+    bool next_block(enredo_block &block);
+    //! Prints a block in the enredo text format
+    void print_block(const binary_block &block, std::ostream &out);
+    void close(void);
+
+    std::string text_header; //!< comment lines of the enredo output, with the parameters
+    std::vector<std::string> species;
+    std::vector<block_file_sequence> sequences;
+    unsigned long long num_blocks; //!< read so far
+    bool error; //!< the file could not be read or is not a valid binary block file
+
+  protected:
+    bool read_bytes(unsigned long long size);
+
+    FILE *file;
+    std::string filename;
+    std::string buffer;
+    binary_block columns;
+};
+
+#endif
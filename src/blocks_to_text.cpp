@@ -0,0 +1,91 @@
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <iostream>
+#include <fstream>
+#include <cstdlib>
+#include "blockfile.h"
+
+using namespace std;
+
+void print_help(void);
+
+int main(int argc, char *argv[])
+{
+  char *filename = NULL;
+  char *output_filename = NULL;
+  bool print_header = true;
+  bool help = false;
+  string this_arg;
+
+  for (int a = 1; a < argc; a++) {
+    this_arg = argv[a];
+    if (this_arg == "--no-header") {
+      print_header = false;
+    } else if (((this_arg == "--output") or (this_arg == "-o")) and (a < argc - 1)) {
+      a++;
+      output_filename = argv[a];
+    } else if ((this_arg == "--help") or (this_arg == "-h")) {
+      help = true;
+    } else if (!filename) {
+      filename = argv[a];
+    } else {
+      cerr << "Unknown option: " << this_arg << endl;
+      exit(1);
+    }
+  }
+
+  if (help or !filename) {
+    print_help();
+    exit(0);
+  }
+
+  BlockFileReader reader;
+  if (!reader.open(filename)) {
+    exit(1);
+  }
+  ios::sync_with_stdio(false);
+  ofstream output_stream;
+  if (output_filename) {
+    output_stream.open(output_filename);
+    if (!output_stream.is_open()) {
+      cerr << "Cannot open file <" << output_filename << "> for output" << endl;
+      exit(1);
+    }
+  }
+  ostream &out = output_filename ? output_stream : cout;
+  if (print_header) {
+    out << reader.text_header;
+  }
+  binary_block block;
+  while (reader.next_block(block)) {
+    reader.print_block(block, out);
+  }
+  out.flush();
+  if (reader.error or !out.good()) {
+    exit(1);
+  }
+
+  return EXIT_SUCCESS;
+}
+
+void print_help(void)
+{
+  cout << "Blocks2text v" << VERSION << endl;
+  cout << endl;
+  cout << "Usage: blocks2text [options] blocks.ebb" << endl;
+  cout << endl;
+  cout << "Prints the blocks of a binary block file (see --output-format in enredo) in" << endl;
+  cout << "the enredo text format. \"-\" reads the file from STDIN." << endl;
+  cout << endl;
+  cout << "Options:" << endl;
+  cout << " --no-header: do not print the comment lines with the parameters of enredo" << endl;
+  cout << " --output: write output to that file (def: STDOUT)" << endl;
+  cout << endl;
+  cout << " --help: prints this help" << endl;
+  cout << endl;
+  cout << "See README file for more details." << endl;
+  cout << endl;
+}
@@ -8,19 +8,32 @@
 #include <fstream>
 #include <sstream>
 #include <cstdlib>
-#include "graph.h"
+#include <vector>
+#include <csignal>
+#include "libenredo.h"
+#include "index.h"
+#include "pipeline.h"
+#include "server.h"
+#include "blockfile.h"
 
 using namespace std;
 
 void print_help(void);
 
+//! On SIGTERM, the pipeline saves a checkpoint before its next pass (see --checkpoint)
+static void checkpoint_on_signal(int)
+{
+  Enredo::request_checkpoint();
+}
+
 int main(int argc, char *argv[])
 {
-  Graph my_graph;
   char *input_filename = NULL;
   char *output_filename = NULL;
+  char *merged_filename = NULL;
   uint max_gap_length = 200000;
   bool anchors_as_links = false;
+  bool merge_overlap = false;
   float min_score = 0.0f;
   uint min_length = 100000;
   uint min_regions = 2;
@@ -28,10 +41,35 @@ int main(int argc, char *argv[])
   float max_ratio = 3.0f;
   uint path_dissimilarity = 4;
   uint simplify_graph = 7;
+  string pipeline = "";
+  bool skip_idle_minimize = true;
+  double max_time = 0;
+  double max_pass_time = 0;
+  uint max_iterations = 0;
+  unsigned long max_total_iterations = 0;
   int histogram_size = 10;
   bool allow_bridges = true;
   bool print_all = false;
   bool print_stats = false;
+  enredo_sort_mode sorting = ENREDO_SORT_AUTO;
+  unsigned long sort_memory = enredo_parameters().sort_memory;
+  char *tmp_dir = NULL;
+  vector<string> regions;
+  vector<string> included_species;
+  vector<string> excluded_species;
+  uint max_anchor_copies = 0;
+  unsigned long max_anchor_hits = 0;
+  char *filtered_anchors_filename = NULL;
+  bool prescan = false;
+  unsigned long memory_limit = 0;
+  uint num_threads = 0;
+  char *serve_socket = NULL;
+  char *load_graph_filename = NULL;
+  char *save_graph_filename = NULL;
+  char *checkpoint_filename = NULL;
+  char *resume_filename = NULL;
+  bool block_index = false;
+  bool binary_output = false;
   bool help = false;
   bool ret;
   string this_arg;
@@ -44,6 +82,62 @@ int main(int argc, char *argv[])
       max_gap_length = atoi(argv[a]);
     } else if ((this_arg == "--anchors-as-links")) {
       anchors_as_links = true;
+    } else if (this_arg == "--merge-overlap") {
+      merge_overlap = true;
+    } else if ((this_arg == "--merge-overlap-output") and (a < argc - 1)) {
+      a++;
+      merge_overlap = true;
+      merged_filename = argv[a];
+    } else if ((this_arg == "--region") and (a < argc - 1)) {
+      a++;
+      region this_region;
+      if (!parse_region(argv[a], this_region)) {
+        cerr << "Wrong region: " << argv[a] << " (use species:chr or species:chr:start-end)" << endl;
+        exit(1);
+      }
+      regions.push_back(argv[a]);
+    } else if (((this_arg == "--species") or (this_arg == "--exclude-species")) and (a < argc - 1)) {
+      a++;
+      string names = argv[a];
+      size_t start = 0;
+      while (start <= names.size()) {
+        size_t end = names.find(',', start);
+        if (end == string::npos) {
+          end = names.size();
+        }
+        if (end > start and this_arg == "--species") {
+          included_species.push_back(names.substr(start, end - start));
+        } else if (end > start) {
+          excluded_species.push_back(names.substr(start, end - start));
+        }
+        start = end + 1;
+      }
+    } else if ((this_arg == "--max-anchor-copies") and (a < argc - 1)) {
+      a++;
+      max_anchor_copies = atoi(argv[a]);
+    } else if ((this_arg == "--max-anchor-hits") and (a < argc - 1)) {
+      a++;
+      max_anchor_hits = atol(argv[a]);
+    } else if ((this_arg == "--filtered-anchors-output") and (a < argc - 1)) {
+      a++;
+      filtered_anchors_filename = argv[a];
+    } else if (this_arg == "--prescan") {
+      prescan = true;
+    } else if ((this_arg == "--no-prescan") or (this_arg == "--noprescan")) {
+      prescan = false;
+    } else if (this_arg == "--sort") {
+      sorting = ENREDO_SORT_ALWAYS;
+    } else if ((this_arg == "--no-sort") or (this_arg == "--nosort")) {
+      sorting = ENREDO_SORT_NEVER;
+    } else if ((this_arg == "--sort-memory") and (a < argc - 1)) {
+      a++;
+      sort_memory = atol(argv[a]);
+    } else if ((this_arg == "--memory-limit") and (a < argc - 1)) {
+      a++;
+      memory_limit = atol(argv[a]);
+    } else if ((this_arg == "--tmp-dir") and (a < argc - 1)) {
+      a++;
+      tmp_dir = argv[a];
     } else if ((this_arg == "--min-score") and (a < argc - 1)) {
       a++;
       min_score = atof(argv[a]);
@@ -53,6 +147,29 @@ int main(int argc, char *argv[])
     } else if ((this_arg == "--simplify-graph") and (a < argc - 1)) {
       a++;
       simplify_graph = atoi(argv[a]);
+    } else if ((this_arg == "--pipeline") and (a < argc - 1)) {
+      a++;
+      Pipeline this_pipeline;
+      if (!this_pipeline.parse(argv[a])) {
+        exit(1);
+      }
+      pipeline = this_pipeline.get_spec();
+    } else if (this_arg == "--skip-idle-minimize") {
+      skip_idle_minimize = true;
+    } else if (this_arg == "--no-skip-idle-minimize") {
+      skip_idle_minimize = false;
+    } else if ((this_arg == "--max-time") and (a < argc - 1)) {
+      a++;
+      max_time = atof(argv[a]);
+    } else if ((this_arg == "--max-pass-time") and (a < argc - 1)) {
+      a++;
+      max_pass_time = atof(argv[a]);
+    } else if ((this_arg == "--max-iterations") and (a < argc - 1)) {
+      a++;
+      max_iterations = atoi(argv[a]);
+    } else if ((this_arg == "--max-total-iterations") and (a < argc - 1)) {
+      a++;
+      max_total_iterations = atol(argv[a]);
     } else if ((this_arg == "--min-length") and (a < argc - 1)) {
       a++;
       min_length = atoi(argv[a]);
@@ -81,6 +198,36 @@ int main(int argc, char *argv[])
     } else if (((this_arg == "--output-file") or (this_arg == "--output") or (this_arg == "-o"))and (a < argc - 1)) {
       a++;
       output_filename  = argv[a];
+    } else if ((this_arg == "--output-format") and (a < argc - 1)) {
+      a++;
+      if (string(argv[a]) == "binary") {
+        binary_output = true;
+      } else if (string(argv[a]) == "text") {
+        binary_output = false;
+      } else {
+        cerr << "Unknown output format: " << argv[a] << endl;
+        exit(1);
+      }
+    } else if (this_arg == "--block-index") {
+      block_index = true;
+    } else if ((this_arg == "--threads") and (a < argc - 1)) {
+      a++;
+      num_threads = atoi(argv[a]);
+    } else if ((this_arg == "--load-graph") and (a < argc - 1)) {
+      a++;
+      load_graph_filename = argv[a];
+    } else if ((this_arg == "--save-graph") and (a < argc - 1)) {
+      a++;
+      save_graph_filename = argv[a];
+    } else if ((this_arg == "--checkpoint") and (a < argc - 1)) {
+      a++;
+      checkpoint_filename = argv[a];
+    } else if ((this_arg == "--resume") and (a < argc - 1)) {
+      a++;
+      resume_filename = argv[a];
+    } else if ((this_arg == "--serve") and (a < argc - 1)) {
+      a++;
+      serve_socket = argv[a];
     } else if ((this_arg == "--debug") and (a < argc - 1)) {
       a++;
       debug  = argv[a];
@@ -103,15 +250,61 @@ int main(int argc, char *argv[])
   }
   cout << endl;
 
-  if (help or !input_filename) {
+  if (help or (!input_filename and !load_graph_filename and !resume_filename)) {
     print_help();
     exit(0);
   }
+  if ((block_index or binary_output) and !output_filename) {
+    cerr << "EXIT (" << (block_index ? "--block-index" : "--output-format binary") << " needs --output)" << endl;
+    exit(1);
+  }
+  if (block_index and binary_output) {
+    cerr << "EXIT (--block-index needs the text output format)" << endl;
+    exit(1);
+  }
 
   cout << endl
       << " Parameters:" << endl
-      << "====================================" << endl
-      << "Input-file \"" << input_filename << "\"" << endl
+      << "====================================" << endl;
+  if (load_graph_filename) {
+    cout << "--load-graph " << load_graph_filename << endl;
+  }
+  if (input_filename) {
+    cout << "Input-file \"" << input_filename << "\"" << endl;
+  }
+  if (save_graph_filename) {
+    cout << "--save-graph " << save_graph_filename << endl;
+  }
+  if (checkpoint_filename) {
+    cout << "--checkpoint " << checkpoint_filename << endl;
+  }
+  if (resume_filename) {
+    cout << "--resume " << resume_filename << endl;
+  }
+  if (merge_overlap) {
+    cout << "--merge-overlap" << endl;
+  }
+  for (uint a = 0; a < regions.size(); a++) {
+    cout << "--region " << regions[a] << endl;
+  }
+  for (uint a = 0; a < included_species.size(); a++) {
+    cout << "--species " << included_species[a] << endl;
+  }
+  for (uint a = 0; a < excluded_species.size(); a++) {
+    cout << "--exclude-species " << excluded_species[a] << endl;
+  }
+  if (max_anchor_copies) {
+    cout << "--max-anchor-copies " << max_anchor_copies << endl;
+  }
+  if (max_anchor_hits) {
+    cout << "--max-anchor-hits " << max_anchor_hits << endl;
+  }
+  if (sorting == ENREDO_SORT_ALWAYS) {
+    cout << "--sort" << endl;
+  } else if (sorting == ENREDO_SORT_NEVER) {
+    cout << "--no-sort" << endl;
+  }
+  cout
       << "--min-score " << min_score << endl
       << "--max-gap-length " << max_gap_length << endl
       << "--max-path-dissimilarity " << path_dissimilarity << endl
@@ -123,9 +316,28 @@ int main(int argc, char *argv[])
   } else {
     cout << "[max-ratio off]" << endl;
   }
-  cout
-//       << "simplify-graph: " << (simplify_graph?"yes":"no") << endl
-      << "--simplify-graph " << simplify_graph << endl;
+  if (pipeline.empty()) {
+    cout
+//         << "simplify-graph: " << (simplify_graph?"yes":"no") << endl
+        << "--simplify-graph " << simplify_graph << endl;
+  } else {
+    cout << "--pipeline \"" << pipeline << "\"" << endl;
+  }
+  if (!skip_idle_minimize) {
+    cout << "--no-skip-idle-minimize" << endl;
+  }
+  if (max_time) {
+    cout << "--max-time " << max_time << endl;
+  }
+  if (max_pass_time) {
+    cout << "--max-pass-time " << max_pass_time << endl;
+  }
+  if (max_iterations) {
+    cout << "--max-iterations " << max_iterations << endl;
+  }
+  if (max_total_iterations) {
+    cout << "--max-total-iterations " << max_total_iterations << endl;
+  }
   if (print_all) {
     cout << "--all" << endl;
   } else if (allow_bridges) {
@@ -134,116 +346,135 @@ int main(int argc, char *argv[])
     cout << "[valid edges only]" << endl;
   }
 
-  cout << endl
-      << " Reading input file:" << endl
-      << "====================================" << endl;
-  ret = my_graph.populate_from_file(input_filename, min_score, max_gap_length, anchors_as_links);
-  if (!ret) {
-    cerr << "EXIT (Error while reading file)" << endl;
-    exit(1);
+  enredo_parameters parameters;
+  parameters.min_score = min_score;
+  parameters.max_gap_length = max_gap_length;
+  parameters.anchors_as_links = anchors_as_links;
+  parameters.merge_overlap = merge_overlap;
+  if (merged_filename) {
+    parameters.merged_filename = merged_filename;
   }
-  if (print_stats) {
-    my_graph.print_anchors_histogram();
+  parameters.sorting = sorting;
+  parameters.sort_memory = sort_memory;
+  if (tmp_dir) {
+    parameters.tmp_dir = tmp_dir;
   }
-
-
-  cout << endl;
-  if (print_stats) {
-    cout << " Stats before minimizing the Graph:" << endl
-        << "====================================" << endl;
-    my_graph.print_stats(histogram_size);
+  parameters.regions = regions;
+  parameters.species = included_species;
+  parameters.excluded_species = excluded_species;
+  parameters.max_anchor_copies = max_anchor_copies;
+  parameters.max_anchor_hits = max_anchor_hits;
+  parameters.prescan = prescan;
+  parameters.memory_limit = memory_limit;
+  if (filtered_anchors_filename) {
+    parameters.filtered_anchors_filename = filtered_anchors_filename;
   }
-
-  my_graph.minimize(debug);
-  for (uint a = 0; a < path_dissimilarity; a++) {
-    my_graph.merge_alternative_paths(a + 1, 10000, debug);
-    my_graph.minimize(debug);
+  parameters.max_path_dissimilarity = path_dissimilarity;
+  parameters.simplify_graph = simplify_graph;
+  parameters.pipeline = pipeline;
+  parameters.skip_idle_minimize = skip_idle_minimize;
+  parameters.max_time = max_time;
+  parameters.max_pass_time = max_pass_time;
+  parameters.max_iterations = max_iterations;
+  parameters.max_total_iterations = max_total_iterations;
+  parameters.min_length = min_length;
+  parameters.min_regions = min_regions;
+  parameters.min_anchors = min_anchors;
+  parameters.max_ratio = max_ratio;
+  parameters.allow_bridges = allow_bridges;
+  parameters.all = print_all;
+  parameters.print_stats = print_stats;
+  parameters.histogram_size = histogram_size;
+  parameters.num_threads = num_threads;
+  parameters.debug = debug;
+  Enredo enredo(parameters);
+  if (checkpoint_filename) {
+    enredo.set_checkpoint_file(checkpoint_filename);
+    signal(SIGTERM, checkpoint_on_signal);
   }
 
-  if (print_stats) {
+  if (resume_filename) {
+    // The graph of the checkpoint replaces the input: the rest is as in the run interrupted
     cout << endl
-        << " Stats after minimizing the Graph:" << endl
-        << "===================================" << endl;
-    my_graph.print_stats(histogram_size);
-  }
-
-//   my_graph.study_anchors();
-  if (simplify_graph > 0) {
-    if (simplify_graph > 4) {
-      while (my_graph.simplify(min_anchors, 1, min_length, debug)) {
-        my_graph.minimize(debug);
-      }
-      if (simplify_graph > 5) {
-        while (my_graph.simplify_aggressive(min_anchors, min_regions, min_length, debug)) {
-          my_graph.minimize(debug);
-          my_graph.simplify(min_anchors, 1, min_length, debug);
-          my_graph.minimize(debug);
-        }
-      }
-      if (simplify_graph > 6) {
-        my_graph.split_unselected_links(min_anchors, min_regions, min_length, debug);
-        my_graph.minimize(debug);
-        my_graph.simplify(min_anchors, 1, min_length, debug);
-        my_graph.minimize(debug);
-        my_graph.simplify_aggressive(min_anchors, 1, min_length, debug);
-        my_graph.minimize(debug);
-      }
-    } else if (simplify_graph > 1) {
-      my_graph.simplify(min_anchors, 1, min_length, debug);
-      my_graph.minimize(debug);
-    } else {
-      my_graph.simplify(min_anchors, min_regions, min_length, debug);
-      my_graph.minimize(debug);
-    }
-    if (simplify_graph == 3 and path_dissimilarity > 0) {
-      my_graph.merge_alternative_paths(path_dissimilarity, 10000, debug);
-      my_graph.minimize(debug);
-    } else if (simplify_graph > 6) {
-      my_graph.resolve_small_palindromes(min_anchors, min_regions, min_length, debug);
-      my_graph.assimilate_small_insertions(min_anchors, min_regions, min_length, 100000, debug);
-      while (my_graph.merge_alternative_paths(0, 10000, debug)) {
-        my_graph.minimize(debug);
-      }
-      my_graph.assimilate_small_insertions(min_anchors, min_regions, min_length, 100000, debug);
-      my_graph.minimize(debug);
-    } else if (simplify_graph > 3) {
-      for (uint a = 0; a < path_dissimilarity; a++) {
-        my_graph.merge_alternative_paths(a + 1, 10000, debug);
-        my_graph.minimize(debug);
-      }
+        << " Reading checkpoint:" << endl
+        << "====================================" << endl;
+    if (!enredo.load_checkpoint(resume_filename)) {
+      cerr << "EXIT (Error while reading the checkpoint)" << endl;
+      exit(1);
     }
-    if (print_stats) {
-      cout << endl
-          << " Stats after simplifying the Graph:" << endl
-          << "===================================" << endl;
-      my_graph.print_stats(histogram_size);
+  } else if (load_graph_filename) {
+    cout << endl
+        << " Reading saved graph:" << endl
+        << "====================================" << endl;
+    if (!enredo.load_graph(load_graph_filename)) {
+      cerr << "EXIT (Error while reading the saved graph)" << endl;
+      exit(1);
     }
-//     my_graph.study_anchors();
   }
-  if (max_ratio > 1.0f) {
-    my_graph.split_unbalanced_links(max_ratio, debug);
-    my_graph.minimize(debug);
-    if (print_stats) {
-      my_graph.print_stats(histogram_size);
+  if (input_filename and !resume_filename) {
+    cout << endl
+        << " Reading input file:" << endl
+        << "====================================" << endl;
+    ret = enredo.load_file(input_filename);
+    if (!ret) {
+      cerr << "EXIT (Error while reading file)" << endl;
+      exit(1);
     }
   }
+  if (save_graph_filename and !resume_filename and !enredo.save_graph(save_graph_filename)) {
+    cerr << "EXIT (Cannot save the graph)" << endl;
+    exit(1);
+  }
+
+  if (!enredo.run()) {
+    cerr << "EXIT (Error while processing the graph)" << endl;
+    exit(1);
+  }
+  if (enredo.was_interrupted()) {
+    cerr << "EXIT (Interrupted: run the same command with --resume " << checkpoint_filename << " to go on)" << endl;
+    exit(1);
+  }
 
   cout << endl
       << " Resulting blocks:" << endl
       << "===================================" << endl;
   unsigned long int num_of_blocks;
+  ostringstream header;
   if (output_filename) {
-    ofstream output_stream(output_filename);
-    if (!output_stream.is_open()) {
-      cerr << "EXIT (Cannot open file <" << output_filename << "> for output)" << endl;
-      exit(1);
-    }
-    cout << "Results in file <" << output_filename << ">" << endl;
-    output_stream << "## Enredo v" << VERSION << endl
+    header << "## Enredo v" << VERSION << endl
         << "#" << endl
         << "#  Parameters:" << endl
-        << "# ====================================" << endl
-        << "# Input-file \"" << input_filename << "\"" << endl
+        << "# ====================================" << endl;
+    if (load_graph_filename) {
+      header << "# --load-graph " << load_graph_filename << endl;
+    }
+    if (input_filename) {
+      header << "# Input-file \"" << input_filename << "\"" << endl;
+    }
+    if (merge_overlap) {
+      header << "# --merge-overlap" << endl;
+    }
+    for (uint a = 0; a < regions.size(); a++) {
+      header << "# --region " << regions[a] << endl;
+    }
+    for (uint a = 0; a < included_species.size(); a++) {
+      header << "# --species " << included_species[a] << endl;
+    }
+    for (uint a = 0; a < excluded_species.size(); a++) {
+      header << "# --exclude-species " << excluded_species[a] << endl;
+    }
+    if (max_anchor_copies) {
+      header << "# --max-anchor-copies " << max_anchor_copies << endl;
+    }
+    if (max_anchor_hits) {
+      header << "# --max-anchor-hits " << max_anchor_hits << endl;
+    }
+    if (sorting == ENREDO_SORT_ALWAYS) {
+      header << "# --sort" << endl;
+    } else if (sorting == ENREDO_SORT_NEVER) {
+      header << "# --no-sort" << endl;
+    }
+    header
         << "# --min-score " << min_score << endl
         << "# --max-gap-length " << max_gap_length << endl
         << "# --max-path-dissimilarity " << path_dissimilarity << endl
@@ -251,36 +482,93 @@ int main(int argc, char *argv[])
         << "# --min-regions " << min_regions << endl
         << "# --min-anchors " << min_anchors << endl;
     if (max_ratio>1.0f) {
-      output_stream << "# --max-ratio " << max_ratio << endl;
+      header << "# --max-ratio " << max_ratio << endl;
+    } else {
+      header << "# max-ratio [off]" << endl;
+    }
+    if (pipeline.empty()) {
+      header
+//           << "# simplify-graph: " << (simplify_graph?"yes":"no") << endl
+          << "# --simplify-graph " << simplify_graph << endl;
     } else {
-      output_stream << "# max-ratio [off]" << endl;
+      header << "# --pipeline \"" << pipeline << "\"" << endl;
+    }
+    if (!skip_idle_minimize) {
+      header << "# --no-skip-idle-minimize" << endl;
+    }
+    if (max_time) {
+      header << "# --max-time " << max_time << endl;
+    }
+    if (max_pass_time) {
+      header << "# --max-pass-time " << max_pass_time << endl;
+    }
+    if (max_iterations) {
+      header << "# --max-iterations " << max_iterations << endl;
+    }
+    if (max_total_iterations) {
+      header << "# --max-total-iterations " << max_total_iterations << endl;
     }
-    output_stream 
-//         << "# simplify-graph: " << (simplify_graph?"yes":"no") << endl
-        << "# --simplify-graph " << simplify_graph << endl;
     if (print_all) {
-      output_stream << "# --all" << endl;
+      header << "# --all" << endl;
     } else if (allow_bridges) {
-      output_stream << "# --bridges" << endl;
+      header << "# --bridges" << endl;
     } else {
-      output_stream << "# [valid edges only]" << endl;
+      header << "# [valid edges only]" << endl;
     }
-    output_stream << endl;
-    if (print_all) {
-      num_of_blocks = my_graph.print_links(output_stream);
+    if (!enredo.get_stop_reason().empty()) {
+      header << "#" << endl
+          << "# Pipeline stopped early (" << enredo.get_stop_reason() << ")" << endl;
+    }
+    header << endl;
+  }
+  if (output_filename and binary_output) {
+    cout << "Results in file <" << output_filename << "> (binary)" << endl;
+    BlockFileWriter writer;
+    if (!writer.open(output_filename, header.str())) {
+      cerr << "EXIT (Cannot open file <" << output_filename << "> for output)" << endl;
+      exit(1);
+    }
+    num_of_blocks = enredo.write_blocks(writer);
+    if (!writer.close()) {
+      cerr << "EXIT (Cannot write file <" << output_filename << ">)" << endl;
+      exit(1);
+    }
+  } else if (output_filename) {
+    ofstream output_stream(output_filename);
+    if (!output_stream.is_open()) {
+      cerr << "EXIT (Cannot open file <" << output_filename << "> for output)" << endl;
+      exit(1);
+    }
+    cout << "Results in file <" << output_filename << ">" << endl;
+    output_stream << header.str();
+    if (block_index) {
+      BlockIndex index;
+      num_of_blocks = enredo.print_blocks(output_stream, &index);
+      cout << "Index of the blocks in file <" << BlockIndex::get_filename(output_filename) << ">" << endl;
+      if (!index.write(BlockIndex::get_filename(output_filename))) {
+        cerr << "EXIT (Cannot write the index of the blocks)" << endl;
+        exit(1);
+      }
     } else {
-      num_of_blocks = my_graph.print_links(output_stream, min_anchors, min_regions, min_length, allow_bridges);
+      num_of_blocks = enredo.print_blocks(output_stream);
     }
     output_stream.close();
   } else {
-    if (print_all) {
-      num_of_blocks = my_graph.print_links(cout);
-    } else {
-      num_of_blocks = my_graph.print_links(cout, min_anchors, min_regions, min_length, allow_bridges);
-    }
+    num_of_blocks = enredo.print_blocks(cout);
   }
   cout << " Got " << num_of_blocks << " blocks." << endl;
 
+  if (serve_socket) {
+    cout << endl
+        << " Serving requests:" << endl
+        << "===================================" << endl;
+    Server server(enredo);
+    if (!server.open(serve_socket) or !server.serve(cout)) {
+      cerr << "EXIT (Error in the server)" << endl;
+      exit(1);
+    }
+  }
+
   return EXIT_SUCCESS;
 }
 
@@ -294,12 +582,44 @@ void print_help(void)
       << "Options:" << endl
       << " --max-gap-length: maximum allowed gap between two anchors (def: 100000)"  << endl
       << " --min-score: minimum score required to accept a hit" << endl
+      << " --merge-overlap: merge overlapping hits while reading the file (like mergeoverlap)" << endl
+      << " --merge-overlap-output: same, and write the merged anchors in that file" << endl
+      << " --species: only load the hits of these species (comma-separated list)" << endl
+      << " --exclude-species: do not load the hits of these species" << endl
+      << " --region: only load the hits in this region (species:chr[:start-end]). The" << endl
+      << "       file must be indexed (see indexanchors). Can be used several times" << endl
+      << " --max-anchor-copies: skip the anchors found more times per species (def: no limit)" << endl
+      << " --max-anchor-hits: skip the anchors found more times in total (def: no limit)" << endl
+      << " --filtered-anchors-output: write the anchors skipped by these limits in that file" << endl
+      << " --[no-]prescan: count the anchors in the file before loading it (def: no)" << endl
+      << " --[no-]sort: sort the anchors file before loading it (def: only if not sorted)" << endl
+      << " --sort-memory: memory used for sorting, in MB (def: 1024)" << endl
+      << " --tmp-dir: directory for the temporary files (def: $TMPDIR or /tmp)" << endl
+      << " --memory-limit: keep the links in a temporary file, with up to this number" << endl
+      << "       of MB in memory (def: off)" << endl
+      << " --threads: number of threads (def: 0, one per core)" << endl
+      << " --save-graph: save the graph before and after the pipeline in that file" << endl
+      << " --load-graph: start from a graph saved with --save-graph and add the hits of" << endl
+      << "       the anchors file, which must be from new species (see README)" << endl
+      << " --checkpoint: on SIGTERM, save the graph in that file before the next stage" << endl
+      << "       of the pipeline and exit" << endl
+      << " --resume: go on from a checkpoint, with the same options as the run" << endl
+      << "       interrupted. The anchors file is not read again" << endl
       << endl
       << " --max-path-dissimilarity: merge alternative paths in the graph if their" << endl
       << "       dissimilarity is up to this threshold (def: 0)" << endl
       << " --simplify-graph: try to split small edges in order to lengthen" << endl
       << "       other blocks. Ranges from 0 (none) to 7 (more aggressive)." << endl
       << "       (def: 0)" << endl
+      << " --pipeline: stages to apply to the graph, instead of the ones set by" << endl
+      << "       --simplify-graph, like \"minimize repeat(simplify(1) minimize)\"" << endl
+      << " --[no-]skip-idle-minimize: skip minimizing the graph when no stage has" << endl
+      << "       changed it since the last minimize (def: yes)" << endl
+      << " --max-time: stop the pipeline after that many seconds (def: no limit)" << endl
+      << " --max-pass-time: skip each pass after it has run for that many seconds" << endl
+      << " --max-iterations: stop each repeat() loop after that many iterations" << endl
+      << " --max-total-iterations: stop the pipeline after that many iterations of" << endl
+      << "       all the repeat() loops" << endl
       << endl
       << " --min-length: minimum length of a valid blocks (def: 100000)" << endl
       << " --min-regions: minimum number of region in a valid block (def: 2)" << endl
@@ -310,6 +630,13 @@ void print_help(void)
       << " --[no]stats: Print some stats about the blocks" << endl
       << " --histogram-size: size for histogram of num. of regions pero link (def: 10)" << endl
       << endl
+      << " --output-format: text or binary (def: text). See blocks2text" << endl
+      << " --block-index: write an index of the blocks in the output file plus .ebi" << endl
+      << "       (see queryblocks)" << endl
+      << endl
+      << " --serve: keep the graph in memory and answer requests on this Unix socket" << endl
+      << "       once the blocks are printed (see README)" << endl
+      << endl
       << " --help: prints this help" << endl
       << endl
       << "See README file for more details." << endl
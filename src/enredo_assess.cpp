@@ -0,0 +1,126 @@
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <iostream>
+#include <fstream>
+#include <cstdlib>
+#include "assess.h"
+#include "threads.h"
+
+using namespace std;
+
+void print_help(void);
+
+int main(int argc, char *argv[])
+{
+  char *filename = NULL;
+  char *output_filename = NULL;
+  unsigned int num_threads = 0;
+  bool help = false;
+  string this_arg;
+  Assessment assessment;
+
+  /* The annotation files are read once the blocks are loaded */
+  vector<string> annotation_species;
+  vector<char*> annotation_files;
+  vector<int> annotation_types; // -1 for sizes files
+  for (int a = 1; a < argc; a++) {
+    this_arg = argv[a];
+    if ((this_arg == "--sizes" or this_arg == "--gaps" or this_arg == "--repeats" or this_arg == "--genes" or
+        this_arg == "--pseudogenes") and (a < argc - 2)) {
+      annotation_species.push_back(argv[a + 1]);
+      annotation_files.push_back(argv[a + 2]);
+      if (this_arg == "--sizes") {
+        annotation_types.push_back(-1);
+      } else if (this_arg == "--gaps") {
+        annotation_types.push_back(ASSESS_GAPS);
+      } else if (this_arg == "--repeats") {
+        annotation_types.push_back(ASSESS_REPEATS);
+      } else if (this_arg == "--genes") {
+        annotation_types.push_back(ASSESS_GENES);
+      } else {
+        annotation_types.push_back(ASSESS_PSEUDOGENES);
+      }
+      a += 2;
+    } else if (((this_arg == "--output") or (this_arg == "-o")) and (a < argc - 1)) {
+      a++;
+      output_filename = argv[a];
+    } else if ((this_arg == "--threads") and (a < argc - 1)) {
+      a++;
+      num_threads = atoi(argv[a]);
+    } else if ((this_arg == "--help") or (this_arg == "-h")) {
+      help = true;
+    } else if (!filename) {
+      filename = argv[a];
+    } else {
+      cerr << "Unknown option: " << this_arg << endl;
+      exit(1);
+    }
+  }
+
+  if (help or !filename) {
+    print_help();
+    exit(0);
+  }
+
+  set_num_threads(num_threads);
+  if (!assessment.read_blocks(filename)) {
+    exit(1);
+  }
+  for (uint a = 0; a < annotation_files.size(); a++) {
+    bool ret;
+    if (annotation_types[a] < 0) {
+      ret = assessment.read_sizes(annotation_species[a], annotation_files[a]);
+    } else {
+      ret = assessment.read_annotation(annotation_species[a], annotation_files[a],
+          (annotation_type)annotation_types[a]);
+    }
+    if (!ret) {
+      exit(1);
+    }
+  }
+  assessment.assess();
+
+  if (output_filename) {
+    ofstream output_stream(output_filename);
+    if (!output_stream.is_open()) {
+      cerr << "Cannot open file <" << output_filename << "> for output" << endl;
+      exit(1);
+    }
+    assessment.print(output_stream);
+    output_stream.close();
+  } else {
+    assessment.print(cout);
+  }
+
+  return EXIT_SUCCESS;
+}
+
+void print_help(void)
+{
+  cout << "Enredo-assess v" << VERSION << endl;
+  cout << endl;
+  cout << "Usage: enredo-assess [options] enredo_output.txt" << endl;
+  cout << endl;
+  cout << "Prints the coverage, N50, duplication and gene coverage stats of the blocks" << endl;
+  cout << "of an enredo output file, like tools/assess_graph.pl, using local files." << endl;
+  cout << "The annotation files can be BED or GFF/GTF (if the name has .gff or .gtf)." << endl;
+  cout << "All of them can be gzipped." << endl;
+  cout << endl;
+  cout << "Options:" << endl;
+  cout << " --sizes species file: length of the chromosomes (chr and length columns," << endl;
+  cout << "       like a .fai or a chrom.sizes file). Needed for the coverage percentages" << endl;
+  cout << " --gaps species file: assembly gaps" << endl;
+  cout << " --repeats species file: repeats" << endl;
+  cout << " --genes species file: protein coding genes" << endl;
+  cout << " --pseudogenes species file: pseudogenes" << endl;
+  cout << " --threads: number of threads (def: 0, one per core)" << endl;
+  cout << " --output: write output to that file (def: STDOUT)" << endl;
+  cout << endl;
+  cout << " --help: prints this help" << endl;
+  cout << endl;
+  cout << "See README file for more details." << endl;
+  cout << endl;
+}
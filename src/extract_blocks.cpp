@@ -0,0 +1,216 @@
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstdlib>
+#include <map>
+#include <algorithm>
+#include "libenredo.h"
+#include "fasta.h"
+#include "index.h"
+#include "input.h"
+#include "threads.h"
+
+using namespace std;
+
+void print_help(void);
+bool read_blocks(char *filename, vector<enredo_block> &blocks);
+
+//! Body of the parallel loop: writes the FASTA file of one block
+struct block_writer {
+  vector<enredo_block> *blocks;
+  map<string, FastaFile*> *genomes;
+  string prefix;
+  unsigned int line_length;
+  vector<string> errors; //!< one per block, empty if the block has been written
+
+  void operator()(unsigned long index) {
+    ostringstream block_filename;
+    block_filename << prefix << index << ".fa";
+    ofstream out(block_filename.str().c_str());
+    if (!out.is_open()) {
+      errors[index] = "Cannot open file " + block_filename.str();
+      return;
+    }
+    string sequence;
+    for (vector<enredo_region>::iterator it = (*blocks)[index].regions.begin();
+        it != (*blocks)[index].regions.end(); it++) {
+      map<string, FastaFile*>::iterator p_genome = genomes->find(it->species);
+      if (p_genome == genomes->end()) {
+        errors[index] = "No genome for species " + it->species;
+        return;
+      }
+      if (!p_genome->second->get_sequence(it->chr, it->start, it->end, it->strand, sequence)) {
+        ostringstream error;
+        error << "Cannot get " << it->species << ":" << it->chr << ":" << it->start << ":" << it->end << " from "
+            << p_genome->second->filename;
+        errors[index] = error.str();
+        return;
+      }
+      out << ">" << it->species << ":" << it->chr << ":" << it->start << ":" << it->end << " [" << it->strand << "]"
+          << endl;
+      for (unsigned long long position = 0; position < sequence.size(); position += line_length) {
+        out.write(sequence.data() + position, min((unsigned long long)line_length, sequence.size() - position));
+        out << "\n";
+      }
+    }
+    out.close();
+    if (out.fail()) {
+      errors[index] = "Cannot write file " + block_filename.str();
+    }
+  }
+};
+
+int main(int argc, char *argv[])
+{
+  char *filename = NULL;
+  string output_dir = ".";
+  string prefix = "block_";
+  unsigned int line_length = 60;
+  unsigned int num_threads = 0;
+  vector<string> genome_species;
+  vector<char*> genome_files;
+  bool help = false;
+  string this_arg;
+
+  for (int a = 1; a < argc; a++) {
+    this_arg = argv[a];
+    if ((this_arg == "--genome") and (a < argc - 2)) {
+      genome_species.push_back(argv[a + 1]);
+      genome_files.push_back(argv[a + 2]);
+      a += 2;
+    } else if ((this_arg == "--output-dir") and (a < argc - 1)) {
+      a++;
+      output_dir = argv[a];
+    } else if ((this_arg == "--prefix") and (a < argc - 1)) {
+      a++;
+      prefix = argv[a];
+    } else if ((this_arg == "--line-length") and (a < argc - 1)) {
+      a++;
+      line_length = atoi(argv[a]);
+    } else if ((this_arg == "--threads") and (a < argc - 1)) {
+      a++;
+      num_threads = atoi(argv[a]);
+    } else if ((this_arg == "--help") or (this_arg == "-h")) {
+      help = true;
+    } else if (!filename) {
+      filename = argv[a];
+    } else {
+      cerr << "Unknown option: " << this_arg << endl;
+      exit(1);
+    }
+  }
+
+  if (help or !filename or genome_files.empty()) {
+    print_help();
+    exit(0);
+  }
+  if (line_length == 0) {
+    cerr << "Wrong line length" << endl;
+    exit(1);
+  }
+
+  map<string, FastaFile*> genomes;
+  for (uint a = 0; a < genome_files.size(); a++) {
+    FastaFile *genome = new FastaFile();
+    if (!genome->open(genome_files[a])) {
+      exit(1);
+    }
+    genomes[genome_species[a]] = genome;
+  }
+  vector<enredo_block> blocks;
+  if (!read_blocks(filename, blocks)) {
+    exit(1);
+  }
+
+  set_num_threads(num_threads);
+  block_writer writer;
+  writer.blocks = &blocks;
+  writer.genomes = &genomes;
+  writer.prefix = output_dir + "/" + prefix;
+  writer.line_length = line_length;
+  writer.errors.resize(blocks.size());
+  parallel_for(blocks.size(), writer);
+  for (uint a = 0; a < writer.errors.size(); a++) {
+    if (!writer.errors[a].empty()) {
+      cerr << "Block " << a << ": " << writer.errors[a] << endl;
+      exit(1);
+    }
+  }
+  cout << "Wrote " << blocks.size() << " blocks in " << output_dir << endl;
+
+  for (map<string, FastaFile*>::iterator it = genomes.begin(); it != genomes.end(); it++) {
+    delete it->second;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+
+/*!
+    \fn read_blocks(char *filename, vector<enredo_block> &blocks)
+    Reads the regions of the blocks of an enredo output file, in order
+ */
+bool read_blocks(char *filename, vector<enredo_block> &blocks)
+{
+  InputStream in;
+  if (!in.open(filename)) {
+    cerr << "Cannot open file " << filename << endl;
+    return false;
+  }
+  bool in_block = false;
+  string line;
+  while (in.getline(line)) {
+    if (line.empty()) {
+      in_block = false;
+      continue;
+    } else if (line[0] == '#') {
+      continue;
+    } else if (line.compare(0, 5, "block") == 0) {
+      blocks.push_back(enredo_block());
+      in_block = true;
+      continue;
+    }
+    enredo_region this_region;
+    if (!in_block or !parse_block_region(line, this_region.species, this_region.chr, this_region.start,
+        this_region.end, this_region.strand)) {
+      cerr << "Wrong line in " << filename << ": <" << line << ">" << endl;
+      return false;
+    }
+    blocks.back().regions.push_back(this_region);
+  }
+  if (in.error) {
+    cerr << "Cannot read file " << filename << endl;
+    return false;
+  }
+
+  return true;
+}
+
+
+void print_help(void)
+{
+  cout << "ExtractBlocks v" << VERSION << endl;
+  cout << endl;
+  cout << "Usage: extractblocks [options] --genome species genome.fa [...] enredo_output.txt" << endl;
+  cout << endl;
+  cout << "Writes one FASTA file per block of an enredo output file, with the sequence of" << endl;
+  cout << "each of its regions (reverse complemented on the -1 strand). The genomes must" << endl;
+  cout << "be plain FASTA files indexed with samtools faidx." << endl;
+  cout << endl;
+  cout << "Options:" << endl;
+  cout << " --genome species file: genome of a species. Can be used several times" << endl;
+  cout << " --output-dir: directory for the FASTA files (def: .)" << endl;
+  cout << " --prefix: name of the FASTA files, followed by the block number (def: block_)" << endl;
+  cout << " --line-length: bases per line (def: 60)" << endl;
+  cout << " --threads: number of threads (def: 0, one per core)" << endl;
+  cout << endl;
+  cout << " --help: prints this help" << endl;
+  cout << endl;
+  cout << "See README file for more details." << endl;
+  cout << endl;
+}
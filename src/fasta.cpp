@@ -0,0 +1,152 @@
+#include "fasta.h"
+#include <fstream>
+#include <sstream>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+using namespace std;
+
+//! Complement of each base, keeping the case. Anything else is left as it is
+struct complement_table {
+  char bases[256];
+
+  complement_table() {
+    for (int a = 0; a < 256; a++) {
+      bases[a] = a;
+    }
+    const char *from = "ACGTUMRWSYKVHDBNacgtumrwsykvhdbn";
+    const char *to = "TGCAAKYWSRMBDHVNtgcaakywsrmbdhvn";
+    for (int a = 0; from[a]; a++) {
+      bases[(unsigned char)from[a]] = to[a];
+    }
+  }
+};
+
+static complement_table complement;
+
+FastaFile::FastaFile()
+{
+  data = NULL;
+  data_size = 0;
+}
+
+
+FastaFile::~FastaFile()
+{
+  close();
+}
+
+
+/*!
+    \fn FastaFile::open(char *filename)
+ */
+bool FastaFile::open(char *filename)
+{
+  close();
+  this->filename = filename;
+  string index_filename = string(filename) + ".fai";
+  ifstream index(index_filename.c_str());
+  if (!index.is_open()) {
+    cerr << "Cannot open file " << index_filename << " (index the FASTA file with samtools faidx)" << endl;
+    return false;
+  }
+  string line;
+  while (getline(index, line)) {
+    istringstream fields(line);
+    string name;
+    fasta_sequence this_sequence;
+    if (!(fields >> name >> this_sequence.length >> this_sequence.offset >> this_sequence.line_bases
+        >> this_sequence.line_width) or this_sequence.line_bases == 0 or
+        this_sequence.line_width < this_sequence.line_bases) {
+      cerr << "Wrong line in " << index_filename << ": <" << line << ">" << endl;
+      return false;
+    }
+    sequences[name] = this_sequence;
+  }
+
+  int fd = ::open(filename, O_RDONLY);
+  struct stat file_stat;
+  if (fd < 0 or fstat(fd, &file_stat) != 0) {
+    cerr << "Cannot open file " << filename << ": " << strerror(errno) << endl;
+    if (fd >= 0) {
+      ::close(fd);
+    }
+    return false;
+  }
+  data_size = file_stat.st_size;
+  if (data_size) {
+    void *start = mmap(NULL, data_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (start == MAP_FAILED) {
+      cerr << "Cannot map file " << filename << ": " << strerror(errno) << endl;
+      ::close(fd);
+      return false;
+    }
+    data = (const char*)start;
+  }
+  ::close(fd);
+
+  return true;
+}
+
+
+/*!
+    \fn FastaFile::close()
+ */
+void FastaFile::close(void)
+{
+  if (data) {
+    munmap((void*)data, data_size);
+  }
+  data = NULL;
+  data_size = 0;
+  sequences.clear();
+}
+
+
+/*!
+    \fn FastaFile::get_sequence(const string &name, unsigned int start, unsigned int end, int strand, string &sequence)
+    The case of the bases is kept (soft-masked repeats stay in lower case). Returns false if the
+    region is not within the sequence.
+ */
+bool FastaFile::get_sequence(const string &name, unsigned int start, unsigned int end, int strand,
+    string &sequence)
+{
+  map<string, fasta_sequence>::iterator it = sequences.find(name);
+  if (it == sequences.end() or start < 1 or end < start or end > it->second.length) {
+    return false;
+  }
+  fasta_sequence &this_sequence = it->second;
+  sequence.resize(end - start + 1);
+  unsigned long long position = start - 1;
+  unsigned long long copied = 0;
+  while (copied < sequence.size()) {
+    unsigned long long line = position / this_sequence.line_bases;
+    unsigned long long column = position % this_sequence.line_bases;
+    unsigned long long offset = this_sequence.offset + line * this_sequence.line_width + column;
+    unsigned long long length = this_sequence.line_bases - column;
+    if (length > sequence.size() - copied) {
+      length = sequence.size() - copied;
+    }
+    if (offset + length > data_size) {
+      return false;
+    }
+    memcpy(&sequence[copied], data + offset, length);
+    copied += length;
+    position += length;
+  }
+
+  if (strand < 0) {
+    unsigned long long last = sequence.size() - 1;
+    for (unsigned long long a = 0; a <= last / 2; a++) {
+      char base = complement.bases[(unsigned char)sequence[a]];
+      sequence[a] = complement.bases[(unsigned char)sequence[last - a]];
+      sequence[last - a] = base;
+    }
+  }
+
+  return true;
+}
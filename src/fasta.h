@@ -0,0 +1,44 @@
+#ifndef FASTA_H
+#define FASTA_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+
+//! One sequence of a FASTA file, as in its .fai index (see samtools faidx)
+
+struct fasta_sequence {
+  unsigned long long length;
+  unsigned long long offset; //!< position of the first base in the file
+  unsigned long long line_bases;
+  unsigned long long line_width; //!< bases plus the end of line
+};
+
+//! Random access to the sequences of a FASTA file indexed with samtools faidx
+
+/*!
+    The file is memory-mapped, so the sequences are read straight from the page cache and any
+    number of threads can read them at the same time. Only plain text FASTA files can be used.
+ */
+class FastaFile{
+public:
+    FastaFile();
+
+    ~FastaFile();
+    //! Opens the FASTA file and reads its index (filename plus .fai)
+    bool open(char *filename);
+    //! Gets the bases from start to end (1-based, both included). strand -1 gets the reverse complement
+    bool get_sequence(const std::string &name, unsigned int start, unsigned int end, int strand,
+        std::string &sequence);
+    void close(void);
+
+    std::string filename;
+
+  protected:
+    std::map<std::string, fasta_sequence> sequences;
+    const char *data;
+    unsigned long long data_size;
+};
+
+#endif
@@ -1,14 +1,21 @@
 #include "graph.h"
 #include "anchor.h"
+#include "overlap.h"
+#include "threads.h"
+#include "stats.h"
+#include "spill.h"
 #include <iostream>
 #include <fstream>
 #include <sstream>
 #include <cstdlib>
 #include <set>
 #include <vector>
+#include <algorithm>
 #include <fstream>
 #include <iomanip>
 #include <math.h>
+#include <sys/stat.h>
+#include <sys/time.h>
 
 using namespace std;
 
@@ -17,6 +24,22 @@ bool DEBUG = false;
 Graph::Graph()
 {
   anchors.clear();
+  min_score = 0.0f;
+  max_gap_length = 0;
+  long_gap_counter = 0;
+  last_anchor = NULL;
+  last_start = 0;
+  last_end = 0;
+  sorting = SORT_AUTO;
+  sort_max_memory = DEFAULT_SORT_MEMORY;
+  unsorted_input = false;
+  sorted_start = 0;
+  max_anchor_copies = 0;
+  max_anchor_hits = 0;
+  prescan = false;
+  max_position_length = 0;
+  updating = false;
+  log = &cout;
 }
 
 Graph::~Graph()
@@ -24,6 +47,48 @@ Graph::~Graph()
 }
 
 
+/*!
+    \fn Graph::clear()
+ */
+void Graph::clear(void)
+{
+  set<Link*> all_links;
+  for (map<string, Anchor*>::iterator it = anchors.begin(); it != anchors.end(); it++) {
+    if (!it->second) {
+      continue;
+    }
+    for (list<Link*>::iterator p_link = it->second->links.begin(); p_link != it->second->links.end(); p_link++) {
+      all_links.insert(*p_link);
+    }
+  }
+  for (set<Link*>::iterator it = all_links.begin(); it != all_links.end(); it++) {
+    delete(*it);
+  }
+  for (map<string, Anchor*>::iterator it = anchors.begin(); it != anchors.end(); it++) {
+    delete(it->second);
+  }
+  anchors.clear();
+  for (map<string, Anchor*>::iterator it = retired_anchors.begin(); it != retired_anchors.end(); it++) {
+    delete(it->second);
+  }
+  retired_anchors.clear();
+  anchor_index.clear();
+  bridge_links.clear();
+  clear_position_index();
+  for (map<string, string*>::iterator it = species.begin(); it != species.end(); it++) {
+    delete(it->second);
+  }
+  species.clear();
+  for (map<string, string*>::iterator it = chrs.begin(); it != chrs.end(); it++) {
+    delete(it->second);
+  }
+  chrs.clear();
+  updating = false;
+  previous_species.clear();
+  updated_anchors.clear();
+}
+
+
 /*!
     \fn Graph::add_Anchor(Anchor *this_anchor)
  */
@@ -33,15 +98,44 @@ void Graph::add_Anchor(Anchor *this_anchor)
 }
 
 
+/*!
+    \fn Graph::restore_Anchor(Anchor *this_anchor)
+    The Anchor goes back to its place in the graph. If a pass is going through the Anchors, it will
+    find it if it is after the current one, as if it had never been moved out.
+ */
+void Graph::restore_Anchor(Anchor *this_anchor)
+{
+  retired_anchors.erase(this_anchor->id);
+  this_anchor->retired_from = NULL;
+  add_Anchor(this_anchor);
+}
+
+
 /*!
     \fn Graph::get_Anchor(string id)
  */
 Anchor* Graph::get_Anchor(string id)
 {
+  if (!anchor_index.empty()) {
+    unordered_map<string, Anchor*>::iterator it = anchor_index.find(id);
+    if (it != anchor_index.end()) {
+      it->second->num++;
+      return it->second;
+    }
+  }
   if (anchors[id]) {
     anchors[id]->num ++;
     return anchors[id];
   }
+  if (!retired_anchors.empty()) {
+    map<string, Anchor*>::iterator it = retired_anchors.find(id);
+    if (it != retired_anchors.end()) {
+      Anchor *this_anchor = it->second;
+      restore_Anchor(this_anchor);
+      this_anchor->num++;
+      return this_anchor;
+    }
+  }
 
   // id was not found => create a new Anchor
   Anchor* new_anchor = new Anchor(id);
@@ -54,222 +148,755 @@ Anchor* Graph::get_Anchor(string id)
 
 
 /*!
-    \fn Graph::populate_from_file(string filename)
+    \fn Graph::populate_from_file(char *filename, float min_score, int max_gap_length, bool anchors_as_links, bool merge_overlap, char *merged_filename)
+    If merge_overlap is set, overlapping hits are merged while reading the file, like mergeoverlap
+    does. The merged anchors file is written in merged_filename, if any.
+
+    By default, the file is loaded as it comes. If it turns out not to be sorted, the Graph is
+    cleared and the file is read again through a SortedHitReader (see Graph::set_sorting).
+
+    If some regions have been set (see Graph::add_region), only the hits in these regions are read
+    using the index of the file.
+
+    If an anchor filter has been set (see Graph::set_anchor_filter) or with a pre-scan (see
+    Graph::set_prescan), the file is read twice: the first time to count the hits of each Anchor
+    (see Graph::prescan_file). The pre-scan also tells whether the file is sorted, so it is never
+    loaded twice.
+
+    While updating a saved graph (see Graph::start_update), an anchors file that may not be sorted is
+    always sorted, as the Graph cannot be cleared.
+
+    Hits from species not selected (see Graph::include_species and Graph::exclude_species) are
+    skipped before parsing them. If the file has an up-to-date index, these species are not even
+    read. Skipped hits do not break the path between the hits before and after them.
  */
-bool Graph::populate_from_file(char *filename, float min_score, int max_gap_length, bool anchors_as_links)
+bool Graph::populate_from_file(char *filename, float min_score, int max_gap_length, bool anchors_as_links,
+    bool merge_overlap, char *merged_filename)
 {
-  ifstream inputfile (filename);
-  string line;
-  if (!inputfile.is_open()) {
-    cerr << "Cannot open file " << filename << endl;
+  species_filter *filter = NULL;
+  if (!selected_species.included.empty() or !selected_species.excluded.empty()) {
+    filter = &selected_species;
+  }
+  vector<region> these_regions = regions;
+  if (filter and regions.empty() and !merge_overlap and sorting != SORT_ALWAYS and
+      get_species_regions(filename, these_regions)) {
+    *log << "Using the index of the anchors file to skip the species not selected" << endl;
+  }
+
+  if (!these_regions.empty() and (merge_overlap or sorting == SORT_ALWAYS)) {
+    cerr << "Regions cannot be used with --merge-overlap or --sort" << endl;
+    return false;
+  }
+  bool is_sorted = true;
+  bool prescanned = (prescan or max_anchor_copies or max_anchor_hits);
+  if (prescanned and !prescan_file(filename, these_regions, filter, min_score, is_sorted)) {
     return false;
   }
 
-  unsigned long long int line_counter = 0;
-  uint long_gap_counter = 0;
-  Anchor *last_anchor = NULL;
-  string last_species;
-  string last_chr;
-  int last_start;
-  int last_end;
-  string last_strand;
-  while (!inputfile.eof()) {
-    getline(inputfile, line);
-    if (line[0] == '#' or inputfile.eof()) {
-      continue;
-    } else if (line == "--") {
-      last_species = "";
-      continue;
+  if (!these_regions.empty()) {
+    IndexedHitReader reader;
+    reader.filter = filter;
+    if (!reader.open(filename)) {
+      return false;
     }
-    string this_anchor_id;
-    string this_species;
-    string this_chr;
-    int this_start;
-    int this_end;
-    string this_strand;
-    float this_score;
-
-    stringstream streamline;
-    streamline << line;
-    streamline
-        >> this_anchor_id >> this_species >> this_chr
-        >> this_start >> this_end >> this_strand >> this_score;
-    if (streamline.fail()) {
-      cerr << "Error reading line (" << line_counter << ")<" << line << ">" << endl;
-      inputfile.close();
+    for (uint a = 0; a < these_regions.size(); a++) {
+      if (!reader.add_region(these_regions[a])) {
+        *log << "No hits in " << these_regions[a].species << ":" << these_regions[a].chr << endl;
+      }
+    }
+    return populate_from_reader(reader, min_score, max_gap_length);
+  }
+  if (merge_overlap and sorting == SORT_ALWAYS) {
+    cerr << "Cannot sort the anchors file and merge the overlapping hits at the same time" << endl;
+    return false;
+  }
+  if (!merge_overlap and sorting == SORT_AUTO and !is_sorted) {
+    *log << "The anchors file is not sorted by species, chromosome and position: sorting it" << endl;
+  } else if (!merge_overlap and sorting == SORT_AUTO and updating and !prescanned) {
+    // If the file turned out not to be sorted, the Graph could not be cleared to read it again
+    *log << "Sorting the anchors file, as a saved graph is being updated" << endl;
+  } else if (!merge_overlap and sorting != SORT_ALWAYS) {
+    HitReader reader;
+    reader.filter = filter;
+    if (!reader.open(filename)) {
       return false;
     }
-    if (this_start > this_end) {
-      cerr << "start cannot be longer than end in <" << line << ">" << endl;
-      inputfile.close();
+    if (populate_from_reader(reader, min_score, max_gap_length, sorting == SORT_AUTO)) {
+      return true;
+    } else if (!unsorted_input) {
+      return false;
+    } else if (string(filename) == "-") {
+      cerr << "The anchors file is not sorted and STDIN cannot be read twice. Use --sort" << endl;
       return false;
     }
-    if (this_strand != "+" and this_strand != "-") {
-      cerr << "strand must be + or - in <" << line << ">" << endl;
-      inputfile.close();
+    *log << "The anchors file is not sorted by species, chromosome and position: sorting it" << endl;
+    clear();
+  }
+  if (!merge_overlap) {
+    SortedHitReader reader(min_score, sort_max_memory, sort_tmp_dir);
+    reader.log = log;
+    reader.filter = filter;
+    if (!reader.open(filename)) {
       return false;
     }
-    if (this_score < min_score) {
+    return populate_from_reader(reader, min_score, max_gap_length);
+  }
+
+  MergedHitReader reader(min_score);
+  reader.filter = filter;
+  ofstream merged_file;
+  if (merged_filename) {
+    merged_file.open(merged_filename);
+    if (!merged_file.is_open()) {
+      cerr << "Cannot open file " << merged_filename << endl;
+      return false;
+    }
+    reader.output = &merged_file;
+  }
+  if (!reader.open(filename)) {
+    return false;
+  }
+  bool ret = populate_from_reader(reader, min_score, max_gap_length, sorting == SORT_AUTO);
+  if (merged_filename) {
+    merged_file.close();
+  }
+  if (unsorted_input) {
+    cerr << "The anchors file must be sorted by species, chromosome and position in order to merge the"
+        << " overlapping hits" << endl;
+  }
+  return ret;
+}
+
+
+/*!
+    \fn Graph::get_species_regions(char *filename, vector<region> &species_regions)
+    Gets one region for each chromosome of the selected species from the index of the file. Returns
+    false if there is no index or if it is older than the file.
+ */
+bool Graph::get_species_regions(char *filename, vector<region> &species_regions)
+{
+  struct stat file_stat, index_stat;
+  string index_filename = AnchorsIndex::get_filename(filename);
+  if (string(filename) == "-" or stat(filename, &file_stat) != 0 or
+      stat(index_filename.c_str(), &index_stat) != 0 or index_stat.st_mtime < file_stat.st_mtime) {
+    return false;
+  }
+  AnchorsIndex index;
+  if (!index.read(index_filename)) {
+    return false;
+  }
+  species_regions.clear();
+  for (uint a = 0; a < index.sequences.size(); a++) {
+    if (selected_species.selects(index.sequences[a].species)) {
+      region this_region;
+      this_region.species = index.sequences[a].species;
+      this_region.chr = index.sequences[a].chr;
+      this_region.start = 0;
+      this_region.end = -1;
+      species_regions.push_back(this_region);
+    }
+  }
+
+  return !species_regions.empty();
+}
+
+
+/*!
+    \fn Graph::include_species(string name)
+ */
+void Graph::include_species(string name)
+{
+  selected_species.included.insert(name);
+}
+
+
+/*!
+    \fn Graph::exclude_species(string name)
+ */
+void Graph::exclude_species(string name)
+{
+  selected_species.excluded.insert(name);
+}
+
+
+/*!
+    \fn Graph::set_anchor_filter(uint max_copies, unsigned long max_hits)
+    Anchors from repeats are found many times in each species. Their Links are hardly ever part of
+    a valid block but they make the graph very slow to build and to minimize. An Anchor is skipped if
+    it has more than max_copies hits per species (on average) or more than max_hits hits in total.
+    This only applies to Graph::populate_from_file.
+ */
+void Graph::set_anchor_filter(uint max_copies, unsigned long max_hits)
+{
+  max_anchor_copies = max_copies;
+  max_anchor_hits = max_hits;
+  filtered_anchors.clear();
+}
+
+
+//! Hits and species of an Anchor (one bit per species) while counting them in Graph::prescan_file
+
+struct anchor_hits {
+  unsigned long hits;
+  species_mask species;
+
+  anchor_hits() : hits(0) {}
+};
+
+
+//! Returns the current time in seconds
+
+static double get_time(void)
+{
+  struct timeval now;
+  gettimeofday(&now, NULL);
+
+  return now.tv_sec + now.tv_usec / 1000000.0;
+}
+
+
+/*!
+    \fn Graph::set_prescan(bool prescan)
+    The anchors file is read twice: the first time only counts the Anchors, species, chromosomes
+    and hits (see Graph::prescan_file). All the Anchors are then created at once and found through
+    a hash table while loading the hits, and an unsorted file is sorted straight away.
+ */
+void Graph::set_prescan(bool prescan)
+{
+  this->prescan = prescan;
+}
+
+
+/*!
+    \fn Graph::prescan_file(char *filename, vector<region> &these_regions, species_filter *filter, float min_score, bool &is_sorted)
+    Reads the whole file (or these regions only) and counts the hits and species of each Anchor.
+
+    If an anchor filter is set, the Anchors above the thresholds go to filtered_anchors and their
+    hits are skipped by Graph::add_hit. When merging overlapping hits, the hits are counted before
+    merging them. Each hit of an Anchor looks for its Link among all the Links of the Anchor, so the
+    number of look-ups avoided while loading is up to the square of the number of hits removed per
+    Anchor.
+
+    If prescan is set, the other Anchors are added to the Graph (with no hits yet) and to
+    anchor_index. With no anchor filter, they are added as they are found, so the names are not
+    kept anywhere else; otherwise, once they are counted, and anchor_index is sized for all of them.
+    Whether the file is sorted is returned in is_sorted.
+ */
+bool Graph::prescan_file(char *filename, vector<region> &these_regions, species_filter *filter, float min_score,
+    bool &is_sorted)
+{
+  if (string(filename) == "-") {
+    cerr << "STDIN cannot be read twice. Do not use the anchor filter or the pre-scan when reading from STDIN"
+        << endl;
+    return false;
+  }
+  double start_time = get_time();
+  filtered_anchors.clear();
+
+  HitReader plain_reader;
+  IndexedHitReader indexed_reader;
+  HitReader *reader = &plain_reader;
+  if (!these_regions.empty()) {
+    reader = &indexed_reader;
+  }
+  reader->filter = filter;
+  if (!reader->open(filename)) {
+    return false;
+  }
+  for (uint a = 0; a < these_regions.size(); a++) {
+    indexed_reader.add_region(these_regions[a]);
+  }
+
+  map<string, uint> species_ids;
+  set< pair<string, string> > sequences;
+  string last_species = "";
+  string last_chr = "";
+  bool count_hits = (max_anchor_copies or max_anchor_hits);
+  map<string, anchor_hits> counts;
+  unsigned long long int total_hits = 0;
+  is_sorted = true;
+  sorted_species = "";
+  sorted_chr = "";
+  sorted_sequences.clear();
+  if (prescan) {
+    anchor_index.clear();
+  }
+  hit this_hit;
+  while (reader->next_hit(this_hit)) {
+    if (this_hit.score < min_score) {
       continue;
     }
-    Anchor *anchor = this->get_Anchor(this_anchor_id);
-    if (!anchor) {
-      cerr << "Out of memory" << endl;
-      return false;
+    total_hits++;
+    if (is_sorted and these_regions.empty() and !hit_is_sorted(this_hit)) {
+      is_sorted = false;
+    }
+    if (this_hit.species != last_species or this_hit.chr != last_chr) {
+      sequences.insert(make_pair(this_hit.species, this_hit.chr));
+      last_species = this_hit.species;
+      last_chr = this_hit.chr;
     }
-    if (!species[this_species]) {
-      cout << "New species " << this_species << endl;
-      species[this_species] = new string(this_species);
-    }
-    anchor->species.insert(species[this_species]);
-    if (last_species == this_species and
-        last_chr == this_chr and
-        last_end < this_start) {
-      if ((max_gap_length > 0) and (this_start - last_end - 1 > max_gap_length)) {
-        if (DEBUG) {
-          cout << " ** LONG GAP **   " << this_species << ":" << this_chr << ":" << last_end << ".." <<
-              this_start << "    " << last_anchor->id << " <--> " << anchor->id << endl;
+    map<string, uint>::iterator p_species = species_ids.find(this_hit.species);
+    if (p_species == species_ids.end()) {
+      p_species = species_ids.insert(make_pair(this_hit.species, (uint)species_ids.size())).first;
+    }
+    if (!count_hits) {
+      add_prescanned_anchor(this_hit.anchor_id);
+      continue;
+    }
+    uint id = p_species->second;
+    anchor_hits &these_hits = counts[this_hit.anchor_id];
+    these_hits.hits++;
+    if (these_hits.species.size() <= id / 64) {
+      these_hits.species.resize(id / 64 + 1, 0);
+    }
+    these_hits.species[id / 64] |= 1ULL << (id % 64);
+  }
+  reader->close();
+  sorted_species = "";
+  sorted_chr = "";
+  sorted_sequences.clear();
+  if (reader->error) {
+    remove_prescanned_anchors();
+    return false;
+  }
+  unsigned long num_anchors = count_hits ? counts.size() : anchor_index.size();
+
+  unsigned long long int removed_hits = 0;
+  unsigned long long int avoided_look_ups = 0;
+  if (count_hits) {
+    for (map<string, anchor_hits>::iterator it = counts.begin(); it != counts.end(); it++) {
+      anchor_count this_count;
+      this_count.hits = it->second.hits;
+      this_count.species = 0;
+      for (uint a = 0; a < it->second.species.size(); a++) {
+        for (unsigned long long int bits = it->second.species[a]; bits; bits &= bits - 1) {
+          this_count.species++;
         }
-        long_gap_counter++;
+      }
+      if ((max_anchor_hits and this_count.hits > max_anchor_hits) or
+          (max_anchor_copies and this_count.hits > (unsigned long)max_anchor_copies * this_count.species)) {
+        filtered_anchors[it->first] = this_count;
+        removed_hits += this_count.hits;
+        avoided_look_ups += (unsigned long long int)this_count.hits * this_count.hits;
+      }
+    }
+  }
+
+  if (prescan and count_hits) {
+    // Each name is dropped from the counts once its Anchor is created
+    anchor_index.reserve(counts.size() - filtered_anchors.size());
+    for (map<string, anchor_hits>::iterator it = counts.begin(); it != counts.end(); ) {
+      if (!filtered_anchors.count(it->first)) {
+        add_prescanned_anchor(it->first);
+      }
+      counts.erase(it++);
+    }
+  }
+
+  ios::fmtflags current_flags = log->flags();
+  log->setf(ios::fixed);
+  log->precision(1);
+  if (prescan) {
+    *log << "Pre-scan: " << total_hits << " hits, " << num_anchors << " anchors, " << species_ids.size()
+        << " species and " << sequences.size() << " chromosomes (" << get_time() - start_time << " s)" << endl;
+  }
+  if (max_anchor_copies or max_anchor_hits) {
+    *log << "Anchor filter: " << filtered_anchors.size() << " of " << num_anchors << " anchors removed ("
+        << removed_hits << " of " << total_hits << " hits, "
+        << (total_hits ? 100.0f * removed_hits / total_hits : 0.0f) << "%)" << endl;
+    *log << "Anchor filter: counting took " << get_time() - start_time << " s and avoids up to "
+        << avoided_look_ups << " Link look-ups while loading" << endl;
+  }
+  log->flags(current_flags);
+
+  return true;
+}
+
+
+/*!
+    \fn Graph::add_prescanned_anchor(const string &id)
+    Adds the Anchor to anchor_index, and to the Graph (with no hits yet) if it is not there already
+ */
+void Graph::add_prescanned_anchor(const string &id)
+{
+  unordered_map<string, Anchor*>::iterator p_index = anchor_index.find(id);
+  if (p_index != anchor_index.end()) {
+    return;
+  }
+  Anchor *&this_anchor = anchors[id];
+  if (!this_anchor) {
+    this_anchor = new Anchor(id);
+    this_anchor->num = 0;
+  }
+  anchor_index[id] = this_anchor;
+}
+
+
+/*!
+    \fn Graph::remove_prescanned_anchors()
+    Once the file is loaded, the hash table is not needed anymore. The Anchors created by the
+    pre-scan and not found afterwards (if any) are removed from the Graph.
+ */
+void Graph::remove_prescanned_anchors(void)
+{
+  anchor_index.clear();
+  for (map<string, Anchor*>::iterator it = anchors.begin(); it != anchors.end(); ) {
+    if (it->second and it->second->num == 0 and it->second->links.empty()) {
+      delete(it->second);
+      anchors.erase(it++);
+    } else {
+      it++;
+    }
+  }
+}
+
+
+/*!
+    \fn Graph::print_filtered_anchors(ostream &out)
+    One line per Anchor: its name, number of hits and number of species
+ */
+void Graph::print_filtered_anchors(ostream &out)
+{
+  for (map<string, anchor_count>::iterator it = filtered_anchors.begin(); it != filtered_anchors.end(); it++) {
+    out << it->first << "\t" << it->second.hits << "\t" << it->second.species << endl;
+  }
+}
+
+
+/*!
+    \fn Graph::clear_selection()
+    Removes all the regions and species selected for loading
+ */
+void Graph::clear_selection(void)
+{
+  regions.clear();
+  selected_species.included.clear();
+  selected_species.excluded.clear();
+}
+
+
+/*!
+    \fn Graph::set_sorting(sort_mode mode, unsigned long max_memory, string tmp_dir)
+    SORT_AUTO sorts the file only if it is not sorted. Hits are sorted in memory up to max_memory
+    bytes, and in temporary files in tmp_dir (default: $TMPDIR or /tmp) after that.
+ */
+void Graph::set_sorting(sort_mode mode, unsigned long max_memory, string tmp_dir)
+{
+  sorting = mode;
+  sort_max_memory = max_memory;
+  sort_tmp_dir = tmp_dir;
+}
+
+
+/*!
+    \fn Graph::add_region(region &this_region)
+ */
+void Graph::add_region(region &this_region)
+{
+  regions.push_back(this_region);
+}
+
+
+/*!
+    \fn Graph::populate_from_reader(HitReader &reader, float min_score, int max_gap_length, bool check_order)
+    If check_order is set, the loading stops as soon as the hits are found not to be sorted and
+    unsorted_input is set.
+ */
+bool Graph::populate_from_reader(HitReader &reader, float min_score, int max_gap_length, bool check_order)
+{
+  start_hits(min_score, max_gap_length);
+
+  hit this_hit;
+  while (reader.next_hit(this_hit)) {
+    if (reader.path_break) {
+      break_path();
+    }
+    if (check_order and !hit_is_sorted(this_hit)) {
+      unsorted_input = true;
+      reader.close();
+      return false;
+    }
+    if (!add_hit(this_hit)) {
+      reader.close();
+      return false;
+    }
+  }
+  reader.close();
+  if (!anchor_index.empty()) {
+    remove_prescanned_anchors();
+  }
+  if (reader.error) {
+    return false;
+  }
+  *log << "Number of long gaps (larger than " << max_gap_length << "): " << long_gap_counter << endl;
+  return true;
+}
+
+
+/*!
+    \fn Graph::start_hits(float min_score, int max_gap_length)
+    Must be called before adding hits with add_hit(). Hits are added to the current graph.
+ */
+void Graph::start_hits(float min_score, int max_gap_length)
+{
+  this->min_score = min_score;
+  this->max_gap_length = max_gap_length;
+  long_gap_counter = 0;
+  break_path();
+  unsorted_input = false;
+  sorted_species = "";
+  sorted_chr = "";
+  sorted_sequences.clear();
+}
+
+
+/*!
+    \fn Graph::add_hit(hit &this_hit)
+    Hits are expected to be sorted by species, chromosome and position. A new tag is added to the
+    Link between this Anchor and the previous one if both hits are on the same chromosome, do not
+    overlap and are not too far apart (see max_gap_length). Hits of the Anchors removed by the
+    anchor filter are skipped without breaking the path.
+ */
+bool Graph::add_hit(hit &this_hit)
+{
+  if (this_hit.score < min_score) {
+    return true;
+  }
+  if (!filtered_anchors.empty() and filtered_anchors.count(this_hit.anchor_id)) {
+    return true;
+  }
+  Anchor *anchor = this->get_Anchor(this_hit.anchor_id);
+  if (!anchor) {
+    cerr << "Out of memory" << endl;
+    return false;
+  }
+  if (!species[this_hit.species]) {
+    *log << "New species " << this_hit.species << endl;
+    species[this_hit.species] = new string(this_hit.species);
+  }
+  if (updating) {
+    if (previous_species.count(species[this_hit.species])) {
+      cerr << "Species " << this_hit.species << " is already in the graph: only new species can be added to a"
+          << " saved graph" << endl;
+      return false;
+    }
+    updated_anchors.insert(anchor);
+  }
+  anchor->species.insert(species[this_hit.species]);
+  if (last_species == this_hit.species and
+      last_chr == this_hit.chr and
+      last_end < this_hit.start) {
+    if ((max_gap_length > 0) and (this_hit.start - last_end - 1 > max_gap_length)) {
+      if (DEBUG) {
+        *log << " ** LONG GAP **   " << this_hit.species << ":" << this_hit.chr << ":" << last_end << ".." <<
+            this_hit.start << "    " << last_anchor->id << " <--> " << anchor->id << endl;
+      }
+      long_gap_counter++;
+    } else {
+      Link *this_link = anchor->get_direct_Link(last_anchor);
+      short this_link_strand;
+      if (last_anchor == anchor) {
+        this_link_strand = 0;
+      } else if (last_anchor == *this_link->anchor_list.begin()) {
+        this_link_strand = 1;
+      } else if (anchor == *this_link->anchor_list.begin()) {
+        this_link_strand = -1;
       } else {
-        Link *this_link = anchor->get_direct_Link(last_anchor);
-        short this_link_strand;
-        if (last_anchor == anchor) {
-          this_link_strand = 0;
-        } else if (last_anchor == *this_link->anchor_list.begin()) {
-          this_link_strand = 1;
-        } else if (anchor == *this_link->anchor_list.begin()) {
-          this_link_strand = -1;
-        } else {
-          cerr << "Error";
-          exit(1);
-        }
-        string *this_chr = chrs[last_chr];
-        if (!this_chr) {
-          this_chr = new string(last_chr);
-          chrs[last_chr] = this_chr;
-        }
-        this_link->add_tag(species[this_species], this_chr, last_start, this_end, this_link_strand);
+        cerr << "Error";
+        exit(1);
       }
+      string *this_chr = chrs[last_chr];
+      if (!this_chr) {
+        this_chr = new string(last_chr);
+        chrs[last_chr] = this_chr;
+      }
+      this_link->add_tag(species[this_hit.species], this_chr, last_start, this_hit.end, this_link_strand);
     }
-    last_anchor = anchor;
-    last_species = this_species;
-    last_chr = this_chr;
-    last_start = this_start;
-    last_end = this_end;
-    last_strand = this_strand;
+  }
+  last_anchor = anchor;
+  last_species = this_hit.species;
+  last_chr = this_hit.chr;
+  last_start = this_hit.start;
+  last_end = this_hit.end;
 
-    line_counter++;
-//     if (!(line_counter % 10000)) {
-//       cerr << "Line " << line_counter << endl;
-//     }
+  return true;
+}
+
+
+/*!
+    \fn Graph::hit_is_sorted(hit &this_hit)
+    The species and chromosomes do not need to be in alphabetical order, but all the hits of each
+    chromosome must be together and sorted by start position.
+ */
+bool Graph::hit_is_sorted(hit &this_hit)
+{
+  if (sorted_species == this_hit.species and sorted_chr == this_hit.chr) {
+    if (this_hit.start < sorted_start) {
+      return false;
+    }
+  } else {
+    if (!sorted_species.empty()) {
+      sorted_sequences.insert(make_pair(sorted_species, sorted_chr));
+    }
+    if (sorted_sequences.count(make_pair(this_hit.species, this_hit.chr))) {
+      return false;
+    }
+    sorted_species = this_hit.species;
+    sorted_chr = this_hit.chr;
   }
-  inputfile.close();
-  cout << "Number of long gaps (larger than " << max_gap_length << "): " << long_gap_counter << endl;
+  sorted_start = this_hit.start;
+
   return true;
 }
 
 
+/*!
+    \fn Graph::break_path()
+ */
+void Graph::break_path(void)
+{
+  last_anchor = NULL;
+  last_species = "";
+}
+
+
 
 
 /*!
     \fn Graph::minimize()
 */
-void Graph::minimize(std::string debug)
+uint Graph::minimize(std::string debug)
 {
   uint count = 0;
-//   anchors["10_11557"]->print();
-//   anchors["9_12874"]->print();
-  cout << "Minimizing graph..." << endl;
+//   anchors["10_11557"]->print(*log);
+//   anchors["9_12874"]->print(*log);
+  *log << "Minimizing graph..." << endl;
   for (std::map<std::string, Anchor*>::iterator it = anchors.begin(); it != anchors.end(); it++) {
     Anchor *this_anchor = it->second;
     uint num_merges;
     if (debug == "ALL" or (it->second->id == debug or it->second->id == debug)) {
-      cout << "=================== ANCHOR " << it->second->id << " ===========================" << endl;
-      it->second->print();
+      *log << "=================== ANCHOR " << it->second->id << " ===========================" << endl;
+      it->second->print(*log);
       num_merges = this_anchor->minimize(true);
     } else {
       num_merges = this_anchor->minimize(false);
     }
     if (num_merges > 0 and (debug == "ALL" or it->second->id == debug)) {
-      cout << "------------ NEW ANCHOR AFTER MINIMIZATION " << it->second->id << " -----------" << endl;
-      it->second->print();
-      cout << "^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^" << endl;
+      *log << "------------ NEW ANCHOR AFTER MINIMIZATION " << it->second->id << " -----------" << endl;
+      it->second->print(*log);
+      *log << "^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^" << endl;
     }
     count += num_merges;
   }
-  cout << count << " merges." << endl;
-  
+  *log << count << " merges." << endl;
+
+  return count;
 }
 
 
+//! Fills the stats of one slice of the anchors or links (see Graph::print_stats)
+
+template <class Item, class Stats>
+struct stats_worker {
+  std::vector<Item*> *items;
+  std::vector<Stats> *stats;
+  const species_index *index;
+
+  void operator()(unsigned long slice) {
+    unsigned long first = items->size() * slice / stats->size();
+    unsigned long last = items->size() * (slice + 1) / stats->size();
+    for (unsigned long i = first; i < last; i++) {
+      (*stats)[slice].add((*items)[i], *index);
+    }
+  }
+};
+
+
+//! Sorts the regions of the position index by sequence and start (see Graph::build_position_index)
+
+struct sort_link_positions {
+  bool operator()(const link_position &a, const link_position &b) const {
+    return a.sequence < b.sequence or (a.sequence == b.sequence and a.start < b.start);
+  }
+};
+
+
 /*!
     \fn Graph::print_anchors_histogram(std::ostream &out)
+    The anchors are split in one slice per thread and the counts of each slice are added up at the end.
  */
 void Graph::print_anchors_histogram(std::ostream &out)
 {
-  std::vector<unsigned long long int> hist_hits;
-  std::map< std::string, unsigned long long int> hist_anchors_per_species;
-  std::vector<unsigned long long int> hist_species(species.size(), 0);
-  std::map< std::string, unsigned long long int> hist_patterns;
-
+  species_index index(species);
+  vector<Anchor*> all_anchors;
+  all_anchors.reserve(anchors.size() + retired_anchors.size());
   for (std::map<std::string, Anchor*>::iterator it = anchors.begin(); it != anchors.end(); it++) {
-    Anchor *this_anchor = it->second;
-    uint num = this_anchor->num;
-    if (num > hist_hits.size()) {
-      hist_hits.resize(num, 0);
-    }
-    hist_hits[num - 1]++;
-    if (this_anchor->species.size() > 0 ) {
-      hist_species[this_anchor->species.size() - 1]++;
-      std::string pattern = "";
-      for (std::map<std::string, std::string*>::iterator it2 = species.begin(); it2 != species.end(); it2++) {
-        for (std::set<std::string*>::iterator it3 = this_anchor->species.begin(); it3 != this_anchor->species.end(); it3++) {
-          if (it2->second == *it3) {
-            hist_anchors_per_species[**it3]++;
-            if (pattern != "") {
-              pattern.append(" + ");
-            }
-            pattern.append(**it3);
-          }
-        }
-      }
-//       if (!hist_patterns[pattern]) {
-//         hist_patterns[pattern] = 1;
-//       } else {
-        hist_patterns[pattern]++;
-//       }
-    } else {
-      cerr << "Hmmm... There is an anchor (" << this_anchor->id << ") mapping on no species! :-S" << endl;
+    if (it->second->species.empty()) {
+      cerr << "Hmmm... There is an anchor (" << it->second->id << ") mapping on no species! :-S" << endl;
     }
+    all_anchors.push_back(it->second);
   }
+  for (std::map<std::string, Anchor*>::iterator it = retired_anchors.begin(); it != retired_anchors.end(); it++) {
+    all_anchors.push_back(it->second);
+  }
+  vector<anchor_stats> slices(get_num_threads());
+  for (uint a = 0; a < slices.size(); a++) {
+    slices[a].init(index.size());
+  }
+  stats_worker<Anchor, anchor_stats> worker;
+  worker.items = &all_anchors;
+  worker.stats = &slices;
+  worker.index = &index;
+  parallel_for(slices.size(), worker);
+  anchor_stats &hist = slices[0];
+  for (uint a = 1; a < slices.size(); a++) {
+    hist.merge(slices[a]);
+  }
+
   out << endl << "Histogram of num. of Anchors per species" << endl;
-  for (std::map< std::string, unsigned long long int>::iterator it = hist_anchors_per_species.begin(); it != hist_anchors_per_species.end(); it++) {
-    cout << it->first << ": " << it->second << " (" << (100.0f * it->second) / anchors.size() << "%)" << endl;
+  for (uint s = 0; s < index.size(); s++) {
+    if (hist.anchors_per_species[s]) {
+      out << index.names[s] << ": " << hist.anchors_per_species[s] << " ("
+          << (100.0f * hist.anchors_per_species[s]) / all_anchors.size() << "%)" << endl;
+    }
   }
   out << endl << "Histogram of num. of species per Anchor (in how many species each Anchor is found)" << endl;
   uint sum = 0;
   ios::fmtflags current_flags = out.flags();
   out.setf(ios::fixed);
   out.precision(1);
-  for (uint a = 0; a < hist_species.size(); a++) {
-    sum += hist_species[a];
+  for (uint a = 0; a < hist.species.size(); a++) {
+    sum += hist.species[a];
   }
-  for (uint a = 0; a < hist_species.size(); a++) {
-    out << a + 1 << ": " << hist_species[a] << " (" << (100.0f * hist_species[a]) / sum << "%)" << endl;
+  for (uint a = 0; a < hist.species.size(); a++) {
+    out << a + 1 << ": " << hist.species[a] << " (" << (100.0f * hist.species[a]) / sum << "%)" << endl;
   }
   out << endl << "The same, by set of species (in no particular order)" << endl;
+  std::map< std::string, unsigned long long int> hist_patterns;
+  for (std::map<species_mask, unsigned long long int>::iterator it = hist.patterns.begin(); it != hist.patterns.end();
+      it++) {
+    std::string pattern = "";
+    for (uint s = 0; s < index.size(); s++) {
+      if (it->first[s / 64] & (1ULL << (s % 64))) {
+        if (pattern != "") {
+          pattern.append(" + ");
+        }
+        pattern.append(index.names[s]);
+      }
+    }
+    hist_patterns[pattern] += it->second;
+  }
   for (std::map< std::string, unsigned long long int>::iterator it = hist_patterns.begin(); it != hist_patterns.end(); it++) {
-    cout << it->first << ": " << it->second << " (" << (100.0f * it->second) / sum << "%)" << endl;
+    out << it->first << ": " << it->second << " (" << (100.0f * it->second) / sum << "%)" << endl;
   }
   out << endl << "Histogram of num. of hits per Anchor (how many times each Anchor is found)" << endl;
   sum = 0;
-  for (uint a = 0; a < hist_hits.size(); a++) {
-    sum += hist_hits[a];
+  for (uint a = 0; a < hist.hits.size(); a++) {
+    sum += hist.hits[a];
   }
-  for (uint a = 0; a < hist_hits.size(); a++) {
-    if (hist_hits[a]) {
-      out << a + 1 << ": " << hist_hits[a] << " (" << (100.0f * hist_hits[a]) / sum << "%)" << endl;
+  for (uint a = 0; a < hist.hits.size(); a++) {
+    if (hist.hits[a]) {
+      out << a + 1 << ": " << hist.hits[a] << " (" << (100.0f * hist.hits[a]) / sum << "%)" << endl;
     }
   }
   out.flags(current_flags);
@@ -278,167 +905,286 @@ void Graph::print_anchors_histogram(std::ostream &out)
 
 /*!
     \fn Graph::print_stats(int histogram_size)
+    The links are split in one slice per thread and the counts of each slice are added up at the end.
+    The N50 values are found by selection on the vectors of lengths (see get_n50).
  */
 void Graph::print_stats(int histogram_size)
 {
+  species_index index(species);
   unsigned long long int non_void_anchors_counter = 0;
-  unsigned long long int links_counter = 0;
-  std::vector<unsigned long long int> hist(histogram_size, 0);
-  std::map< std::string, std::vector<unsigned long long int> > hist_per_species;
-  std::map< std::string, list<uint> > lengths;
-  std::map< std::string, unsigned long long int > total_length;
-  std::vector< std::map< std::string, list<uint> > > lengths_per_cardinality(histogram_size, lengths);
-  std::map< std::string, std::vector< uint > > length_per_species_cardinality;
-
-  for (std::map<std::string, std::string*>::iterator it = species.begin(); it != species.end(); it++) {
-    hist_per_species[it->first].resize(histogram_size, 0);
-  }
+  vector<Link*> all_links;
   for (std::map<std::string, Anchor*>::iterator it = anchors.begin(); it != anchors.end(); it++) {
     Anchor * this_anchor = it->second;
     if (this_anchor->links.size()) {
       non_void_anchors_counter++;
     }
     for (std::list<Link*>::iterator p_link = this_anchor->links.begin(); p_link != this_anchor->links.end(); p_link++) {
-      if ((*p_link)->anchor_list.front()->id != this_anchor->id) {
-        /* Each link will be counted twice, once when counting links for the
-        first anchor and once when counting links for the last anchor
-        (except when the fist and the last anchors are the same one). */
-        continue;
-      }
-      links_counter++;
-
-      int size = (*p_link)->tags.size();
-      if (size > histogram_size) {
-        size = histogram_size;
+      /* Each link is in the list of its first and its last anchor. Take it from the first one only */
+      if ((*p_link)->anchor_list.front() == this_anchor) {
+        all_links.push_back(*p_link);
       }
-      hist[size - 1]++;
-
-      if (size > 0) {
-        std::map< std::string, unsigned int > cardinality_per_species;
-        for (std::list<tag>::iterator p_tag = (*p_link)->tags.begin(); p_tag != (*p_link)->tags.end(); p_tag++) {
-          string this_species = *(p_tag->species);
-          uint this_length = p_tag->end - p_tag->start + 1;
-          hist_per_species[this_species][size - 1]++;
-          lengths[this_species].push_back(this_length);
-          lengths_per_cardinality[size - 1][this_species].push_back(this_length);
-          cardinality_per_species[this_species]++;
-        }
-        for (std::list<tag>::iterator p_tag = (*p_link)->tags.begin(); p_tag != (*p_link)->tags.end(); p_tag++) {
-          string this_species = *(p_tag->species);
-          uint this_length = p_tag->end - p_tag->start + 1;
-          if (length_per_species_cardinality[this_species].size() < cardinality_per_species[this_species]) {
-            length_per_species_cardinality[this_species].resize(cardinality_per_species[this_species], 0);
-          }
-          length_per_species_cardinality[this_species][cardinality_per_species[this_species]-1] += this_length;
-        }
-      }
-
     }
   }
-  ios::fmtflags current_flags = cout.flags();
-  cout.setf(ios::fixed);
-  cout.precision(1);
-  cout << "Graph has " << non_void_anchors_counter << " non-void anchors ("
-      << anchors.size() << " in total) and " << links_counter << " links (edges)" << endl << endl;
+  vector<link_stats> slices(get_num_threads());
+  for (uint a = 0; a < slices.size(); a++) {
+    slices[a].init(index.size(), histogram_size);
+  }
+  stats_worker<Link, link_stats> worker;
+  worker.items = &all_links;
+  worker.stats = &slices;
+  worker.index = &index;
+  parallel_for(slices.size(), worker);
+  link_stats &hist = slices[0];
+  for (uint a = 1; a < slices.size(); a++) {
+    hist.merge(slices[a]);
+  }
+
+  ios::fmtflags current_flags = log->flags();
+  log->setf(ios::fixed);
+  log->precision(1);
+  *log << "Graph has " << non_void_anchors_counter << " non-void anchors ("
+      << anchors.size() + retired_anchors.size() << " in total) and " << hist.links << " links (edges)" << endl << endl;
 
-  cout << "Duplications according to graph (length in bp)" << endl;
-  cout << "|! species\t|! 1x\t|! 2x\t|! 3x\t|! 4x\t|! 5x\t|" << endl;
-  for (std::map<std::string, std::string*>::iterator it = species.begin(); it != species.end(); it++) {
-    cout << "|! " << it->first;
+  *log << "Duplications according to graph (length in bp)" << endl;
+  *log << "|! species\t|! 1x\t|! 2x\t|! 3x\t|! 4x\t|! 5x\t|" << endl;
+  for (uint s = 0; s < index.size(); s++) {
+    *log << "|! " << index.names[s];
     for (uint a = 0; a < 5; a++) {
-      if (a < length_per_species_cardinality[it->first].size()) {
-        cout << "\t| " << length_per_species_cardinality[it->first][a];
+      if (a < hist.length_per_copies[s].size()) {
+        *log << "\t| " << hist.length_per_copies[s][a];
       } else {
-        cout << "\t| 0";
+        *log << "\t| 0";
       }
     }
-    cout << "\t|" << endl;
+    *log << "\t|" << endl;
   }
-  cout << endl;
-
-  for (std::map<std::string, list<uint> >::iterator it = lengths.begin(); it != lengths.end(); it++) {
-    cout << "N50 for " << it->first << ": ";
-    list<uint> *this_list = &(it->second);
-    this_list->sort();
-    unsigned long long int sum = 0;
-    for (std::list<uint>::iterator p_length = this_list->begin(); p_length != this_list->end(); p_length++) {
-      sum += *p_length;
+  *log << endl;
+
+  std::vector<unsigned long long int> total_length(index.size(), 0);
+  std::vector<bool> has_lengths(index.size(), false);
+  for (uint s = 0; s < index.size(); s++) {
+    vector<uint> lengths;
+    for (int a = 0; a < histogram_size; a++) {
+      lengths.insert(lengths.end(), hist.lengths_per_cardinality[s][a].begin(),
+          hist.lengths_per_cardinality[s][a].end());
     }
-    unsigned long long int acc = 0;
-    for (std::list<uint>::iterator p_length = this_list->begin(); p_length != this_list->end(); p_length++) {
-      acc += *p_length;
-      if (acc * 2 > sum) {
-        cout << *p_length;
-        break;
-      }
+    if (lengths.empty()) {
+      continue;
     }
-    total_length[it->first] = sum;
-    cout << " (total length = " << sum << ")" << endl;
+    has_lengths[s] = true;
+    *log << "N50 for " << index.names[s] << ": ";
+    for (uint a = 0; a < lengths.size(); a++) {
+      total_length[s] += lengths[a];
+    }
+    uint n50;
+    if (get_n50(lengths, total_length[s], n50)) {
+      *log << n50;
+    }
+    *log << " (total length = " << total_length[s] << ")" << endl;
   }
-  cout << endl;
+  *log << endl;
 
-  cout << "Detailed N50 stats per species and cardinality" << endl;
-  for (std::map<std::string, list<uint> >::iterator it = lengths.begin(); it != lengths.end(); it++) {
-    cout << "|>|>|>|>|>|! " << it->first << " |" << endl;
-    cout << "|! Link cardinality |! Total num. of Links |! num of links |! Total Length |! length% |! N50 |" << endl;
+  *log << "Detailed N50 stats per species and cardinality" << endl;
+  for (uint s = 0; s < index.size(); s++) {
+    if (!has_lengths[s]) {
+      continue;
+    }
+    *log << "|>|>|>|>|>|! " << index.names[s] << " |" << endl;
+    *log << "|! Link cardinality |! Total num. of Links |! num of links |! Total Length |! length% |! N50 |" << endl;
     for (int a=0; a < histogram_size; a++) {
       if (a == histogram_size - 1) {
-        cout << "|! >" << a << " | " << hist[a];
+        *log << "|! >" << a << " | " << hist.hist[a];
       } else {
-        cout << "|! " << a + 1 << " | " << hist[a];
+        *log << "|! " << a + 1 << " | " << hist.hist[a];
       }
 
-      cout << " | " << hist_per_species[it->first][a] << " | ";
-      list<uint> *this_list = &lengths_per_cardinality[a][it->first];
-      this_list->sort();
+      *log << " | " << hist.tags_per_cardinality[s][a] << " | ";
+      vector<uint> &lengths = hist.lengths_per_cardinality[s][a];
       unsigned long long int sum = 0;
-      for (std::list<uint>::iterator p_length = this_list->begin(); p_length != this_list->end(); p_length++) {
-        sum += *p_length;
-      }
-      cout << sum << " | " << 100.0f * sum / total_length[it->first] << "% | ";
-      unsigned long long int acc = 0;
-      for (std::list<uint>::iterator p_length = this_list->begin(); p_length != this_list->end(); p_length++) {
-        acc += *p_length;
-        if (acc * 2 > sum) {
-          cout << *p_length << " |";
-          break;
-        }
+      for (uint b = 0; b < lengths.size(); b++) {
+        sum += lengths[b];
       }
-      cout << endl;
+      *log << sum << " | " << 100.0f * sum / total_length[s] << "% | ";
+      uint n50;
+      if (get_n50(lengths, sum, n50)) {
+        *log << n50 << " |";
+      }
+      *log << endl;
     }
-    cout << endl;
+    *log << endl;
 
   }
-  cout.flags(current_flags);
+  log->flags(current_flags);
 }
 
 
 /*!
-    \fn Graph::print_links(ostream &out, int min_anchors, int min_regions, int min_length, bool allow_bridges)
+    \fn Graph::get_links(vector<Link*> &links, uint min_anchors, uint min_regions, uint min_length, bool allow_bridges)
+    Returns the Links that are valid blocks, or bridges between valid blocks if allow_bridges is set.
  */
-unsigned long int Graph::print_links(ostream &out, uint min_anchors, uint min_regions, uint min_length, bool allow_bridges)
+void Graph::get_links(vector<Link*> &links, uint min_anchors, uint min_regions, uint min_length, bool allow_bridges)
 {
-  int num_blocks = 0;
-  set<Link*> all_links;
+  restore_bridges();
+  link_set all_links;
   for (std::map<std::string, Anchor*>::iterator it = anchors.begin(); it != anchors.end(); it++) {
     Anchor * this_anchor = it->second;
     for (list<Link*>::iterator p_link_it = this_anchor->links.begin(); p_link_it != this_anchor->links.end(); p_link_it++) {
       Link * this_link = *p_link_it;
       if (this_link->is_valid(min_anchors, min_regions, min_length)) {
-        if (all_links.insert(this_link).second) {
-          num_blocks++;
+        all_links.insert(this_link);
+      } else if (allow_bridges and is_bridge(this_link, min_anchors, min_regions, min_length)) {
+        all_links.insert(this_link);
+      }
+    }
+  }
+  links.assign(all_links.begin(), all_links.end());
+}
+
+
+/*!
+    \fn Graph::is_bridge(Link *this_link, uint min_anchors, uint min_regions, uint min_length)
+    Link::is_bridge() trims the regions of the bridge that overlap the links on each side and drops
+    the ones left empty, even when it returns false. The tags are saved before, so restore_bridges()
+    can undo it.
+ */
+bool Graph::is_bridge(Link *this_link, uint min_anchors, uint min_regions, uint min_length)
+{
+  bridge_links.push_back(bridge_link());
+  bridge_links.back().link = this_link;
+  bridge_links.back().tags = this_link->tags;
+
+  return this_link->is_bridge(min_anchors, min_regions, min_length);
+}
+
+
+/*!
+    \fn Graph::restore_bridges()
+    The printed bridges are trimmed, but the graph must not change: the next selection of links,
+    with other limits, would not find the same bridges.
+ */
+void Graph::restore_bridges(void)
+{
+  // A link can be tested more than once: the first tags saved are put back last
+  for (list<bridge_link>::reverse_iterator it = bridge_links.rbegin(); it != bridge_links.rend(); it++) {
+    it->link->tags.swap(it->tags);
+    it->link->update_signature();
+  }
+  bridge_links.clear();
+}
+
+
+/*!
+    \fn Graph::print_links(ostream &out, int min_anchors, int min_regions, int min_length, bool allow_bridges)
+ */
+unsigned long int Graph::print_links(ostream &out, uint min_anchors, uint min_regions, uint min_length, bool allow_bridges)
+{
+  vector<Link*> links;
+  get_links(links, min_anchors, min_regions, min_length, allow_bridges);
+  for (std::vector<Link*>::iterator p_link_it = links.begin(); p_link_it != links.end(); p_link_it++) {
+    (*p_link_it)->print(out);
+  }
+  return links.size();
+}
+
+
+/*!
+    \fn Graph::build_position_index()
+    Once built, finding the Links in a region takes a binary search
+ */
+void Graph::build_position_index(void)
+{
+  position_index.clear();
+  max_position_length = 0;
+  for (std::map<std::string, Anchor*>::iterator it = anchors.begin(); it != anchors.end(); it++) {
+    Anchor *this_anchor = it->second;
+    for (list<Link*>::iterator p_link = this_anchor->links.begin(); p_link != this_anchor->links.end(); p_link++) {
+      /* Each link is in the list of its first and its last anchor. Take it from the first one only */
+      if ((*p_link)->anchor_list.front() != this_anchor) {
+        continue;
+      }
+      for (tag_list::iterator p_tag = (*p_link)->tags.begin(); p_tag != (*p_link)->tags.end(); p_tag++) {
+        link_position this_position;
+        this_position.sequence = p_tag->sequence;
+        this_position.start = p_tag->start;
+        this_position.end = p_tag->end;
+        this_position.link = *p_link;
+        position_index.push_back(this_position);
+        if (p_tag->end - p_tag->start > max_position_length) {
+          max_position_length = p_tag->end - p_tag->start;
         }
-      } else if (allow_bridges and this_link->is_bridge(min_anchors, min_regions, min_length)) {
-        if (all_links.insert(this_link).second) {
-          num_blocks++;
+      }
+    }
+  }
+  sort(position_index.begin(), position_index.end(), sort_link_positions());
+}
+
+
+/*!
+    \fn Graph::clear_position_index()
+ */
+void Graph::clear_position_index(void)
+{
+  position_index.clear();
+}
+
+
+/*!
+    \fn Graph::get_links_at(string species, string chr, uint start, uint end, vector<Link*> &links, uint min_anchors, uint min_regions, uint min_length, bool allow_bridges)
+    The index of positions is built the first time. As the regions are sorted by start, the ones
+    overlapping start..end begin after start minus the longest region in the index.
+ */
+void Graph::get_links_at(string species, string chr, uint start, uint end, vector<Link*> &links,
+    uint min_anchors, uint min_regions, uint min_length, bool allow_bridges)
+{
+  map<string, string*>::iterator p_species = this->species.find(species);
+  map<string, string*>::iterator p_chr = chrs.find(chr);
+  if (p_species == this->species.end() or p_chr == chrs.end()) {
+    return;
+  }
+  restore_bridges();
+  if (position_index.empty()) {
+    build_position_index();
+  }
+  link_position first;
+  first.sequence = get_tag_sequence(p_species->second, p_chr->second);
+  first.start = (start > max_position_length) ? start - max_position_length : 0;
+  link_set found_links;
+  for (vector<link_position>::iterator it = lower_bound(position_index.begin(), position_index.end(), first,
+      sort_link_positions()); it != position_index.end() and it->sequence == first.sequence and it->start <= end; it++) {
+    if (it->end < start or found_links.count(it->link)) {
+      continue;
+    }
+    found_links.insert(it->link);
+    if (it->link->is_valid(min_anchors, min_regions, min_length)) {
+      links.push_back(it->link);
+    } else if (allow_bridges and is_bridge(it->link, min_anchors, min_regions, min_length)) {
+      // The bridge may not overlap the region anymore once trimmed
+      for (tag_list::iterator p_tag = it->link->tags.begin(); p_tag != it->link->tags.end(); p_tag++) {
+        if (p_tag->sequence == first.sequence and p_tag->start <= end and p_tag->end >= start) {
+          links.push_back(it->link);
+          break;
         }
       }
     }
   }
-  for (std::set<Link*>::iterator p_link_it = all_links.begin(); p_link_it != all_links.end(); p_link_it++) {
-    (*p_link_it)->print(out);
+}
+
+
+/*!
+    \fn Graph::print_anchor(string id, ostream &out)
+ */
+bool Graph::print_anchor(string id, ostream &out)
+{
+  map<string, Anchor*>::iterator it = anchors.find(id);
+  if (it == anchors.end() or !it->second) {
+    it = retired_anchors.find(id);
+    if (it == retired_anchors.end()) {
+      return false;
+    }
   }
-  return num_blocks;
+  it->second->print(out);
+
+  return true;
 }
 
 
@@ -448,13 +1194,13 @@ unsigned long int Graph::print_links(ostream &out, uint min_anchors, uint min_re
 int Graph::merge_alternative_paths(uint max_anchors, uint max_length, std::string debug)
 {
   int count = 0;
-  cout << "Merging alternative paths... (max anchors: " << max_anchors << ")" << endl;
+  *log << "Merging alternative paths... (max anchors: " << max_anchors << ")" << endl;
   for (std::map<std::string, Anchor*>::iterator it = anchors.begin(); it != anchors.end(); it++) {
     bool merge_event;
     Anchor *this_anchor = it->second;
     if (debug == "ALL" or this_anchor->id == debug) {
-      cout << "Anchor before merging..." << endl;
-      this_anchor->print();
+      *log << "Anchor before merging..." << endl;
+      this_anchor->print(*log);
     }
     do {
       merge_event = false;
@@ -464,10 +1210,10 @@ int Graph::merge_alternative_paths(uint max_anchors, uint max_length, std::strin
             if ((max_anchors == 0) or ((*p_link1)->get_num_of_mismatches(*p_link2) <= max_anchors)) {
               count++;
               if (debug == "ALL" or this_anchor->id == debug) {
-                cout << "Merging these two paths:" << endl;
-                (*p_link1)->print();
-                (*p_link2)->print();
-                cout << "^^^^^^^^^^^^^^^^^^^^^^^^^" << endl;
+                *log << "Merging these two paths:" << endl;
+                (*p_link1)->print(*log);
+                (*p_link2)->print(*log);
+                *log << "^^^^^^^^^^^^^^^^^^^^^^^^^" << endl;
               }
               (*p_link1)->merge(*p_link2);
               merge_event = true;
@@ -477,12 +1223,12 @@ int Graph::merge_alternative_paths(uint max_anchors, uint max_length, std::strin
       }
     } while (merge_event);
     if (debug == "ALL" or this_anchor->id == debug) {
-      cout << "Anchor after merging..." << endl;
-      this_anchor->print();
+      *log << "Anchor after merging..." << endl;
+      this_anchor->print(*log);
     }
-//     cout << endl;
+//     *log << endl;
   }
-  cout << count << " merges." << endl;
+  *log << count << " merges." << endl;
 
   return count;
 }
@@ -496,15 +1242,16 @@ int Graph::merge_alternative_paths(uint max_anchors, uint max_length, std::strin
     considered as a co-linear region, this method will try to split it in order to allow the minimization of
     (A-B-C-D) and (X-B-C-Y).
     -# Get all the unselected links with enough regions to be split and still be eligible as selected link
+    -# Look in parallel for the links that can be split (see Graph::find_split_candidates)
     -# See if any of these blocks can be split in order to enlarge adjacent blocks
        This happens when for any of the "front" Link, all the Link.tags are compatible with
        the ones in this Link and with all the ones of the "back" Link
  */
 int Graph::simplify(uint min_anchors, uint min_regions, uint min_length, std::string debug)
 {
-  cout << "Simplifying graph..." << endl;
+  *log << "Simplifying graph..." << endl;
   // Get set of links that won't be selected as syntenic regions but contain enough regions to be split
-  set<Link*> all_links;
+  link_set all_links;
   for (std::map<std::string, Anchor*>::iterator it = anchors.begin(); it != anchors.end(); it++) {
     Anchor * this_anchor = it->second;
     for (list<Link*>::iterator p_link_it = this_anchor->links.begin(); p_link_it != this_anchor->links.end(); p_link_it++) {
@@ -514,189 +1261,299 @@ int Graph::simplify(uint min_anchors, uint min_regions, uint min_length, std::st
       }
     }
   }
+  vector<Link*> candidates(all_links.begin(), all_links.end());
+  vector<char> may_split;
+  find_split_candidates(candidates, false, min_anchors, min_regions, min_length, debug, may_split);
 
   uint split_count = 0;
+  set<Anchor*> changed_anchors; // ends of the links split so far
 
   // See if any of these blocks can be split in order to enlarge adjacent blocks
-  for (std::set<Link*>::iterator p_link_it = all_links.begin(); p_link_it != all_links.end(); p_link_it++) {
-    Link* this_link = *p_link_it;
+  for (uint a = 0; a < candidates.size(); a++) {
+    Link* this_link = candidates[a];
     Anchor *front_anchor = this_link->anchor_list.front();
     Anchor *back_anchor = this_link->anchor_list.back();
+    if (!may_split[a] and !changed_anchors.count(front_anchor) and !changed_anchors.count(back_anchor)) {
+      continue;
+    }
 
-    // ==========================================================
     // Get the list of links for the front and the back anchors
-    // ==========================================================
-    set<Link*> front_links;
-    set<Link*> back_links;
-    for (list<Link*>::iterator p_front_link_it = front_anchor->links.begin(); p_front_link_it != front_anchor->links.end(); p_front_link_it++) {
-      Link *this_front_link = *p_front_link_it;
-      if (this_front_link != this_link
-          and this_front_link->tags.size() < this_link->tags.size()
-          and this_front_link->tags.size() >= min_regions) {
-        front_links.insert(this_front_link);
-      }
-    }
-    for (list<Link*>::iterator p_back_link_it = back_anchor->links.begin(); p_back_link_it != back_anchor->links.end(); p_back_link_it++) {
-      Link *this_back_link = *p_back_link_it;
-      if (this_back_link != this_link
-          and this_back_link->tags.size() < this_link->tags.size()
-          and this_back_link->tags.size() >= min_regions) {
-        back_links.insert(this_back_link);
-      }
-    }
-    // ==========================================================
+    link_set front_links;
+    link_set back_links;
+    get_simplify_neighbours(this_link, min_regions, front_links, back_links);
 
-    // ==========================================================
     // Print debug info if requested
-    // ==========================================================
     bool print_debug_info = false;
     if (debug == "ALL" or (front_anchor->id == debug or back_anchor->id == debug)) {
       print_debug_info = true;
-      cout << "------------------------------------" << endl;
-      cout << " Test Simplifying ";
-      this_link->print();
-      if (front_anchor == back_anchor) {
-        cout << "Front and back links (loop edge):" << endl;
-        for (std::set<Link*>::iterator p_front_it = front_links.begin(); p_front_it != front_links.end(); p_front_it++) {
-          if ((*p_front_it)->is_valid(min_anchors, min_regions, min_length)) cout << "valid ";
-          (*p_front_it)->print();
-        }
-      } else {
-        cout << "Front links:" << endl;
-        for (std::set<Link*>::iterator p_front_it = front_links.begin(); p_front_it != front_links.end(); p_front_it++) {
-          if ((*p_front_it)->is_valid(min_anchors, min_regions, min_length)) cout << "valid ";
-          (*p_front_it)->print();
-        }
-        cout << "Back links:" << endl;
-        for (std::set<Link*>::iterator p_back_it = back_links.begin(); p_back_it != back_links.end(); p_back_it++) {
-          if ((*p_back_it)->is_valid(min_anchors, min_regions, min_length)) cout << "valid ";
-          (*p_back_it)->print();
-        }
-      }
-      cout << "------------------------------------" << endl;
+      print_neighbours(this_link, front_links, back_links, min_anchors, min_regions, min_length);
     }
-    // ==========================================================
 
     // test empty front or back links (or just 1?)
     if (front_links.size() == 0 or back_links.size() == 0) {
       continue;
     }
-    // ==========================================================
-    // spot matches front -- partial tested -- back
-    //  this uses two interlaced loops
-    // ==========================================================
-    bool split = false;
-    do {
-      split = false;
-      // FIRST LOOP: back anchor
-      for (std::set<Link*>::iterator p_back_it = back_links.begin(); 
-           !split and (p_back_it != back_links.end()); p_back_it++) {
-        Link* back_link = *p_back_it;
-        // the get_matching_tags method assumes this link comes before the other one.
-        // Use strand 1 to test connectivity between the END of this link and the front_link:
-        //  FrontAnchor---(this_link)---BackAnchor  <=?=> BackAnchor---(other_link)---AnyAnchor
-        short this_strand = 1;
-        short back_strand = back_link->get_strand_for_matching_tags(back_anchor);
-        std::vector< std::list<tag>::iterator > this_tag_links_to_back =
-            this_link->get_matching_tags(back_link, this_strand, back_strand, false);
-        if (this_tag_links_to_back.empty()) {
-          if (print_debug_info) cout << "empty back matching tag" << back_link->tags.size() << endl;
-          continue;
-        }
+    vector<bool> tags_to_split;
+    while (find_simplify_split(this_link, front_links, back_links, tags_to_split, print_debug_info)) {
+      // Split this link. A posterior loop of minimization will take care of joining the edges
+      Link* new_link = this_link->split(tags_to_split);
+      split_count++;
+      changed_anchors.insert(front_anchor);
+      changed_anchors.insert(back_anchor);
+      if (print_debug_info) {
+        *log << "This link has been split in two parts:" << endl;
+        new_link->print(*log);
+        this_link->print(*log);
+      }
+    }
+  }
 
-        // SECOND LOOP: front anchor
-        for (std::set<Link*>::iterator p_front_it = front_links.begin();
-             !split and (p_front_it != front_links.end()); p_front_it++) {
-          Link* front_link = *p_front_it;
-          if (front_link == back_link) {
-//             cerr << "Self-link" << endl;
-            continue;
-            exit(11);
-          }
-          // the get_matching_tags method assumes this link comes before the other one.
-          // Use strand -1 to test connectivity between the BEGINNING of this link and the front_link:
-          //  BackAnchor---(this_link)---FrontAnchor  <=?=> FrontAnchor---(other_link)---AnyAnchor
-          this_strand = -1;
-          short front_strand = front_link->get_strand_for_matching_tags(front_anchor);
-          std::vector< std::list<tag>::iterator > this_tag_links_to_front =
-              this_link->get_matching_tags(front_link, this_strand, front_strand, false);
-          if (this_tag_links_to_front.empty()) {
-            if (print_debug_info) cout << "empty front matching tag" << front_link->tags.size() << endl;
-            continue;
-          }
-          if (this_tag_links_to_front.size() != this_tag_links_to_back.size()) {
-            cerr << "THIS SHOULD NEVER HAPPEN: lists for front and back do not have the same length: " <<
-                this_tag_links_to_front.size() << " -- " << this_tag_links_to_back.size() << endl;
-            exit(1);
-          }
-          bool should_be_split = true;
-          uint front_matches = 0;
-          uint back_matches = 0;
-          uint number_of_matches = 0;
-          vector<bool> tags_to_split(this_tag_links_to_front.size(), false);
-          for (uint i=0; i< this_tag_links_to_front.size(); i++) {
-            // this_tag_links_to_front[i] = front_link->tags.end() when no match has been found
-            if (this_tag_links_to_front[i] != front_link->tags.end()) {
-              front_matches++;
-            }
-            // this_tag_links_to_back[i] = back_link->tags.end() when no match has been found
-            if (this_tag_links_to_back[i] != back_link->tags.end()) {
-              back_matches++;
-            }
-            if (this_tag_links_to_front[i] != front_link->tags.end() and this_tag_links_to_back[i] != back_link->tags.end()) {
-              number_of_matches++;
-              tags_to_split[i] = true;
-            } else if (this_tag_links_to_front[i] != front_link->tags.end() or this_tag_links_to_back[i] != back_link->tags.end()) {
-              should_be_split = false;
-  //             continue;
-            }
-          }
-          if (print_debug_info) {
-            std::list<tag>::iterator p_center_tag_it = this_link->tags.begin();
-            for (uint i=0; i< this_tag_links_to_front.size(); i++) {
-              cout << setw(2) << i+1 << " : ";
-              if (this_tag_links_to_front[i] != front_link->tags.end()) {
-                print_tag(*this_tag_links_to_front[i]);
-              } else {
-                cout << " ----------------------------------------- ";
-              }
-              cout << " :: ";
-              print_tag(*(p_center_tag_it++));
-              cout << " :: ";
-              if (this_tag_links_to_back[i] != back_link->tags.end()) {
-                print_tag(*this_tag_links_to_back[i]);
-              } else {
-                cout << " ----------------------------------------- ";
-              }
-              cout << endl;
-            }
-            cout << " ==> " << number_of_matches << " full match(es); details = "
-                << front_matches << "/" << front_link->tags.size() << "; " << this_link->tags.size() << "; "
-                << back_matches << "/" << back_link->tags.size() << "; should be split: "
-                << (should_be_split and number_of_matches and number_of_matches < this_tag_links_to_front.size())
-                << endl;
-          }
-          if (should_be_split and number_of_matches and number_of_matches < this_tag_links_to_front.size()) {
-            // Split this link. A posterior loop of minimization will take care of joining the edges
-            Link* new_link = this_link->split(tags_to_split);
-            if (new_link) {
-              split = true;
-              split_count++;
-              if (print_debug_info) {
-                cout << "This link has been split in two parts:" << endl;
-                new_link->print();
-                this_link->print();
-              }
-            }
-          }
+  *log << split_count << " splits." << endl;
+
+  return split_count;
+}
+
+
+/*!
+    \fn Graph::get_simplify_neighbours(Link *this_link, uint min_regions, link_set &front_links, link_set &back_links)
+    Gets the links at both ends of this one with fewer regions (but at least min_regions)
+ */
+void Graph::get_simplify_neighbours(Link *this_link, uint min_regions, link_set &front_links,
+    link_set &back_links)
+{
+  Anchor *front_anchor = this_link->anchor_list.front();
+  Anchor *back_anchor = this_link->anchor_list.back();
+  for (list<Link*>::iterator p_front_link_it = front_anchor->links.begin(); p_front_link_it != front_anchor->links.end(); p_front_link_it++) {
+    Link *this_front_link = *p_front_link_it;
+    if (this_front_link != this_link
+        and this_front_link->tags.size() < this_link->tags.size()
+        and this_front_link->tags.size() >= min_regions) {
+      front_links.insert(this_front_link);
+    }
+  }
+  for (list<Link*>::iterator p_back_link_it = back_anchor->links.begin(); p_back_link_it != back_anchor->links.end(); p_back_link_it++) {
+    Link *this_back_link = *p_back_link_it;
+    if (this_back_link != this_link
+        and this_back_link->tags.size() < this_link->tags.size()
+        and this_back_link->tags.size() >= min_regions) {
+      back_links.insert(this_back_link);
+    }
+  }
+}
+
+
+/*!
+    \fn Graph::find_simplify_split(Link *this_link, link_set &front_links, link_set &back_links, vector<bool> &tags_to_split, bool print_debug_info)
+    Looks for a pair of front and back links such that the tags of this link matching both of them
+    could be split from the rest. Returns false if there is none. The graph is not modified.
+ */
+bool Graph::find_simplify_split(Link *this_link, link_set &front_links, link_set &back_links,
+    vector<bool> &tags_to_split, bool print_debug_info)
+{
+  Anchor *front_anchor = this_link->anchor_list.front();
+  Anchor *back_anchor = this_link->anchor_list.back();
+
+  // ==========================================================
+  // spot matches front -- partial tested -- back
+  //  this uses two interlaced loops
+  // ==========================================================
+  // FIRST LOOP: back anchor
+  for (link_set::iterator p_back_it = back_links.begin(); p_back_it != back_links.end(); p_back_it++) {
+    Link* back_link = *p_back_it;
+    // the get_matching_tags method assumes this link comes before the other one.
+    // Use strand 1 to test connectivity between the END of this link and the front_link:
+    //  FrontAnchor---(this_link)---BackAnchor  <=?=> BackAnchor---(other_link)---AnyAnchor
+    short this_strand = 1;
+    short back_strand = back_link->get_strand_for_matching_tags(back_anchor);
+    std::vector< tag_list::iterator > this_tag_links_to_back =
+        this_link->get_matching_tags(back_link, this_strand, back_strand, false);
+    if (this_tag_links_to_back.empty()) {
+      if (print_debug_info) *log << "empty back matching tag" << back_link->tags.size() << endl;
+      continue;
+    }
+
+    // SECOND LOOP: front anchor
+    for (link_set::iterator p_front_it = front_links.begin(); p_front_it != front_links.end(); p_front_it++) {
+      Link* front_link = *p_front_it;
+      if (front_link == back_link) {
+        continue;
+      }
+      // the get_matching_tags method assumes this link comes before the other one.
+      // Use strand -1 to test connectivity between the BEGINNING of this link and the front_link:
+      //  BackAnchor---(this_link)---FrontAnchor  <=?=> FrontAnchor---(other_link)---AnyAnchor
+      this_strand = -1;
+      short front_strand = front_link->get_strand_for_matching_tags(front_anchor);
+      std::vector< tag_list::iterator > this_tag_links_to_front =
+          this_link->get_matching_tags(front_link, this_strand, front_strand, false);
+      if (this_tag_links_to_front.empty()) {
+        if (print_debug_info) *log << "empty front matching tag" << front_link->tags.size() << endl;
+        continue;
+      }
+      if (this_tag_links_to_front.size() != this_tag_links_to_back.size()) {
+        cerr << "THIS SHOULD NEVER HAPPEN: lists for front and back do not have the same length: " <<
+            this_tag_links_to_front.size() << " -- " << this_tag_links_to_back.size() << endl;
+        exit(1);
+      }
+      bool should_be_split = true;
+      uint front_matches = 0;
+      uint back_matches = 0;
+      uint number_of_matches = 0;
+      tags_to_split.assign(this_tag_links_to_front.size(), false);
+      for (uint i=0; i< this_tag_links_to_front.size(); i++) {
+        // this_tag_links_to_front[i] = front_link->tags.end() when no match has been found
+        if (this_tag_links_to_front[i] != front_link->tags.end()) {
+          front_matches++;
+        }
+        // this_tag_links_to_back[i] = back_link->tags.end() when no match has been found
+        if (this_tag_links_to_back[i] != back_link->tags.end()) {
+          back_matches++;
         }
+        if (this_tag_links_to_front[i] != front_link->tags.end() and this_tag_links_to_back[i] != back_link->tags.end()) {
+          number_of_matches++;
+          tags_to_split[i] = true;
+        } else if (this_tag_links_to_front[i] != front_link->tags.end() or this_tag_links_to_back[i] != back_link->tags.end()) {
+          should_be_split = false;
+        }
+      }
+      if (print_debug_info) {
+        print_matching_tags(this_link, front_link, back_link, this_tag_links_to_front, this_tag_links_to_back);
+        *log << " ==> " << number_of_matches << " full match(es); details = "
+            << front_matches << "/" << front_link->tags.size() << "; " << this_link->tags.size() << "; "
+            << back_matches << "/" << back_link->tags.size() << "; should be split: "
+            << (should_be_split and number_of_matches and number_of_matches < this_tag_links_to_front.size())
+            << endl;
       }
-    } while (split);
+      if (should_be_split and number_of_matches and number_of_matches < this_tag_links_to_front.size()) {
+        return true;
+      }
+    }
   }
 
-  cout << split_count << " splits." << endl;
+  return false;
+}
 
-  return split_count;
+
+/*!
+    \fn Graph::print_neighbours(Link *this_link, link_set &front_links, link_set &back_links, uint min_anchors, uint min_regions, uint min_length)
+    Debug information for Graph::simplify and Graph::simplify_aggressive
+ */
+void Graph::print_neighbours(Link *this_link, link_set &front_links, link_set &back_links,
+    uint min_anchors, uint min_regions, uint min_length)
+{
+  *log << "------------------------------------" << endl;
+  *log << " Test Simplifying ";
+  this_link->print(*log);
+  if (this_link->anchor_list.front() == this_link->anchor_list.back()) {
+    *log << "Front and back links (loop edge):" << endl;
+    for (link_set::iterator p_front_it = front_links.begin(); p_front_it != front_links.end(); p_front_it++) {
+      if ((*p_front_it)->is_valid(min_anchors, min_regions, min_length)) *log << "valid ";
+      (*p_front_it)->print(*log);
+    }
+  } else {
+    *log << "Front links:" << endl;
+    for (link_set::iterator p_front_it = front_links.begin(); p_front_it != front_links.end(); p_front_it++) {
+      if ((*p_front_it)->is_valid(min_anchors, min_regions, min_length)) *log << "valid ";
+      (*p_front_it)->print(*log);
+    }
+    *log << "Back links:" << endl;
+    for (link_set::iterator p_back_it = back_links.begin(); p_back_it != back_links.end(); p_back_it++) {
+      if ((*p_back_it)->is_valid(min_anchors, min_regions, min_length)) *log << "valid ";
+      (*p_back_it)->print(*log);
+    }
+  }
+  *log << "------------------------------------" << endl;
+}
+
+
+/*!
+    \fn Graph::print_matching_tags(Link *this_link, Link *front_link, Link *back_link, vector< tag_list::iterator > &this_tag_links_to_front, vector< tag_list::iterator > &this_tag_links_to_back)
+    Debug information for Graph::simplify and Graph::simplify_aggressive
+ */
+void Graph::print_matching_tags(Link *this_link, Link *front_link, Link *back_link,
+    vector< tag_list::iterator > &this_tag_links_to_front, vector< tag_list::iterator > &this_tag_links_to_back)
+{
+  tag_list::iterator p_center_tag_it = this_link->tags.begin();
+  for (uint i=0; i< this_tag_links_to_front.size(); i++) {
+    *log << setw(2) << i+1 << " : ";
+    if (this_tag_links_to_front[i] != front_link->tags.end()) {
+      print_tag(*this_tag_links_to_front[i], *log);
+    } else {
+      *log << " ----------------------------------------- ";
+    }
+    *log << " :: ";
+    print_tag(*(p_center_tag_it++), *log);
+    *log << " :: ";
+    if (this_tag_links_to_back[i] != back_link->tags.end()) {
+      print_tag(*this_tag_links_to_back[i], *log);
+    } else {
+      *log << " ----------------------------------------- ";
+    }
+    *log << endl;
+  }
+}
+
+
+//! Looks for the candidate links that may be split by simplify() or simplify_aggressive() (see Graph::find_split_candidates)
+
+struct split_finder {
+  Graph *graph;
+  vector<Link*> *candidates;
+  vector<char> *may_split;
+  bool aggressive;
+  uint min_anchors;
+  uint min_regions;
+  uint min_length;
+
+  void operator()(unsigned long i) {
+    Link *this_link = (*candidates)[i];
+    link_set front_links;
+    link_set back_links;
+    if (aggressive) {
+      graph->get_aggressive_neighbours(this_link, min_anchors, min_length, front_links, back_links);
+    } else {
+      graph->get_simplify_neighbours(this_link, min_regions, front_links, back_links);
+    }
+    if (front_links.empty() or back_links.empty()) {
+      (*may_split)[i] = false;
+    } else if (aggressive) {
+      Link *front_link;
+      Link *back_link;
+      vector< tag_list::iterator > front_tags;
+      vector< tag_list::iterator > back_tags;
+      bool split_front, split_back;
+      (*may_split)[i] = graph->find_aggressive_split(this_link, front_links, back_links, front_link, back_link,
+          front_tags, back_tags, split_front, split_back, false);
+    } else {
+      vector<bool> tags_to_split;
+      (*may_split)[i] = graph->find_simplify_split(this_link, front_links, back_links, tags_to_split, false);
+    }
+  }
+};
+
+
+/*!
+    \fn Graph::find_split_candidates(vector<Link*> &candidates, bool aggressive, uint min_anchors, uint min_regions, uint min_length, string debug, vector<char> &may_split)
+    Tests all the candidate links at once, using several threads, on the graph as it is now. This is
+    read-only: the splits are done afterwards, one candidate after the other. A candidate found
+    not to be split does not need to be tested again unless a split has changed the links at its
+    ends in the meantime. Everything is tested one by one when debugging or with only one thread.
+ */
+void Graph::find_split_candidates(vector<Link*> &candidates, bool aggressive, uint min_anchors, uint min_regions,
+    uint min_length, string debug, vector<char> &may_split)
+{
+  may_split.assign(candidates.size(), true);
+  if (get_num_threads() <= 1 or !debug.empty()) {
+    return;
+  }
+  split_finder finder;
+  finder.graph = this;
+  finder.candidates = &candidates;
+  finder.may_split = &may_split;
+  finder.aggressive = aggressive;
+  finder.min_anchors = min_anchors;
+  finder.min_regions = min_regions;
+  finder.min_length = min_length;
+  parallel_for(candidates.size(), finder, 64);
 }
 
 
@@ -708,13 +1565,14 @@ int Graph::simplify(uint min_anchors, uint min_regions, uint min_length, std::st
     fullfill all the requirements to be considered as a co-linear region, this method will try to split them
     in order to allow the minimization of (A-B-C-D).
     -# Get all the \link Link links \endlink with enough regions to be eligible as selected link
+    -# Look in parallel for the links that can be split (see Graph::find_split_candidates)
     -# See if two adjacent unselected \link Link links \endlink can be split in order to lengthen this one
  */
 int Graph::simplify_aggressive(uint min_anchors, uint min_regions, uint min_length, std::string debug)
 {
-  cout << "Simplifying graph (aggressive method)..." << endl;
+  *log << "Simplifying graph (aggressive method)..." << endl;
   // Get set of links that contain enough regions to be split
-  set<Link*> all_links;
+  link_set all_links;
   for (std::map<std::string, Anchor*>::iterator it = anchors.begin(); it != anchors.end(); it++) {
     Anchor * this_anchor = it->second;
     for (list<Link*>::iterator p_link_it = this_anchor->links.begin(); p_link_it != this_anchor->links.end(); p_link_it++) {
@@ -725,222 +1583,198 @@ int Graph::simplify_aggressive(uint min_anchors, uint min_regions, uint min_leng
       }
     }
   }
+  vector<Link*> candidates(all_links.begin(), all_links.end());
+  vector<char> may_split;
+  find_split_candidates(candidates, true, min_anchors, min_regions, min_length, debug, may_split);
 
   uint split_count = 0;
+  set<Anchor*> changed_anchors; // ends of the links split so far
 
   // See if any of these blocks can be split in order to enlarge adjacent blocks
-  for (std::set<Link*>::iterator p_link_it = all_links.begin(); p_link_it != all_links.end(); p_link_it++) {
-    Link* this_link = *p_link_it;
+  for (uint a = 0; a < candidates.size(); a++) {
+    Link* this_link = candidates[a];
     Anchor *front_anchor = this_link->anchor_list.front();
     Anchor *back_anchor = this_link->anchor_list.back();
+    if (!may_split[a] and !changed_anchors.count(front_anchor) and !changed_anchors.count(back_anchor)) {
+      continue;
+    }
 
-    // ==========================================================
     // Get the list of links for the front and the back anchors
-    // ==========================================================
-    set<Link*> front_links;
-    set<Link*> back_links;
-    for (list<Link*>::iterator p_front_link_it = front_anchor->links.begin();
-         p_front_link_it != front_anchor->links.end(); p_front_link_it++) {
-      Link *this_front_link = *p_front_link_it;
-//       this_link->anchor_list.size() < min_anchors or this_link->get_shortest_length() < min_length
-      if (this_front_link != this_link
-          and this_front_link->tags.size() >= this_link->tags.size()
-          and (this_front_link->anchor_list.size() < min_anchors or
-          this_front_link->get_shortest_region_length() < min_length)) {
-        front_links.insert(this_front_link);
-      }
-    }
-    for (list<Link*>::iterator p_back_link_it = back_anchor->links.begin(); p_back_link_it != back_anchor->links.end(); p_back_link_it++) {
-      Link *this_back_link = *p_back_link_it;
-      if (this_back_link != this_link
-          and this_back_link->tags.size() >= this_link->tags.size()
-          and (this_back_link->anchor_list.size() < min_anchors or this_back_link->get_shortest_region_length() < min_length)) {
-        back_links.insert(this_back_link);
-      }
-    }
-    // ==========================================================
+    link_set front_links;
+    link_set back_links;
+    get_aggressive_neighbours(this_link, min_anchors, min_length, front_links, back_links);
 
-    // ==========================================================
     // Print debug info if requested
-    // ==========================================================
     bool print_debug_info = false;
     if (debug == "ALL" or (front_anchor->id == debug or back_anchor->id == debug)) {
       print_debug_info = true;
-      cout << "------------------------------------" << endl;
-      cout << " Test Simplifying ";
-      this_link->print();
-      if (front_anchor == back_anchor) {
-        cout << "Front and back links (loop edge):" << endl;
-        for (std::set<Link*>::iterator p_front_it = front_links.begin(); p_front_it != front_links.end(); p_front_it++) {
-          if ((*p_front_it)->is_valid(min_anchors, min_regions, min_length)) cout << "valid ";
-          (*p_front_it)->print();
-        }
-      } else {
-        cout << "Front links:" << endl;
-        for (std::set<Link*>::iterator p_front_it = front_links.begin(); p_front_it != front_links.end(); p_front_it++) {
-          if ((*p_front_it)->is_valid(min_anchors, min_regions, min_length)) cout << "valid ";
-          (*p_front_it)->print();
-        }
-        cout << "Back links:" << endl;
-        for (std::set<Link*>::iterator p_back_it = back_links.begin(); p_back_it != back_links.end(); p_back_it++) {
-          if ((*p_back_it)->is_valid(min_anchors, min_regions, min_length)) cout << "valid ";
-          (*p_back_it)->print();
-        }
-      }
-      cout << "------------------------------------" << endl;
+      print_neighbours(this_link, front_links, back_links, min_anchors, min_regions, min_length);
     }
-    // ==========================================================
 
     // test empty front or back links (or just 1?)
     if (front_links.size() == 0 or back_links.size() == 0) {
       continue;
     }
-    // ==========================================================
-    // spot matches front -- partial tested -- back
-    //  this uses two interlaced loops
-    // ==========================================================
-    bool split = false;
-    do {
-      split = false;
-      // FIRST LOOP: back anchor
-      for (std::set<Link*>::iterator p_back_it = back_links.begin(); 
-           !split and (p_back_it != back_links.end()); p_back_it++) {
-        Link* back_link = *p_back_it;
-        // the get_matching_tags method assumes this link comes before the other one.
-        // Use strand 1 to test connectivity between the END of this link and the front_link:
-        //  FrontAnchor---(this_link)---BackAnchor  <=?=> BackAnchor---(other_link)---AnyAnchor
-        short this_strand = 1;
-        short back_strand = back_link->get_strand_for_matching_tags(back_anchor);
-        std::vector< std::list<tag>::iterator > this_tag_links_to_back =
-            this_link->get_matching_tags(back_link, this_strand, back_strand, true);
-        if (this_tag_links_to_back.empty()) {
-          if (print_debug_info) cout << "empty back matching tag" << back_link->tags.size() << endl;
-          continue;
+    Link *front_link;
+    Link *back_link;
+    vector< tag_list::iterator > this_tag_links_to_front;
+    vector< tag_list::iterator > this_tag_links_to_back;
+    bool split_front, split_back;
+    while (find_aggressive_split(this_link, front_links, back_links, front_link, back_link,
+        this_tag_links_to_front, this_tag_links_to_back, split_front, split_back, print_debug_info)) {
+      // Split these links. A posterior loop of minimization will take care of joining the edges
+      if (split_front) {
+        Link* new_front_link = front_link->split(this_tag_links_to_front);
+        split_count++;
+        changed_anchors.insert(front_link->anchor_list.front());
+        changed_anchors.insert(front_link->anchor_list.back());
+        if (print_debug_info) {
+          *log << "This link has been split in two parts (1/2):" << endl;
+          new_front_link->print(*log);
+          front_link->print(*log);
         }
-
-        // SECOND LOOP: front anchor
-        for (std::set<Link*>::iterator p_front_it = front_links.begin();
-             !split and (p_front_it != front_links.end()); p_front_it++) {
-          Link* front_link = *p_front_it;
-          if (front_link == back_link) {
-//             cerr << "Self-link" << endl;
-            continue;
-            exit(11);
-          }
-          // the get_matching_tags method assumes this link comes before the other one.
-          // Use strand -1 to test connectivity between the BEGINNING of this link and the front_link:
-          //  BackAnchor---(this_link)---FrontAnchor  <=?=> FrontAnchor---(other_link)---AnyAnchor
-          this_strand = -1;
-          short front_strand = front_link->get_strand_for_matching_tags(front_anchor);
-          std::vector< std::list<tag>::iterator > this_tag_links_to_front =
-              this_link->get_matching_tags(front_link, this_strand, front_strand, true);
-          if (this_tag_links_to_front.empty()) {
-            if (print_debug_info) cout << "empty front matching tag" << front_link->tags.size() << endl;
-            continue;
-          }
-          if (this_tag_links_to_front.size() != this_tag_links_to_back.size()) {
-            cerr << "THIS SHOULD NEVER HAPPEN: lists for front and back do not have the same length: " <<
-                this_tag_links_to_front.size() << " -- " << this_tag_links_to_back.size() << endl;
-            exit(1);
-          }
-          bool should_be_split = true;
-          uint front_matches = 0;
-          uint back_matches = 0;
-          uint number_of_matches = 0;
-          vector<bool> tags_to_split(this_tag_links_to_front.size(), false);
-          for (uint i=0; i< this_tag_links_to_front.size(); i++) {
-            // this_tag_links_to_front[i] = front_link->tags.end() when no match has been found
-            if (this_tag_links_to_front[i] != front_link->tags.end()) {
-              front_matches++;
-            }
-            // this_tag_links_to_back[i] = back_link->tags.end() when no match has been found
-            if (this_tag_links_to_back[i] != back_link->tags.end()) {
-              back_matches++;
-            }
-            if (this_tag_links_to_front[i] != front_link->tags.end() and this_tag_links_to_back[i] != back_link->tags.end()) {
-              number_of_matches++;
-              tags_to_split[i] = true;
-            } else if (this_tag_links_to_front[i] != front_link->tags.end() or this_tag_links_to_back[i] != back_link->tags.end()) {
-              should_be_split = false;
-  //             continue;
-            }
-          }
-          bool print_this_debug_info = false;
-          should_be_split = false;
-          if ((front_matches and front_matches == front_link->tags.size() and front_matches == number_of_matches) or
-               (back_matches and back_matches == back_link->tags.size() and back_matches == number_of_matches)) {
-//             print_this_debug_info = true;
-//             cout << "SHOW THIS MATCH" << endl;
-          }
-          if (front_matches == number_of_matches and back_matches == number_of_matches and
-             number_of_matches == this_link->tags.size()) {
-//             print_this_debug_info = true;
-            should_be_split = true;
-//             cout << "SHOW THIS MATCH 2" << endl;
-          }
-          if (print_debug_info or print_this_debug_info) {
-            std::list<tag>::iterator p_center_tag_it = this_link->tags.begin();
-            for (uint i=0; i< this_tag_links_to_front.size(); i++) {
-              cout << setw(2) << i+1 << " : ";
-              if (this_tag_links_to_front[i] != front_link->tags.end()) {
-                print_tag(*this_tag_links_to_front[i]);
-              } else {
-                cout << " ----------------------------------------- ";
-              }
-              cout << " :: ";
-              print_tag(*(p_center_tag_it++));
-              cout << " :: ";
-              if (this_tag_links_to_back[i] != back_link->tags.end()) {
-                print_tag(*this_tag_links_to_back[i]);
-              } else {
-                cout << " ----------------------------------------- ";
-              }
-              cout << endl;
-            }
-            cout << " ==> " << number_of_matches << " full match(es); details = "
-                << front_matches << "/" << front_link->tags.size() << "; " << this_link->tags.size() << "; "
-                << back_matches << "/" << back_link->tags.size() << "; should be split: "
-                << (should_be_split and number_of_matches and number_of_matches < this_tag_links_to_front.size())
-                << endl;
-          }
-          if (should_be_split and number_of_matches) {
-            // Split this link. A posterior loop of minimization will take care of joining the edges
-            if (front_matches < front_link->tags.size()) {
-              Link* new_front_link = front_link->split(this_tag_links_to_front);
-              if (new_front_link) {
-                split = true;
-                split_count++;
-                if (print_debug_info) {
-                  cout << "This link has been split in two parts (1/2):" << endl;
-                  new_front_link->print();
-                  front_link->print();
-                }
-              }
-            }
-            if (back_matches < back_link->tags.size()) {
-              Link* new_back_link = back_link->split(this_tag_links_to_back);
-              if (new_back_link) {
-                split = true;
-                split_count++;
-                if (print_debug_info) {
-                  cout << "This link has been split in two parts (2/2):" << endl;
-                  new_back_link->print();
-                  back_link->print();
-                }
-              }
-            }
-          }
+      }
+      if (split_back) {
+        Link* new_back_link = back_link->split(this_tag_links_to_back);
+        split_count++;
+        changed_anchors.insert(back_link->anchor_list.front());
+        changed_anchors.insert(back_link->anchor_list.back());
+        if (print_debug_info) {
+          *log << "This link has been split in two parts (2/2):" << endl;
+          new_back_link->print(*log);
+          back_link->print(*log);
         }
       }
-    } while (split);
+    }
   }
 
-  cout << split_count << " aggresive splits." << endl;
+  *log << split_count << " aggresive splits." << endl;
 
   return split_count;
 }
 
 
+/*!
+    \fn Graph::get_aggressive_neighbours(Link *this_link, uint min_anchors, uint min_length, link_set &front_links, link_set &back_links)
+    Gets the links at both ends of this one with at least as many regions but too short to be valid
+ */
+void Graph::get_aggressive_neighbours(Link *this_link, uint min_anchors, uint min_length, link_set &front_links,
+    link_set &back_links)
+{
+  Anchor *front_anchor = this_link->anchor_list.front();
+  Anchor *back_anchor = this_link->anchor_list.back();
+  for (list<Link*>::iterator p_front_link_it = front_anchor->links.begin();
+       p_front_link_it != front_anchor->links.end(); p_front_link_it++) {
+    Link *this_front_link = *p_front_link_it;
+    if (this_front_link != this_link
+        and this_front_link->tags.size() >= this_link->tags.size()
+        and (this_front_link->anchor_list.size() < min_anchors or
+        this_front_link->get_shortest_region_length() < min_length)) {
+      front_links.insert(this_front_link);
+    }
+  }
+  for (list<Link*>::iterator p_back_link_it = back_anchor->links.begin(); p_back_link_it != back_anchor->links.end(); p_back_link_it++) {
+    Link *this_back_link = *p_back_link_it;
+    if (this_back_link != this_link
+        and this_back_link->tags.size() >= this_link->tags.size()
+        and (this_back_link->anchor_list.size() < min_anchors or this_back_link->get_shortest_region_length() < min_length)) {
+      back_links.insert(this_back_link);
+    }
+  }
+}
+
+
+/*!
+    \fn Graph::find_aggressive_split(Link *this_link, link_set &front_links, link_set &back_links, Link* &front_link, Link* &back_link, vector< tag_list::iterator > &this_tag_links_to_front, vector< tag_list::iterator > &this_tag_links_to_back, bool &split_front, bool &split_back, bool print_debug_info)
+    Looks for a pair of front and back links that match all the tags of this link and have some
+    more tags that could be split from them. Returns false if there is none. The graph is not modified.
+ */
+bool Graph::find_aggressive_split(Link *this_link, link_set &front_links, link_set &back_links,
+    Link* &front_link, Link* &back_link, vector< tag_list::iterator > &this_tag_links_to_front,
+    vector< tag_list::iterator > &this_tag_links_to_back, bool &split_front, bool &split_back,
+    bool print_debug_info)
+{
+  Anchor *front_anchor = this_link->anchor_list.front();
+  Anchor *back_anchor = this_link->anchor_list.back();
+
+  // ==========================================================
+  // spot matches front -- partial tested -- back
+  //  this uses two interlaced loops
+  // ==========================================================
+  // FIRST LOOP: back anchor
+  for (link_set::iterator p_back_it = back_links.begin(); p_back_it != back_links.end(); p_back_it++) {
+    back_link = *p_back_it;
+    // the get_matching_tags method assumes this link comes before the other one.
+    // Use strand 1 to test connectivity between the END of this link and the front_link:
+    //  FrontAnchor---(this_link)---BackAnchor  <=?=> BackAnchor---(other_link)---AnyAnchor
+    short this_strand = 1;
+    short back_strand = back_link->get_strand_for_matching_tags(back_anchor);
+    this_tag_links_to_back = this_link->get_matching_tags(back_link, this_strand, back_strand, true);
+    if (this_tag_links_to_back.empty()) {
+      if (print_debug_info) *log << "empty back matching tag" << back_link->tags.size() << endl;
+      continue;
+    }
+
+    // SECOND LOOP: front anchor
+    for (link_set::iterator p_front_it = front_links.begin(); p_front_it != front_links.end(); p_front_it++) {
+      front_link = *p_front_it;
+      if (front_link == back_link) {
+        continue;
+      }
+      // the get_matching_tags method assumes this link comes before the other one.
+      // Use strand -1 to test connectivity between the BEGINNING of this link and the front_link:
+      //  BackAnchor---(this_link)---FrontAnchor  <=?=> FrontAnchor---(other_link)---AnyAnchor
+      this_strand = -1;
+      short front_strand = front_link->get_strand_for_matching_tags(front_anchor);
+      this_tag_links_to_front = this_link->get_matching_tags(front_link, this_strand, front_strand, true);
+      if (this_tag_links_to_front.empty()) {
+        if (print_debug_info) *log << "empty front matching tag" << front_link->tags.size() << endl;
+        continue;
+      }
+      if (this_tag_links_to_front.size() != this_tag_links_to_back.size()) {
+        cerr << "THIS SHOULD NEVER HAPPEN: lists for front and back do not have the same length: " <<
+            this_tag_links_to_front.size() << " -- " << this_tag_links_to_back.size() << endl;
+        exit(1);
+      }
+      uint front_matches = 0;
+      uint back_matches = 0;
+      uint number_of_matches = 0;
+      for (uint i=0; i< this_tag_links_to_front.size(); i++) {
+        // this_tag_links_to_front[i] = front_link->tags.end() when no match has been found
+        if (this_tag_links_to_front[i] != front_link->tags.end()) {
+          front_matches++;
+        }
+        // this_tag_links_to_back[i] = back_link->tags.end() when no match has been found
+        if (this_tag_links_to_back[i] != back_link->tags.end()) {
+          back_matches++;
+        }
+        if (this_tag_links_to_front[i] != front_link->tags.end() and this_tag_links_to_back[i] != back_link->tags.end()) {
+          number_of_matches++;
+        }
+      }
+      bool should_be_split = false;
+      if (front_matches == number_of_matches and back_matches == number_of_matches and
+         number_of_matches == this_link->tags.size()) {
+        should_be_split = true;
+      }
+      if (print_debug_info) {
+        print_matching_tags(this_link, front_link, back_link, this_tag_links_to_front, this_tag_links_to_back);
+        *log << " ==> " << number_of_matches << " full match(es); details = "
+            << front_matches << "/" << front_link->tags.size() << "; " << this_link->tags.size() << "; "
+            << back_matches << "/" << back_link->tags.size() << "; should be split: "
+            << (should_be_split and number_of_matches and number_of_matches < this_tag_links_to_front.size())
+            << endl;
+      }
+      split_front = (front_matches < front_link->tags.size());
+      split_back = (back_matches < back_link->tags.size());
+      if (should_be_split and number_of_matches and (split_front or split_back)) {
+        return true;
+      }
+    }
+  }
+
+  return false;
+}
 
 
 /*!
@@ -952,9 +1786,9 @@ int Graph::simplify_aggressive(uint min_anchors, uint min_regions, uint min_leng
  */
 int Graph::split_unselected_links(uint min_anchors, uint min_regions, uint min_length, std::string debug)
 {
-  cout << "Splitting unselected links..." << endl;
+  *log << "Splitting unselected links..." << endl;
   // Get set of links that won't be selected as syntenic regions but contain enough regions to be splitted
-  set<Link*> all_links;
+  link_set all_links;
   for (std::map<std::string, Anchor*>::iterator it = anchors.begin(); it != anchors.end(); it++) {
     Anchor * this_anchor = it->second;
     for (list<Link*>::iterator p_link_it = this_anchor->links.begin(); p_link_it != this_anchor->links.end(); p_link_it++) {
@@ -966,7 +1800,7 @@ int Graph::split_unselected_links(uint min_anchors, uint min_regions, uint min_l
   }
 
   uint split_count = 0;
-  for (std::set<Link*>::iterator p_link_it = all_links.begin(); p_link_it != all_links.end(); p_link_it++) {
+  for (link_set::iterator p_link_it = all_links.begin(); p_link_it != all_links.end(); p_link_it++) {
     Link* this_link = *p_link_it;
     while (this_link->tags.size() > 1) {
       vector<bool> tags_to_split(this_link->tags.size(), false);
@@ -978,7 +1812,7 @@ int Graph::split_unselected_links(uint min_anchors, uint min_regions, uint min_l
     }
   }
 
-  cout << split_count << " splits (unselected links)" << endl;
+  *log << split_count << " splits (unselected links)" << endl;
 
   return split_count;
 }
@@ -999,7 +1833,7 @@ void Graph::study_anchors(void)
   uint singular_other_count = 0;
   bool debug = false;
 
-  cout << "Studying anchors..." << endl;
+  *log << "Studying anchors..." << endl;
   for (std::map<std::string, Anchor*>::iterator it = anchors.begin(); it != anchors.end(); it++) {
     Anchor *this_anchor = it->second;
 //     if (this_anchor->id != "11_23281" and this_anchor->id != "1_9852") {
@@ -1031,7 +1865,7 @@ void Graph::study_anchors(void)
         (*p_link1)->print(cerr);
         exit(12);
       }
-      for (std::list<tag>::iterator p_tag1 = (*p_link1)->tags.begin(); p_tag1 != (*p_link1)->tags.end(); p_tag1++) {
+      for (tag_list::iterator p_tag1 = (*p_link1)->tags.begin(); p_tag1 != (*p_link1)->tags.end(); p_tag1++) {
         all_tags.push_back(*p_tag1);
         link_nums.push_back(link_num);
         tag_nums.push_back(tag_num);
@@ -1041,12 +1875,12 @@ void Graph::study_anchors(void)
       link_num++;
     }
     if (debug) {
-      this_anchor->print();
-      cout << endl;
+      this_anchor->print(*log);
+      *log << endl;
       for (uint c = 0; c < all_tags.size(); c++) {
-        cout << "  " << strands[c] << " (" << link_nums[c] << "." << tag_nums[c] << ") ";
-        print_tag(all_tags[c]);
-        cout << endl;
+        *log << "  " << strands[c] << " (" << link_nums[c] << "." << tag_nums[c] << ") ";
+        print_tag(all_tags[c], *log);
+        *log << endl;
       }
     }
     vector <uint> match (all_tags.size(), 0);
@@ -1055,7 +1889,7 @@ void Graph::study_anchors(void)
       for (uint b = a + 1; b < all_tags.size(); b++) {
         tag *p_tag1 = &all_tags[a];
         tag *p_tag2 = &all_tags[b];
-        if (p_tag1->species != p_tag2->species or p_tag1->chr != p_tag2->chr) {
+        if (p_tag1->sequence != p_tag2->sequence) {
           continue;
         }
         short strand1 = p_tag1->strand * strands[a];
@@ -1064,18 +1898,18 @@ void Graph::study_anchors(void)
           if (link_nums[a] == link_nums[b]) {
             if (strand1 == 1 and strand2 == -1) {
               if (p_tag2->start < p_tag1->start and p_tag2->end < p_tag1->end) {
-//                 cout << "INVERSION: ";
+//                 *log << "INVERSION: ";
                 inv_match[a]++;
                 inv_match[b]++;
               }
             } else if (strand1 == -1 and strand2 == 1) {
               if (p_tag1->start < p_tag2->start and p_tag1->end < p_tag2->end) {
-//                 cout << "INVERSION: ";
+//                 *log << "INVERSION: ";
                 inv_match[a]++;
                 inv_match[b]++;
               }
             } else if (strand1 == 0 and strand2 == 0) {
-//               cout << "Loop: ";
+//               *log << "Loop: ";
               match[a]++;
               match[b]++;
             } else {
@@ -1085,7 +1919,7 @@ void Graph::study_anchors(void)
           } else {
             if (strand1 == 1 and strand2 == -1) {
               if (p_tag2->start < p_tag1->start and p_tag2->end < p_tag1->end) {
-//                 cout << "Match: ";
+//                 *log << "Match: ";
                 match[a]++;
                 match[b]++;
                 path[a] = b;
@@ -1093,7 +1927,7 @@ void Graph::study_anchors(void)
               }
             } else if (strand1 == -1 and strand2 == 1) {
               if (p_tag1->start < p_tag2->start and p_tag1->end < p_tag2->end) {
-//                 cout << "Match: ";
+//                 *log << "Match: ";
                 match[a]++;
                 match[b]++;
                 path[a] = b;
@@ -1108,11 +1942,11 @@ void Graph::study_anchors(void)
             }
           }
           if (debug) {
-                        cout << "(" << link_nums[a] << "." << tag_nums[a] << ") ";
-                        print_tag(*p_tag1);
-                        cout << " -- (" << link_nums[b] << "." << tag_nums[b] << ") ";
-                        print_tag(*p_tag2);
-                        cout << endl;
+                        *log << "(" << link_nums[a] << "." << tag_nums[a] << ") ";
+                        print_tag(*p_tag1, *log);
+                        *log << " -- (" << link_nums[b] << "." << tag_nums[b] << ") ";
+                        print_tag(*p_tag2, *log);
+                        *log << endl;
           }
         }
       }
@@ -1124,22 +1958,22 @@ void Graph::study_anchors(void)
     for (uint a = 0; a < match.size(); a++) {
       if (match[a] == 0) {
         if (inv_match[a] == 1) {
-//           cout << "[inversion] (" << link_nums[a] << "." << tag_nums[a] << ")";
+//           *log << "[inversion] (" << link_nums[a] << "." << tag_nums[a] << ")";
           this_inversion_count++;
         } else if (inv_match[a] > 1) {
-          this_anchor->print();
-          cout << "[ARGHHH] (" << link_nums[a] << "." << tag_nums[a] << ")";
+          this_anchor->print(*log);
+          *log << "[ARGHHH] (" << link_nums[a] << "." << tag_nums[a] << ")";
           string resp;
           cin >> resp;
         } else {
-//           cout << "[end_path] (" << link_nums[a] << "." << tag_nums[a] << ")";
+//           *log << "[end_path] (" << link_nums[a] << "." << tag_nums[a] << ")";
           this_end_path_count++;
         }
       } else if (match[a] > 1) {
-//         cout << "[tandem] (" << link_nums[a] << "." << tag_nums[a] << ")";
+//         *log << "[tandem] (" << link_nums[a] << "." << tag_nums[a] << ")";
         this_tandem_count++;
       } else if (strands[a] == 0) {
-//         cout << "[end_path] (" << link_nums[a] << "." << tag_nums[a] << ")";
+//         *log << "[end_path] (" << link_nums[a] << "." << tag_nums[a] << ")";
         this_end_path_count++;
       } else {
         left[a] = true;
@@ -1166,7 +2000,7 @@ void Graph::study_anchors(void)
         for (uint b = 0; b < match.size(); b++) {
           if (!left[b]) continue;
           if (link_nums[b] != a) continue;
-//           cout << "[bifurcation " << a << "] (" << link_nums[b] << "." << tag_nums[b] << ") => ("
+//           *log << "[bifurcation " << a << "] (" << link_nums[b] << "." << tag_nums[b] << ") => ("
 //               << link_nums[path[b]] << "." << tag_nums[path[b]] << ")" << endl;
           left[b] = false;
           left[path[b]] = false;
@@ -1188,41 +2022,41 @@ void Graph::study_anchors(void)
       }
       for (uint b = 0; b < match.size(); b++) {
         if (!left[b]) continue;
-//       cout << "[left] (" << link_nums[b] << "." << tag_nums[b] << ")";
+//       *log << "[left] (" << link_nums[b] << "." << tag_nums[b] << ")";
 //       if (path.count(b)) {
-//         cout << " => (" << link_nums[path[b]] << "." << tag_nums[path[b]] << ")";
+//         *log << " => (" << link_nums[path[b]] << "." << tag_nums[path[b]] << ")";
 //         if (!left[path[b]]) {
 //           if (match[path[b]] > 1) {
-//             cout << " --tandem--";
+//             *log << " --tandem--";
 //           } else {
-//             cout << " -- other--";
+//             *log << " -- other--";
 //           }
 //         }
 //       }
-//       cout << endl;
-//       this_anchor->print();
-//       cout << endl;
+//       *log << endl;
+//       this_anchor->print(*log);
+//       *log << endl;
 //       for (uint c = 0; c < all_tags.size(); c++) {
-//         cout << "  " << strands[c] << " (" << link_nums[c] << "." << tag_nums[c] << ") ";
-//         print_tag(all_tags[c]);
-//         cout << endl;
+//         *log << "  " << strands[c] << " (" << link_nums[c] << "." << tag_nums[c] << ") ";
+//         print_tag(all_tags[c], *log);
+//         *log << endl;
 //       }
 
-//       cout << "[Enter] ";
+//       *log << "[Enter] ";
 //       string resp;
 //       cin >> resp;
       }
     }
 
   }
-  cout << end_path_count << " end of path." << endl;
-  cout << (inversion_count/2) << " inversions." << endl;
-  cout << tandem_count << " tandem anchors." << endl;
-  cout << pure_branching_count << " bifurcating anchors." << endl;
-  cout << singular_branching_count << " bifurcating anchors + singularity." << endl;
-  cout << pure_other_count << " other situations." << endl;
-  cout << singular_other_count << " other situations + singularity." << endl;
-  cout << count << " merges." << endl;
+  *log << end_path_count << " end of path." << endl;
+  *log << (inversion_count/2) << " inversions." << endl;
+  *log << tandem_count << " tandem anchors." << endl;
+  *log << pure_branching_count << " bifurcating anchors." << endl;
+  *log << singular_branching_count << " bifurcating anchors + singularity." << endl;
+  *log << pure_other_count << " other situations." << endl;
+  *log << singular_other_count << " other situations + singularity." << endl;
+  *log << count << " merges." << endl;
 }
 
 
@@ -1230,18 +2064,18 @@ void Graph::study_anchors(void)
 /*!
     \fn Graph::split_unbalanced_links(float max_ratio, std::string debug)
  */
-void Graph::split_unbalanced_links(float max_ratio, std::string debug)
+uint Graph::split_unbalanced_links(float max_ratio, std::string debug)
 {
   if (max_ratio <= 1.0) {
-    return;
+    return 0;
   }
 
-  cout << "Edit unbalanced links..." << endl;
+  *log << "Edit unbalanced links..." << endl;
 
   uint unbalanced_segments_counter = 0;
   uint unbalanced_links_counter = 0;
 
-  set<Link*> all_links;
+  link_set all_links;
   for (std::map<std::string, Anchor*>::iterator it = anchors.begin(); it != anchors.end(); it++) {
     Anchor * this_anchor = it->second;
     for (list<Link*>::iterator p_link_it = this_anchor->links.begin(); p_link_it != this_anchor->links.end(); p_link_it++) {
@@ -1255,15 +2089,15 @@ void Graph::split_unbalanced_links(float max_ratio, std::string debug)
         }
 //         uint longest_segment = 0;
 //         uint shortest_segment = 0;
-        for (list<tag>::iterator p_tag_it = this_link->tags.begin(); p_tag_it != this_link->tags.end(); p_tag_it++) {
+        for (tag_list::iterator p_tag_it = this_link->tags.begin(); p_tag_it != this_link->tags.end(); p_tag_it++) {
           uint length = p_tag_it->end - p_tag_it->start + 1;
-          if (length > longest_segment[*p_tag_it->species]) {
-            longest_segment[*p_tag_it->species] = length;
+          if (length > longest_segment[*p_tag_it->get_species()]) {
+            longest_segment[*p_tag_it->get_species()] = length;
           }
-          if (shortest_segment[*p_tag_it->species] == 0) {
-            shortest_segment[*p_tag_it->species] = length;
-          } else if (length < shortest_segment[*p_tag_it->species]) {
-            shortest_segment[*p_tag_it->species] = length;
+          if (shortest_segment[*p_tag_it->get_species()] == 0) {
+            shortest_segment[*p_tag_it->get_species()] = length;
+          } else if (length < shortest_segment[*p_tag_it->get_species()]) {
+            shortest_segment[*p_tag_it->get_species()] = length;
           }
         }
         bool all_segments_are_balanced = true;
@@ -1276,36 +2110,39 @@ void Graph::split_unbalanced_links(float max_ratio, std::string debug)
           continue;
         }
         if (debug == "ALL" or this_anchor->id == debug) {
-          cout << "Removing unbalanced links:" << endl;
-          this_link->print();
+          *log << "Removing unbalanced links:" << endl;
+          this_link->print(*log);
         }
-        list<tag> tmp_tags;
-        for (list<tag>::iterator p_tag_it = this_link->tags.begin(); p_tag_it != this_link->tags.end(); p_tag_it++) {
+        tag_list tmp_tags;
+        for (tag_list::iterator p_tag_it = this_link->tags.begin(); p_tag_it != this_link->tags.end(); p_tag_it++) {
           uint length = p_tag_it->end - p_tag_it->start + 1;
-          if ((length * max_ratio) < longest_segment[*p_tag_it->species]) {
+          if ((length * max_ratio) < longest_segment[*p_tag_it->get_species()]) {
             unbalanced_segments_counter++;
             if (debug == "ALL" or this_anchor->id == debug) {
-              cout << "Drop this: ";
-              print_tag(*p_tag_it);
-              cout << endl;
+              *log << "Drop this: ";
+              print_tag(*p_tag_it, *log);
+              *log << endl;
             }
           } else {
             tmp_tags.push_back(*p_tag_it);
           }
         }
         if (debug == "ALL" or this_anchor->id == debug) {
-          cout << "^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^" << endl;
+          *log << "^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^" << endl;
         }
         if (tmp_tags.size() == 0) {
-          cout << "Leaving empty link" << endl;
+          *log << "Leaving empty link" << endl;
           exit(1);
         }
         unbalanced_links_counter++;
         this_link->tags = tmp_tags;
+        this_link->update_signature();
       }
     }
   }
-  cout << "removed " << unbalanced_segments_counter << " unbalanced segments in " << unbalanced_links_counter << " blocks" << endl;
+  *log << "removed " << unbalanced_segments_counter << " unbalanced segments in " << unbalanced_links_counter << " blocks" << endl;
+
+  return unbalanced_links_counter;
 }
 
 
@@ -1318,9 +2155,9 @@ void Graph::split_unbalanced_links(float max_ratio, std::string debug)
  */
 uint Graph::resolve_small_palindromes(uint min_anchors, uint min_regions, uint min_length, std::string debug)
 {
-  cout << "Resolving small palindromes..." << endl;
+  *log << "Resolving small palindromes..." << endl;
   // Get set of circular links
-  set<Link*> all_links;
+  link_set all_links;
   for (std::map<std::string, Anchor*>::iterator it = anchors.begin(); it != anchors.end(); it++) {
     Anchor * this_anchor = it->second;
     for (list<Link*>::iterator p_link_it = this_anchor->links.begin(); p_link_it != this_anchor->links.end(); p_link_it++) {
@@ -1334,63 +2171,63 @@ uint Graph::resolve_small_palindromes(uint min_anchors, uint min_regions, uint m
   uint palindromes_count = 0;
 
   // See if any of these blocks is a small insertion breaking a large block
-  for (std::set<Link*>::iterator p_link_it = all_links.begin(); p_link_it != all_links.end(); p_link_it++) {
+  for (link_set::iterator p_link_it = all_links.begin(); p_link_it != all_links.end(); p_link_it++) {
     Link* this_link = *p_link_it;
-    if (this_link->anchor_list.front()->id == debug and this_link->anchor_list.back()->id == debug) this_link->print();
-    std::vector< std::list<tag>::iterator > this_tag_links_to_itself =
+    if (this_link->anchor_list.front()->id == debug and this_link->anchor_list.back()->id == debug) this_link->print(*log);
+    std::vector< tag_list::iterator > this_tag_links_to_itself =
         this_link->get_matching_tags(this_link, 1, -1, false);
     vector<bool> tags_to_split(this_link->tags.size(), false);
     if (!this_tag_links_to_itself.empty()) {
-//       this_link->print();
-      std::list<tag>::iterator p_tag_it = this_link->tags.begin();
+//       this_link->print(*log);
+      tag_list::iterator p_tag_it = this_link->tags.begin();
       for (uint i=0; i< this_link->tags.size(); i++) {
-//         cout << i+1;
-//         print_tag(*p_tag_it);
-//         cout << " >>> ";
-//         print_tag(*this_tag_links_to_itself[i]);
-//         cout << endl;
+//         *log << i+1;
+//         print_tag(*p_tag_it, *log);
+//         *log << " >>> ";
+//         print_tag(*this_tag_links_to_itself[i], *log);
+//         *log << endl;
         if (p_tag_it->start < this_tag_links_to_itself[i]->start) {
           tags_to_split[i] = true;
         }
         p_tag_it++;
       }
-//       cout << endl;
+//       *log << endl;
     } else {
       this_tag_links_to_itself = this_link->get_matching_tags(this_link, -1, 1, false);
       if (!this_tag_links_to_itself.empty()) {
-//         this_link->print();
-        std::list<tag>::iterator p_tag_it = this_link->tags.begin();
+//         this_link->print(*log);
+        tag_list::iterator p_tag_it = this_link->tags.begin();
         for (uint i=0; i< this_link->tags.size(); i++) {
-//           cout << i+1;
-//           print_tag(*p_tag_it);
-//           cout << " >>> ";
-//           print_tag(*this_tag_links_to_itself[i]);
-//           cout << endl;
+//           *log << i+1;
+//           print_tag(*p_tag_it, *log);
+//           *log << " >>> ";
+//           print_tag(*this_tag_links_to_itself[i], *log);
+//           *log << endl;
           if (p_tag_it->start < this_tag_links_to_itself[i]->start) {
             tags_to_split[i] = true;
           }
           p_tag_it++;
         }
-//         cout << endl;
+//         *log << endl;
       }
     }
     if (!this_tag_links_to_itself.empty()) {
       Link* new_link = this_link->split(tags_to_split);
-//       this_link->print();
-//       new_link->print();
+//       this_link->print(*log);
+//       new_link->print(*log);
       if (this_link->try_to_concatenate_with(new_link)) {
         palindromes_count++;
       } else {
-        cout << "FAIL!!!" << endl;
+        *log << "FAIL!!!" << endl;
       }
-      for (list<tag>::iterator p_tag1 = this_link->tags.begin(); p_tag1 != this_link->tags.end(); p_tag1++) {
+      for (tag_list::iterator p_tag1 = this_link->tags.begin(); p_tag1 != this_link->tags.end(); p_tag1++) {
         p_tag1->strand = 0;
       }
-//       this_link->print();
+//       this_link->print(*log);
     }
   }
 
-  cout << "removed " << palindromes_count << " palindromic segments" << endl;
+  *log << "removed " << palindromes_count << " palindromic segments" << endl;
 
   return palindromes_count;
 }
@@ -1407,9 +2244,9 @@ uint Graph::resolve_small_palindromes(uint min_anchors, uint min_regions, uint m
 uint Graph::assimilate_small_insertions(uint min_anchors, uint min_regions, uint min_length,
                                         uint max_insertion_length, std::string debug)
 {
-  cout << "Assimilating small insertions (max. insertion length: " << max_insertion_length << ")..." << endl;
+  *log << "Assimilating small insertions (max. insertion length: " << max_insertion_length << ")..." << endl;
   // Get set of circular links
-  set<Link*> all_links;
+  link_set all_links;
   for (std::map<std::string, Anchor*>::iterator it = anchors.begin(); it != anchors.end(); it++) {
     Anchor * this_anchor = it->second;
     for (list<Link*>::iterator p_link_it = this_anchor->links.begin(); p_link_it != this_anchor->links.end(); p_link_it++) {
@@ -1423,7 +2260,7 @@ uint Graph::assimilate_small_insertions(uint min_anchors, uint min_regions, uint
   uint assimilate_count = 0;
 
   // See if any of these blocks is a small insertion breaking a large block
-  for (std::set<Link*>::iterator p_link_it = all_links.begin(); p_link_it != all_links.end(); p_link_it++) {
+  for (link_set::iterator p_link_it = all_links.begin(); p_link_it != all_links.end(); p_link_it++) {
     Link* this_link = *p_link_it;
     Anchor *front_anchor = this_link->anchor_list.front();
     Anchor *back_anchor = this_link->anchor_list.back();
@@ -1431,8 +2268,8 @@ uint Graph::assimilate_small_insertions(uint min_anchors, uint min_regions, uint
     // ==========================================================
     // Get the list of links for the front and the back anchors
     // ==========================================================
-    set<Link*> front_links;
-    set<Link*> back_links;
+    link_set front_links;
+    link_set back_links;
     for (list<Link*>::iterator p_front_link_it = front_anchor->links.begin(); p_front_link_it != front_anchor->links.end(); p_front_link_it++) {
       Link *this_front_link = *p_front_link_it;
       if (this_front_link != this_link and this_front_link->is_valid(min_anchors, min_regions, min_length)
@@ -1455,28 +2292,28 @@ uint Graph::assimilate_small_insertions(uint min_anchors, uint min_regions, uint
     bool print_debug_info = false;
     if (debug == "ALL" or (front_anchor->id == debug or back_anchor->id == debug)) {
       print_debug_info = true;
-      cout << "------------------------------------" << endl;
-      cout << " Test Assimilating ";
-      this_link->print();
+      *log << "------------------------------------" << endl;
+      *log << " Test Assimilating ";
+      this_link->print(*log);
       if (front_anchor == back_anchor) {
-        cout << "Front and back links (loop edge):" << endl;
-        for (std::set<Link*>::iterator it1 = front_links.begin(); it1 != front_links.end(); it1++) {
-          if ((*it1)->is_valid(min_anchors, min_regions, min_length)) cout << "valid ";
-          (*it1)->print();
+        *log << "Front and back links (loop edge):" << endl;
+        for (link_set::iterator it1 = front_links.begin(); it1 != front_links.end(); it1++) {
+          if ((*it1)->is_valid(min_anchors, min_regions, min_length)) *log << "valid ";
+          (*it1)->print(*log);
         }
       } else {
-        cout << "Front links:" << endl;
-        for (std::set<Link*>::iterator it1 = front_links.begin(); it1 != front_links.end(); it1++) {
-          if ((*it1)->is_valid(min_anchors, min_regions, min_length)) cout << "valid ";
-          (*it1)->print();
+        *log << "Front links:" << endl;
+        for (link_set::iterator it1 = front_links.begin(); it1 != front_links.end(); it1++) {
+          if ((*it1)->is_valid(min_anchors, min_regions, min_length)) *log << "valid ";
+          (*it1)->print(*log);
         }
-        cout << "Back links:" << endl;
-        for (std::set<Link*>::iterator it1 = back_links.begin(); it1 != back_links.end(); it1++) {
-          if ((*it1)->is_valid(min_anchors, min_regions, min_length)) cout << "valid ";
-          (*it1)->print();
+        *log << "Back links:" << endl;
+        for (link_set::iterator it1 = back_links.begin(); it1 != back_links.end(); it1++) {
+          if ((*it1)->is_valid(min_anchors, min_regions, min_length)) *log << "valid ";
+          (*it1)->print(*log);
         }
       }
-      cout << "------------------------------------" << endl;
+      *log << "------------------------------------" << endl;
     }
     // ==========================================================
 
@@ -1491,7 +2328,7 @@ uint Graph::assimilate_small_insertions(uint min_anchors, uint min_regions, uint
     // spot small insertions
     // ==========================================================
     // FIRST LOOP: back anchor
-    for (std::set<Link*>::iterator p_back_it = back_links.begin(); !has_been_assimilated and p_back_it != back_links.end(); p_back_it++) {
+    for (link_set::iterator p_back_it = back_links.begin(); !has_been_assimilated and p_back_it != back_links.end(); p_back_it++) {
       Link* back_link = *p_back_it;
 
       // the get_matching_tags method assumes this link comes before the other one.
@@ -1499,10 +2336,10 @@ uint Graph::assimilate_small_insertions(uint min_anchors, uint min_regions, uint
       //  FrontAnchor---(this_link)---BackAnchor  <=?=> BackAnchor---(other_link)---AnyAnchor
       short this_strand = 1;
       short back_strand = back_link->get_strand_for_matching_tags(back_anchor);
-      std::vector< std::list<tag>::iterator > this_tag_links_to_back =
+      std::vector< tag_list::iterator > this_tag_links_to_back =
           this_link->get_matching_tags(back_link, this_strand, back_strand, true);
       if (this_tag_links_to_back.empty()) {
-        if (print_debug_info) cout << "empty back matching tag " << back_link->tags.size() << " " << back_strand << endl;
+        if (print_debug_info) *log << "empty back matching tag " << back_link->tags.size() << " " << back_strand << endl;
         continue;
       }
       uint back_matches = 0;
@@ -1515,7 +2352,7 @@ uint Graph::assimilate_small_insertions(uint min_anchors, uint min_regions, uint
 
 
       // SECOND LOOP: front anchor
-      for (std::set<Link*>::iterator p_front_it = front_links.begin(); !has_been_assimilated and p_front_it != front_links.end(); p_front_it++) {
+      for (link_set::iterator p_front_it = front_links.begin(); !has_been_assimilated and p_front_it != front_links.end(); p_front_it++) {
         Link* front_link = *p_front_it;
         if (front_link == back_link) continue;
         // I am looking for insertions between front and back link, therefore they must
@@ -1527,10 +2364,10 @@ uint Graph::assimilate_small_insertions(uint min_anchors, uint min_regions, uint
         //  BackAnchor---(this_link)---FrontAnchor  <=?=> FrontAnchor---(other_link)---AnyAnchor
         this_strand = -1;
         short front_strand = front_link->get_strand_for_matching_tags(front_anchor);
-        std::vector< std::list<tag>::iterator > this_tag_links_to_front =
+        std::vector< tag_list::iterator > this_tag_links_to_front =
             this_link->get_matching_tags(front_link, this_strand, front_strand, true);
         if (this_tag_links_to_front.empty()) {
-          if (print_debug_info) cout << "empty front matching tag" << front_link->tags.size() << endl;
+          if (print_debug_info) *log << "empty front matching tag" << front_link->tags.size() << endl;
           continue;
         }
         if (this_tag_links_to_front.size() != this_tag_links_to_back.size()) {
@@ -1546,20 +2383,20 @@ uint Graph::assimilate_small_insertions(uint min_anchors, uint min_regions, uint
         }
         if (front_matches != this_link->tags.size()) continue;
 
-        std::vector< std::list<tag>::iterator > front_tag_links_to_this =
+        std::vector< tag_list::iterator > front_tag_links_to_this =
             front_link->get_matching_tags(this_link, -front_strand, 1, true);
-        std::vector< std::list<tag>::iterator > front_tag_links_to_back =
+        std::vector< tag_list::iterator > front_tag_links_to_back =
             front_link->get_matching_tags(back_link, -front_strand, back_strand, true);
         bool is_an_insertion = true;
         if (front_tag_links_to_back.empty() or front_tag_links_to_this.empty()) continue;
         for (uint i=0; i< front_link->tags.size(); i++) {
           if (front_tag_links_to_back[i] != back_link->tags.end() and front_tag_links_to_this[i] != this_link->tags.end()) {
-            cout << "------------------------------------" << endl;
-            cout << " WEIRD INSERTION ";
-            front_link->print();
-            this_link->print();
-            back_link->print();
-            cout << i << " matches this and back" << endl;
+            *log << "------------------------------------" << endl;
+            *log << " WEIRD INSERTION ";
+            front_link->print(*log);
+            this_link->print(*log);
+            back_link->print(*log);
+            *log << i << " matches this and back" << endl;
             is_an_insertion = false;
           } else if (front_tag_links_to_back[i] == back_link->tags.end() and
                      front_tag_links_to_this[i] == this_link->tags.end()) {
@@ -1570,13 +2407,13 @@ uint Graph::assimilate_small_insertions(uint min_anchors, uint min_regions, uint
         uint longest_region_length = this_link->get_longest_region_length();
         if (longest_region_length > max_insertion_length) continue;
         if (print_debug_info) {
-          cout << "------------------------------------" << endl;
-          cout << " INSERTION ";
-          front_link->print();
-          this_link->print();
-          back_link->print();
+          *log << "------------------------------------" << endl;
+          *log << " INSERTION ";
+          front_link->print(*log);
+          this_link->print(*log);
+          back_link->print(*log);
         }
-        std::list<tag>::iterator p_front_tag_it = front_link->tags.begin();
+        tag_list::iterator p_front_tag_it = front_link->tags.begin();
         for (uint i=0; i< front_link->tags.size(); i++) {
           if (front_tag_links_to_this[i] != this_link->tags.end()) {
             if (p_front_tag_it->end < front_tag_links_to_this[i]->end) {
@@ -1587,6 +2424,7 @@ uint Graph::assimilate_small_insertions(uint min_anchors, uint min_regions, uint
           }
           p_front_tag_it++;
         }
+        front_link->update_signature();
         delete(this_link);
         has_been_assimilated = true;
         assimilate_count++;
@@ -1596,7 +2434,487 @@ uint Graph::assimilate_small_insertions(uint min_anchors, uint min_regions, uint
 
   }
 
-  cout << assimilate_count << " assimilated insertion." << endl;
+  *log << assimilate_count << " assimilated insertion." << endl;
 
   return assimilate_count;
 }
+
+
+/*!
+    \fn Graph::compact()
+    After many passes, most Anchors are in the middle of the paths of the Links and have no links
+    of their own. They are moved out of the graph (see retired_anchors), so the next passes do not
+    go through them, and go back to it if they get a new Link (see restore_Anchor).
+    The Links, their tags and their paths are copied in the order of the Anchors to new chunks of
+    memory and the old ones are released (see start_spill_compaction). The next passes go through
+    the Links in the same order and find them one after the other in memory.
+    Returns the number of Anchors moved out of the graph.
+ */
+uint Graph::compact(void)
+{
+  *log << "Compacting graph..." << endl;
+  uint retired_count = 0;
+  for (map<string, Anchor*>::iterator it = anchors.begin(); it != anchors.end(); ) {
+    if (!it->second) {
+      anchors.erase(it++);
+    } else if (it->second->links.empty()) {
+      it->second->retired_from = this;
+      retired_anchors[it->first] = it->second;
+      anchors.erase(it++);
+      retired_count++;
+    } else {
+      it++;
+    }
+  }
+
+  open_memory_arena();
+  start_spill_compaction();
+  set<Link*> moved_links;
+  for (map<string, Anchor*>::iterator it = anchors.begin(); it != anchors.end(); it++) {
+    Anchor *this_anchor = it->second;
+    for (list<Link*>::iterator p_link = this_anchor->links.begin(); p_link != this_anchor->links.end(); p_link++) {
+      Link *old_link = *p_link;
+      /* Each link is in the list of its first and its last anchor. Take it from the first one only */
+      if (old_link->anchor_list.front() != this_anchor or moved_links.count(old_link)) {
+        continue;
+      }
+      Link *new_link = new Link(old_link);
+      new_link->serial = old_link->serial;
+      new_link->tags = old_link->tags;
+      new_link->update_signature();
+      Anchor *back_anchor = old_link->anchor_list.back();
+      replace(this_anchor->links.begin(), this_anchor->links.end(), old_link, new_link);
+      if (back_anchor != this_anchor) {
+        replace(back_anchor->links.begin(), back_anchor->links.end(), old_link, new_link);
+      }
+      moved_links.insert(new_link);
+      // old_link is not in the list of any Anchor anymore
+      delete(old_link);
+    }
+  }
+  finish_spill_compaction();
+
+  unsigned long long used, mapped;
+  get_spill_file_usage(used, mapped);
+  *log << retired_count << " anchors without links moved out of the graph (" << anchors.size() << " left); "
+      << moved_links.size() << " links moved to " << used / 1048576 << " MB" << endl;
+
+  return retired_count;
+}
+
+
+/*!
+    \fn get_name(map<string, string*> &names, const string &name)
+    Returns the string kept in the map for this name of a species or chromosome, adding it if needed
+ */
+static string *get_name(map<string, string*> &names, const string &name)
+{
+  string* &this_name = names[name];
+  if (!this_name) {
+    this_name = new string(name);
+  }
+
+  return this_name;
+}
+
+
+/*!
+    \fn Graph::write_snapshot(SnapshotFile &file)
+    The graph is written as:
+      - The species and the chromosomes: their number (4 bytes) and their names.
+      - The Anchors: their number (4 bytes) and, for each of them, its id, its number of hits (4 bytes),
+        whether it has been moved out of the graph by compact() (1 byte), and the number (4 bytes) and
+        indexes (4 bytes each) of its species.
+      - The Links, in order of first appearance in the lists of the Anchors: their number (8 bytes)
+        and, for each of them, its serial number (8 bytes, see link_order), the length of its path
+        and the indexes of its Anchors (4 bytes each)
+        and the number of tags (4 bytes) followed by the species, chromosome, start and end (4 bytes
+        each) and strand (1 byte) of each tag.
+      - For each Anchor, the number of Links in its list (4 bytes) and their indexes (8 bytes each),
+        so the Links are found in the same order as now.
+ */
+bool Graph::write_snapshot(SnapshotFile &file)
+{
+  map<string*, uint> species_indexes;
+  file.write_uint(species.size(), 4);
+  for (map<string, string*>::iterator it = species.begin(); it != species.end(); it++) {
+    uint index = species_indexes.size();
+    species_indexes[it->second] = index;
+    file.write_string(it->first);
+  }
+  map<string*, uint> chr_indexes;
+  file.write_uint(chrs.size(), 4);
+  for (map<string, string*>::iterator it = chrs.begin(); it != chrs.end(); it++) {
+    uint index = chr_indexes.size();
+    chr_indexes[it->second] = index;
+    file.write_string(it->first);
+  }
+
+  vector<Anchor*> these_anchors;
+  unordered_map<Anchor*, uint> anchor_indexes;
+  for (map<string, Anchor*>::iterator it = anchors.begin(); it != anchors.end(); it++) {
+    if (it->second) {
+      anchor_indexes[it->second] = these_anchors.size();
+      these_anchors.push_back(it->second);
+    }
+  }
+  for (map<string, Anchor*>::iterator it = retired_anchors.begin(); it != retired_anchors.end(); it++) {
+    anchor_indexes[it->second] = these_anchors.size();
+    these_anchors.push_back(it->second);
+  }
+  file.write_uint(these_anchors.size(), 4);
+  for (vector<Anchor*>::iterator p_anchor = these_anchors.begin(); p_anchor != these_anchors.end(); p_anchor++) {
+    file.write_string((*p_anchor)->id);
+    file.write_uint((*p_anchor)->num, 4);
+    file.write_uint((*p_anchor)->retired_from ? 1 : 0, 1);
+    // Sorted, so the same graph always gives the same file
+    vector<uint> these_species;
+    for (set<string*>::iterator p_species = (*p_anchor)->species.begin(); p_species != (*p_anchor)->species.end();
+        p_species++) {
+      these_species.push_back(species_indexes[*p_species]);
+    }
+    sort(these_species.begin(), these_species.end());
+    file.write_uint(these_species.size(), 4);
+    for (vector<uint>::iterator p_index = these_species.begin(); p_index != these_species.end(); p_index++) {
+      file.write_uint(*p_index, 4);
+    }
+  }
+
+  vector<Link*> these_links;
+  unordered_map<Link*, unsigned long> link_indexes;
+  for (vector<Anchor*>::iterator p_anchor = these_anchors.begin(); p_anchor != these_anchors.end(); p_anchor++) {
+    for (list<Link*>::iterator p_link = (*p_anchor)->links.begin(); p_link != (*p_anchor)->links.end(); p_link++) {
+      if (!link_indexes.count(*p_link)) {
+        link_indexes[*p_link] = these_links.size();
+        these_links.push_back(*p_link);
+      }
+    }
+  }
+  file.write_uint(these_links.size(), 8);
+  for (vector<Link*>::iterator p_link = these_links.begin(); p_link != these_links.end(); p_link++) {
+    file.write_uint((*p_link)->serial, 8);
+    file.write_uint((*p_link)->anchor_list.size(), 4);
+    for (anchor_path::iterator p_anchor = (*p_link)->anchor_list.begin(); p_anchor != (*p_link)->anchor_list.end();
+        p_anchor++) {
+      file.write_uint(anchor_indexes[*p_anchor], 4);
+    }
+    file.write_uint((*p_link)->tags.size(), 4);
+    for (tag_list::iterator p_tag = (*p_link)->tags.begin(); p_tag != (*p_link)->tags.end(); p_tag++) {
+      file.write_uint(species_indexes[p_tag->get_species()], 4);
+      file.write_uint(chr_indexes[p_tag->get_chr()], 4);
+      file.write_uint(p_tag->start, 4);
+      file.write_uint(p_tag->end, 4);
+      file.write_uint((unsigned char)(signed char)p_tag->strand, 1);
+    }
+  }
+  for (vector<Anchor*>::iterator p_anchor = these_anchors.begin(); p_anchor != these_anchors.end(); p_anchor++) {
+    file.write_uint((*p_anchor)->links.size(), 4);
+    for (list<Link*>::iterator p_link = (*p_anchor)->links.begin(); p_link != (*p_anchor)->links.end(); p_link++) {
+      file.write_uint(link_indexes[*p_link], 8);
+    }
+  }
+
+  return !file.error;
+}
+
+
+/*!
+    \fn Graph::read_snapshot(SnapshotFile &file)
+    On error, the Graph must be cleared (see Graph::clear).
+ */
+bool Graph::read_snapshot(SnapshotFile &file)
+{
+  string name;
+  vector<string*> these_species;
+  unsigned long long num = file.read_uint(4);
+  for (unsigned long long a = 0; a < num and file.read_string(name); a++) {
+    these_species.push_back(get_name(species, name));
+  }
+  vector<string*> these_chrs;
+  num = file.read_uint(4);
+  for (unsigned long long a = 0; a < num and file.read_string(name); a++) {
+    these_chrs.push_back(get_name(chrs, name));
+  }
+
+  vector<Anchor*> these_anchors;
+  num = file.read_uint(4);
+  for (unsigned long long a = 0; a < num and file.read_string(name); a++) {
+    if ((anchors.count(name) and anchors[name]) or retired_anchors.count(name)) {
+      file.error = true;
+      break;
+    }
+    Anchor *this_anchor = new Anchor(name);
+    this_anchor->num = file.read_uint(4);
+    if (file.read_uint(1)) {
+      this_anchor->retired_from = this;
+      retired_anchors[name] = this_anchor;
+    } else {
+      anchors[name] = this_anchor;
+    }
+    these_anchors.push_back(this_anchor);
+    unsigned long long num_species = file.read_uint(4);
+    for (unsigned long long b = 0; b < num_species and !file.error; b++) {
+      unsigned long long index = file.read_uint(4);
+      if (index >= these_species.size()) {
+        file.error = true;
+      } else {
+        this_anchor->species.insert(these_species[index]);
+      }
+    }
+  }
+
+  vector<Link*> these_links;
+  num = file.read_uint(8);
+  unsigned long long next_serial = get_next_link_serial();
+  for (unsigned long long a = 0; a < num and !file.error; a++) {
+    unsigned long long serial = file.read_uint(8);
+    unsigned long long path_length = file.read_uint(4);
+    if (path_length < 2) {
+      file.error = true;
+      break;
+    }
+    vector<Anchor*> path;
+    for (unsigned long long b = 0; b < path_length and !file.error; b++) {
+      unsigned long long index = file.read_uint(4);
+      if (index >= these_anchors.size()) {
+        file.error = true;
+      } else {
+        path.push_back(these_anchors[index]);
+      }
+    }
+    if (file.error) {
+      break;
+    }
+    Link *this_link = new Link(path[0], path[1]);
+    these_links.push_back(this_link);
+    this_link->serial = serial;
+    if (serial >= next_serial) {
+      next_serial = serial + 1;
+    }
+    for (uint b = 2; b < path.size(); b++) {
+      this_link->anchor_list.push_back(path[b]);
+    }
+    unsigned long long num_tags = file.read_uint(4);
+    for (unsigned long long b = 0; b < num_tags and !file.error; b++) {
+      unsigned long long species_index = file.read_uint(4);
+      unsigned long long chr_index = file.read_uint(4);
+      tag this_tag;
+      this_tag.start = file.read_uint(4);
+      this_tag.end = file.read_uint(4);
+      this_tag.strand = (signed char)file.read_uint(1);
+      if (species_index >= these_species.size() or chr_index >= these_chrs.size()) {
+        file.error = true;
+        break;
+      }
+      this_tag.sequence = get_tag_sequence(these_species[species_index], these_chrs[chr_index]);
+      this_link->tags.push_back(this_tag);
+    }
+    this_link->update_signature();
+  }
+
+  for (vector<Anchor*>::iterator p_anchor = these_anchors.begin(); p_anchor != these_anchors.end() and
+      !file.error; p_anchor++) {
+    unsigned long long num_links = file.read_uint(4);
+    for (unsigned long long b = 0; b < num_links and !file.error; b++) {
+      unsigned long long index = file.read_uint(8);
+      if (index >= these_links.size()) {
+        file.error = true;
+      } else {
+        (*p_anchor)->links.push_back(these_links[index]);
+      }
+    }
+  }
+
+  if (file.error) {
+    // The Links are not in the lists of the Anchors yet, or not in all of them
+    for (vector<Anchor*>::iterator p_anchor = these_anchors.begin(); p_anchor != these_anchors.end(); p_anchor++) {
+      (*p_anchor)->links.clear();
+    }
+    for (vector<Link*>::iterator p_link = these_links.begin(); p_link != these_links.end(); p_link++) {
+      delete(*p_link);
+    }
+    return false;
+  }
+  // The new Links must come after the ones read, as they would have in the Graph saved
+  set_next_link_serial(next_serial);
+
+  return true;
+}
+
+
+/*!
+    \fn Graph::start_update()
+    A new species only adds tags to the Links between the Anchors of its own consecutive hits. The
+    Anchors of these hits are recorded, so the parts of the graph that may change are known (see
+    Graph::get_updated_components). Hits of a species already in the graph would not be linked to
+    the hits loaded before: they are refused.
+ */
+void Graph::start_update(void)
+{
+  updating = true;
+  previous_species.clear();
+  for (map<string, string*>::iterator it = species.begin(); it != species.end(); it++) {
+    if (it->second) {
+      previous_species.insert(it->second);
+    }
+  }
+  updated_anchors.clear();
+}
+
+
+/*!
+    \fn find_component(vector<uint> &components, uint index)
+    Returns the first element of the component of this one, halving the path on the way
+ */
+static uint find_component(vector<uint> &components, uint index)
+{
+  while (components[index] != index) {
+    components[index] = components[components[index]];
+    index = components[index];
+  }
+
+  return index;
+}
+
+
+/*!
+    \fn Graph::get_updated_components(set<string> &ids)
+    Two Anchors are in the same connected component if they are in the path of the same Link, not
+    only at its ends. No stage of the pipeline links two components, so the rest of the graph is
+    not affected by the hits added since the update started.
+ */
+uint Graph::get_updated_components(set<string> &ids)
+{
+  vector<Anchor*> these_anchors;
+  unordered_map<Anchor*, uint> anchor_indexes;
+  for (map<string, Anchor*>::iterator it = anchors.begin(); it != anchors.end(); it++) {
+    if (it->second) {
+      anchor_indexes[it->second] = these_anchors.size();
+      these_anchors.push_back(it->second);
+    }
+  }
+  for (map<string, Anchor*>::iterator it = retired_anchors.begin(); it != retired_anchors.end(); it++) {
+    anchor_indexes[it->second] = these_anchors.size();
+    these_anchors.push_back(it->second);
+  }
+
+  vector<uint> components(these_anchors.size());
+  for (uint a = 0; a < components.size(); a++) {
+    components[a] = a;
+  }
+  for (uint a = 0; a < these_anchors.size(); a++) {
+    for (list<Link*>::iterator p_link = these_anchors[a]->links.begin(); p_link != these_anchors[a]->links.end();
+        p_link++) {
+      if ((*p_link)->anchor_list.front() != these_anchors[a]) {
+        continue;
+      }
+      uint component = find_component(components, a);
+      for (anchor_path::iterator p_anchor = (*p_link)->anchor_list.begin();
+          p_anchor != (*p_link)->anchor_list.end(); p_anchor++) {
+        unordered_map<Anchor*, uint>::iterator p_index = anchor_indexes.find(*p_anchor);
+        if (p_index != anchor_indexes.end()) {
+          components[find_component(components, p_index->second)] = component;
+        }
+      }
+    }
+  }
+
+  set<uint> updated_components;
+  for (set<Anchor*>::iterator it = updated_anchors.begin(); it != updated_anchors.end(); it++) {
+    unordered_map<Anchor*, uint>::iterator p_index = anchor_indexes.find(*it);
+    if (p_index != anchor_indexes.end()) {
+      updated_components.insert(find_component(components, p_index->second));
+    }
+  }
+  for (uint a = 0; a < these_anchors.size(); a++) {
+    if (updated_components.count(find_component(components, a))) {
+      ids.insert(these_anchors[a]->id);
+    }
+  }
+
+  return updated_components.size();
+}
+
+
+/*!
+    \fn Graph::remove_anchors(set<string> &ids, bool keep)
+    The ids must cover whole connected components (see Graph::get_updated_components), as the
+    Links of the removed Anchors are removed too. Returns the number of Anchors removed.
+ */
+unsigned long Graph::remove_anchors(set<string> &ids, bool keep)
+{
+  set<Link*> these_links;
+  vector<Anchor*> these_anchors;
+  map<string, Anchor*> *maps[2] = {&anchors, &retired_anchors};
+  for (uint a = 0; a < 2; a++) {
+    for (map<string, Anchor*>::iterator it = maps[a]->begin(); it != maps[a]->end(); ) {
+      if (!it->second) {
+        maps[a]->erase(it++);
+      } else if ((ids.count(it->first) > 0) != keep) {
+        these_links.insert(it->second->links.begin(), it->second->links.end());
+        these_anchors.push_back(it->second);
+        maps[a]->erase(it++);
+      } else {
+        it++;
+      }
+    }
+  }
+  for (set<Link*>::iterator it = these_links.begin(); it != these_links.end(); it++) {
+    delete(*it);
+  }
+  for (vector<Anchor*>::iterator it = these_anchors.begin(); it != these_anchors.end(); it++) {
+    delete(*it);
+  }
+  clear_position_index();
+
+  return these_anchors.size();
+}
+
+
+/*!
+    \fn Graph::move_anchors_from(Graph &other)
+    The species and chromosomes of the Anchors and tags are changed to the ones of this Graph. The
+    other Graph is left without Anchors. Both Graphs must not have any Anchor in common.
+ */
+void Graph::move_anchors_from(Graph &other)
+{
+  map<uint, uint> sequences; //!< from the sequences of the other Graph to the ones of this one
+  map<string, Anchor*> *maps[2] = {&other.anchors, &other.retired_anchors};
+  for (uint a = 0; a < 2; a++) {
+    for (map<string, Anchor*>::iterator it = maps[a]->begin(); it != maps[a]->end(); it++) {
+      Anchor *this_anchor = it->second;
+      if (!this_anchor) {
+        continue;
+      }
+      set<string*> these_species;
+      for (set<string*>::iterator p_species = this_anchor->species.begin(); p_species != this_anchor->species.end();
+          p_species++) {
+        these_species.insert(get_name(species, **p_species));
+      }
+      this_anchor->species.swap(these_species);
+      for (list<Link*>::iterator p_link = this_anchor->links.begin(); p_link != this_anchor->links.end(); p_link++) {
+        if ((*p_link)->anchor_list.front() != this_anchor) {
+          continue;
+        }
+        for (tag_list::iterator p_tag = (*p_link)->tags.begin(); p_tag != (*p_link)->tags.end(); p_tag++) {
+          map<uint, uint>::iterator p_sequence = sequences.find(p_tag->sequence);
+          if (p_sequence == sequences.end()) {
+            uint sequence = get_tag_sequence(get_name(species, *p_tag->get_species()),
+                get_name(chrs, *p_tag->get_chr()));
+            p_sequence = sequences.insert(make_pair((uint)p_tag->sequence, sequence)).first;
+          }
+          p_tag->sequence = p_sequence->second;
+        }
+        (*p_link)->update_signature();
+      }
+      if (this_anchor->retired_from) {
+        this_anchor->retired_from = this;
+        retired_anchors[it->first] = this_anchor;
+      } else {
+        anchors[it->first] = this_anchor;
+      }
+    }
+    maps[a]->clear();
+  }
+  clear_position_index();
+}
@@ -9,9 +9,40 @@
 #include <cstdlib>
 #include <map>
 #include <fstream>
+#include <set>
+#include <vector>
+#include <unordered_map>
+#include "reader.h"
+#include "sort.h"
+#include "index.h"
+#include "link.h"
+#include "snapshot.h"
 
 typedef class Anchor Anchor;
 
+//! Number of hits and of species of an Anchor removed by the anchor filter (see Graph::prescan_file)
+
+struct anchor_count {
+  unsigned long hits;
+  uint species;
+};
+
+//! One region of a Link in the position index of the Graph (see Graph::get_links_at)
+
+struct link_position {
+  uint sequence; //!< species and chromosome (see get_tag_sequence)
+  uint start;
+  uint end;
+  Link *link;
+};
+
+//! Tags of a Link before get_links() tests whether it is a bridge (see Graph::restore_bridges)
+
+struct bridge_link {
+  Link *link;
+  tag_list tags;
+};
+
 //! A Graph is made of Anchor objects linked by Links. Each Anchor is a vertex and each Link is an edge
 
 class Graph{
@@ -19,31 +50,159 @@ public:
     Graph();
 
     ~Graph();
+    //! Removes all the Anchors and Links from the graph
+    void clear(void);
     //! Adds an anchor in the graph
     void add_Anchor(Anchor *this_anchor);
+    //! Puts back in the graph an Anchor moved out by compact()
+    void restore_Anchor(Anchor *this_anchor);
     Anchor* get_Anchor(std::string id);
-    bool populate_from_file(char *filename, float min_score, int max_gap_length, bool anchors_as_links);
-    void minimize(std::string debug = "");
+    bool populate_from_file(char *filename, float min_score, int max_gap_length, bool anchors_as_links,
+        bool merge_overlap = false, char *merged_filename = NULL);
+    //! Loads all the species and regions again
+    void clear_selection(void);
+    //! Sets whether and how unsorted anchors files are sorted while loading them
+    void set_sorting(sort_mode mode, unsigned long max_memory = DEFAULT_SORT_MEMORY, std::string tmp_dir = "");
+    //! Restricts the loading to this region (see IndexedHitReader)
+    void add_region(region &this_region);
+    //! Loads this species (all of them by default)
+    void include_species(std::string name);
+    //! Does not load this species
+    void exclude_species(std::string name);
+    //! Skips the Anchors found too many times per species or in total (0 for no limit)
+    void set_anchor_filter(uint max_copies, unsigned long max_hits);
+    //! Prints the Anchors removed by the anchor filter
+    void print_filtered_anchors(std::ostream &out);
+    //! Counts the Anchors in the anchors file before loading it
+    void set_prescan(bool prescan);
+    bool populate_from_reader(HitReader &reader, float min_score, int max_gap_length, bool check_order = false);
+    //! Resets the status of the loading before adding hits one by one
+    void start_hits(float min_score, int max_gap_length);
+    //! Adds one hit to the graph, linking it to the previous one if they are consecutive on the genome
+    bool add_hit(hit &this_hit);
+    //! Prevents the next hit from being linked to the previous one
+    void break_path(void);
+    //! Checks that the hits come sorted by species, chromosome and position
+    bool hit_is_sorted(hit &this_hit);
+    uint minimize(std::string debug = "");
     void print_anchors_histogram(std::ostream &out = std::cout);
     void print_stats(int histogram_size);
+    //! Gets the Links that would be printed by print_links()
+    void get_links(std::vector<Link*> &links, uint min_anchors = 1, uint min_regions = 1, uint min_length = 0,
+        bool allow_bridges = false);
     unsigned long int print_links(std::ostream &out = std::cout, uint min_anchors = 1, uint min_regions = 1,
         uint min_length = 0, bool allow_bridges = false);
+    //! Gets the Links with a region overlapping this one, in order of position (see get_links for the limits)
+    void get_links_at(std::string species, std::string chr, uint start, uint end, std::vector<Link*> &links,
+        uint min_anchors = 1, uint min_regions = 1, uint min_length = 0, bool allow_bridges = false);
+    //! Removes the index used by get_links_at(). Must be called after any change in the graph
+    void clear_position_index(void);
+    //! Undoes the trimming of the bridges found by the last get_links() or get_links_at()
+    void restore_bridges(void);
+    //! Prints the Links of this Anchor, as in the debug output. Returns false if it is not in the graph
+    bool print_anchor(std::string id, std::ostream &out);
     int merge_alternative_paths(uint max_anchors, uint max_length = 10000, std::string debug = "");
     void study_anchors(void);
     int simplify(uint min_anchors = 1, uint min_regions = 1, uint min_length = 0, std::string debug = "");
     int simplify_aggressive(uint min_anchors = 1, uint min_regions = 1, uint min_length = 0, std::string debug = "");
     int split_unselected_links(uint min_anchors = 1, uint min_regions = 1, uint min_length = 0, std::string debug = "");
-    void split_unbalanced_links(float max_ratio, std::string debug = "");
+    uint split_unbalanced_links(float max_ratio, std::string debug = "");
+    //! Moves out the Anchors without links and moves the Links together in memory
+    uint compact(void);
+    //! Writes all the Anchors and Links in a snapshot file
+    bool write_snapshot(SnapshotFile &file);
+    //! Reads a graph written by write_snapshot(). The Graph must be empty
+    bool read_snapshot(SnapshotFile &file);
+    //! Records the Anchors of the hits added from now on. Hits of the species already in the Graph are refused
+    void start_update(void);
+    //! Gets the ids of the Anchors connected to the ones recorded since start_update(). Returns the number of components
+    uint get_updated_components(std::set<std::string> &ids);
+    //! Removes the Anchors with these ids (or all the others if keep is set) and their Links
+    unsigned long remove_anchors(std::set<std::string> &ids, bool keep = false);
+    //! Moves all the Anchors and Links of another Graph to this one
+    void move_anchors_from(Graph &other);
     //! Looks for small palindromes and destroy them: A=B=C will become A-B-C-B-A
     uint resolve_small_palindromes(uint min_anchors = 1, uint min_regions = 1, uint min_length = 0, std::string debug = "");
     //! Looks for small insertions and assimilates them in the paths
     uint assimilate_small_insertions(uint min_anchors = 1, uint min_regions = 1, uint min_length = 0,
                                      uint max_insertion_length = 10000, std::string debug = "");
 
+    // Read-only parts of simplify() and simplify_aggressive(), safe to run in parallel
+    void get_simplify_neighbours(Link *this_link, uint min_regions, link_set &front_links,
+        link_set &back_links);
+    bool find_simplify_split(Link *this_link, link_set &front_links, link_set &back_links,
+        std::vector<bool> &tags_to_split, bool print_debug_info = false);
+    void get_aggressive_neighbours(Link *this_link, uint min_anchors, uint min_length, link_set &front_links,
+        link_set &back_links);
+    bool find_aggressive_split(Link *this_link, link_set &front_links, link_set &back_links,
+        Link* &front_link, Link* &back_link, std::vector< tag_list::iterator > &this_tag_links_to_front,
+        std::vector< tag_list::iterator > &this_tag_links_to_back, bool &split_front, bool &split_back,
+        bool print_debug_info = false);
+
+    std::ostream *log; //!< progress messages and stats are written to this stream (STDOUT by default)
+
 protected:
     std::map<std::string, Anchor*> anchors;
+    std::map<std::string, Anchor*> retired_anchors; //!< Anchors without links, out of the graph (see compact)
     std::map<std::string, std::string*> species;
     std::map<std::string, std::string*> chrs;
+
+    // Status of the loading of hits (see Graph::add_hit)
+    float min_score;
+    int max_gap_length;
+    uint long_gap_counter;
+    Anchor *last_anchor;
+    std::string last_species;
+    std::string last_chr;
+    int last_start;
+    int last_end;
+
+    // Sorting of the anchors file (see Graph::set_sorting)
+    sort_mode sorting;
+    unsigned long sort_max_memory;
+    std::string sort_tmp_dir;
+    bool get_species_regions(char *filename, std::vector<region> &species_regions);
+
+    // Anchor filter (see Graph::set_anchor_filter)
+    uint max_anchor_copies;
+    unsigned long max_anchor_hits;
+    std::map<std::string, anchor_count> filtered_anchors; //!< hits of these Anchors are skipped
+
+    // Pre-scan of the anchors file (see Graph::set_prescan)
+    bool prescan;
+    std::unordered_map<std::string, Anchor*> anchor_index; //!< all the Anchors while loading a pre-scanned file
+    bool prescan_file(char *filename, std::vector<region> &these_regions, species_filter *filter, float min_score,
+        bool &is_sorted);
+    void add_prescanned_anchor(const std::string &id);
+    void remove_prescanned_anchors(void);
+
+    void find_split_candidates(std::vector<Link*> &candidates, bool aggressive, uint min_anchors, uint min_regions,
+        uint min_length, std::string debug, std::vector<char> &may_split);
+    void print_neighbours(Link *this_link, link_set &front_links, link_set &back_links,
+        uint min_anchors, uint min_regions, uint min_length);
+    void print_matching_tags(Link *this_link, Link *front_link, Link *back_link,
+        std::vector< tag_list::iterator > &this_tag_links_to_front,
+        std::vector< tag_list::iterator > &this_tag_links_to_back);
+
+    // Index of the regions of the Links (see get_links_at)
+    std::vector<link_position> position_index; //!< sorted by sequence and start
+    uint max_position_length; //!< of the regions in the index
+    void build_position_index(void);
+    std::list<bridge_link> bridge_links; //!< links tested by is_bridge() in get_links() and get_links_at()
+    bool is_bridge(Link *this_link, uint min_anchors, uint min_regions, uint min_length);
+
+    std::vector<region> regions; //!< if any, only the hits in these regions are loaded
+    species_filter selected_species; //!< species to be loaded
+    bool unsorted_input; //!< set when populate_from_reader() stops because the hits are not sorted
+    std::string sorted_species;
+    std::string sorted_chr;
+    int sorted_start;
+    std::set<std::pair<std::string, std::string> > sorted_sequences; //!< species and chromosomes already finished
+
+    // Update of a saved graph (see Graph::start_update)
+    bool updating;
+    std::set<std::string*> previous_species; //!< species in the Graph when the update started
+    std::set<Anchor*> updated_anchors; //!< Anchors of the hits added since then
 };
 
 #endif
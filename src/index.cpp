@@ -0,0 +1,714 @@
+#include "index.h"
+#include <fstream>
+#include <cstdlib>
+#include <algorithm>
+
+using namespace std;
+
+#define INDEX_MAGIC "ENREDOIX"
+#define INDEX_VERSION 1
+#define BLOCK_INDEX_MAGIC "ENREDOBX"
+#define BLOCK_INDEX_VERSION 1
+
+static void write_uint(ostream &out, unsigned long long value, int bytes)
+{
+  for (int a = 0; a < bytes; a++) {
+    out.put((char)((value >> (8 * a)) & 0xff));
+  }
+}
+
+static unsigned long long read_uint(istream &in, int bytes)
+{
+  unsigned long long value = 0;
+  for (int a = 0; a < bytes; a++) {
+    value |= (unsigned long long)(unsigned char)in.get() << (8 * a);
+  }
+  return value;
+}
+
+static void write_string(ostream &out, string &value)
+{
+  write_uint(out, value.size(), 4);
+  out.write(value.data(), value.size());
+}
+
+static bool read_string(istream &in, string &value)
+{
+  unsigned long long size = read_uint(in, 4);
+  if (!in.good() or size > 1048576) {
+    return false;
+  }
+  value.resize(size);
+  if (size) {
+    in.read(&value[0], size);
+  }
+  return in.good();
+}
+
+
+/*!
+    \fn parse_region(string text, region &this_region)
+    The chromosome name can contain colons. Positions can contain commas (1,000,000).
+ */
+bool parse_region(string text, region &this_region)
+{
+  size_t species_end = text.find(':');
+  if (species_end == string::npos or species_end == 0) {
+    return false;
+  }
+  this_region.species = text.substr(0, species_end);
+  this_region.chr = text.substr(species_end + 1);
+  this_region.start = 0;
+  this_region.end = -1;
+
+  size_t chr_end = this_region.chr.rfind(':');
+  if (chr_end != string::npos) {
+    string range = "";
+    string positions = this_region.chr.substr(chr_end + 1);
+    for (uint a = 0; a < positions.size(); a++) {
+      if (positions[a] != ',') {
+        range += positions[a];
+      }
+    }
+    size_t dash = range.find('-');
+    if (dash != string::npos and dash > 0 and dash < range.size() - 1 and
+        range.find_first_not_of("0123456789-") == string::npos and range.find('-', dash + 1) == string::npos) {
+      this_region.start = atoi(range.substr(0, dash).c_str());
+      this_region.end = atoi(range.substr(dash + 1).c_str());
+      this_region.chr = this_region.chr.substr(0, chr_end);
+    }
+  }
+
+  return (!this_region.chr.empty() and (this_region.end < 0 or this_region.start <= this_region.end));
+}
+
+
+/*!
+    \fn parse_position(string text, region &this_region)
+ */
+bool parse_position(string text, region &this_region)
+{
+  size_t last_colon = text.rfind(':');
+  if (last_colon != string::npos and last_colon < text.size() - 1 and
+      text.find_first_not_of("0123456789,", last_colon + 1) == string::npos and
+      text.find(':') < last_colon) {
+    string position = text.substr(last_colon + 1);
+    text += "-" + position;
+  }
+
+  return parse_region(text, this_region);
+}
+
+
+/*!
+    \fn parse_block_region(const string &line, string &species, string &chr, unsigned int &start, unsigned int &end, int &strand)
+    The chromosome name can contain colons, the species name cannot.
+ */
+bool parse_block_region(const string &line, string &species, string &chr, unsigned int &start, unsigned int &end,
+    int &strand)
+{
+  size_t strand_start = line.rfind(" [");
+  if (strand_start == string::npos) {
+    return false;
+  }
+  size_t strand_end = line.find(']', strand_start);
+  size_t end_start = line.rfind(':', strand_start);
+  size_t start_start = (end_start == string::npos or end_start == 0) ? string::npos : line.rfind(':', end_start - 1);
+  size_t chr_start = line.find(':');
+  if (strand_end == string::npos or start_start == string::npos or chr_start == string::npos or
+      chr_start >= start_start) {
+    return false;
+  }
+  species = line.substr(0, chr_start);
+  chr = line.substr(chr_start + 1, start_start - chr_start - 1);
+  start = atoi(line.substr(start_start + 1, end_start - start_start - 1).c_str());
+  end = atoi(line.substr(end_start + 1, strand_start - end_start - 1).c_str());
+  strand = atoi(line.substr(strand_start + 2, strand_end - strand_start - 2).c_str());
+
+  return true;
+}
+
+
+AnchorsIndex::AnchorsIndex()
+{
+}
+
+
+AnchorsIndex::~AnchorsIndex()
+{
+}
+
+
+/*!
+    \fn AnchorsIndex::get_filename(char *filename)
+ */
+string AnchorsIndex::get_filename(char *filename)
+{
+  return string(filename) + ".eix";
+}
+
+
+/*!
+    \fn AnchorsIndex::build(char *filename)
+    The anchors file must be sorted: all the hits of each chromosome together and sorted by start
+    position. The order of the species and chromosomes does not matter.
+ */
+bool AnchorsIndex::build(char *filename)
+{
+  HitReader reader;
+  if (!reader.open(filename)) {
+    return false;
+  }
+  reader.track_offsets = true;
+  sequences.clear();
+  sequence_indexes.clear();
+
+  hit this_hit;
+  sequence_index *sequence = NULL;
+  int last_start = 0;
+  while (reader.next_hit(this_hit)) {
+    if (!sequence or sequence->species != this_hit.species or sequence->chr != this_hit.chr) {
+      pair<string, string> key(this_hit.species, this_hit.chr);
+      if (sequence_indexes.count(key)) {
+        cerr << "The anchors file is not sorted: " << this_hit.species << ":" << this_hit.chr
+            << " appears twice" << endl;
+        reader.close();
+        return false;
+      }
+      sequence_indexes[key] = sequences.size();
+      sequences.push_back(sequence_index());
+      sequence = &sequences.back();
+      sequence->species = this_hit.species;
+      sequence->chr = this_hit.chr;
+      sequence->first_offset = reader.line_offset;
+      sequence->num_hits = 0;
+    } else if (this_hit.start < last_start) {
+      cerr << "The anchors file is not sorted by position: <" << reader.line << ">" << endl;
+      reader.close();
+      return false;
+    }
+    last_start = this_hit.start;
+    sequence->num_hits++;
+
+    uint first_bin = (this_hit.start > 0) ? this_hit.start / INDEX_BIN_SIZE : 0;
+    uint last_bin = (this_hit.end > 0) ? this_hit.end / INDEX_BIN_SIZE : 0;
+    if (last_bin >= sequence->bins.size()) {
+      sequence->bins.resize(last_bin + 1, NO_OFFSET);
+    }
+    for (uint bin = first_bin; bin <= last_bin; bin++) {
+      if (sequence->bins[bin] == NO_OFFSET) {
+        sequence->bins[bin] = reader.line_offset;
+      }
+    }
+  }
+  reader.close();
+  if (reader.error) {
+    return false;
+  }
+
+  // Empty bins point to the first hit after them
+  for (uint a = 0; a < sequences.size(); a++) {
+    vector<unsigned long long> &bins = sequences[a].bins;
+    for (int bin = (int)bins.size() - 2; bin >= 0; bin--) {
+      if (bins[bin] == NO_OFFSET) {
+        bins[bin] = bins[bin + 1];
+      }
+    }
+  }
+
+  return true;
+}
+
+
+/*!
+    \fn AnchorsIndex::write(string index_filename)
+ */
+bool AnchorsIndex::write(string index_filename)
+{
+  ofstream out(index_filename.c_str(), ios::out | ios::binary);
+  if (!out.is_open()) {
+    cerr << "Cannot open file " << index_filename << endl;
+    return false;
+  }
+  out.write(INDEX_MAGIC, 8);
+  write_uint(out, INDEX_VERSION, 4);
+  write_uint(out, INDEX_BIN_SIZE, 4);
+  write_uint(out, sequences.size(), 4);
+  for (uint a = 0; a < sequences.size(); a++) {
+    write_string(out, sequences[a].species);
+    write_string(out, sequences[a].chr);
+    write_uint(out, sequences[a].first_offset, 8);
+    write_uint(out, sequences[a].num_hits, 8);
+    write_uint(out, sequences[a].bins.size(), 4);
+    for (uint bin = 0; bin < sequences[a].bins.size(); bin++) {
+      write_uint(out, sequences[a].bins[bin], 8);
+    }
+  }
+  out.close();
+  if (out.fail()) {
+    cerr << "Cannot write file " << index_filename << endl;
+    return false;
+  }
+
+  return true;
+}
+
+
+/*!
+    \fn AnchorsIndex::read(string index_filename)
+ */
+bool AnchorsIndex::read(string index_filename)
+{
+  ifstream in(index_filename.c_str(), ios::in | ios::binary);
+  if (!in.is_open()) {
+    return false;
+  }
+  char magic[8];
+  in.read(magic, 8);
+  if (!in.good() or string(magic, 8) != INDEX_MAGIC or read_uint(in, 4) != INDEX_VERSION or
+      read_uint(in, 4) != INDEX_BIN_SIZE) {
+    cerr << "Wrong index file " << index_filename << endl;
+    return false;
+  }
+  sequences.clear();
+  sequence_indexes.clear();
+  unsigned long long num_sequences = read_uint(in, 4);
+  for (unsigned long long a = 0; a < num_sequences and in.good(); a++) {
+    sequences.push_back(sequence_index());
+    sequence_index &sequence = sequences.back();
+    if (!read_string(in, sequence.species) or !read_string(in, sequence.chr)) {
+      break;
+    }
+    sequence.first_offset = read_uint(in, 8);
+    sequence.num_hits = read_uint(in, 8);
+    unsigned long long num_bins = read_uint(in, 4);
+    for (unsigned long long bin = 0; bin < num_bins and in.good(); bin++) {
+      sequence.bins.push_back(read_uint(in, 8));
+    }
+    sequence_indexes[make_pair(sequence.species, sequence.chr)] = a;
+  }
+  if (!in.good()) {
+    cerr << "Wrong index file " << index_filename << endl;
+    sequences.clear();
+    sequence_indexes.clear();
+    return false;
+  }
+
+  return true;
+}
+
+
+/*!
+    \fn AnchorsIndex::find(string species, string chr)
+ */
+sequence_index* AnchorsIndex::find(string species, string chr)
+{
+  map<pair<string, string>, unsigned int>::iterator it = sequence_indexes.find(make_pair(species, chr));
+  if (it == sequence_indexes.end()) {
+    return NULL;
+  }
+
+  return &sequences[it->second];
+}
+
+
+/*!
+    \fn AnchorsIndex::get_offset(sequence_index *sequence, int start)
+    Returns ~0 if no hit reaches this position
+ */
+unsigned long long AnchorsIndex::get_offset(sequence_index *sequence, int start)
+{
+  if (start <= 0) {
+    return sequence->first_offset;
+  }
+  unsigned long bin = start / INDEX_BIN_SIZE;
+  if (bin >= sequence->bins.size()) {
+    return NO_OFFSET;
+  }
+
+  return sequence->bins[bin];
+}
+
+
+IndexedHitReader::IndexedHitReader()
+{
+  current_region = 0;
+  region_is_started = false;
+  pending_path_break = false;
+}
+
+
+IndexedHitReader::~IndexedHitReader()
+{
+}
+
+
+/*!
+    \fn IndexedHitReader::open(char *filename)
+ */
+bool IndexedHitReader::open(char *filename)
+{
+  if (!index.read(AnchorsIndex::get_filename(filename))) {
+    cerr << "Cannot read the index of " << filename << " (see indexanchors)" << endl;
+    return false;
+  }
+  current_region = 0;
+  region_is_started = false;
+
+  return HitReader::open(filename);
+}
+
+
+/*!
+    \fn IndexedHitReader::add_region(region &this_region)
+    Returns false if there are no hits on this chromosome
+ */
+bool IndexedHitReader::add_region(region &this_region)
+{
+  regions.push_back(this_region);
+
+  return (index.find(this_region.species, this_region.chr) != NULL);
+}
+
+
+/*!
+    \fn IndexedHitReader::start_region()
+    Jumps to the first hit that can overlap the current region. Returns false if there is none
+ */
+bool IndexedHitReader::start_region(void)
+{
+  region &this_region = regions[current_region];
+  sequence_index *sequence = index.find(this_region.species, this_region.chr);
+  if (!sequence) {
+    return false;
+  }
+  unsigned long long offset = index.get_offset(sequence, this_region.start);
+  if (offset == NO_OFFSET) {
+    return false;
+  }
+
+  return seek(offset);
+}
+
+
+/*!
+    \fn IndexedHitReader::next_hit(hit &this_hit)
+    Hits are returned if they overlap the region
+ */
+bool IndexedHitReader::next_hit(hit &this_hit)
+{
+  while (current_region < regions.size()) {
+    region &this_region = regions[current_region];
+    if (!region_is_started) {
+      if (!start_region()) {
+        if (error) {
+          return false;
+        }
+        current_region++;
+        continue;
+      }
+      region_is_started = true;
+      pending_path_break = true;
+    }
+    while (HitReader::next_hit(this_hit)) {
+      if (this_hit.species != this_region.species or this_hit.chr != this_region.chr or
+          (this_region.end >= 0 and this_hit.start > this_region.end)) {
+        break;
+      }
+      if (this_hit.end < this_region.start) {
+        pending_path_break = pending_path_break or path_break;
+        continue;
+      }
+      path_break = path_break or pending_path_break;
+      pending_path_break = false;
+      return true;
+    }
+    if (error) {
+      return false;
+    }
+    current_region++;
+    region_is_started = false;
+  }
+
+  return false;
+}
+
+
+BlockIndex::BlockIndex()
+{
+  is_sorted = true;
+}
+
+
+BlockIndex::~BlockIndex()
+{
+}
+
+
+/*!
+    \fn BlockIndex::get_filename(char *filename)
+ */
+string BlockIndex::get_filename(char *filename)
+{
+  return string(filename) + ".ebi";
+}
+
+
+/*!
+    \fn BlockIndex::add_block(unsigned long long offset)
+ */
+void BlockIndex::add_block(unsigned long long offset)
+{
+  block_offsets.push_back(offset);
+}
+
+
+/*!
+    \fn BlockIndex::add_region(const string &species, const string &chr, unsigned int start, unsigned int end, int strand)
+ */
+void BlockIndex::add_region(const string &species, const string &chr, unsigned int start, unsigned int end,
+    int strand)
+{
+  block_sequence *sequence = find(species, chr);
+  if (!sequence) {
+    sequence_indexes[make_pair(species, chr)] = sequences.size();
+    sequences.push_back(block_sequence());
+    sequence = &sequences.back();
+    sequence->species = species;
+    sequence->chr = chr;
+    sequence->max_length = 0;
+  }
+  block_interval this_interval;
+  this_interval.start = start;
+  this_interval.end = end;
+  this_interval.block = block_offsets.size() - 1;
+  this_interval.strand = strand;
+  if (!sequence->intervals.empty() and start < sequence->intervals.back().start) {
+    is_sorted = false;
+  }
+  sequence->intervals.push_back(this_interval);
+  if (end - start > sequence->max_length) {
+    sequence->max_length = end - start;
+  }
+}
+
+
+/*!
+    \fn BlockIndex::build(char *filename)
+    Reads the blocks as printed by enredo: a "block" line followed by one line per region
+    (species:chr:start:end [strand] l=length). Comment lines are skipped.
+ */
+bool BlockIndex::build(char *filename)
+{
+  ifstream in(filename);
+  if (!in.is_open()) {
+    cerr << "Cannot open file " << filename << endl;
+    return false;
+  }
+  unsigned long long offset = 0;
+  string line;
+  bool in_block = false;
+  while (getline(in, line)) {
+    unsigned long long line_offset = offset;
+    offset += line.size() + 1;
+    if (line.empty()) {
+      in_block = false;
+      continue;
+    } else if (line[0] == '#') {
+      continue;
+    } else if (line.compare(0, 5, "block") == 0) {
+      add_block(line_offset);
+      in_block = true;
+      continue;
+    }
+    string species, chr;
+    unsigned int start, end;
+    int strand;
+    if (!in_block or !parse_block_region(line, species, chr, start, end, strand)) {
+      cerr << "Wrong line in " << filename << ": <" << line << ">" << endl;
+      return false;
+    }
+    add_region(species, chr, start, end, strand);
+  }
+  if (in.bad()) {
+    cerr << "Cannot read file " << filename << endl;
+    return false;
+  }
+
+  return true;
+}
+
+
+struct sort_block_intervals {
+  bool operator()(const block_interval &a, const block_interval &b) const {
+    if (a.start != b.start) {
+      return a.start < b.start;
+    } else if (a.end != b.end) {
+      return a.end < b.end;
+    }
+    return a.block < b.block;
+  }
+};
+
+
+/*!
+    \fn BlockIndex::sort()
+ */
+void BlockIndex::sort(void)
+{
+  if (is_sorted) {
+    return;
+  }
+  for (vector<block_sequence>::iterator it = sequences.begin(); it != sequences.end(); it++) {
+    std::sort(it->intervals.begin(), it->intervals.end(), sort_block_intervals());
+  }
+  is_sorted = true;
+}
+
+
+/*!
+    \fn BlockIndex::write(string index_filename)
+ */
+bool BlockIndex::write(string index_filename)
+{
+  sort();
+  ofstream out(index_filename.c_str(), ios::out | ios::binary);
+  if (!out.is_open()) {
+    cerr << "Cannot open file " << index_filename << endl;
+    return false;
+  }
+  out.write(BLOCK_INDEX_MAGIC, 8);
+  write_uint(out, BLOCK_INDEX_VERSION, 4);
+  write_uint(out, block_offsets.size(), 4);
+  for (uint a = 0; a < block_offsets.size(); a++) {
+    write_uint(out, block_offsets[a], 8);
+  }
+  write_uint(out, sequences.size(), 4);
+  for (uint a = 0; a < sequences.size(); a++) {
+    write_string(out, sequences[a].species);
+    write_string(out, sequences[a].chr);
+    write_uint(out, sequences[a].max_length, 4);
+    write_uint(out, sequences[a].intervals.size(), 4);
+    for (vector<block_interval>::iterator it = sequences[a].intervals.begin(); it != sequences[a].intervals.end();
+        it++) {
+      write_uint(out, it->start, 4);
+      write_uint(out, it->end, 4);
+      write_uint(out, it->block, 4);
+      out.put((char)it->strand);
+    }
+  }
+  out.close();
+  if (out.fail()) {
+    cerr << "Cannot write file " << index_filename << endl;
+    return false;
+  }
+
+  return true;
+}
+
+
+/*!
+    \fn BlockIndex::read(string index_filename)
+ */
+bool BlockIndex::read(string index_filename)
+{
+  ifstream in(index_filename.c_str(), ios::in | ios::binary);
+  if (!in.is_open()) {
+    return false;
+  }
+  char magic[8];
+  in.read(magic, 8);
+  if (!in.good() or string(magic, 8) != BLOCK_INDEX_MAGIC or read_uint(in, 4) != BLOCK_INDEX_VERSION) {
+    cerr << "Wrong index file " << index_filename << endl;
+    return false;
+  }
+  sequences.clear();
+  sequence_indexes.clear();
+  block_offsets.clear();
+  unsigned long long num_blocks = read_uint(in, 4);
+  for (unsigned long long a = 0; a < num_blocks and in.good(); a++) {
+    block_offsets.push_back(read_uint(in, 8));
+  }
+  unsigned long long num_sequences = read_uint(in, 4);
+  for (unsigned long long a = 0; a < num_sequences and in.good(); a++) {
+    sequences.push_back(block_sequence());
+    block_sequence &sequence = sequences.back();
+    if (!read_string(in, sequence.species) or !read_string(in, sequence.chr)) {
+      break;
+    }
+    sequence.max_length = read_uint(in, 4);
+    unsigned long long num_intervals = read_uint(in, 4);
+    sequence.intervals.resize(num_intervals);
+    for (unsigned long long b = 0; b < num_intervals and in.good(); b++) {
+      sequence.intervals[b].start = read_uint(in, 4);
+      sequence.intervals[b].end = read_uint(in, 4);
+      sequence.intervals[b].block = read_uint(in, 4);
+      sequence.intervals[b].strand = (signed char)in.get();
+    }
+    sequence_indexes[make_pair(sequence.species, sequence.chr)] = a;
+  }
+  if (!in.good()) {
+    cerr << "Wrong index file " << index_filename << endl;
+    sequences.clear();
+    sequence_indexes.clear();
+    block_offsets.clear();
+    return false;
+  }
+  is_sorted = true;
+
+  return true;
+}
+
+
+/*!
+    \fn BlockIndex::find(string species, string chr)
+ */
+block_sequence* BlockIndex::find(string species, string chr)
+{
+  map<pair<string, string>, unsigned int>::iterator it = sequence_indexes.find(make_pair(species, chr));
+  if (it == sequence_indexes.end()) {
+    return NULL;
+  }
+
+  return &sequences[it->second];
+}
+
+
+/*!
+    \fn BlockIndex::find(string species, string chr, unsigned int start, unsigned int end, vector<block_interval> &intervals)
+    No region is longer than max_length, so the first one that can overlap the query starts after
+    start - max_length.
+ */
+void BlockIndex::find(string species, string chr, unsigned int start, unsigned int end,
+    vector<block_interval> &intervals)
+{
+  sort();
+  block_sequence *sequence = find(species, chr);
+  if (!sequence) {
+    return;
+  }
+  block_interval first;
+  first.start = (start > sequence->max_length) ? start - sequence->max_length : 0;
+  first.end = 0;
+  first.block = 0;
+  vector<block_interval>::iterator it = lower_bound(sequence->intervals.begin(), sequence->intervals.end(),
+      first, sort_block_intervals());
+  for (; it != sequence->intervals.end() and it->start <= end; it++) {
+    if (it->end >= start) {
+      intervals.push_back(*it);
+    }
+  }
+}
+
+
+/*!
+    \fn BlockIndex::get_offset(unsigned int block)
+ */
+unsigned long long BlockIndex::get_offset(unsigned int block)
+{
+  if (block >= block_offsets.size()) {
+    return NO_OFFSET;
+  }
+
+  return block_offsets[block];
+}
@@ -0,0 +1,165 @@
+#ifndef INDEX_H
+#define INDEX_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+#include "reader.h"
+
+//! Size of the bins of the index (in bp)
+#define INDEX_BIN_SIZE 16384
+//! Position in a file that is not known or does not exist
+#define NO_OFFSET (~0ULL)
+
+//! A region of one chromosome. end is -1 for the whole chromosome
+
+struct region {
+  std::string species;
+  std::string chr;
+  int start;
+  int end;
+};
+    //! Reads a region written as species:chr or species:chr:start-end
+    bool parse_region(std::string text, region &this_region);
+    //! Same, also accepting a single position written as species:chr:pos
+    bool parse_position(std::string text, region &this_region);
+    //! Reads a region of a block as printed by enredo: species:chr:start:end [strand] l=length
+    bool parse_block_region(const std::string &line, std::string &species, std::string &chr, unsigned int &start,
+        unsigned int &end, int &strand);
+
+//! The hits of one chromosome in an indexed anchors file
+
+struct sequence_index {
+  std::string species;
+  std::string chr;
+  unsigned long long first_offset; //!< position of the first hit in the file
+  unsigned long long num_hits;
+  std::vector<unsigned long long> bins; //!< position of the first hit overlapping each bin
+};
+
+//! Random-access index of a sorted anchors file, like the tabix index
+
+/*!
+    The index is stored next to the anchors file, with the ".eix" extension. For each species and
+    chromosome it keeps the position of its first hit in the file and, for every INDEX_BIN_SIZE bp,
+    the position of the first hit that overlaps that bin. Positions are those returned by
+    InputStream::tell(): the anchors file must be plain text or bgzip.
+ */
+class AnchorsIndex{
+public:
+    AnchorsIndex();
+
+    ~AnchorsIndex();
+    //! Builds the index by reading the whole anchors file
+    bool build(char *filename);
+    //! Writes the index in a file
+    bool write(std::string index_filename);
+    //! Reads the index from a file
+    bool read(std::string index_filename);
+    //! Returns the index of this chromosome or NULL if it has no hits
+    sequence_index* find(std::string species, std::string chr);
+    //! Returns the position of the first hit that may overlap this position of the chromosome
+    unsigned long long get_offset(sequence_index *sequence, int start);
+
+    std::vector<sequence_index> sequences; //!< in the same order as in the anchors file
+
+    //! Returns the name of the index file of an anchors file
+    static std::string get_filename(char *filename);
+
+  protected:
+    std::map<std::pair<std::string, std::string>, unsigned int> sequence_indexes;
+};
+
+//! Reads the hits of a set of regions of an indexed anchors file
+
+/*!
+    The regions are read in the order they are added. The first hit of each region comes with
+    path_break set so it is never linked to the last hit of the previous region.
+ */
+class IndexedHitReader : public HitReader{
+public:
+    IndexedHitReader();
+
+    ~IndexedHitReader();
+    //! Opens the anchors file and reads its index
+    bool open(char *filename);
+    //! Adds a region to be read
+    bool add_region(region &this_region);
+    //! Reads the next hit of the current region
+    bool next_hit(hit &this_hit);
+
+    AnchorsIndex index;
+
+  protected:
+    bool start_region(void);
+
+    std::vector<region> regions;
+    uint current_region;
+    bool region_is_started;
+    bool pending_path_break; //!< the next hit must not be linked to the previous one
+};
+
+//! One region of a block, as stored in a BlockIndex
+
+struct block_interval {
+  unsigned int start;
+  unsigned int end;
+  unsigned int block; //!< number of the block in the output file, from 0
+  int strand;
+};
+
+//! The regions of the blocks in one chromosome
+
+struct block_sequence {
+  std::string species;
+  std::string chr;
+  unsigned int max_length; //!< of the regions. A query only has to look back this far
+  std::vector<block_interval> intervals; //!< sorted by start once the index is written or read
+};
+
+//! Index of the regions of the blocks in an enredo output file
+
+/*!
+    The index is stored next to the output file, with the ".ebi" extension. It keeps the regions of
+    all the blocks sorted by species, chromosome and start, and the position of each block in the
+    output file. Finding the blocks that overlap a position or a region takes a binary search.
+ */
+class BlockIndex{
+public:
+    BlockIndex();
+
+    ~BlockIndex();
+    //! Adds a block that starts at this position of the output file (NO_OFFSET if not known)
+    void add_block(unsigned long long offset);
+    //! Adds a region to the last block
+    void add_region(const std::string &species, const std::string &chr, unsigned int start,
+        unsigned int end, int strand);
+    //! Builds the index by reading the whole output file
+    bool build(char *filename);
+    //! Writes the index in a file
+    bool write(std::string index_filename);
+    //! Reads the index from a file
+    bool read(std::string index_filename);
+    //! Returns the regions of this chromosome or NULL if it has none
+    block_sequence* find(std::string species, std::string chr);
+    //! Appends the regions of the blocks that overlap species:chr:start-end, sorted by start
+    void find(std::string species, std::string chr, unsigned int start, unsigned int end,
+        std::vector<block_interval> &intervals);
+    //! Returns the position of this block in the output file (NO_OFFSET if not known)
+    unsigned long long get_offset(unsigned int block);
+
+    std::vector<block_sequence> sequences;
+    std::vector<unsigned long long> block_offsets; //!< position of each block in the output file
+
+    //! Returns the name of the index file of an enredo output file
+    static std::string get_filename(char *filename);
+
+  protected:
+    void sort(void);
+
+    std::map<std::pair<std::string, std::string>, unsigned int> sequence_indexes;
+    bool is_sorted;
+};
+
+#endif
@@ -0,0 +1,80 @@
+
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <iostream>
+#include <cstdlib>
+#include "index.h"
+
+using namespace std;
+
+void print_help(void);
+
+int main(int argc, char *argv[])
+{
+  char *filename = NULL;
+  bool list = false;
+  bool help = false;
+  string this_arg;
+
+  for (int a = 1; a < argc; a++) {
+    this_arg = argv[a];
+    if ((this_arg == "--list") or (this_arg == "-l")) {
+      list = true;
+    } else if ((this_arg == "--help") or (this_arg == "-h")) {
+      help = true;
+    } else if (!filename) {
+      filename = argv[a];
+    } else {
+      cerr << "Unknown option: " << this_arg << endl;
+    }
+  }
+
+  if (help or !filename) {
+    print_help();
+    exit(0);
+  }
+
+  AnchorsIndex index;
+  if (list) {
+    if (!index.read(AnchorsIndex::get_filename(filename))) {
+      cerr << "Cannot read the index of " << filename << endl;
+      exit(1);
+    }
+    for (uint a = 0; a < index.sequences.size(); a++) {
+      cout << index.sequences[a].species << "\t" << index.sequences[a].chr << "\t"
+          << index.sequences[a].num_hits << endl;
+    }
+    return EXIT_SUCCESS;
+  }
+
+  if (string(filename) == "-") {
+    cerr << "Cannot index STDIN" << endl;
+    exit(1);
+  }
+  if (!index.build(filename) or !index.write(AnchorsIndex::get_filename(filename))) {
+    exit(1);
+  }
+
+  return EXIT_SUCCESS;
+}
+
+void print_help(void)
+{
+  cout << "IndexAnchors v" << VERSION << endl;
+  cout << endl;
+  cout << "Usage: indexanchors [options] anchors_file.txt" << endl;
+  cout << endl;
+  cout << "Writes the index of a sorted anchors file (plain text or bgzip) in" << endl;
+  cout << "anchors_file.txt.eix. See --region in enredo." << endl;
+  cout << endl;
+  cout << "Options:" << endl;
+  cout << " --list: prints the number of hits per species and chromosome in the index" << endl;
+  cout << endl;
+  cout << " --help: prints this help" << endl;
+  cout << endl;
+  cout << "See README file for more details." << endl;
+  cout << endl;
+}
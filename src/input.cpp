@@ -0,0 +1,697 @@
+#include "input.h"
+#include "threads.h"
+#include <iostream>
+#include <cstring>
+#include <cerrno>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace std;
+
+#define RAW_BUFFER_SIZE 1048576
+#define TEXT_BUFFER_SIZE 1048576
+#define BGZF_HEADER_SIZE 12
+#define BGZF_FOOTER_SIZE 8
+#define BGZF_BLOCKS_PER_BATCH 64
+#define MAX_BGZF_BATCHES 4
+
+//! A compressed BGZF block and its uncompressed content
+
+struct bgzf_block {
+  unsigned long long offset;
+  std::string compressed;
+  std::string uncompressed;
+  bool is_valid;
+};
+
+//! Decompresses a set of BGZF blocks (see parallel_for)
+
+struct bgzf_inflater {
+  std::vector<bgzf_block> *blocks;
+
+  void operator()(unsigned long i) {
+    bgzf_block &block = (*blocks)[i];
+    block.is_valid = false;
+    if (block.compressed.size() < BGZF_FOOTER_SIZE) {
+      return;
+    }
+    const unsigned char *footer = (const unsigned char*)block.compressed.data() +
+        block.compressed.size() - BGZF_FOOTER_SIZE;
+    unsigned long crc = footer[0] | (footer[1] << 8) | (footer[2] << 16) | ((unsigned long)footer[3] << 24);
+    unsigned long size = footer[4] | (footer[5] << 8) | (footer[6] << 16) | ((unsigned long)footer[7] << 24);
+    block.uncompressed.resize(size);
+    if (size == 0) {
+      block.is_valid = true;
+      return;
+    }
+
+    z_stream block_stream;
+    memset(&block_stream, 0, sizeof(block_stream));
+    if (inflateInit2(&block_stream, -15) != Z_OK) {
+      return;
+    }
+    block_stream.next_in = (Bytef*)block.compressed.data();
+    block_stream.avail_in = block.compressed.size() - BGZF_FOOTER_SIZE;
+    block_stream.next_out = (Bytef*)&block.uncompressed[0];
+    block_stream.avail_out = size;
+    int ret = inflate(&block_stream, Z_FINISH);
+    inflateEnd(&block_stream);
+    if (ret == Z_STREAM_END and block_stream.avail_out == 0 and
+        crc32(0L, (const Bytef*)block.uncompressed.data(), size) == crc) {
+      block.is_valid = true;
+    }
+  }
+};
+
+
+InputStream::InputStream()
+{
+  error = false;
+  spool = false;
+  fd = -1;
+  start_offset = 0;
+  seekable = false;
+  end_of_file = false;
+  format = PLAIN;
+  buffer_pos = 0;
+  raw_pos = 0;
+  raw_size = 0;
+  file_offset = 0;
+  blocks_end_offset = 0;
+  stream_is_set = false;
+  end_of_member = false;
+  spool_file = NULL;
+  reading_spool = false;
+  reader_is_running = false;
+  reader_done = false;
+  reader_error = false;
+  stop_reader = false;
+}
+
+
+InputStream::~InputStream()
+{
+  close();
+}
+
+
+/*!
+    \fn InputStream::open(const char *filename)
+ */
+bool InputStream::open(const char *filename)
+{
+  close();
+  this->filename = filename;
+  if (this->filename == "-") {
+    fd = STDIN_FILENO;
+  } else {
+    fd = ::open(filename, O_RDONLY);
+  }
+  if (fd < 0) {
+    return false;
+  }
+  start_offset = lseek(fd, 0, SEEK_CUR);
+  seekable = (start_offset >= 0);
+  if (spool and !seekable) {
+    spool_file = tmpfile();
+    if (!spool_file) {
+      cerr << "Cannot create a temporary file for reading " << filename << " twice" << endl;
+      close();
+      return false;
+    }
+  }
+
+  return start();
+}
+
+
+/*!
+    \fn InputStream::start()
+    Detects the format of the file from its first bytes and sets up the decompression if needed
+ */
+bool InputStream::start(void)
+{
+  error = false;
+  end_of_file = false;
+  buffer.clear();
+  buffer_pos = 0;
+  raw.resize(RAW_BUFFER_SIZE);
+  raw_pos = 0;
+  raw_size = 0;
+  file_offset = 0;
+  while (raw_size < BGZF_HEADER_SIZE + 6) {
+    long n = ::read(fd, &raw[raw_size], RAW_BUFFER_SIZE - raw_size);
+    if (n < 0 and errno == EINTR) {
+      continue;
+    } else if (n < 0) {
+      cerr << "Cannot read file " << filename << endl;
+      error = true;
+      return false;
+    } else if (n == 0) {
+      break;
+    }
+    raw_size += n;
+  }
+
+  const unsigned char *magic = (const unsigned char*)&raw[0];
+  format = PLAIN;
+  if (raw_size >= 2 and magic[0] == 0x1f and magic[1] == 0x8b) {
+    format = GZIP;
+    if (raw_size >= BGZF_HEADER_SIZE + 6 and (magic[3] & 4) and magic[12] == 'B' and magic[13] == 'C'
+        and magic[14] == 2 and magic[15] == 0) {
+      format = BGZF;
+    }
+  }
+
+  if (format == GZIP) {
+    memset(&stream, 0, sizeof(stream));
+    // 15 + 32: automatic detection of the gzip header
+    if (inflateInit2(&stream, 15 + 32) != Z_OK) {
+      cerr << "Cannot decompress file " << filename << endl;
+      error = true;
+      return false;
+    }
+    stream_is_set = true;
+    end_of_member = false;
+    compressed.resize(RAW_BUFFER_SIZE);
+  } else if (format == BGZF) {
+    start_reader_thread();
+  }
+
+  return true;
+}
+
+
+/*!
+    \fn InputStream::start_reader_thread()
+    The reader thread reads bgzip blocks from the current position of the file
+ */
+void InputStream::start_reader_thread(void)
+{
+  block_offsets.clear();
+  block_starts.clear();
+  blocks_end_offset = file_offset;
+  reader_done = false;
+  reader_error = false;
+  stop_reader = false;
+  reader_thread = std::thread(&InputStream::read_bgzf_blocks, this);
+  reader_is_running = true;
+}
+
+
+/*!
+    \fn InputStream::getline(string &line)
+    The last line of the file is returned even if it does not end with a newline.
+ */
+bool InputStream::getline(string &line)
+{
+  line.clear();
+  while (true) {
+    if (buffer_pos >= buffer.size()) {
+      if (!fill()) {
+        return (!error and !line.empty());
+      }
+      continue;
+    }
+    const char *start = buffer.data() + buffer_pos;
+    const char *newline = (const char*)memchr(start, '\n', buffer.size() - buffer_pos);
+    if (newline) {
+      line.append(start, newline - start);
+      buffer_pos += newline - start + 1;
+      return true;
+    }
+    line.append(start, buffer.size() - buffer_pos);
+    buffer_pos = buffer.size();
+  }
+}
+
+
+/*!
+    \fn InputStream::fill()
+    Replaces the content of the buffer with the next chunk of uncompressed data
+ */
+bool InputStream::fill(void)
+{
+  buffer_pos = 0;
+  if (end_of_file or error or fd < 0) {
+    buffer.clear();
+    return false;
+  }
+
+  bool ret;
+  if (reading_spool) {
+    buffer.resize(TEXT_BUFFER_SIZE);
+    size_t n = fread(&buffer[0], 1, TEXT_BUFFER_SIZE, spool_file);
+    buffer.resize(n);
+    ret = (n > 0);
+  } else if (format == GZIP) {
+    ret = fill_gzip();
+  } else if (format == BGZF) {
+    ret = fill_bgzf();
+  } else {
+    ret = fill_plain();
+  }
+  if (!ret) {
+    buffer.clear();
+    end_of_file = true;
+    return false;
+  }
+
+  if (spool_file and !reading_spool and buffer.size()) {
+    if (fwrite(buffer.data(), 1, buffer.size(), spool_file) != buffer.size()) {
+      cerr << "Cannot write the temporary copy of " << filename << endl;
+      error = true;
+      return false;
+    }
+  }
+
+  return true;
+}
+
+
+/*!
+    \fn InputStream::fill_plain()
+ */
+bool InputStream::fill_plain(void)
+{
+  buffer.resize(TEXT_BUFFER_SIZE);
+  long n = read_raw(&buffer[0], TEXT_BUFFER_SIZE);
+  if (n < 0) {
+    cerr << "Cannot read file " << filename << endl;
+    error = true;
+    n = 0;
+  }
+  buffer.resize(n);
+
+  return (n > 0);
+}
+
+
+/*!
+    \fn InputStream::fill_gzip()
+    Concatenated gzip files (several gzip members) are read as one single file
+ */
+bool InputStream::fill_gzip(void)
+{
+  buffer.resize(TEXT_BUFFER_SIZE);
+  stream.next_out = (Bytef*)&buffer[0];
+  stream.avail_out = TEXT_BUFFER_SIZE;
+  while (stream.avail_out == TEXT_BUFFER_SIZE) {
+    if (stream.avail_in == 0) {
+      long n = read_raw(&compressed[0], compressed.size());
+      if (n < 0) {
+        cerr << "Cannot read file " << filename << endl;
+        error = true;
+        return false;
+      } else if (n == 0) {
+        if (!end_of_member) {
+          cerr << "Unexpected end of compressed file " << filename << endl;
+          error = true;
+          return false;
+        }
+        break;
+      }
+      stream.next_in = (Bytef*)&compressed[0];
+      stream.avail_in = n;
+    }
+    int ret = inflate(&stream, Z_NO_FLUSH);
+    if (ret == Z_STREAM_END) {
+      end_of_member = true;
+      inflateReset(&stream);
+    } else if (ret == Z_OK or ret == Z_BUF_ERROR) {
+      end_of_member = false;
+    } else {
+      cerr << "Error while decompressing file " << filename << endl;
+      error = true;
+      return false;
+    }
+  }
+  buffer.resize(TEXT_BUFFER_SIZE - stream.avail_out);
+
+  return (buffer.size() > 0);
+}
+
+
+/*!
+    \fn InputStream::fill_bgzf()
+    Gets the next batch of blocks decompressed by the reader thread
+ */
+bool InputStream::fill_bgzf(void)
+{
+  std::unique_lock<std::mutex> lock(reader_mutex);
+  while (batches.empty() and !reader_done) {
+    reader_condition.wait(lock);
+  }
+  if (batches.empty()) {
+    if (reader_error) {
+      error = true;
+    }
+    return false;
+  }
+  bgzf_batch *batch = batches.front();
+  batches.pop_front();
+  lock.unlock();
+  reader_condition.notify_all();
+
+  buffer.swap(batch->data);
+  block_offsets.swap(batch->block_offsets);
+  block_starts.swap(batch->block_starts);
+  blocks_end_offset = batch->end_offset;
+  delete(batch);
+
+  return true;
+}
+
+
+/*!
+    \fn InputStream::read_bgzf_blocks()
+    Body of the reader thread. Reads the compressed blocks in batches, decompresses each batch in
+    parallel and queues it for fill_bgzf(). At most MAX_BGZF_BATCHES are kept in the queue.
+ */
+void InputStream::read_bgzf_blocks(void)
+{
+  bool this_error = false;
+  bool finished = false;
+  while (!finished and !this_error) {
+    {
+      std::unique_lock<std::mutex> lock(reader_mutex);
+      if (stop_reader) {
+        break;
+      }
+    }
+    std::vector<bgzf_block> blocks;
+    for (uint b = 0; b < BGZF_BLOCKS_PER_BATCH; b++) {
+      unsigned char header[BGZF_HEADER_SIZE];
+      unsigned long long block_offset = file_offset;
+      bool eof;
+      if (!read_raw_exactly((char*)header, BGZF_HEADER_SIZE, eof)) {
+        if (!eof) {
+          this_error = true;
+        }
+        finished = true;
+        break;
+      }
+      if (header[0] != 0x1f or header[1] != 0x8b or header[2] != 8 or !(header[3] & 4)) {
+        cerr << "Wrong BGZF block in " << filename << endl;
+        this_error = true;
+        break;
+      }
+      unsigned int extra_length = header[10] | (header[11] << 8);
+      std::string extra(extra_length, '\0');
+      if (!read_raw_exactly(&extra[0], extra_length, eof)) {
+        this_error = true;
+        break;
+      }
+      long block_size = -1;
+      for (unsigned int i = 0; i + 4 <= extra_length; ) {
+        const unsigned char *subfield = (const unsigned char*)extra.data() + i;
+        unsigned int subfield_length = subfield[2] | (subfield[3] << 8);
+        if (subfield[0] == 'B' and subfield[1] == 'C' and subfield_length == 2 and i + 6 <= extra_length) {
+          block_size = (subfield[4] | (subfield[5] << 8)) + 1;
+          break;
+        }
+        i += 4 + subfield_length;
+      }
+      if (block_size < (long)(BGZF_HEADER_SIZE + extra_length + BGZF_FOOTER_SIZE)) {
+        cerr << "Wrong BGZF block in " << filename << endl;
+        this_error = true;
+        break;
+      }
+      blocks.push_back(bgzf_block());
+      bgzf_block &block = blocks.back();
+      block.offset = block_offset;
+      block.compressed.resize(block_size - BGZF_HEADER_SIZE - extra_length);
+      if (!read_raw_exactly(&block.compressed[0], block.compressed.size(), eof)) {
+        this_error = true;
+        break;
+      }
+    }
+    if (this_error) {
+      break;
+    }
+
+    bgzf_inflater inflater;
+    inflater.blocks = &blocks;
+    parallel_for(blocks.size(), inflater);
+
+    bgzf_batch *batch = new bgzf_batch;
+    unsigned long batch_size = 0;
+    for (uint b = 0; b < blocks.size(); b++) {
+      if (!blocks[b].is_valid) {
+        cerr << "Error while decompressing file " << filename << endl;
+        this_error = true;
+      }
+      batch_size += blocks[b].uncompressed.size();
+    }
+    if (this_error) {
+      delete(batch);
+      break;
+    }
+    batch->data.reserve(batch_size);
+    for (uint b = 0; b < blocks.size(); b++) {
+      batch->block_offsets.push_back(blocks[b].offset);
+      batch->block_starts.push_back(batch->data.size());
+      batch->data.append(blocks[b].uncompressed);
+    }
+    batch->end_offset = file_offset;
+
+    std::unique_lock<std::mutex> lock(reader_mutex);
+    while (batches.size() >= MAX_BGZF_BATCHES and !stop_reader) {
+      reader_condition.wait(lock);
+    }
+    if (stop_reader) {
+      delete(batch);
+      break;
+    }
+    batches.push_back(batch);
+    lock.unlock();
+    reader_condition.notify_all();
+  }
+
+  std::unique_lock<std::mutex> lock(reader_mutex);
+  reader_done = true;
+  reader_error = this_error;
+  lock.unlock();
+  reader_condition.notify_all();
+}
+
+
+/*!
+    \fn InputStream::read_raw(char *data, unsigned long size)
+    Reads up to size bytes from the file. Returns the number of bytes read, 0 at the end of the
+    file and -1 on error
+ */
+long InputStream::read_raw(char *data, unsigned long size)
+{
+  if (raw_pos < raw_size) {
+    unsigned long n = raw_size - raw_pos;
+    if (n > size) {
+      n = size;
+    }
+    memcpy(data, &raw[raw_pos], n);
+    raw_pos += n;
+    file_offset += n;
+    return n;
+  }
+  long n;
+  do {
+    n = ::read(fd, data, size);
+  } while (n < 0 and errno == EINTR);
+  if (n > 0) {
+    file_offset += n;
+  }
+
+  return n;
+}
+
+
+/*!
+    \fn InputStream::read_raw_exactly(char *data, unsigned long size, bool &eof)
+    Returns false if the file ends (eof is set if nothing at all could be read) or cannot be read
+ */
+bool InputStream::read_raw_exactly(char *data, unsigned long size, bool &eof)
+{
+  unsigned long done = 0;
+  eof = false;
+  while (done < size) {
+    long n = read_raw(data + done, size - done);
+    if (n < 0) {
+      cerr << "Cannot read file " << filename << endl;
+      return false;
+    } else if (n == 0) {
+      if (done == 0) {
+        eof = true;
+      } else {
+        cerr << "Unexpected end of compressed file " << filename << endl;
+      }
+      return false;
+    }
+    done += n;
+  }
+
+  return true;
+}
+
+
+/*!
+    \fn InputStream::stop_reader_thread()
+ */
+void InputStream::stop_reader_thread(void)
+{
+  if (!reader_is_running) {
+    return;
+  }
+  {
+    std::unique_lock<std::mutex> lock(reader_mutex);
+    stop_reader = true;
+  }
+  reader_condition.notify_all();
+  reader_thread.join();
+  reader_is_running = false;
+  for (std::deque<bgzf_batch*>::iterator it = batches.begin(); it != batches.end(); it++) {
+    delete(*it);
+  }
+  batches.clear();
+}
+
+
+/*!
+    \fn InputStream::reset_decoders()
+ */
+void InputStream::reset_decoders(void)
+{
+  stop_reader_thread();
+  if (stream_is_set) {
+    inflateEnd(&stream);
+    stream_is_set = false;
+  }
+}
+
+
+/*!
+    \fn InputStream::rewind()
+    Non-seekable files (pipes) can only be rewound if InputStream::spool was set before opening
+    them. In that case the rest of the file is read first and the copy is used from then on.
+ */
+bool InputStream::rewind(void)
+{
+  if (fd < 0) {
+    return false;
+  }
+  if (spool_file) {
+    if (!reading_spool) {
+      while (fill());
+      if (error) {
+        return false;
+      }
+      reset_decoders();
+      reading_spool = true;
+    }
+    fflush(spool_file);
+    fseek(spool_file, 0, SEEK_SET);
+    error = false;
+    end_of_file = false;
+    buffer.clear();
+    buffer_pos = 0;
+    return true;
+  }
+  if (!seekable) {
+    cerr << "Cannot read " << filename << " twice (it is not a regular file)" << endl;
+    return false;
+  }
+  reset_decoders();
+  if (lseek(fd, start_offset, SEEK_SET) < 0) {
+    cerr << "Cannot rewind file " << filename << endl;
+    return false;
+  }
+
+  return start();
+}
+
+
+/*!
+    \fn InputStream::tell()
+ */
+unsigned long long InputStream::tell(void)
+{
+  if (format == BGZF and !reading_spool) {
+    if (buffer_pos >= buffer.size()) {
+      return blocks_end_offset << 16;
+    }
+    unsigned long b = upper_bound(block_starts.begin(), block_starts.end(), buffer_pos) - block_starts.begin() - 1;
+    return (block_offsets[b] << 16) | (buffer_pos - block_starts[b]);
+  }
+
+  return file_offset - buffer.size() + buffer_pos;
+}
+
+
+/*!
+    \fn InputStream::seek(unsigned long long offset)
+ */
+bool InputStream::seek(unsigned long long offset)
+{
+  if (fd < 0 or !seekable or reading_spool or format == GZIP) {
+    cerr << "Cannot jump to a position in " << filename << " (only plain and bgzip files can be used)" << endl;
+    error = true;
+    return false;
+  }
+  reset_decoders();
+  unsigned long long new_file_offset = (format == BGZF) ? (offset >> 16) : offset;
+  if (lseek(fd, start_offset + new_file_offset, SEEK_SET) < 0) {
+    cerr << "Cannot jump to a position in " << filename << endl;
+    error = true;
+    return false;
+  }
+  raw_pos = 0;
+  raw_size = 0;
+  file_offset = new_file_offset;
+  buffer.clear();
+  buffer_pos = 0;
+  error = false;
+  end_of_file = false;
+  if (format == BGZF) {
+    start_reader_thread();
+    unsigned long block_pos = offset & 0xffff;
+    if (block_pos > 0) {
+      if (!fill() or block_pos > buffer.size()) {
+        cerr << "Cannot jump to a position in " << filename << endl;
+        error = true;
+        return false;
+      }
+      buffer_pos = block_pos;
+    }
+  }
+
+  return true;
+}
+
+
+/*!
+    \fn InputStream::close()
+ */
+void InputStream::close(void)
+{
+  reset_decoders();
+  if (fd > STDIN_FILENO) {
+    ::close(fd);
+  }
+  fd = -1;
+  if (spool_file) {
+    fclose(spool_file);
+    spool_file = NULL;
+  }
+  reading_spool = false;
+  buffer.clear();
+  buffer_pos = 0;
+}
+
+
+/*!
+    \fn InputStream::is_open()
+ */
+bool InputStream::is_open(void)
+{
+  return (fd >= 0);
+}
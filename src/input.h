@@ -0,0 +1,106 @@
+#ifndef INPUT_H
+#define INPUT_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <cstdio>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <zlib.h>
+
+//! A set of consecutive BGZF blocks, decompressed by the reader thread of an InputStream
+
+struct bgzf_batch {
+  std::string data; //!< the uncompressed content of all the blocks
+  std::vector<unsigned long long> block_offsets; //!< position of each block in the file
+  std::vector<unsigned long> block_starts; //!< position of each block in data
+  unsigned long long end_offset; //!< position in the file of the block after the last one
+};
+
+//! Reads a text file line by line
+
+/*!
+    The file can be plain text, gzip or bgzip (blocked gzip, as written by bgzip or tabix). The
+    format is detected from the first bytes of the file. The file name "-" stands for STDIN.
+
+    The blocks of bgzip files are read and decompressed in parallel by a reader thread while the
+    lines of the previous blocks are being parsed.
+
+    Plain text and bgzip files support random access (see tell() and seek()). Like in tabix, the
+    positions in bgzip files are virtual offsets: the position of the compressed block in the file
+    shifted 16 bits to the left plus the position within the uncompressed block.
+ */
+class InputStream{
+public:
+    InputStream();
+
+    ~InputStream();
+    //! Opens the file ("-" for STDIN)
+    bool open(const char *filename);
+    //! Reads the next line, without the newline. Returns false at the end of the file or on error
+    bool getline(std::string &line);
+    //! Goes back to the beginning of the file
+    bool rewind(void);
+    //! Returns the position of the next line (a virtual offset for bgzip files)
+    unsigned long long tell(void);
+    //! Goes to a position returned by tell(). Only plain text and bgzip files support this
+    bool seek(unsigned long long offset);
+    void close(void);
+    bool is_open(void);
+
+    bool error; //!< true if the file could not be read or decompressed
+    bool spool; //!< keep a copy of non-seekable input (like STDIN) in a temporary file so it can be rewound
+
+  protected:
+    enum input_format {PLAIN, GZIP, BGZF};
+
+    bool start(void);
+    bool fill(void);
+    bool fill_plain(void);
+    bool fill_gzip(void);
+    bool fill_bgzf(void);
+    void reset_decoders(void);
+    void start_reader_thread(void);
+    long read_raw(char *data, unsigned long size);
+    bool read_raw_exactly(char *data, unsigned long size, bool &eof);
+    void read_bgzf_blocks(void);
+    void stop_reader_thread(void);
+
+    std::string filename;
+    int fd;
+    long long start_offset; //!< position of the file when it was opened (STDIN might not be at the beginning)
+    bool seekable;
+    bool end_of_file;
+    input_format format;
+
+    std::string buffer; //!< uncompressed data not returned yet
+    unsigned long buffer_pos;
+    std::vector<char> raw; //!< data read from the file but not used yet
+    unsigned long raw_pos;
+    unsigned long raw_size;
+    unsigned long long file_offset; //!< position in the file of the next byte returned by read_raw()
+
+    std::vector<char> compressed; //!< compressed data for the gzip stream
+    z_stream stream;
+    bool stream_is_set;
+    bool end_of_member;
+
+    FILE *spool_file;
+    bool reading_spool;
+
+    std::thread reader_thread;
+    std::mutex reader_mutex;
+    std::condition_variable reader_condition;
+    std::deque<bgzf_batch*> batches;
+    std::vector<unsigned long long> block_offsets; //!< position of the blocks in the buffer (see bgzf_batch)
+    std::vector<unsigned long> block_starts;
+    unsigned long long blocks_end_offset;
+    bool reader_is_running;
+    bool reader_done;
+    bool reader_error;
+    bool stop_reader;
+};
+
+#endif
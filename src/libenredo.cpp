@@ -0,0 +1,917 @@
+#include "libenredo.h"
+#include "graph.h"
+#include "link.h"
+#include "anchor.h"
+#include "threads.h"
+#include "pipeline.h"
+#include "spill.h"
+#include "index.h"
+#include "blockfile.h"
+#include "snapshot.h"
+#include <sstream>
+#include <fstream>
+#include <cstdio>
+#include <csignal>
+
+using namespace std;
+
+//! Set by Enredo::request_checkpoint(), maybe from a signal handler
+static volatile sig_atomic_t checkpoint_requested = 0;
+
+enredo_parameters::enredo_parameters()
+{
+  min_score = 0.0f;
+  max_gap_length = 200000;
+  anchors_as_links = false;
+  merge_overlap = false;
+  sorting = ENREDO_SORT_AUTO;
+  sort_memory = DEFAULT_SORT_MEMORY / 1048576;
+  max_anchor_copies = 0;
+  max_anchor_hits = 0;
+  prescan = false;
+  memory_limit = 0;
+  max_path_dissimilarity = 4;
+  simplify_graph = 7;
+  min_length = 100000;
+  min_regions = 2;
+  min_anchors = 3;
+  max_ratio = 3.0f;
+  skip_idle_minimize = true;
+  max_time = 0;
+  max_pass_time = 0;
+  max_iterations = 0;
+  max_total_iterations = 0;
+  allow_bridges = true;
+  all = false;
+  print_stats = false;
+  histogram_size = 10;
+  num_threads = 0;
+}
+
+
+Enredo::Enredo(const enredo_parameters &parameters)
+{
+  this->parameters = parameters;
+  graph = new Graph();
+  log = &cout;
+  null_log = NULL;
+  hits_started = false;
+  previous_result = NULL;
+  interrupted = false;
+}
+
+
+Enredo::~Enredo()
+{
+  clear();
+  delete graph;
+  delete null_log;
+}
+
+
+/*!
+    \fn Enredo::set_log(ostream *log)
+ */
+void Enredo::set_log(ostream *log)
+{
+  if (!log) {
+    if (!null_log) {
+      null_log = new ostream(NULL); // A stream without buffer discards everything
+    }
+    log = null_log;
+  }
+  this->log = log;
+  graph->log = log;
+  if (previous_result) {
+    previous_result->log = log;
+  }
+}
+
+
+/*!
+    \fn Enredo::load_file(string filename)
+    The loading options (sorting, regions, species, anchor filter, pre-scan, etc.) are taken from the
+    parameters.
+ */
+bool Enredo::load_file(string filename)
+{
+  graph->clear_selection();
+  for (uint a = 0; a < parameters.regions.size(); a++) {
+    region this_region;
+    if (!parse_region(parameters.regions[a], this_region)) {
+      cerr << "Wrong region: " << parameters.regions[a] << " (use species:chr or species:chr:start-end)" << endl;
+      return false;
+    }
+    graph->add_region(this_region);
+  }
+  for (uint a = 0; a < parameters.species.size(); a++) {
+    graph->include_species(parameters.species[a]);
+  }
+  for (uint a = 0; a < parameters.excluded_species.size(); a++) {
+    graph->exclude_species(parameters.excluded_species[a]);
+  }
+  sort_mode sorting = SORT_AUTO;
+  if (parameters.sorting == ENREDO_SORT_ALWAYS) {
+    sorting = SORT_ALWAYS;
+  } else if (parameters.sorting == ENREDO_SORT_NEVER) {
+    sorting = SORT_NEVER;
+  }
+  graph->set_sorting(sorting, parameters.sort_memory * 1048576, parameters.tmp_dir);
+  graph->set_anchor_filter(parameters.max_anchor_copies, parameters.max_anchor_hits);
+  graph->set_prescan(parameters.prescan);
+  set_num_threads(parameters.num_threads);
+  hits_started = false;
+  graph->clear_position_index();
+  if (!start_out_of_core()) {
+    return false;
+  }
+
+  if (!graph->populate_from_file((char*)filename.c_str(), parameters.min_score, parameters.max_gap_length,
+      parameters.anchors_as_links, parameters.merge_overlap,
+      parameters.merged_filename.empty() ? NULL : (char*)parameters.merged_filename.c_str())) {
+    return false;
+  }
+  if (!trim_out_of_core()) {
+    return false;
+  }
+  if (!parameters.filtered_anchors_filename.empty()) {
+    ofstream filtered_anchors_file(parameters.filtered_anchors_filename.c_str());
+    if (!filtered_anchors_file.is_open()) {
+      cerr << "Cannot open file " << parameters.filtered_anchors_filename << endl;
+      return false;
+    }
+    graph->print_filtered_anchors(filtered_anchors_file);
+    filtered_anchors_file.close();
+  }
+
+  return true;
+}
+
+
+/*!
+    \fn Enredo::add_hit(const string &anchor_id, const string &species, const string &chr, int start, int end, char strand, float score)
+    The hits must come sorted by species, chromosome and position, as in an anchors file.
+ */
+bool Enredo::add_hit(const string &anchor_id, const string &species, const string &chr,
+    int start, int end, char strand, float score)
+{
+  if (!hits_started) {
+    if (!start_out_of_core()) {
+      return false;
+    }
+    graph->start_hits(parameters.min_score, parameters.max_gap_length);
+    graph->clear_position_index();
+    hits_started = true;
+  }
+  hit this_hit;
+  this_hit.anchor_id = anchor_id;
+  this_hit.species = species;
+  this_hit.chr = chr;
+  this_hit.start = start;
+  this_hit.end = end;
+  this_hit.strand = string(1, strand);
+  this_hit.score = score;
+
+  return graph->add_hit(this_hit);
+}
+
+
+/*!
+    \fn Enredo::start_out_of_core()
+    Starts the out-of-core mode if there is a memory limit (see open_spill_file). Once started,
+    it goes on until the end of the program.
+ */
+bool Enredo::start_out_of_core(void)
+{
+  if (!parameters.memory_limit or spill_file_is_open()) {
+    return true;
+  }
+  if (!open_spill_file(parameters.tmp_dir, parameters.memory_limit * 1048576)) {
+    return false;
+  }
+  *log << "Out-of-core mode: links kept in a temporary file, with up to " << parameters.memory_limit
+      << " MB in memory" << endl;
+
+  return true;
+}
+
+
+/*!
+    \fn Enredo::trim_out_of_core()
+    Drops from memory the part of the links beyond the memory limit (see trim_spill_file)
+ */
+bool Enredo::trim_out_of_core(void)
+{
+  if (!spill_file_is_open()) {
+    return true;
+  }
+  unsigned long long used, mapped;
+  get_spill_file_usage(used, mapped);
+  *log << "Out-of-core mode: " << used / 1048576 << " MB of links in a file of " << mapped / 1048576
+      << " MB" << endl;
+
+  return trim_spill_file();
+}
+
+
+/*!
+    \fn Enredo::break_path()
+ */
+void Enredo::break_path(void)
+{
+  graph->break_path();
+}
+
+
+/*!
+    \fn Enredo::clear()
+ */
+void Enredo::clear(void)
+{
+  graph->clear();
+  hits_started = false;
+  if (previous_result) {
+    previous_result->clear();
+    delete previous_result;
+    previous_result = NULL;
+  }
+  snapshot_filename.clear();
+  checkpoint_settings.clear();
+  checkpoint_state.clear();
+}
+
+
+/*!
+    \fn Enredo::save_graph(const string &filename)
+    The graph is saved as it is. Once run() has applied the pipeline, it adds the resulting graph to
+    the same file, so a later load_graph() only has to process the parts of the graph that change.
+ */
+bool Enredo::save_graph(const string &filename)
+{
+  SnapshotFile file;
+  if (!file.create(filename)) {
+    return false;
+  }
+  file.start_section(SNAPSHOT_INPUT_GRAPH);
+  graph->write_snapshot(file);
+  if (!file.close()) {
+    cerr << "Cannot write file " << filename << endl;
+    return false;
+  }
+  snapshot_filename = filename;
+  *log << "Graph saved in " << filename << endl;
+
+  return true;
+}
+
+
+/*!
+    \fn Enredo::load_graph(const string &filename)
+    Replaces the current graph with the one saved in the file. The hits added afterwards (with
+    load_file() or add_hit()) must come from species not in the saved graph: they are linked to each
+    other as usual and their anchors are recorded. If the file also has the result of the pipeline
+    applied to the saved graph, run() only applies the pipeline to the connected components of the
+    graph with these anchors and takes the rest from the saved result (see Graph::start_update).
+ */
+bool Enredo::load_graph(const string &filename)
+{
+  clear();
+  graph->clear_position_index();
+  if (!start_out_of_core()) {
+    return false;
+  }
+  SnapshotFile file;
+  if (!file.open(filename)) {
+    return false;
+  }
+  snapshot_section section;
+  if (!file.next_section(section) or section != SNAPSHOT_INPUT_GRAPH or !graph->read_snapshot(file)) {
+    file.error = true;
+  } else if (file.next_section(section)) {
+    previous_result = new Graph();
+    previous_result->log = log;
+    if (section != SNAPSHOT_RESULT_GRAPH or !file.read_string(previous_settings) or
+        !previous_result->read_snapshot(file)) {
+      file.error = true;
+    }
+  }
+  if (file.error) {
+    cerr << "Wrong snapshot file " << filename << endl;
+    clear();
+    return false;
+  }
+  file.close();
+  graph->start_update();
+  *log << "Graph loaded from " << filename << (previous_result ? ", with the result of its pipeline" : "") << endl;
+
+  return trim_out_of_core();
+}
+
+
+/*!
+    \fn Enredo::set_checkpoint_file(const string &filename)
+ */
+void Enredo::set_checkpoint_file(const string &filename)
+{
+  checkpoint_filename = filename;
+}
+
+
+/*!
+    \fn Enredo::request_checkpoint()
+    Only sets a flag: run() checks it before each pass. Nothing happens without a checkpoint file.
+ */
+void Enredo::request_checkpoint(void)
+{
+  checkpoint_requested = 1;
+}
+
+
+/*!
+    \fn Enredo::was_interrupted()
+ */
+bool Enredo::was_interrupted(void)
+{
+  return interrupted;
+}
+
+
+/*!
+    \fn Enredo::write_checkpoint(const string &state)
+    A checkpoint file has one section with the settings of the run, the state of the pipeline (see
+    Pipeline::get_state), the file where the result goes (see save_graph), the graph, the saved result
+    the graph is going to be added to (if any) and the serial number of the next Link (see
+    link_order). It is written in a temporary file first, so a
+    previous checkpoint is only replaced by a complete one.
+ */
+bool Enredo::write_checkpoint(const string &state)
+{
+  string tmp_filename = checkpoint_filename + ".tmp";
+  SnapshotFile file;
+  if (!file.create(tmp_filename)) {
+    return false;
+  }
+  file.start_section(SNAPSHOT_CHECKPOINT);
+  file.write_string(get_run_settings());
+  file.write_string(state);
+  file.write_string(snapshot_filename);
+  graph->write_snapshot(file);
+  file.write_uint(previous_result ? 1 : 0, 1);
+  if (previous_result) {
+    file.write_string(previous_settings);
+    previous_result->write_snapshot(file);
+  }
+  file.write_uint(get_next_link_serial(), 8);
+  if (!file.close() or rename(tmp_filename.c_str(), checkpoint_filename.c_str()) != 0) {
+    cerr << "Cannot write file " << checkpoint_filename << endl;
+    remove(tmp_filename.c_str());
+    return false;
+  }
+
+  return true;
+}
+
+
+/*!
+    \fn Enredo::load_checkpoint(const string &filename)
+    Replaces the current graph with the one in the checkpoint. The next run() must have the same
+    parameters as the one interrupted: it goes on from the same pass, and its result is the same as
+    if it had not been interrupted.
+ */
+bool Enredo::load_checkpoint(const string &filename)
+{
+  clear();
+  graph->clear_position_index();
+  if (!start_out_of_core()) {
+    return false;
+  }
+  SnapshotFile file;
+  if (!file.open(filename)) {
+    return false;
+  }
+  snapshot_section section;
+  if (!file.next_section(section) or section != SNAPSHOT_CHECKPOINT or !file.read_string(checkpoint_settings) or
+      !file.read_string(checkpoint_state) or !file.read_string(snapshot_filename) or
+      !graph->read_snapshot(file)) {
+    file.error = true;
+  } else if (file.read_uint(1)) {
+    previous_result = new Graph();
+    previous_result->log = log;
+    if (!file.read_string(previous_settings) or !previous_result->read_snapshot(file)) {
+      file.error = true;
+    }
+  }
+  // The new Links get the same serial numbers as in the run interrupted
+  unsigned long long next_serial = file.read_uint(8);
+  if (file.error or checkpoint_state.empty() or next_serial < get_next_link_serial()) {
+    cerr << "Wrong checkpoint file " << filename << endl;
+    clear();
+    return false;
+  }
+  file.close();
+  set_next_link_serial(next_serial);
+  *log << "Checkpoint loaded from " << filename << endl;
+
+  return trim_out_of_core();
+}
+
+
+/*!
+    \fn Enredo::run()
+    Applies the pipeline (see Enredo::get_pipeline) and prints the number of changes of each stage
+    in the log. If a budget runs out (see max_time), the passes left are skipped and the graph is
+    minimized once more if needed (see get_stop_reason).
+
+    With a checkpoint file, the passes stop once a checkpoint is requested: the graph and the
+    position in the pipeline are written in the file and run() returns with was_interrupted() set.
+    After load_checkpoint(), run() goes on from that position.
+ */
+bool Enredo::run(void)
+{
+  Pipeline pipeline;
+  if (!pipeline.parse(get_pipeline())) {
+    return false;
+  }
+  pipeline.skip_idle_minimize = parameters.skip_idle_minimize;
+  pipeline.max_time = parameters.max_time;
+  pipeline.max_pass_time = parameters.max_pass_time;
+  pipeline.max_iterations = parameters.max_iterations;
+  pipeline.max_total_iterations = parameters.max_total_iterations;
+  if (!checkpoint_filename.empty()) {
+    pipeline.interrupt_flag = &checkpoint_requested;
+  }
+  interrupted = false;
+
+  set_num_threads(parameters.num_threads);
+  if (!checkpoint_state.empty()) {
+    if (checkpoint_settings != get_run_settings()) {
+      cerr << "The checkpoint comes from a run with other settings" << endl;
+      return false;
+    } else if (!pipeline.set_state(checkpoint_state)) {
+      cerr << "Wrong position of the pipeline in the checkpoint" << endl;
+      return false;
+    }
+    checkpoint_state.clear();
+    *log << endl
+        << "Pipeline: " << pipeline.get_spec() << endl
+        << "Going on from the checkpoint" << endl;
+  } else {
+    if (previous_result and previous_settings != get_run_settings()) {
+      *log << "The saved result comes from other settings: the whole graph will be processed" << endl;
+      previous_result->clear();
+      delete previous_result;
+      previous_result = NULL;
+    }
+    if (previous_result) {
+      set<string> updated_anchors;
+      uint num_components = graph->get_updated_components(updated_anchors);
+      unsigned long kept_anchors = graph->remove_anchors(updated_anchors, true);
+      previous_result->remove_anchors(updated_anchors);
+      *log << "Updating the saved result: " << num_components << " connected components with "
+          << updated_anchors.size() << " anchors are affected by the new hits, " << kept_anchors
+          << " other anchors are taken from the saved result" << endl;
+    }
+    if (parameters.print_stats) {
+      graph->print_anchors_histogram(*log);
+    }
+    *log << endl
+        << "Pipeline: " << pipeline.get_spec() << endl;
+  }
+
+  pipeline.run(*this, *log);
+  pass_stats = pipeline.stats;
+  stop_reason = pipeline.stop_reason;
+  if (pipeline.interrupted) {
+    checkpoint_requested = 0;
+    if (!write_checkpoint(pipeline.get_state())) {
+      return false;
+    }
+    interrupted = true;
+    *log << "Pipeline interrupted: checkpoint saved in " << checkpoint_filename << endl;
+    return true;
+  }
+  if (previous_result) {
+    graph->move_anchors_from(*previous_result);
+    delete previous_result;
+    previous_result = NULL;
+  }
+  if (!trim_out_of_core()) {
+    return false;
+  }
+  if (!snapshot_filename.empty()) {
+    SnapshotFile file;
+    if (!file.append(snapshot_filename)) {
+      return false;
+    }
+    file.start_section(SNAPSHOT_RESULT_GRAPH);
+    // A result cut by the budgets is not reused by load_graph()
+    file.write_string(get_run_settings() + (stop_reason.empty() ? "" : ";stopped_early"));
+    graph->write_snapshot(file);
+    if (!file.close()) {
+      cerr << "Cannot write file " << snapshot_filename << endl;
+      return false;
+    }
+    *log << "Result of the pipeline saved in " << snapshot_filename << endl;
+    snapshot_filename.clear();
+  }
+
+  *log << endl
+      << " Stages of the pipeline:" << endl
+      << "===================================" << endl;
+  pipeline.print_stats(*log);
+  if (!stop_reason.empty()) {
+    *log << "Pipeline stopped early: " << stop_reason << endl;
+  }
+
+  return true;
+}
+
+
+/*!
+    \fn Enredo::get_pipeline()
+    Unless the pipeline is set in the parameters, this is the pipeline of the enredo program for
+    the simplify_graph level: the graph is minimized and simplified, and the unbalanced links are
+    split at the end.
+ */
+string Enredo::get_pipeline(void)
+{
+  if (!parameters.pipeline.empty()) {
+    return parameters.pipeline;
+  }
+
+  ostringstream pipeline;
+  uint simplify_graph = parameters.simplify_graph;
+  pipeline << "stats(before minimizing the Graph) minimize";
+  for (uint a = 0; a < parameters.max_path_dissimilarity; a++) {
+    pipeline << " merge(" << (a + 1) << ") minimize";
+  }
+  pipeline << " stats(after minimizing the Graph)";
+  if (simplify_graph > 0) {
+    if (simplify_graph > 4) {
+      pipeline << " repeat(simplify(1) minimize)";
+      if (simplify_graph > 5) {
+        pipeline << " repeat(simplify_aggressive minimize simplify(1) minimize)";
+      }
+      if (simplify_graph > 6) {
+        pipeline << " split_unselected minimize simplify(1) minimize simplify_aggressive(1) minimize";
+      }
+    } else if (simplify_graph > 1) {
+      pipeline << " simplify(1) minimize";
+    } else {
+      pipeline << " simplify minimize";
+    }
+    if (simplify_graph == 3 and parameters.max_path_dissimilarity > 0) {
+      pipeline << " merge(" << parameters.max_path_dissimilarity << ") minimize";
+    } else if (simplify_graph > 6) {
+      pipeline << " resolve_palindromes assimilate(100000) repeat(merge(0) minimize) assimilate(100000) minimize";
+    } else if (simplify_graph > 3) {
+      for (uint a = 0; a < parameters.max_path_dissimilarity; a++) {
+        pipeline << " merge(" << (a + 1) << ") minimize";
+      }
+    }
+    pipeline << " stats(after simplifying the Graph)";
+  }
+  if (parameters.max_ratio > 1.0f) {
+    pipeline << " split_unbalanced minimize stats";
+  }
+
+  return pipeline.str();
+}
+
+
+/*!
+    \fn Enredo::get_stop_reason()
+ */
+string Enredo::get_stop_reason(void)
+{
+  return stop_reason;
+}
+
+
+/*!
+    \fn Enredo::get_run_settings()
+ */
+string Enredo::get_run_settings(void)
+{
+  ostringstream settings;
+  settings << "pipeline=" << get_pipeline() << ";min_anchors=" << parameters.min_anchors << ";min_regions="
+      << parameters.min_regions << ";min_length=" << parameters.min_length << ";max_ratio=" << parameters.max_ratio
+      << ";skip_idle_minimize=" << parameters.skip_idle_minimize;
+
+  return settings.str();
+}
+
+
+/*!
+    \fn Enredo::get_pass_stats()
+ */
+const vector<enredo_pass_stats>& Enredo::get_pass_stats(void)
+{
+  return pass_stats;
+}
+
+
+/*!
+    \fn Enredo::minimize()
+ */
+unsigned int Enredo::minimize(void)
+{
+  graph->clear_position_index();
+  return graph->minimize(parameters.debug);
+}
+
+
+/*!
+    \fn Enredo::merge_alternative_paths(unsigned int max_anchors, unsigned int max_length)
+    max_anchors is the maximum number of different anchors between both paths (0 for no limit)
+ */
+unsigned int Enredo::merge_alternative_paths(unsigned int max_anchors, unsigned int max_length)
+{
+  graph->clear_position_index();
+  return graph->merge_alternative_paths(max_anchors, max_length, parameters.debug);
+}
+
+
+/*!
+    \fn Enredo::simplify(unsigned int min_regions)
+ */
+unsigned int Enredo::simplify(unsigned int min_regions)
+{
+  graph->clear_position_index();
+  return graph->simplify(parameters.min_anchors, min_regions, parameters.min_length, parameters.debug);
+}
+
+
+/*!
+    \fn Enredo::simplify_aggressive(unsigned int min_regions)
+ */
+unsigned int Enredo::simplify_aggressive(unsigned int min_regions)
+{
+  graph->clear_position_index();
+  return graph->simplify_aggressive(parameters.min_anchors, min_regions, parameters.min_length, parameters.debug);
+}
+
+
+/*!
+    \fn Enredo::split_unselected_links()
+ */
+unsigned int Enredo::split_unselected_links(void)
+{
+  graph->clear_position_index();
+  return graph->split_unselected_links(parameters.min_anchors, parameters.min_regions, parameters.min_length,
+      parameters.debug);
+}
+
+
+/*!
+    \fn Enredo::resolve_small_palindromes()
+ */
+unsigned int Enredo::resolve_small_palindromes(void)
+{
+  graph->clear_position_index();
+  return graph->resolve_small_palindromes(parameters.min_anchors, parameters.min_regions, parameters.min_length,
+      parameters.debug);
+}
+
+
+/*!
+    \fn Enredo::assimilate_small_insertions(unsigned int max_insertion_length)
+ */
+unsigned int Enredo::assimilate_small_insertions(unsigned int max_insertion_length)
+{
+  graph->clear_position_index();
+  return graph->assimilate_small_insertions(parameters.min_anchors, parameters.min_regions, parameters.min_length,
+      max_insertion_length, parameters.debug);
+}
+
+
+/*!
+    \fn Enredo::split_unbalanced_links()
+ */
+unsigned int Enredo::split_unbalanced_links(void)
+{
+  graph->clear_position_index();
+  return graph->split_unbalanced_links(parameters.max_ratio, parameters.debug);
+}
+
+
+/*!
+    \fn Enredo::compact()
+ */
+unsigned int Enredo::compact(void)
+{
+  graph->clear_position_index();
+  return graph->compact();
+}
+
+
+/*!
+    \fn Enredo::print_stats()
+ */
+void Enredo::print_stats(void)
+{
+  graph->print_stats(parameters.histogram_size);
+}
+
+
+/*!
+    \fn links_to_blocks(vector<Link*> &links, vector<enredo_block> &blocks)
+ */
+static void links_to_blocks(vector<Link*> &links, vector<enredo_block> &blocks)
+{
+  blocks.reserve(blocks.size() + links.size());
+  for (vector<Link*>::iterator p_link = links.begin(); p_link != links.end(); p_link++) {
+    blocks.push_back(enredo_block());
+    enredo_block &block = blocks.back();
+    for (anchor_path::iterator p_anchor = (*p_link)->anchor_list.begin();
+        p_anchor != (*p_link)->anchor_list.end(); p_anchor++) {
+      block.anchors.push_back((*p_anchor)->id);
+    }
+    for (tag_list::iterator p_tag = (*p_link)->tags.begin(); p_tag != (*p_link)->tags.end(); p_tag++) {
+      enredo_region this_region;
+      this_region.species = *p_tag->get_species();
+      this_region.chr = *p_tag->get_chr();
+      this_region.start = p_tag->start;
+      this_region.end = p_tag->end;
+      this_region.strand = p_tag->strand;
+      block.regions.push_back(this_region);
+    }
+  }
+}
+
+
+/*!
+    \fn Enredo::get_blocks(vector<enredo_block> &blocks)
+    The blocks are appended to the vector in the same order as print_blocks() prints them. The
+    bridges are trimmed for the output only: the graph is the same afterwards.
+ */
+unsigned long Enredo::get_blocks(vector<enredo_block> &blocks)
+{
+  vector<Link*> links;
+  if (parameters.all) {
+    graph->get_links(links);
+  } else {
+    graph->get_links(links, parameters.min_anchors, parameters.min_regions, parameters.min_length,
+        parameters.allow_bridges);
+  }
+  links_to_blocks(links, blocks);
+  graph->restore_bridges();
+
+  return links.size();
+}
+
+
+/*!
+    \fn Enredo::print_blocks(ostream &out, BlockIndex *index)
+    The position of each block in out is the one given by tellp(), NO_OFFSET if out is not a file.
+ */
+unsigned long Enredo::print_blocks(ostream &out, BlockIndex *index)
+{
+  unsigned long num_of_blocks;
+  if (!index) {
+    if (parameters.all) {
+      num_of_blocks = graph->print_links(out);
+    } else {
+      num_of_blocks = graph->print_links(out, parameters.min_anchors, parameters.min_regions, parameters.min_length,
+          parameters.allow_bridges);
+    }
+    graph->restore_bridges();
+    return num_of_blocks;
+  }
+
+  vector<Link*> links;
+  if (parameters.all) {
+    graph->get_links(links);
+  } else {
+    graph->get_links(links, parameters.min_anchors, parameters.min_regions, parameters.min_length,
+        parameters.allow_bridges);
+  }
+  for (vector<Link*>::iterator p_link = links.begin(); p_link != links.end(); p_link++) {
+    streampos offset = out.tellp();
+    index->add_block((offset < 0) ? NO_OFFSET : (unsigned long long)offset);
+    for (tag_list::iterator p_tag = (*p_link)->tags.begin(); p_tag != (*p_link)->tags.end(); p_tag++) {
+      index->add_region(*p_tag->get_species(), *p_tag->get_chr(), p_tag->start, p_tag->end, p_tag->strand);
+    }
+    (*p_link)->print(out);
+  }
+  graph->restore_bridges();
+
+  return links.size();
+}
+
+
+/*!
+    \fn Enredo::write_blocks(BlockFileWriter &writer)
+    The dictionaries of the file only have the species and chromosomes of the blocks, in order of
+    first appearance.
+ */
+unsigned long Enredo::write_blocks(BlockFileWriter &writer)
+{
+  vector<Link*> links;
+  if (parameters.all) {
+    graph->get_links(links);
+  } else {
+    graph->get_links(links, parameters.min_anchors, parameters.min_regions, parameters.min_length,
+        parameters.allow_bridges);
+  }
+
+  map<uint, uint> sequence_indexes;
+  map<string*, uint> species_indexes;
+  vector<string> species;
+  vector<block_file_sequence> sequences;
+  for (vector<Link*>::iterator p_link = links.begin(); p_link != links.end(); p_link++) {
+    for (tag_list::iterator p_tag = (*p_link)->tags.begin(); p_tag != (*p_link)->tags.end(); p_tag++) {
+      if (sequence_indexes.count(p_tag->sequence)) {
+        continue;
+      }
+      string *this_species = p_tag->get_species();
+      if (!species_indexes.count(this_species)) {
+        species_indexes[this_species] = species.size();
+        species.push_back(*this_species);
+      }
+      block_file_sequence this_sequence;
+      this_sequence.species = species_indexes[this_species];
+      this_sequence.chr = *p_tag->get_chr();
+      sequence_indexes[p_tag->sequence] = sequences.size();
+      sequences.push_back(this_sequence);
+    }
+  }
+  writer.write_header(species, sequences);
+
+  binary_block block;
+  for (vector<Link*>::iterator p_link = links.begin(); p_link != links.end(); p_link++) {
+    block.clear();
+    for (anchor_path::iterator p_anchor = (*p_link)->anchor_list.begin();
+        p_anchor != (*p_link)->anchor_list.end(); p_anchor++) {
+      block.anchors.push_back((*p_anchor)->id);
+    }
+    for (tag_list::iterator p_tag = (*p_link)->tags.begin(); p_tag != (*p_link)->tags.end(); p_tag++) {
+      block.sequences.push_back(sequence_indexes[p_tag->sequence]);
+      block.starts.push_back(p_tag->start);
+      block.ends.push_back(p_tag->end);
+      block.strands.push_back(p_tag->strand);
+    }
+    writer.write_block(block);
+  }
+  graph->restore_bridges();
+
+  return links.size();
+}
+
+
+/*!
+    \fn Enredo::get_links_at(const string &species, const string &chr, unsigned int start, unsigned int end, vector<Link*> &links)
+ */
+void Enredo::get_links_at(const string &species, const string &chr, unsigned int start, unsigned int end,
+    vector<Link*> &links)
+{
+  if (parameters.all) {
+    graph->get_links_at(species, chr, start, end, links);
+  } else {
+    graph->get_links_at(species, chr, start, end, links, parameters.min_anchors, parameters.min_regions,
+        parameters.min_length, parameters.allow_bridges);
+  }
+}
+
+
+/*!
+    \fn Enredo::get_blocks_at(const string &species, const string &chr, unsigned int start, unsigned int end, vector<enredo_block> &blocks)
+    The first call builds an index of the positions of the blocks, so the next ones are fast as
+    long as the graph does not change.
+ */
+unsigned long Enredo::get_blocks_at(const string &species, const string &chr, unsigned int start,
+    unsigned int end, vector<enredo_block> &blocks)
+{
+  vector<Link*> links;
+  get_links_at(species, chr, start, end, links);
+  links_to_blocks(links, blocks);
+  graph->restore_bridges();
+
+  return links.size();
+}
+
+
+/*!
+    \fn Enredo::print_blocks_at(const string &species, const string &chr, unsigned int start, unsigned int end, ostream &out)
+ */
+unsigned long Enredo::print_blocks_at(const string &species, const string &chr, unsigned int start,
+    unsigned int end, ostream &out)
+{
+  vector<Link*> links;
+  get_links_at(species, chr, start, end, links);
+  for (vector<Link*>::iterator p_link = links.begin(); p_link != links.end(); p_link++) {
+    (*p_link)->print(out);
+  }
+  graph->restore_bridges();
+
+  return links.size();
+}
+
+
+/*!
+    \fn Enredo::print_anchor(const string &id, ostream &out)
+ */
+bool Enredo::print_anchor(const string &id, ostream &out)
+{
+  return graph->print_anchor(id, out);
+}
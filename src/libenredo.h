@@ -0,0 +1,210 @@
+#ifndef LIBENREDO_H
+#define LIBENREDO_H
+
+/**
+	Public interface of the enredo library (libenredo). This header does not depend on any other
+	header of enredo and is the only one installed.
+*/
+#include <iostream>
+#include <string>
+#include <vector>
+
+//! Version of the interface. Only changes when existing calls change
+#define LIBENREDO_API_VERSION 1
+
+typedef class Graph Graph;
+typedef class Link Link;
+typedef class BlockIndex BlockIndex;
+typedef class BlockFileWriter BlockFileWriter;
+
+//! One genomic region of a block
+
+struct enredo_region {
+  std::string species;
+  std::string chr;
+  unsigned int start;
+  unsigned int end;
+  int strand; //!< 1 or -1 when the region goes along or against the anchors of the block, 0 if unknown
+};
+
+//! A block of co-linear genomic regions, as printed in the enredo output
+
+struct enredo_block {
+  std::vector<std::string> anchors; //!< ids of the anchors in the path of the block
+  std::vector<enredo_region> regions;
+};
+
+//! Number of runs and changes of one pass of the pipeline
+
+struct enredo_pass_stats {
+  std::string name; //!< as in the pipeline spec, like "simplify(1)"
+  unsigned int runs;
+  unsigned int skipped; //!< runs skipped: minimize when the graph had not changed, other passes over max_pass_time
+  unsigned long changes;
+  double time; //!< seconds spent in the runs
+};
+
+//! What to do when the anchors file is not sorted (see the --sort option)
+enum enredo_sort_mode {
+  ENREDO_SORT_AUTO,
+  ENREDO_SORT_ALWAYS,
+  ENREDO_SORT_NEVER
+};
+
+//! Options of the enredo library. They have the same name and default value as in the enredo program
+
+struct enredo_parameters {
+  enredo_parameters();
+
+  // Loading of the hits
+  float min_score;
+  int max_gap_length;
+  bool anchors_as_links;
+  bool merge_overlap;
+  std::string merged_filename; //!< the merged anchors are written here if set (with merge_overlap)
+  enredo_sort_mode sorting;
+  unsigned long sort_memory; //!< in MB
+  std::string tmp_dir;
+  std::vector<std::string> regions; //!< species:chr[:start-end]. The anchors file must be indexed
+  std::vector<std::string> species; //!< only load these species (all by default)
+  std::vector<std::string> excluded_species;
+  unsigned int max_anchor_copies; //!< skip the anchors with more hits per species (0 for no limit)
+  unsigned long max_anchor_hits; //!< skip the anchors with more hits in total (0 for no limit)
+  std::string filtered_anchors_filename; //!< the anchors skipped by these two limits are written here if set
+  bool prescan; //!< count the anchors in the file before loading it
+  unsigned long memory_limit; //!< in MB. If set, the links are kept in a file in tmp_dir (out-of-core mode)
+
+  // Simplification of the graph
+  unsigned int max_path_dissimilarity;
+  unsigned int simplify_graph; //!< 0 to 7
+  unsigned int min_length;
+  unsigned int min_regions;
+  unsigned int min_anchors;
+  float max_ratio; //!< values <= 1.0 disable the splitting of unbalanced links
+  std::string pipeline; //!< stages applied by run() (see the README). By default, set by simplify_graph
+  bool skip_idle_minimize; //!< skip a minimize when no stage has changed the graph since the last one
+  // Budgets of the pipeline (0 for no limit). See the README
+  double max_time; //!< in seconds. Once over, the rest of the pipeline is skipped
+  double max_pass_time; //!< in seconds. A pass (other than minimize) that has run for this long is skipped
+  unsigned int max_iterations; //!< of each repeat() loop
+  unsigned long max_total_iterations; //!< of all the repeat() loops together. Once over, as max_time
+
+  // Resulting blocks
+  bool allow_bridges;
+  bool all; //!< return all the links, not only the valid blocks
+
+  bool print_stats; //!< print the stats of the graph in the log during run()
+  int histogram_size;
+  unsigned int num_threads; //!< 0 uses all the cores
+  std::string debug;
+};
+
+//! Builds an enredo graph from anchor hits and returns the resulting blocks
+
+/*!
+    Hits can be read from an anchors file (load_file()) or pushed one by one (add_hit()), in both
+    cases sorted by species, chromosome and position. They can also be added to a graph saved by a
+    previous run (load_graph()), as long as they come from new species. Then run() applies the same pipeline as the
+    enredo program, or the stages can be called one by one. A run() can be interrupted between two
+    stages and go on later from a checkpoint (see request_checkpoint()). The blocks are returned as structs by
+    get_blocks() or printed in the enredo format by print_blocks().
+
+    Progress messages are written to STDOUT unless set_log() is used. Errors are written to STDERR.
+ */
+class Enredo{
+public:
+    Enredo(const enredo_parameters &parameters = enredo_parameters());
+
+    ~Enredo();
+    //! Sets the stream for the progress messages. NULL disables them
+    void set_log(std::ostream *log);
+    //! Loads the hits of an anchors file ("-" for STDIN; gzip and bgzip files are accepted)
+    bool load_file(std::string filename);
+    //! Adds one hit. strand is '+' or '-'. Hits with a score lower than min_score are ignored
+    bool add_hit(const std::string &anchor_id, const std::string &species, const std::string &chr,
+        int start, int end, char strand, float score = 0.0f);
+    //! The next hit will not be linked to the previous one (like "--" lines in an anchors file)
+    void break_path(void);
+    //! Removes all the hits
+    void clear(void);
+    //! Saves the graph in a snapshot file. Must be called before run(), which adds its result to the file
+    bool save_graph(const std::string &filename);
+    //! Loads a graph saved by save_graph(), to add the hits of new species to it (see the README)
+    bool load_graph(const std::string &filename);
+    //! Sets the file where run() saves the graph and its position when request_checkpoint() is called
+    void set_checkpoint_file(const std::string &filename);
+    //! Makes run() save a checkpoint and return before the next pass. Can be called from a signal handler
+    static void request_checkpoint(void);
+    //! Loads a checkpoint. The next run() goes on from there, with the same parameters (see the README)
+    bool load_checkpoint(const std::string &filename);
+    //! Returns true if the last run() stopped at a checkpoint. The blocks are not ready then
+    bool was_interrupted(void);
+
+    //! Applies all the stages of the pipeline. Returns false if the pipeline is not valid (or on errors)
+    bool run(void);
+    //! Returns the pipeline used by run()
+    std::string get_pipeline(void);
+    //! Returns the number of runs and changes of each stage in the last run()
+    const std::vector<enredo_pass_stats>& get_pass_stats(void);
+    //! Returns why the last run() did not apply the whole pipeline (see max_time), or an empty string
+    std::string get_stop_reason(void);
+
+    // Stages of the pipeline. They return the number of changes in the graph
+    unsigned int minimize(void);
+    unsigned int merge_alternative_paths(unsigned int max_anchors, unsigned int max_length = 10000);
+    unsigned int simplify(unsigned int min_regions = 1);
+    unsigned int simplify_aggressive(unsigned int min_regions = 1);
+    unsigned int split_unselected_links(void);
+    unsigned int resolve_small_palindromes(void);
+    unsigned int assimilate_small_insertions(unsigned int max_insertion_length = 100000);
+    unsigned int split_unbalanced_links(void);
+    //! Moves the Links together in memory. Returns the number of Anchors without links moved out of the graph
+    unsigned int compact(void);
+    //! Prints the stats of the graph in the log
+    void print_stats(void);
+
+    //! Gets the resulting blocks. Returns the number of blocks
+    unsigned long get_blocks(std::vector<enredo_block> &blocks);
+    //! Prints the resulting blocks in the enredo format. Returns the number of blocks
+    /*! If index is set, the regions of the blocks and their position in out are added to it (see index.h) */
+    unsigned long print_blocks(std::ostream &out, BlockIndex *index = NULL);
+    //! Writes the resulting blocks in a binary block file (see blockfile.h). Returns the number of blocks
+    unsigned long write_blocks(BlockFileWriter &writer);
+    //! Gets the resulting blocks with a region overlapping species:chr:start-end. Returns the number of blocks
+    unsigned long get_blocks_at(const std::string &species, const std::string &chr, unsigned int start,
+        unsigned int end, std::vector<enredo_block> &blocks);
+    //! Same, printing the blocks in the enredo format
+    unsigned long print_blocks_at(const std::string &species, const std::string &chr, unsigned int start,
+        unsigned int end, std::ostream &out);
+    //! Prints the links of an anchor, as in the debug output. Returns false if the anchor is not in the graph
+    bool print_anchor(const std::string &id, std::ostream &out);
+
+    enredo_parameters parameters; //!< can be changed between stages
+
+  protected:
+    Graph *graph;
+    std::ostream *log;
+    std::ostream *null_log;
+    bool hits_started; //!< add_hit() has already been called
+    std::vector<enredo_pass_stats> pass_stats;
+    std::string stop_reason;
+    Graph *previous_result; //!< result saved with the graph loaded by load_graph(), if any
+    std::string previous_settings; //!< settings of the pipeline that gave previous_result
+    std::string snapshot_filename; //!< run() adds its result to this file (see save_graph())
+    std::string checkpoint_filename;
+    std::string checkpoint_settings; //!< settings of the run that wrote the checkpoint loaded
+    std::string checkpoint_state; //!< position of the pipeline in the checkpoint loaded, empty if none
+    bool interrupted;
+
+    //! Returns the settings that change the result of run()
+    std::string get_run_settings(void);
+
+    //! Writes the graph and the state of the pipeline in the checkpoint file
+    bool write_checkpoint(const std::string &state);
+    bool start_out_of_core(void);
+    bool trim_out_of_core(void);
+    void get_links_at(const std::string &species, const std::string &chr, unsigned int start, unsigned int end,
+        std::vector<Link*> &links);
+};
+
+#endif
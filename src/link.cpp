@@ -1,13 +1,19 @@
 #include <iostream>
 #include "link.h"
 #include "anchor.h"
+#include "tag_overlap.h"
 #include <vector>
 #include <map>
 #include <cstdlib>
 #include <iomanip>
+#include <mutex>
+
+static unsigned long long next_link_serial = 0;
 
 Link::Link(Anchor* anchor1, Anchor* anchor2)
 {
+  serial = next_link_serial++;
+  clear_signature();
   this->anchor_list.push_back(anchor1);
   this->anchor_list.push_back(anchor2);
 //   cerr << "New link" << anchor1->id << ":" << anchor2->id << endl;
@@ -18,8 +24,9 @@ Link::Link(Anchor* anchor1, Anchor* anchor2)
  */
 Link::Link(Link *my_link)
 {
-  
-  for (list<Anchor*>::iterator p_anchor_it = my_link->anchor_list.begin(); p_anchor_it != my_link->anchor_list.end(); p_anchor_it++) {
+  serial = next_link_serial++;
+  clear_signature();
+  for (anchor_path::iterator p_anchor_it = my_link->anchor_list.begin(); p_anchor_it != my_link->anchor_list.end(); p_anchor_it++) {
     this->anchor_list.push_back(*p_anchor_it);
   }
 }
@@ -44,140 +51,487 @@ Link::~Link()
 }
 
 
+/*!
+    \fn get_next_link_serial()
+ */
+unsigned long long get_next_link_serial(void)
+{
+  return next_link_serial;
+}
+
+
+/*!
+    \fn set_next_link_serial(unsigned long long serial)
+ */
+void set_next_link_serial(unsigned long long serial)
+{
+  next_link_serial = serial;
+}
+
+
+//! Species and chromosome of a tag (see get_tag_sequence)
+
+struct tag_sequence {
+  string *species;
+  string *chr;
+};
+
+//! The table of sequences grows in chunks that never move, so it can be read while adding new ones
+#define TAG_SEQUENCE_CHUNK_SIZE 65536
+#define MAX_TAG_SEQUENCES (1U << 30)
+
+static tag_sequence *tag_sequence_chunks[MAX_TAG_SEQUENCES / TAG_SEQUENCE_CHUNK_SIZE];
+static map< pair<string*, string*>, uint > tag_sequence_ids;
+static uint last_tag_sequence = 0;
+static mutex tag_sequence_mutex;
+
+
+/*!
+    \fn get_tag_sequence(string *species, string *chr)
+    The hits come sorted by chromosome, so the sequence is almost always the same as the last one.
+ */
+uint get_tag_sequence(string *species, string *chr)
+{
+  lock_guard<mutex> lock(tag_sequence_mutex);
+  if (!tag_sequence_ids.empty()) {
+    tag_sequence &last = tag_sequence_chunks[last_tag_sequence / TAG_SEQUENCE_CHUNK_SIZE]
+        [last_tag_sequence % TAG_SEQUENCE_CHUNK_SIZE];
+    if (last.species == species and last.chr == chr) {
+      return last_tag_sequence;
+    }
+  }
+  map< pair<string*, string*>, uint >::iterator it = tag_sequence_ids.find(make_pair(species, chr));
+  if (it != tag_sequence_ids.end()) {
+    last_tag_sequence = it->second;
+    return last_tag_sequence;
+  }
+  uint sequence = tag_sequence_ids.size();
+  if (sequence >= MAX_TAG_SEQUENCES) {
+    cerr << "Too many chromosomes (more than " << MAX_TAG_SEQUENCES << ")" << endl;
+    exit(1);
+  }
+  if (sequence % TAG_SEQUENCE_CHUNK_SIZE == 0) {
+    tag_sequence_chunks[sequence / TAG_SEQUENCE_CHUNK_SIZE] = new tag_sequence[TAG_SEQUENCE_CHUNK_SIZE];
+  }
+  tag_sequence &new_sequence = tag_sequence_chunks[sequence / TAG_SEQUENCE_CHUNK_SIZE]
+      [sequence % TAG_SEQUENCE_CHUNK_SIZE];
+  new_sequence.species = species;
+  new_sequence.chr = chr;
+  tag_sequence_ids[make_pair(species, chr)] = sequence;
+  last_tag_sequence = sequence;
+
+  return sequence;
+}
+
+
+/*!
+    \fn tag::get_species()
+ */
+string *tag::get_species(void) const
+{
+  return tag_sequence_chunks[sequence / TAG_SEQUENCE_CHUNK_SIZE][sequence % TAG_SEQUENCE_CHUNK_SIZE].species;
+}
+
+
+/*!
+    \fn tag::get_chr()
+ */
+string *tag::get_chr(void) const
+{
+  return tag_sequence_chunks[sequence / TAG_SEQUENCE_CHUNK_SIZE][sequence % TAG_SEQUENCE_CHUNK_SIZE].chr;
+}
+
+
 /*!
     \fn Link::add_tag(string species, string chr, int start, int end)
  */
 void Link::add_tag(string *species, string *chr, int start, int end, short strand)
 {
   tag this_tag;
-  this_tag.species = species;
-  this_tag.chr = chr;
+  this_tag.sequence = get_tag_sequence(species, chr);
   this_tag.start = start;
   this_tag.end = end;
   this_tag.strand = strand;
 
   tags.push_back(this_tag);
+  add_to_signature(this_tag);
 }
 
 
 /*!
-    \fn Link::get_matching_tags(Link *other_link, short strand1, short strand2, bool allow_partial_match)
-    strand1 and/or strand2 can be 0. In this case, both possible strands will be tested.
+    \fn get_sequence_hash(uint sequence)
+    Mixes the bits of the index of the sequence (finalizer of MurmurHash3)
  */
-std::vector< std::list<tag>::iterator > Link::get_matching_tags(Link *other_link, short strand1, short strand2, bool allow_partial_match)
+static inline uint64_t get_sequence_hash(uint sequence)
 {
-  std::vector< std::list<tag>::iterator > this_tag_links_to(this->tags.size(), other_link->tags.end());
-  std::vector< std::list<tag>::iterator > other_tag_links_to(other_link->tags.size(), this->tags.end());
-  if (strand1 == 0) {
-    this_tag_links_to = this->get_matching_tags(other_link, 1, strand2);
-    if (!this_tag_links_to.empty()) {
-      return this_tag_links_to;
-    } else {
-      return this->get_matching_tags(other_link, -1, strand2);
+  uint64_t hash = sequence;
+  hash ^= hash >> 33;
+  hash *= 0xff51afd7ed558ccdULL;
+  hash ^= hash >> 33;
+  hash *= 0xc4ceb9fe1a85ec53ULL;
+  hash ^= hash >> 33;
+
+  return hash;
+}
+
+
+/*!
+    \fn Link::clear_signature()
+ */
+void Link::clear_signature(void)
+{
+  sequence_hash = 0;
+  sequence_mask = 0;
+  min_start = ~0U;
+  max_end = 0;
+}
+
+
+/*!
+    \fn Link::add_to_signature(const tag &this_tag)
+ */
+void Link::add_to_signature(const tag &this_tag)
+{
+  uint64_t hash = get_sequence_hash(this_tag.sequence);
+  sequence_hash += hash;
+  sequence_mask |= (1ULL << (hash >> 58));
+  if (this_tag.start < min_start) {
+    min_start = this_tag.start;
+  }
+  if (this_tag.end > max_end) {
+    max_end = this_tag.end;
+  }
+}
+
+
+/*!
+    \fn Link::update_signature()
+    Needed when tags are added, removed or moved to another sequence without add_tag(). Moving the
+    coordinates of the tags outwards needs it as well. Trimming them does not.
+ */
+void Link::update_signature(void)
+{
+  clear_signature();
+  for (tag_list::iterator p_tag = tags.begin(); p_tag != tags.end(); p_tag++) {
+    add_to_signature(*p_tag);
+  }
+}
+
+
+/*!
+    \fn Link::may_concatenate_with(Link *other_link)
+    Concatenating two links needs each tag of one of them to overlap a different tag of the other
+    one on the same sequence (see try_to_concatenate_with): both have the same number of tags on
+    each sequence and their bounds overlap.
+ */
+bool Link::may_concatenate_with(Link *other_link)
+{
+  if (tags.size() != other_link->tags.size() or sequence_hash != other_link->sequence_hash
+      or sequence_mask != other_link->sequence_mask) {
+    return false;
+  }
+  if (!tags.empty() and (min_start >= other_link->max_end or other_link->min_start >= max_end)) {
+    return false;
+  }
+
+  return true;
+}
+
+
+/*!
+    \fn Link::may_contain_tags_of(Link *other_link)
+    Same as may_concatenate_with() when only the tags of the other link must all be matched (see
+    get_matching_tags): the other link has no sequence this one does not have.
+ */
+bool Link::may_contain_tags_of(Link *other_link)
+{
+  if (other_link->tags.size() > tags.size() or (other_link->sequence_mask & ~sequence_mask)) {
+    return false;
+  }
+  if (!other_link->tags.empty() and (min_start >= other_link->max_end or other_link->min_start >= max_end)) {
+    return false;
+  }
+
+  return true;
+}
+
+
+//! Result of matching the tags of two Links for one combination of their strands (see match_tags)
+
+struct tag_matching {
+  std::vector< tag_list::iterator > this_tag_links_to; //!< empty once the strands are known to be wrong
+  std::vector< tag_list::iterator > other_tag_links_to;
+};
+
+//! The combinations of strands, in the order they are tried when a strand is 0
+#define NUM_STRAND_COMBINATIONS 4
+static const short combination_strand1[NUM_STRAND_COMBINATIONS] = {1, 1, -1, -1};
+static const short combination_strand2[NUM_STRAND_COMBINATIONS] = {1, -1, 1, -1};
+
+//! Below this number of tags in the other link, the tags are compared one by one
+#define MIN_TAGS_FOR_OVERLAP_MASK 16
+
+
+/*!
+    \fn add_tag_pair(tag_matching &matching, tag_list::iterator p_tag1, tag_list::iterator p_tag2, uint index1, uint index2, tag_list::iterator no_tag)
+    Adds two overlapping tags to the matching of the combination of strands. Returns 1 if these
+    strands turn out to be wrong (the matching is cleared then), 0 otherwise.
+ */
+template <int combination>
+static inline uint add_tag_pair(tag_matching &matching, tag_list::iterator p_tag1, tag_list::iterator p_tag2,
+    uint index1, uint index2, tag_list::iterator no_tag)
+{
+  const int strand1 = (combination < 2) ? 1 : -1;
+  const int strand2 = (combination % 2 == 0) ? 1 : -1;
+  int str1 = strand1 * p_tag1->strand;
+  int str2 = strand2 * p_tag2->strand;
+  if (str1 == 1 and str2 == 1) {
+    if (!(p_tag1->start < p_tag2->start and p_tag1->end < p_tag2->end)) {
+      // link goes and come back: they will be concatenated when studying the other anchor
+      return 0;
     }
+  } else if (str1 == -1 and str2 == -1) {
+    if (!(p_tag2->start < p_tag1->start and p_tag2->end < p_tag1->end)) {
+      // link goes and come back: they will be concatenated when studying the other anchor
+      return 0;
+    }
+  } else if (str1 != 0 and str2 != 0) {
+    // testing wrong strand when 2 strands can be tested
+    matching.this_tag_links_to.clear();
+    matching.other_tag_links_to.clear();
+    return 1;
   }
-  if (strand2 == 0) {
-    this_tag_links_to = this->get_matching_tags(other_link, strand1, 1);
-    if (!this_tag_links_to.empty()) {
-      return this_tag_links_to;
-    } else {
-      return this->get_matching_tags(other_link, strand1, -1);
+  if (matching.other_tag_links_to[index2] != no_tag) {
+    // This other tag already matches a tag. Skip this.
+    return 0;
+  }
+  matching.other_tag_links_to[index2] = p_tag1;
+  matching.this_tag_links_to[index1] = p_tag2;
+
+  return 0;
+}
+
+
+/*!
+    \fn add_overlapping_tags(tag_matching *matchings, uint &num_left, tag_list::iterator p_tag1, tag_list::iterator p_tag2, uint index1, uint index2, tag_list::iterator no_tag)
+    Adds two overlapping tags to the matching of each combination of strands still left. Returns
+    true once none is left.
+ */
+template <int combinations>
+static inline bool add_overlapping_tags(tag_matching *matchings, uint &num_left, tag_list::iterator p_tag1,
+    tag_list::iterator p_tag2, uint index1, uint index2, tag_list::iterator no_tag)
+{
+  if ((combinations & 1) and !matchings[0].this_tag_links_to.empty()) {
+    num_left -= add_tag_pair<0>(matchings[0], p_tag1, p_tag2, index1, index2, no_tag);
+  }
+  if ((combinations & 2) and !matchings[1].this_tag_links_to.empty()) {
+    num_left -= add_tag_pair<1>(matchings[1], p_tag1, p_tag2, index1, index2, no_tag);
+  }
+  if ((combinations & 4) and !matchings[2].this_tag_links_to.empty()) {
+    num_left -= add_tag_pair<2>(matchings[2], p_tag1, p_tag2, index1, index2, no_tag);
+  }
+  if ((combinations & 8) and !matchings[3].this_tag_links_to.empty()) {
+    num_left -= add_tag_pair<3>(matchings[3], p_tag1, p_tag2, index1, index2, no_tag);
+  }
+
+  return (num_left == 0);
+}
+
+
+/*!
+    \fn match_tags(Link *link1, Link *link2, tag_matching *matchings)
+    Matches the tags of link1 with the ones of link2 for each combination of strands in the bits
+    of combinations, in one single pass over the pairs of tags: whether two tags overlap does not
+    depend on the strands. When link2 has many tags, each tag of link1 is tested against blocks of
+    them at once (see get_overlap_mask). The overlapping pairs are found in the same order anyway.
+ */
+template <int combinations>
+static void match_tags(Link *link1, Link *link2, tag_matching *matchings)
+{
+  uint num_left = 0;
+  for (uint a = 0; a < NUM_STRAND_COMBINATIONS; a++) {
+    if (combinations & (1 << a)) {
+      matchings[a].this_tag_links_to.assign(link1->tags.size(), link2->tags.end());
+      matchings[a].other_tag_links_to.assign(link2->tags.size(), link1->tags.end());
+      num_left++;
+    }
+  }
+  bool same_link = (link1 == link2);
+  tag_list::iterator no_tag = link1->tags.end();
+  uint index1 = 0;
+
+  if (link2->tags.size() >= MIN_TAGS_FOR_OVERLAP_MASK) {
+    tag_block block;
+    block.assign(link2->tags);
+    for (tag_list::iterator p_tag1 = link1->tags.begin(); p_tag1 != link1->tags.end(); p_tag1++, index1++) {
+      for (uint first = 0; first < block.sequences.size(); first += TAG_BLOCK_SIZE) {
+        uint32_t mask = get_overlap_mask(*p_tag1, block, first);
+        if (same_link and index1 >= first and index1 < first + TAG_BLOCK_SIZE) {
+          /* Support for loops, avoid trivial match */
+          mask &= ~(1U << (index1 - first));
+        }
+        while (mask) {
+          uint index2 = first + get_first_bit(mask);
+          mask &= mask - 1;
+          if (add_overlapping_tags<combinations>(matchings, num_left, p_tag1, block.tags[index2], index1, index2,
+              no_tag)) {
+            return;
+          }
+        }
+      }
     }
+    return;
   }
 
-  uint this_tag_counter = 0;
-  // p_tag1: iterator for tags in this link
-  for (list<tag>::iterator p_tag1 = this->tags.begin(); p_tag1 != this->tags.end(); p_tag1++) {
-    this_tag_counter++;
-    short str1 = strand1 * p_tag1->strand;
-    uint other_tag_counter = 0;
-    // p_tag2: iterator for tags in the other link
-    for (list<tag>::iterator p_tag2 = other_link->tags.begin(); p_tag2 != other_link->tags.end(); p_tag2++) {
-      other_tag_counter++;
-      if (this == other_link and p_tag1 == p_tag2) {
+  // p_tag1: iterator for tags in link1
+  for (tag_list::iterator p_tag1 = link1->tags.begin(); p_tag1 != link1->tags.end(); p_tag1++, index1++) {
+    uint index2 = 0;
+    // p_tag2: iterator for tags in link2
+    for (tag_list::iterator p_tag2 = link2->tags.begin(); p_tag2 != link2->tags.end(); p_tag2++, index2++) {
+      if (same_link and p_tag1 == p_tag2) {
         /* Support for loops, avoid trivial match */
         continue;
       }
-      if (p_tag1->species == p_tag2->species and p_tag1->chr == p_tag2->chr and p_tag1->start < p_tag2->end and p_tag2->start < p_tag1->end) {
-        short str2 = strand2 * p_tag2->strand;
-        if (str1 == 1 and str2 == 1) {
-          if (!(p_tag1->start < p_tag2->start and p_tag1->end < p_tag2->end)) {
-            // link goes and come back: they will be concatenated when studying the other anchor
-            continue;
-          }
-        } else if (str1 == -1 and str2 == -1) {
-          if (!(p_tag2->start < p_tag1->start and p_tag2->end < p_tag1->end)) {
-            // link goes and come back: they will be concatenated when studying the other anchor
-            continue;
-          }
-        } else if (str1 != 0 and str2 != 0) {
-          // testing wrong strand when 2 strands can be tested. return void vector
-          this_tag_links_to.clear();
-          return this_tag_links_to;
-        }
-        if (other_tag_links_to[other_tag_counter - 1] != this->tags.end()) {
-          // This other tag already matches a tag. Skip this.
-          continue;
-        }
-        other_tag_links_to[other_tag_counter - 1] = p_tag1;
-        this_tag_links_to[this_tag_counter - 1] = p_tag2;
+      if (p_tag1->sequence != p_tag2->sequence or p_tag1->start >= p_tag2->end or p_tag2->start >= p_tag1->end) {
+        continue;
+      }
+      if (add_overlapping_tags<combinations>(matchings, num_left, p_tag1, p_tag2, index1, index2, no_tag)) {
+        return;
       }
     }
   }
+}
+
 
+/*!
+    \fn match_tags(Link *link1, Link *link2, short strand1, short strand2, tag_matching *matchings)
+    A strand of 0 stands for both strands. Returns the combinations of strands tested, as bits
+    (see combination_strand1 and combination_strand2).
+ */
+static uint match_tags(Link *link1, Link *link2, short strand1, short strand2, tag_matching *matchings)
+{
+  uint combinations = 0;
+  for (uint a = 0; a < NUM_STRAND_COMBINATIONS; a++) {
+    if ((strand1 == 0 or strand1 == combination_strand1[a]) and (strand2 == 0 or strand2 == combination_strand2[a])) {
+      combinations |= (1 << a);
+    }
+  }
+  switch (combinations) {
+    case 1: match_tags<1>(link1, link2, matchings); break;
+    case 2: match_tags<2>(link1, link2, matchings); break;
+    case 4: match_tags<4>(link1, link2, matchings); break;
+    case 8: match_tags<8>(link1, link2, matchings); break;
+    case 3: match_tags<3>(link1, link2, matchings); break;
+    case 12: match_tags<12>(link1, link2, matchings); break;
+    case 5: match_tags<5>(link1, link2, matchings); break;
+    case 10: match_tags<10>(link1, link2, matchings); break;
+    case 15: match_tags<15>(link1, link2, matchings); break;
+  }
+
+  return combinations;
+}
+
+
+/*!
+    \fn check_matching(tag_matching &matching, tag_list::iterator no_tag, bool allow_partial_match)
+    Every tag of the other link must match a different tag of this one
+ */
+static bool check_matching(tag_matching &matching, tag_list::iterator no_tag, bool allow_partial_match)
+{
+  if (matching.this_tag_links_to.empty()) {
+    return false;
+  }
+  std::vector< tag_list::iterator > &other_tag_links_to = matching.other_tag_links_to;
   for (uint a = 0; a < other_tag_links_to.size(); a++) {
     // Check if any of the other tags has not been linked
-    if (other_tag_links_to[a] == this->tags.end()) {
+    if (other_tag_links_to[a] == no_tag) {
       if (allow_partial_match) continue;
-      this_tag_links_to.clear();
-      return this_tag_links_to;
+      return false;
     }
     // Check if any two of the other tags link to the same tag of this link
     for (uint b = a + 1; b < other_tag_links_to.size(); b++) {
       if (other_tag_links_to[a] == other_tag_links_to[b]) {
-        this_tag_links_to.clear();
-        return this_tag_links_to;
+        return false;
       }
     }
   }
-  return this_tag_links_to;
+
+  return true;
 }
 
 
 /*!
-    \fn Link::try_to_concatenate_with(Link *other_link, short strand1, short strand2)
+    \fn Link::get_matching_tags(Link *other_link, short strand1, short strand2, bool allow_partial_match)
+    strand1 and/or strand2 can be 0. In this case, both possible strands are tested at once and the
+    first combination that matches, in the order of combination_strand1, is returned. Partial
+    matches are only allowed when both strands are given.
  */
-bool Link::try_to_concatenate_with(Link *other_link, short strand1, short strand2)
+std::vector< tag_list::iterator > Link::get_matching_tags(Link *other_link, short strand1, short strand2, bool allow_partial_match)
 {
-  if (strand1 == 0) {
-    if (this->try_to_concatenate_with(other_link, 1, strand2)) {
-      return true;
-    } else {
-      return this->try_to_concatenate_with(other_link, -1, strand2);
-    }
+  std::vector< tag_list::iterator > this_tag_links_to;
+  if (strand1 == 0 or strand2 == 0) {
+    allow_partial_match = false;
   }
-  if (strand2 == 0) {
-    if (this->try_to_concatenate_with(other_link, strand1, 1)) {
-      return true;
-    } else {
-      return this->try_to_concatenate_with(other_link, strand1, -1);
+  if (!allow_partial_match and !may_contain_tags_of(other_link)) {
+    return this_tag_links_to;
+  }
+  tag_matching matchings[NUM_STRAND_COMBINATIONS];
+  uint combinations = match_tags(this, other_link, strand1, strand2, matchings);
+  for (uint a = 0; a < NUM_STRAND_COMBINATIONS; a++) {
+    if ((combinations & (1 << a)) and check_matching(matchings[a], this->tags.end(), allow_partial_match)) {
+      this_tag_links_to.swap(matchings[a].this_tag_links_to);
+      break;
     }
   }
 
-  std::vector< std::list<tag>::iterator > this_tag_links_to = this->get_matching_tags(other_link, strand1, strand2);
-  if (this_tag_links_to.empty()) {
-    // vector will be empty if any of the tags in the other_link has no match in this link
+  return this_tag_links_to;
+}
+
+
+/*!
+    \fn Link::try_to_concatenate_with(Link *other_link, short strand1, short strand2)
+    As in get_matching_tags(), a strand of 0 tests both strands, all of them in the same pass over
+    the tags. The first combination where all the tags match is used.
+ */
+bool Link::try_to_concatenate_with(Link *other_link, short strand1, short strand2)
+{
+  if (!may_concatenate_with(other_link)) {
     return false;
-  } else {
+  }
+  tag_matching matchings[NUM_STRAND_COMBINATIONS];
+  uint combinations = match_tags(this, other_link, strand1, strand2, matchings);
+  for (uint a = 0; a < NUM_STRAND_COMBINATIONS; a++) {
+    if (!(combinations & (1 << a)) or !check_matching(matchings[a], this->tags.end(), false)) {
+      // vector will be empty if any of the tags in the other_link has no match in this link
+      continue;
+    }
     // check that all tags in this link have a match in the other_link
-    for (uint a = 0; a < this_tag_links_to.size(); a++) {
-      if (this_tag_links_to[a] == other_link->tags.end()) {
+    std::vector< tag_list::iterator > &this_tag_links_to = matchings[a].this_tag_links_to;
+    bool all_matched = true;
+    for (uint b = 0; b < this_tag_links_to.size(); b++) {
+      if (this_tag_links_to[b] == other_link->tags.end()) {
         cerr << "ERROR. One of the tags links to nothing (should have been detected before)";
-        return false;
+        all_matched = false;
+        break;
       }
     }
-  } 
+    if (all_matched) {
+      concatenate_with(other_link, combination_strand1[a], combination_strand2[a], this_tag_links_to);
+      return true;
+    }
+  }
+
+  return false;
+}
 
+
+/*!
+    \fn Link::concatenate_with(Link *other_link, short strand1, short strand2, std::vector< tag_list::iterator > &this_tag_links_to)
+    this_tag_links_to is the matching of the tags for these strands (see get_matching_tags)
+ */
+void Link::concatenate_with(Link *other_link, short strand1, short strand2,
+    std::vector< tag_list::iterator > &this_tag_links_to)
+{
   if (strand1 == -1) {
     this->reverse();
   }
@@ -197,8 +551,8 @@ bool Link::try_to_concatenate_with(Link *other_link, short strand1, short strand
   bool resulting_link_is_palindromic = false;
   if (front_anchor == back_anchor and this->anchor_list.size() == other_link->anchor_list.size()) {
     resulting_link_is_palindromic = true;
-    list<Anchor*>::iterator p_anchor1 = this->anchor_list.begin();
-    list<Anchor*>::reverse_iterator p_anchor2 = other_link->anchor_list.rbegin();
+    anchor_path::iterator p_anchor1 = this->anchor_list.begin();
+    anchor_path::reverse_iterator p_anchor2 = other_link->anchor_list.rbegin();
     // Skip the first one, we know they mathc already
     p_anchor1++;
     p_anchor2++;
@@ -215,8 +569,8 @@ bool Link::try_to_concatenate_with(Link *other_link, short strand1, short strand
 
   // Concatenate the links
   uint this_tag_counter = 0;
-  for (list<tag>::iterator p_tag1 = this->tags.begin(); p_tag1 != this->tags.end(); p_tag1++) {
-    std::list<tag>::iterator p_tag2 = this_tag_links_to[this_tag_counter];
+  for (tag_list::iterator p_tag1 = this->tags.begin(); p_tag1 != this->tags.end(); p_tag1++) {
+    tag_list::iterator p_tag2 = this_tag_links_to[this_tag_counter];
 //     cout << "concatenating (" << *p_tag1->species << ":" << *p_tag1->chr << ":" << p_tag1->start << ":"
 //         << p_tag1->end << ":" << p_tag1->strand << ")"
 //         << " -- (" << *p_tag2->species << ":" << *p_tag2->chr << ":" << p_tag2->start << ":"
@@ -230,6 +584,13 @@ bool Link::try_to_concatenate_with(Link *other_link, short strand1, short strand
     if (p_tag1->start > p_tag2->start) {
       p_tag1->start = p_tag2->start;
     }
+    // Same tags per sequence as before, only the bounds can grow
+    if (p_tag1->start < min_start) {
+      min_start = p_tag1->start;
+    }
+    if (p_tag1->end > max_end) {
+      max_end = p_tag1->end;
+    }
     if (resulting_link_is_palindromic) {
       p_tag1->strand = 0;
     } else if (p_tag1->strand == 0 ) {
@@ -267,11 +628,9 @@ bool Link::try_to_concatenate_with(Link *other_link, short strand1, short strand
   }
 
   // Append anchors from other_link to this link
-  for (list<Anchor*>::iterator anchor_it = ++other_link->anchor_list.begin(); anchor_it != other_link->anchor_list.end(); anchor_it++) {
+  for (anchor_path::iterator anchor_it = ++other_link->anchor_list.begin(); anchor_it != other_link->anchor_list.end(); anchor_it++) {
     this->anchor_list.push_back(*anchor_it);
   }
-
-  return true;
 }
 
 
@@ -281,7 +640,7 @@ bool Link::try_to_concatenate_with(Link *other_link, short strand1, short strand
 void Link::reverse()
 {
   this->anchor_list.reverse();
-  for (list<tag>::iterator p_tag = this->tags.begin(); p_tag != this->tags.end(); p_tag++) {
+  for (tag_list::iterator p_tag = this->tags.begin(); p_tag != this->tags.end(); p_tag++) {
     // from 1 to -1; from -1 to 1 and from 0 to 0
     p_tag->strand *= -1;
   }
@@ -297,11 +656,11 @@ void Link::print(ostream &out)
 //     return;
 //   }
   out << "block";
-  for (std::list<Anchor*>::iterator p_anchor_it = this->anchor_list.begin(); p_anchor_it != this->anchor_list.end(); p_anchor_it++) {
+  for (anchor_path::iterator p_anchor_it = this->anchor_list.begin(); p_anchor_it != this->anchor_list.end(); p_anchor_it++) {
     out << " - " << (*p_anchor_it)->id;
   }
   out << "  (made of " << this->tags.size() << " genomic regions)" << endl;
-  for (list<tag>::iterator p_tag = this->tags.begin(); p_tag != this->tags.end(); p_tag++) {
+  for (tag_list::iterator p_tag = this->tags.begin(); p_tag != this->tags.end(); p_tag++) {
     print_tag(*p_tag, out);
     out << endl;
   }
@@ -314,7 +673,7 @@ void Link::print(ostream &out)
  */
 void print_tag(tag this_tag, ostream &out)
 {
-  out << *this_tag.species << ":" << *this_tag.chr << ":"
+  out << *this_tag.get_species() << ":" << *this_tag.get_chr() << ":"
       << this_tag.start << ":" << this_tag.end
       << " [" << this_tag.strand << "] l=" << (this_tag.end - this_tag.start + 1);
 }
@@ -325,7 +684,11 @@ void print_tag(tag this_tag, ostream &out)
  */
 uint Link::get_shortest_region_length()
 {
-  list<tag>::iterator p_tag = this->tags.begin();
+  if (this->tags.empty()) {
+    // Link::is_bridge() may leave a link with no tags until Graph::restore_bridges()
+    return 0;
+  }
+  tag_list::iterator p_tag = this->tags.begin();
   uint shortest_region_length = p_tag->end - p_tag->start + 1;
   for (p_tag++; p_tag != this->tags.end(); p_tag++) {
     uint length = p_tag->end - p_tag->start + 1;
@@ -342,7 +705,11 @@ uint Link::get_shortest_region_length()
  */
 uint Link::get_longest_region_length()
 {
-  list<tag>::iterator p_tag = this->tags.begin();
+  if (this->tags.empty()) {
+    // Link::is_bridge() may leave a link with no tags until Graph::restore_bridges()
+    return 0;
+  }
+  tag_list::iterator p_tag = this->tags.begin();
   uint longest_region_length = p_tag->end - p_tag->start + 1;
   for (p_tag++; p_tag != this->tags.end(); p_tag++) {
     uint length = p_tag->end - p_tag->start + 1;
@@ -363,8 +730,8 @@ Link* Link::merge(Link* other_link)
       this->anchor_list.back() == other_link->anchor_list.front()) {
     other_link->reverse();
   }
-  list<Anchor*>::iterator p_anchor_1 = this->anchor_list.begin();
-  list<Anchor*>::iterator p_anchor_2 = other_link->anchor_list.begin();
+  anchor_path::iterator p_anchor_1 = this->anchor_list.begin();
+  anchor_path::iterator p_anchor_2 = other_link->anchor_list.begin();
 //   cout << "Merging:" <<endl;
 //   this->print();
 //   other_link->print();
@@ -378,7 +745,7 @@ Link* Link::merge(Link* other_link)
     } else {
       int dist = 1;
       bool match = false;
-      list<Anchor*>::iterator p_this_anchor = p_anchor_1;
+      anchor_path::iterator p_this_anchor = p_anchor_1;
       p_this_anchor++;
       while (p_this_anchor != this->anchor_list.end()) {
         if (*p_this_anchor == *p_anchor_2) {
@@ -416,6 +783,14 @@ Link* Link::merge(Link* other_link)
     }
   }
   this->tags.splice(this->tags.end(), other_link->tags);
+  sequence_hash += other_link->sequence_hash;
+  sequence_mask |= other_link->sequence_mask;
+  if (other_link->min_start < min_start) {
+    min_start = other_link->min_start;
+  }
+  if (other_link->max_end > max_end) {
+    max_end = other_link->max_end;
+  }
   // other_link must be delete as the 
   delete(other_link);
 
@@ -450,8 +825,8 @@ uint Link::get_num_of_mismatches(Link* other_link)
       this->anchor_list.back() == other_link->anchor_list.front()) {
     other_link->reverse();
   }
-  list<Anchor*>::iterator p_anchor_1 = this->anchor_list.begin();
-  list<Anchor*>::iterator p_anchor_2 = other_link->anchor_list.begin();
+  anchor_path::iterator p_anchor_1 = this->anchor_list.begin();
+  anchor_path::iterator p_anchor_2 = other_link->anchor_list.begin();
 
   while (p_anchor_1 != this->anchor_list.end() and p_anchor_2 != other_link->anchor_list.end()) {
     if (*p_anchor_1 == *p_anchor_2) {
@@ -460,7 +835,7 @@ uint Link::get_num_of_mismatches(Link* other_link)
     } else {
       int dist = 1;
       bool match = false;
-      list<Anchor*>::iterator p_this_anchor = p_anchor_1;
+      anchor_path::iterator p_this_anchor = p_anchor_1;
       p_this_anchor++;
       while (p_this_anchor != this->anchor_list.end()) {
         if (*p_this_anchor == *p_anchor_2) {
@@ -515,11 +890,12 @@ Link* Link::split(vector<bool> tags_to_split)
 
   Link* new_link = new Link(this);
 
-  std::list<tag>::iterator p_tag_it = this->tags.begin();
-  list<tag> tmp_tags;
+  tag_list::iterator p_tag_it = this->tags.begin();
+  tag_list tmp_tags;
   for (uint i=0; i < tags_to_split.size(); i++) {
     if (tags_to_split[i]) {
       new_link->tags.push_back(*p_tag_it);
+      new_link->add_to_signature(*p_tag_it);
     } else {
       tmp_tags.push_back(*p_tag_it);
     }
@@ -531,6 +907,7 @@ Link* Link::split(vector<bool> tags_to_split)
     exit(1);
   }
   this->tags = tmp_tags;
+  update_signature();
   new_link->anchor_list.front()->add_Link(new_link);
   if (new_link->anchor_list.front() != new_link->anchor_list.back()) {
     new_link->anchor_list.back()->add_Link(new_link);
@@ -541,19 +918,20 @@ Link* Link::split(vector<bool> tags_to_split)
 
 
 /*!
-    \fn Link::split(std::vector< std::list<tag>::iterator > tags_to_split)
+    \fn Link::split(std::vector< tag_list::iterator > tags_to_split)
  */
-Link* Link::split(std::vector< std::list<tag>::iterator > tags_to_split)
+Link* Link::split(std::vector< tag_list::iterator > tags_to_split)
 {
   Link* new_link = new Link(this);
 
-  std::list<tag>::iterator p_tag_it = this->tags.begin();
-  list<tag> tmp_tags;
+  tag_list::iterator p_tag_it = this->tags.begin();
+  tag_list tmp_tags;
   for (uint i=0; i < this->tags.size(); i++) {
     bool tag_found = false;
     for (uint j=0; j < tags_to_split.size(); j++) {
       if (p_tag_it == tags_to_split[j]) {
         new_link->tags.push_back(*p_tag_it);
+        new_link->add_to_signature(*p_tag_it);
         tag_found = true;
         break;
       }
@@ -573,6 +951,7 @@ Link* Link::split(std::vector< std::list<tag>::iterator > tags_to_split)
     exit(1);
   }
   this->tags = tmp_tags;
+  update_signature();
   new_link->anchor_list.front()->add_Link(new_link);
   if (new_link->anchor_list.front() != new_link->anchor_list.back()) {
     new_link->anchor_list.back()->add_Link(new_link);
@@ -634,7 +1013,7 @@ bool Link::is_bridge(uint min_anchors, uint min_regions, uint min_length, bool t
     return false;
   }
 
-  list<tag> tags = this->tags;
+  tag_list tags = this->tags;
 
   Anchor *front_anchor = this->anchor_list.front();
   Anchor *back_anchor = this->anchor_list.back();
@@ -646,7 +1025,7 @@ bool Link::is_bridge(uint min_anchors, uint min_regions, uint min_length, bool t
   Link *front_link = NULL;
   Link *back_link = NULL;
   std::list<Link*> links_from_front_anchor = front_anchor->links;
-  std::vector< std::list<tag>::iterator > front_tag_links_to_this;
+  std::vector< tag_list::iterator > front_tag_links_to_this;
   for (std::list<Link*>::iterator l_it = links_from_front_anchor.begin(); l_it != links_from_front_anchor.end(); l_it++) {
     Link *other_link = *l_it;
     if (other_link == this or !other_link->is_valid(min_anchors, min_regions, min_length)) {
@@ -683,7 +1062,7 @@ bool Link::is_bridge(uint min_anchors, uint min_regions, uint min_length, bool t
 
 
   std::list<Link*> links_from_back_anchor = back_anchor->links;
-  std::vector< std::list<tag>::iterator > back_tag_links_to_this;
+  std::vector< tag_list::iterator > back_tag_links_to_this;
   for (std::list<Link*>::iterator l_it = links_from_back_anchor.begin(); l_it != links_from_back_anchor.end(); l_it++) {
     Link *other_link = *l_it;
     if (other_link == this or !other_link->is_valid(min_anchors, min_regions, min_length)) {
@@ -718,7 +1097,7 @@ bool Link::is_bridge(uint min_anchors, uint min_regions, uint min_length, bool t
   /* Print resulting link (beside the other ones) */
   if (front_link and back_link) {
     if (trim_link) {
-      std::list<tag>::iterator p_front_tag_it = front_link->tags.begin();
+      tag_list::iterator p_front_tag_it = front_link->tags.begin();
       for (uint i=0; i< front_tag_links_to_this.size(); i++) {
 //         if (debug) {
 //           cout << setw(2) << i+1 << " : ";
@@ -753,7 +1132,7 @@ bool Link::is_bridge(uint min_anchors, uint min_regions, uint min_length, bool t
 //       if (debug) {
 //         cout << endl;
 //       }
-      std::list<tag>::iterator p_back_tag_it = back_link->tags.begin();
+      tag_list::iterator p_back_tag_it = back_link->tags.begin();
       for (uint i=0; i< back_tag_links_to_this.size(); i++) {
 //         if (debug) {
 //           cout << setw(2) << i+1 << " : ";
@@ -801,7 +1180,7 @@ bool Link::is_bridge(uint min_anchors, uint min_regions, uint min_length, bool t
       bool empty_tag = false;
       do {
         empty_tag = false;
-        for (std::list<tag>::iterator p_this_tag_it = this->tags.begin();
+        for (tag_list::iterator p_this_tag_it = this->tags.begin();
             p_this_tag_it != this->tags.end(); p_this_tag_it++) {
           if (p_this_tag_it->start > p_this_tag_it->end) {
             empty_tag = true;
@@ -812,6 +1191,7 @@ bool Link::is_bridge(uint min_anchors, uint min_regions, uint min_length, bool t
           }
         }
       } while (empty_tag);
+      update_signature();
       if (this->tags.size() < 2) {
         return false;
       }
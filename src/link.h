@@ -5,9 +5,13 @@
 	@author Javier Herrero <jherrero@ebi.ac.uk>
 */
 
+#include <iostream>
 #include <string>
 #include <list>
 #include <vector>
+#include <set>
+#include <stdint.h>
+#include "spill.h"
 
 using namespace std;
 
@@ -15,16 +19,30 @@ typedef class Anchor Anchor;
 
 //! A tag in a Link represents a genomic region which goes through the path of the Link
 
+/*!
+    The species and chromosome of the tag are stored as the index of the pair in a table shared by
+    all the tags (see get_tag_sequence) and packed with the strand, so a tag takes 12 bytes. Two
+    tags are on the same chromosome if they have the same sequence.
+ */
 struct tag {
-  string *species;
-  string *chr;
   uint start;
   uint end;
-  short strand; // 1 when tag start => end corresponds to anchor_list.front() => anchor_list.back()
-                // and -1 when start => end corresponds to anchor_list.back() => anchor_list.front()
+  uint sequence : 30; //!< index of the species and chromosome (see get_tag_sequence)
+  int strand : 2; // 1 when tag start => end corresponds to anchor_list.front() => anchor_list.back()
+                  // and -1 when start => end corresponds to anchor_list.back() => anchor_list.front()
+
+  string *get_species(void) const;
+  string *get_chr(void) const;
 };
+
+//! Returns the index of this species and chromosome for tag::sequence. It is added to the table if needed
+uint get_tag_sequence(string *species, string *chr);
     void print_tag(tag this_tag, ostream &out = cout);
 
+//! The tags of a Link and its path of Anchors can be moved out of memory (see open_spill_file)
+typedef std::list<tag, spill_allocator<tag> > tag_list;
+typedef std::list<Anchor*, spill_allocator<Anchor*> > anchor_path;
+
 //! A Link defines an edge in the Enredo graph
 
 class Link{
@@ -33,6 +51,9 @@ public:
   Link(Link *my_link);
 
     ~Link();
+    //! Links are taken from the same chunks as their tags and paths (see spill_allocator)
+    static void* operator new(size_t size) { return spill_allocate(size); }
+    static void operator delete(void *pointer, size_t size) { spill_deallocate(pointer, size); }
     void add_tag(string *species, string *chr, int start, int end, short strand);
     Link* merge(Link* other_link);
     bool try_to_concatenate_with(Link *other_link, short strand1 = 0, short strand2 = 0);
@@ -42,17 +63,59 @@ public:
     uint get_longest_region_length();
     bool is_an_alternative_path_of(Link* other_link);
     uint get_num_of_mismatches(Link* other_link);
-    std::vector< std::list<tag>::iterator > get_matching_tags(Link *other_link, short strand1 = 0, short strand2 = 0,
+    std::vector< tag_list::iterator > get_matching_tags(Link *other_link, short strand1 = 0, short strand2 = 0,
                                                              bool allow_partial_match = false);
     Link* split(vector<bool> tags_to_split);
-    Link* split(std::vector< std::list<tag>::iterator > tags_to_split);
+    Link* split(std::vector< tag_list::iterator > tags_to_split);
     short get_strand_for_matching_tags(Anchor* anchor);
     bool is_valid(uint min_anchors, uint min_regions, uint min_length);
     bool is_bridge(uint min_anchors, uint min_regions, uint min_length, bool trim_link = true);
+    //! Returns false if the tags of this link and the other one cannot all match one to one
+    bool may_concatenate_with(Link *other_link);
+    //! Returns false if the tags of the other link cannot all match different tags of this one
+    bool may_contain_tags_of(Link *other_link);
+    //! Computes the signature again after changing the tags (add_tag() updates it on its own)
+    void update_signature(void);
+
+    anchor_path anchor_list;
+
+    tag_list tags; //!< list of \link tag tags \endlink
+    unsigned long long serial; //!< order of creation of the Link (see link_order)
+
+  protected:
+    void concatenate_with(Link *other_link, short strand1, short strand2,
+        std::vector< tag_list::iterator > &this_tag_links_to);
+    void add_to_signature(const tag &this_tag);
+    void clear_signature(void);
 
-    list<Anchor*> anchor_list;
+    // Signature of the tags, to tell in O(1) that two links cannot match (see may_concatenate_with)
+    uint64_t sequence_hash; //!< sum of a hash of the sequence of each tag: the same for the same tags per sequence
+    uint64_t sequence_mask; //!< one bit per sequence of the tags, taken from its hash
+    uint min_start; //!< no tag starts before; it may be lower than needed, but never higher
+    uint max_end; //!< no tag ends after; it may be higher than needed, but never lower
 
-    list<tag> tags; //!< list of \link tag tags \endlink
 };
 
+//! Returns the serial number the next Link will get
+unsigned long long get_next_link_serial(void);
+//! Sets the serial number of the next Link, when the Links are read back from a file
+void set_next_link_serial(unsigned long long serial);
+
+//! Sorts the Links in order of creation
+
+/*!
+    The passes go through the Links in this order, so the result does not depend on where they are
+    in memory: a Graph read back from a file gives the same result as the original one.
+ */
+struct link_order {
+  bool operator()(const Link *link1, const Link *link2) const {
+    if (link1->serial != link2->serial) {
+      return link1->serial < link2->serial;
+    }
+    return link1 < link2;
+  }
+};
+
+typedef std::set<Link*, link_order> link_set;
+
 #endif
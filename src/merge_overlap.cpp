@@ -8,24 +8,20 @@
 #include <fstream>
 #include <sstream>
 #include <cstdlib>
-#include <map>
+#include "overlap.h"
+#include "threads.h"
 
 using namespace std;
 
-bool read_file(char *filename, float min_score);
-bool print_file(char *input_filename, char *output_filename, float min_score);
 void print_help(void);
 
-// Global variable
-std::map<std::string, std::string* > anchors;
-
 int main(int argc, char *argv[])
 {
   char *filename = NULL;
   char *output_filename = NULL;
   float min_score = 0.0f;
+  uint num_threads = 0;
   bool help = false;
-  bool ret;
   string this_arg;
 
   for (int a = 1; a < argc; a++) {
@@ -36,6 +32,9 @@ int main(int argc, char *argv[])
     } else if ((this_arg == "--min-score") and (a < argc - 1)) {
       a++;
       min_score = atof(argv[a]);
+    } else if ((this_arg == "--threads") and (a < argc - 1)) {
+      a++;
+      num_threads = atoi(argv[a]);
     } else if ((this_arg == "--help") or (this_arg == "-h")) {
       help = true;
     } else if (!filename) {
@@ -50,229 +49,35 @@ int main(int argc, char *argv[])
     exit(0);
   }
 
-  ret = read_file(filename, min_score);
-  ret = print_file(filename, output_filename, min_score);
-
-  return EXIT_SUCCESS;
-}
-
-bool read_file(char *filename, float min_score)
-{
-  ifstream inputfile (filename);
-  string line;
-  if (!inputfile.is_open()) {
-    cerr << "Cannot open file " << filename << endl;
-    return false;
-  }
-
-  unsigned long long int line_counter = 0;
-  string last_anchor_id = "";
-  string last_species = "";
-  string last_chr = "";
-  int last_start = 0;
-  int last_end = 0;
-  string last_strand = "";
-
-  while (!inputfile.eof()) {
-    getline(inputfile, line);
-    if (line[0] == '#' or inputfile.eof()) {
-      continue;
-    }
-    string this_anchor_id;
-    string this_species;
-    string this_chr;
-    int this_start;
-    int this_end;
-    string this_strand;
-    float this_score;
-
-    stringstream streamline;
-    streamline << line;
-    streamline
-        >> this_anchor_id >> this_species >> this_chr
-        >> this_start >> this_end >> this_strand >> this_score;
-    if (streamline.fail()) {
-      cerr << "Error reading line (" << line_counter << ")<" << line << ">" << endl;
-      inputfile.close();
-      return false;
-    }
-    if (this_start > this_end) {
-      cerr << "start cannot be larger than end in <" << line << ">" << endl;
-      inputfile.close();
-      return false;
-    }
-    if (this_strand != "+" and this_strand != "-") {
-      cerr << "strand must be + or - in <" << line << ">" << endl;
-      inputfile.close();
-      return false;
-    }
-    if (this_score < min_score) {
-      continue;
-    }
-
-    if (
-        last_species == this_species and
-        last_chr == this_chr and
-        this_start <= last_end) {
-      // These two anchors overlap
-      cerr << this_anchor_id << " overlaps with " << last_anchor_id << ": ";
-      if (!anchors[this_anchor_id] and !anchors[last_anchor_id]) {
-        cerr << "new link " << this_anchor_id << " => " << last_anchor_id << endl;
-        anchors[this_anchor_id] = new string(last_anchor_id);
-      } else if (!anchors[this_anchor_id] and anchors[last_anchor_id]) {
-        if (*anchors[last_anchor_id] != this_anchor_id) {
-          cerr << "set " << this_anchor_id << " to " << *anchors[last_anchor_id] << endl;
-          anchors[this_anchor_id] = anchors[last_anchor_id];
-        } else {
-          cerr << "(already existing)" << endl;
-        }
-      } else if (anchors[this_anchor_id] and !anchors[last_anchor_id]) {
-        if (*anchors[this_anchor_id] != last_anchor_id) {
-          cerr << "set " << last_anchor_id << " to " << *anchors[this_anchor_id] << endl;
-          anchors[last_anchor_id] = anchors[this_anchor_id];
-        } else {
-          cerr << "(already existing)" << endl;
-        }
-      } else if (anchors[this_anchor_id] and anchors[last_anchor_id]) {
-        if (*anchors[this_anchor_id] != *anchors[last_anchor_id]) {
-          cerr << "both link to different anchors (" << *anchors[this_anchor_id] << " and " << *anchors[last_anchor_id] << "); set all to " << *anchors[this_anchor_id] << endl;
-          string former_merged_id = *anchors[last_anchor_id];
-          anchors[former_merged_id] = anchors[this_anchor_id];
-          for (std::map<std::string, std::string*>::iterator it = anchors.begin(); it != anchors.end(); it++) {
-            if (it->second and (*(it->second) == former_merged_id)) {
-              it->second = anchors[this_anchor_id];
-            }
-          }
-        } else {
-          cerr << "both link to " << *anchors[this_anchor_id] << endl;
-        }
-      }
-
-    }
-
-    // Set last_* variables to current ones before next loop
-    last_anchor_id = this_anchor_id;
-    last_species = this_species;
-    last_chr = this_chr;
-    last_start = this_start;
-    last_end = this_end;
-    last_strand = this_strand;
-
-    line_counter++;
-//     if (!(line_counter % 10000)) {
-//       cerr << "Line " << line_counter << endl;
-//     }
-  }
-  inputfile.close();
-  return true;
-}
-
-bool print_file(char *input_filename, char *output_filename, float min_score) {
-  ifstream inputfile (input_filename);
+  set_num_threads(num_threads);
+  MergedHitReader reader(min_score);
   ofstream outputfile;
-  ostream *out;
   if (output_filename) {
     outputfile.open(output_filename);
     if (!outputfile.is_open()) {
       cerr << "Cannot open file " << output_filename << endl;
-      return false;
+      exit(1);
     }
-    out = &outputfile;
+    reader.output = &outputfile;
   } else {
-    out = &cout;
+    reader.output = &cout;
   }
-  string line;
-  if (!inputfile.is_open()) {
-    cerr << "Cannot open file " << output_filename << endl;
-    return false;
-  }
-
-  unsigned long long int line_counter = 0;
-  string last_anchor_id = "";
-  string last_species = "";
-  string last_chr = "";
-  int last_start = 0;
-  int last_end = 0;
-  string last_strand = "+";
-  float last_score = 0.0f;
-  while (!inputfile.eof()) {
-    getline(inputfile, line);
-    if (inputfile.eof()) {
-      if (anchors[last_anchor_id]) {
-        *out << *anchors[last_anchor_id] << "\t" << last_species << "\t"
-            << last_chr << "\t" << last_start << "\t" << last_end << "\t"
-            << last_strand << "\t" << last_score << endl;
-      } else if (last_anchor_id != "") {
-        *out << last_anchor_id << "\t" << last_species << "\t"
-            << last_chr << "\t" << last_start << "\t" << last_end << "\t"
-            << last_strand << "\t" << last_score << endl;
-      }
-      break;
-    }
-    if (line[0] == '#') {
-      *out << line << endl;
-      continue;
-    }
-    string this_anchor_id;
-    string this_species;
-    string this_chr;
-    int this_start;
-    int this_end;
-    string this_strand;
-    float this_score;
+  reader.log = &cerr;
 
-    stringstream streamline;
-    streamline << line;
-    streamline
-        >> this_anchor_id >> this_species >> this_chr
-        >> this_start >> this_end >> this_strand >> this_score;
-    if (streamline.fail()) {
-      cerr << "Error reading line (" << line_counter << ")<" << line << ">" << endl;
-      inputfile.close();
-      return false;
-    }
-    if (this_score < min_score) {
-      *out << "#LOW_SCORE:" << line << endl;
-      continue;
-    }
-    if (
-        last_species == this_species and
-        last_chr == this_chr and
-        this_start <= last_end) {
-      if (this_end > last_end) {
-        last_end = this_end;
-      }
-      if (this_score > last_score) {
-        last_score = this_score;
-      }
-    } else {
-      if (anchors[last_anchor_id]) {
-        *out << *anchors[last_anchor_id] << "\t" << last_species << "\t"
-            << last_chr << "\t" << last_start << "\t" << last_end << "\t"
-            << last_strand << "\t" << last_score << endl;
-      } else if (last_anchor_id != "") {
-        *out << last_anchor_id << "\t" << last_species << "\t"
-            << last_chr << "\t" << last_start << "\t" << last_end << "\t"
-            << last_strand << "\t" << last_score << endl;
-      }
-
-      // Set last_* variables to current ones before next loop
-      last_anchor_id = this_anchor_id;
-      last_species = this_species;
-      last_chr = this_chr;
-      last_start = this_start;
-      last_end = this_end;
-      last_strand = this_strand;
-      last_score = this_score;
-    }
-
-    line_counter++;
+  if (!reader.open(filename)) {
+    exit(1);
   }
-  inputfile.close();
+  hit this_hit;
+  while (reader.next_hit(this_hit));
+  reader.close();
   if (output_filename) {
     outputfile.close();
   }
-  return true;
+  if (reader.error) {
+    exit(1);
+  }
+
+  return EXIT_SUCCESS;
 }
 
 void print_help(void)
@@ -280,9 +85,12 @@ void print_help(void)
   cout << "MergeOverlap v" << VERSION << endl;
   cout << endl;
   cout << "Usage: mergeoverlap [options] anchors_file.txt" << endl;
+  cout << "       (gzip and bgzip files are accepted, use - to read from STDIN)" << endl;
   cout << endl;
   cout << "Options:" << endl;
   cout << " --min-score: minimum score required to accept a hit" << endl;
+  cout << " --output: write output to that file (def: STDOUT)" << endl;
+  cout << " --threads: number of threads (def: 0, one per core)" << endl;
   cout << endl;
   cout << " --help: prints this help" << endl;
   cout << endl;
@@ -0,0 +1,194 @@
+#include "overlap.h"
+#include <set>
+
+using namespace std;
+
+MergedHitReader::MergedHitReader(float min_score)
+{
+  this->min_score = min_score;
+  output = NULL;
+  log = NULL;
+  last_hit_is_set = false;
+  last_hit_path_break = false;
+}
+
+
+MergedHitReader::~MergedHitReader()
+{
+  set<string*> all_ids;
+  for (map<string, string*>::iterator it = merged_ids.begin(); it != merged_ids.end(); it++) {
+    if (it->second) {
+      all_ids.insert(it->second);
+    }
+  }
+  for (set<string*>::iterator it = all_ids.begin(); it != all_ids.end(); it++) {
+    delete(*it);
+  }
+}
+
+
+/*!
+    \fn MergedHitReader::open(char *filename)
+ */
+bool MergedHitReader::open(char *filename)
+{
+  // STDIN cannot be read twice: keep a copy of it
+  inputfile.spool = true;
+  if (!HitReader::open(filename)) {
+    return false;
+  }
+  if (!find_overlapping_anchors()) {
+    return false;
+  }
+  last_hit_is_set = false;
+  last_hit_path_break = false;
+  comments = output;
+  return HitReader::rewind();
+}
+
+
+/*!
+    \fn MergedHitReader::find_overlapping_anchors()
+    First pass on the file: every time two consecutive hits overlap, their Anchors are set to be
+    the same one. If any of these Anchors had already been merged with another one, all of them
+    are merged together.
+ */
+bool MergedHitReader::find_overlapping_anchors()
+{
+  hit this_hit;
+  string last_anchor_id = "";
+  string last_species = "";
+  string last_chr = "";
+  int last_end = 0;
+  comments = NULL;
+  while (HitReader::next_hit(this_hit)) {
+    if (path_break) {
+      last_species = "";
+    }
+    if (this_hit.score < min_score) {
+      continue;
+    }
+    string &this_anchor_id = this_hit.anchor_id;
+
+    if (
+        last_species == this_hit.species and
+        last_chr == this_hit.chr and
+        this_hit.start <= last_end) {
+      // These two anchors overlap
+      if (log) *log << this_anchor_id << " overlaps with " << last_anchor_id << ": ";
+      if (!merged_ids[this_anchor_id] and !merged_ids[last_anchor_id]) {
+        if (log) *log << "new link " << this_anchor_id << " => " << last_anchor_id << endl;
+        merged_ids[this_anchor_id] = new string(last_anchor_id);
+      } else if (!merged_ids[this_anchor_id] and merged_ids[last_anchor_id]) {
+        if (*merged_ids[last_anchor_id] != this_anchor_id) {
+          if (log) *log << "set " << this_anchor_id << " to " << *merged_ids[last_anchor_id] << endl;
+          merged_ids[this_anchor_id] = merged_ids[last_anchor_id];
+        } else {
+          if (log) *log << "(already existing)" << endl;
+        }
+      } else if (merged_ids[this_anchor_id] and !merged_ids[last_anchor_id]) {
+        if (*merged_ids[this_anchor_id] != last_anchor_id) {
+          if (log) *log << "set " << last_anchor_id << " to " << *merged_ids[this_anchor_id] << endl;
+          merged_ids[last_anchor_id] = merged_ids[this_anchor_id];
+        } else {
+          if (log) *log << "(already existing)" << endl;
+        }
+      } else if (merged_ids[this_anchor_id] and merged_ids[last_anchor_id]) {
+        if (*merged_ids[this_anchor_id] != *merged_ids[last_anchor_id]) {
+          if (log) *log << "both link to different anchors (" << *merged_ids[this_anchor_id] << " and "
+              << *merged_ids[last_anchor_id] << "); set all to " << *merged_ids[this_anchor_id] << endl;
+          string former_merged_id = *merged_ids[last_anchor_id];
+          merged_ids[former_merged_id] = merged_ids[this_anchor_id];
+          for (map<string, string*>::iterator it = merged_ids.begin(); it != merged_ids.end(); it++) {
+            if (it->second and (*(it->second) == former_merged_id)) {
+              it->second = merged_ids[this_anchor_id];
+            }
+          }
+        } else {
+          if (log) *log << "both link to " << *merged_ids[this_anchor_id] << endl;
+        }
+      }
+
+    }
+
+    // Set last_* variables to current ones before next loop
+    last_anchor_id = this_anchor_id;
+    last_species = this_hit.species;
+    last_chr = this_hit.chr;
+    last_end = this_hit.end;
+  }
+
+  return !error;
+}
+
+
+/*!
+    \fn MergedHitReader::next_hit(hit &this_hit)
+    Overlapping hits are merged into the first one, which is only returned once the next
+    non-overlapping hit has been read.
+ */
+bool MergedHitReader::next_hit(hit &this_hit)
+{
+  hit new_hit;
+  while (HitReader::next_hit(new_hit)) {
+    bool new_hit_path_break = path_break;
+    if (new_hit.score < min_score) {
+      if (output) *output << "#LOW_SCORE:" << line << endl;
+      last_hit_path_break = last_hit_path_break or new_hit_path_break;
+      continue;
+    }
+    if (last_hit_is_set and !new_hit_path_break and
+        last_hit.species == new_hit.species and
+        last_hit.chr == new_hit.chr and
+        new_hit.start <= last_hit.end) {
+      if (new_hit.end > last_hit.end) {
+        last_hit.end = new_hit.end;
+      }
+      if (new_hit.score > last_hit.score) {
+        last_hit.score = new_hit.score;
+      }
+      continue;
+    }
+    if (last_hit_is_set) {
+      this_hit = last_hit;
+      path_break = last_hit_path_break;
+      set_merged_id(this_hit);
+      last_hit = new_hit;
+      last_hit_path_break = new_hit_path_break;
+      return true;
+    }
+    last_hit = new_hit;
+    last_hit_is_set = true;
+    last_hit_path_break = new_hit_path_break;
+  }
+  if (error or !last_hit_is_set) {
+    return false;
+  }
+
+  // Return the last hit of the file
+  this_hit = last_hit;
+  path_break = last_hit_path_break;
+  set_merged_id(this_hit);
+  last_hit_is_set = false;
+  return true;
+}
+
+
+/*!
+    \fn MergedHitReader::set_merged_id(hit &this_hit)
+    Renames the Anchor of this hit if it has been merged with another one and writes the hit
+    to the output stream if any.
+ */
+void MergedHitReader::set_merged_id(hit &this_hit)
+{
+  map<string, string*>::iterator it = merged_ids.find(this_hit.anchor_id);
+  if (it != merged_ids.end() and it->second) {
+    this_hit.anchor_id = *it->second;
+  }
+  if (output) {
+    if (path_break) {
+      *output << "--" << endl;
+    }
+    print_hit(this_hit, *output);
+  }
+}
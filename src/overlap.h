@@ -0,0 +1,41 @@
+#ifndef OVERLAP_H
+#define OVERLAP_H
+
+#include <iostream>
+#include <string>
+#include <map>
+#include "reader.h"
+
+//! Reads an anchors file merging the overlapping hits (see mergeoverlap)
+
+/*!
+    Two consecutive hits overlapping on the same chromosome are merged into one single hit, and
+    their Anchors are considered to be the same one from then on. This requires reading the file
+    twice: a first time to find out which Anchors must be merged and a second one to return the
+    merged hits.
+ */
+class MergedHitReader : public HitReader{
+public:
+    MergedHitReader(float min_score = 0.0f);
+
+    ~MergedHitReader();
+    //! Finds out which Anchors overlap and opens the file again for reading the merged hits
+    bool open(char *filename);
+    //! Reads the next merged hit
+    bool next_hit(hit &this_hit);
+
+    std::ostream *output; //!< if set, the merged anchors file is written to this stream
+    std::ostream *log; //!< if set, the Anchors being merged are reported to this stream
+
+  protected:
+    bool find_overlapping_anchors();
+    void set_merged_id(hit &this_hit);
+
+    float min_score;
+    std::map<std::string, std::string*> merged_ids; //!< new id for each one of the merged Anchors
+    hit last_hit;
+    bool last_hit_is_set;
+    bool last_hit_path_break;
+};
+
+#endif
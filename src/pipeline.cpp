@@ -0,0 +1,541 @@
+#include "pipeline.h"
+#include "spill.h"
+#include <cstdlib>
+#include <sstream>
+#include <sys/time.h>
+
+using namespace std;
+
+//! Returns the current time in seconds
+
+static double get_time(void)
+{
+  struct timeval now;
+  gettimeofday(&now, NULL);
+
+  return now.tv_sec + now.tv_usec / 1000000.0;
+}
+
+
+Pipeline::Pipeline()
+{
+  skip_idle_minimize = true;
+  max_time = 0;
+  max_pass_time = 0;
+  max_iterations = 0;
+  max_total_iterations = 0;
+  last_changes = -1;
+  needs_minimize = true;
+  start_time = 0;
+  total_iterations = 0;
+  stopped = false;
+  interrupt_flag = NULL;
+  interrupted = false;
+  depth = 0;
+  resuming = false;
+}
+
+
+Pipeline::~Pipeline()
+{
+}
+
+
+/*!
+    \fn Pipeline::parse(string spec)
+ */
+bool Pipeline::parse(string spec)
+{
+  size_t pos = 0;
+  passes.clear();
+  if (!parse_passes(spec, pos, passes, false)) {
+    passes.clear();
+    return false;
+  }
+
+  return true;
+}
+
+
+/*!
+    \fn Pipeline::parse_passes(string &spec, size_t &pos, vector<pipeline_pass> &these_passes, bool nested)
+    Reads passes until the end of the spec or, if nested, until the closing bracket of the loop
+ */
+bool Pipeline::parse_passes(string &spec, size_t &pos, vector<pipeline_pass> &these_passes, bool nested)
+{
+  while (true) {
+    pos = spec.find_first_not_of(" \t\n,", pos);
+    if (pos == string::npos) {
+      pos = spec.size();
+      if (nested) {
+        cerr << "Wrong pipeline: missing ')'" << endl;
+        return false;
+      }
+      return true;
+    }
+    if (spec[pos] == ')') {
+      if (!nested) {
+        cerr << "Wrong pipeline: unexpected ')'" << endl;
+        return false;
+      }
+      pos++;
+      return true;
+    }
+
+    pipeline_pass pass;
+    size_t end = spec.find_first_not_of("abcdefghijklmnopqrstuvwxyz_", pos);
+    if (end == string::npos) {
+      end = spec.size();
+    }
+    pass.name = spec.substr(pos, end - pos);
+    pos = end;
+    if (pass.name.empty()) {
+      cerr << "Wrong pipeline: unexpected '" << spec[pos] << "'" << endl;
+      return false;
+    }
+    if (pos < spec.size() and spec[pos] == '(') {
+      pos++;
+      if (pass.name == "repeat") {
+        if (!parse_passes(spec, pos, pass.body, true)) {
+          return false;
+        }
+      } else {
+        end = spec.find(')', pos);
+        if (end == string::npos) {
+          cerr << "Wrong pipeline: missing ')' after " << pass.name << endl;
+          return false;
+        }
+        size_t arg_start = spec.find_first_not_of(" \t", pos);
+        size_t arg_end = spec.find_last_not_of(" \t", end - 1);
+        if (arg_start < end and arg_end != string::npos and arg_end >= arg_start) {
+          pass.arg = spec.substr(arg_start, arg_end - arg_start + 1);
+        }
+        pos = end + 1;
+      }
+    }
+    if (!check_pass(pass)) {
+      return false;
+    }
+    these_passes.push_back(pass);
+  }
+}
+
+
+/*!
+    \fn Pipeline::check_pass(pipeline_pass &pass)
+ */
+bool Pipeline::check_pass(pipeline_pass &pass)
+{
+  bool numeric_arg = (pass.arg.find_first_not_of("0123456789") == string::npos);
+  if (pass.name == "repeat") {
+    if (pass.body.empty()) {
+      cerr << "Wrong pipeline: empty repeat()" << endl;
+      return false;
+    }
+    return true;
+  } else if (pass.name == "stats") {
+    return true;
+  } else if (pass.name == "merge") {
+    if (pass.arg.empty() or !numeric_arg) {
+      cerr << "Wrong pipeline: merge needs the maximum number of different anchors, like merge(2)" << endl;
+      return false;
+    }
+    return true;
+  } else if (pass.name == "simplify" or pass.name == "simplify_aggressive" or pass.name == "assimilate") {
+    if (!numeric_arg) {
+      cerr << "Wrong pipeline: wrong number in " << pass.name << "(" << pass.arg << ")" << endl;
+      return false;
+    }
+    return true;
+  } else if (pass.name == "minimize" or pass.name == "split_unselected" or pass.name == "resolve_palindromes" or
+      pass.name == "split_unbalanced" or pass.name == "compact") {
+    if (!pass.arg.empty()) {
+      cerr << "Wrong pipeline: " << pass.name << " takes no argument" << endl;
+      return false;
+    }
+    return true;
+  }
+  cerr << "Wrong pipeline: unknown pass " << pass.name << endl;
+
+  return false;
+}
+
+
+/*!
+    \fn Pipeline::get_spec()
+ */
+string Pipeline::get_spec(void)
+{
+  return get_spec(passes);
+}
+
+
+/*!
+    \fn Pipeline::get_spec(vector<pipeline_pass> &these_passes)
+ */
+string Pipeline::get_spec(vector<pipeline_pass> &these_passes)
+{
+  string spec = "";
+  for (uint a = 0; a < these_passes.size(); a++) {
+    if (a > 0) {
+      spec += " ";
+    }
+    spec += these_passes[a].name;
+    if (these_passes[a].name == "repeat") {
+      spec += "(" + get_spec(these_passes[a].body) + ")";
+    } else if (!these_passes[a].arg.empty()) {
+      spec += "(" + these_passes[a].arg + ")";
+    }
+  }
+
+  return spec;
+}
+
+
+/*!
+    \fn Pipeline::run(Enredo &enredo, ostream &log)
+ */
+void Pipeline::run(Enredo &enredo, ostream &log)
+{
+  if (resuming) {
+    // The time spent before the interruption counts for max_time (see set_state)
+    start_time = get_time() - start_time;
+    resuming = false;
+  } else {
+    last_changes = -1;
+    needs_minimize = true;
+    start_time = get_time();
+    total_iterations = 0;
+    stopped = false;
+    stop_reason = "";
+    over_time_passes.clear();
+    position.clear();
+  }
+  depth = 0;
+  interrupted = false;
+  run_passes(enredo, log, passes, false);
+  if (interrupted) {
+    return;
+  }
+  position.clear();
+
+  if (!stop_reason.empty() and needs_minimize) {
+    // Out of the budgets: the blocks found so far are only merged where possible
+    log << "Some passes have been skipped: minimizing the graph once more" << endl;
+    pipeline_pass pass;
+    pass.name = "minimize";
+    enredo_pass_stats &this_stats = get_stats(pass);
+    double pass_start_time = get_time();
+    this_stats.changes += enredo.minimize();
+    this_stats.runs++;
+    this_stats.time += get_time() - pass_start_time;
+    needs_minimize = false;
+    trim_spill_file();
+  }
+}
+
+
+/*!
+    \fn Pipeline::add_stop_reason(const string &reason, ostream &log)
+ */
+void Pipeline::add_stop_reason(const string &reason, ostream &log)
+{
+  log << "Budget of the pipeline: " << reason << endl;
+  if (!stop_reason.empty()) {
+    stop_reason += "; ";
+  }
+  stop_reason += reason;
+}
+
+
+/*!
+    \fn Pipeline::run_passes(Enredo &enredo, ostream &log, vector<pipeline_pass> &these_passes, bool is_loop)
+    Returns the total number of changes. A loop stops as soon as its first pass makes no changes.
+    When going on from an interrupted run, each level starts from its saved position, and the
+    interrupt_flag is only checked once the innermost one is reached.
+ */
+unsigned long Pipeline::run_passes(Enredo &enredo, ostream &log, vector<pipeline_pass> &these_passes, bool is_loop)
+{
+  unsigned long total_changes = 0;
+  unsigned int iterations = 0;
+  uint first_pass = 0;
+  if (depth < position.size()) {
+    first_pass = position[depth].pass;
+    iterations = position[depth].iterations;
+    total_changes = position[depth].changes;
+    if (depth + 1 == position.size()) {
+      position.clear();
+    }
+  }
+  do {
+    if (is_loop and iterations > 0 and !stopped) {
+      ostringstream reason;
+      if (max_iterations and iterations >= max_iterations) {
+        reason << "repeat(" << get_spec(these_passes) << ") stopped after " << iterations << " iterations";
+        add_stop_reason(reason.str(), log);
+        return total_changes;
+      } else if (max_total_iterations and total_iterations >= max_total_iterations) {
+        reason << "stopped after " << total_iterations << " iterations of the repeat() loops";
+        add_stop_reason(reason.str(), log);
+        stopped = true;
+      }
+    }
+    for (uint a = first_pass; a < these_passes.size(); a++) {
+      if (stopped) {
+        return total_changes;
+      }
+      if (interrupt_flag and *interrupt_flag and position.empty()) {
+        interrupted = true;
+      }
+      unsigned long changes = interrupted ? 0 : run_pass(enredo, log, these_passes[a]);
+      if (interrupted) {
+        // The levels are saved from the innermost one out, as the calls return
+        pipeline_position this_position;
+        this_position.pass = a;
+        this_position.iterations = iterations;
+        this_position.changes = total_changes;
+        position.insert(position.begin(), this_position);
+        return total_changes;
+      }
+      if (is_loop and a == 0 and changes == 0) {
+        return total_changes;
+      }
+      total_changes += changes;
+    }
+    first_pass = 0;
+    if (is_loop) {
+      iterations++;
+      total_iterations++;
+    }
+  } while (is_loop);
+
+  return total_changes;
+}
+
+
+/*!
+    \fn Pipeline::run_pass(Enredo &enredo, ostream &log, pipeline_pass &pass)
+    Returns the number of changes made by the pass. In out-of-core mode, the links beyond the
+    memory limit are dropped from memory after each pass (see trim_spill_file). A compact pass
+    does not change the blocks: it counts as no change for the loops and the next minimize.
+ */
+unsigned long Pipeline::run_pass(Enredo &enredo, ostream &log, pipeline_pass &pass)
+{
+  if (stopped) {
+    return 0;
+  } else if (max_time and get_time() - start_time >= max_time) {
+    ostringstream reason;
+    reason << "stopped after " << max_time << " s";
+    add_stop_reason(reason.str(), log);
+    stopped = true;
+    return 0;
+  }
+  if (pass.name == "repeat") {
+    depth++;
+    unsigned long changes = run_passes(enredo, log, pass.body, true);
+    depth--;
+    return changes;
+  } else if (pass.name == "stats") {
+    if (enredo.parameters.print_stats) {
+      if (!pass.arg.empty()) {
+        log << endl
+            << " Stats " << pass.arg << ":" << endl
+            << string(pass.arg.size() + 9, '=') << endl;
+      }
+      enredo.print_stats();
+    }
+    return 0;
+  } else if (pass.name == "compact") {
+    enredo_pass_stats &this_stats = get_stats(pass);
+    this_stats.runs++;
+    this_stats.changes += enredo.compact();
+    trim_spill_file();
+    return 0;
+  }
+
+  enredo_pass_stats &this_stats = get_stats(pass);
+  if (pass.name == "minimize" and skip_idle_minimize and !needs_minimize) {
+    log << "Minimizing graph... skipped (no changes)" << endl;
+    this_stats.skipped++;
+    return 0;
+  }
+  if (pass.name != "minimize" and max_pass_time and this_stats.time >= max_pass_time) {
+    if (!over_time_passes.count(this_stats.name)) {
+      ostringstream reason;
+      reason.setf(ios::fixed);
+      reason.precision(1);
+      reason << this_stats.name << " skipped after " << this_stats.time << " s";
+      add_stop_reason(reason.str(), log);
+      over_time_passes.insert(this_stats.name);
+    }
+    this_stats.skipped++;
+    last_changes = 0;
+    return 0;
+  }
+  double pass_start_time = get_time();
+  unsigned long changes = 0;
+  uint number = atoi(pass.arg.c_str());
+  if (pass.name == "minimize") {
+    changes = enredo.minimize();
+  } else if (pass.name == "merge") {
+    changes = enredo.merge_alternative_paths(number);
+  } else if (pass.name == "simplify") {
+    changes = enredo.simplify(pass.arg.empty() ? enredo.parameters.min_regions : number);
+  } else if (pass.name == "simplify_aggressive") {
+    changes = enredo.simplify_aggressive(pass.arg.empty() ? enredo.parameters.min_regions : number);
+  } else if (pass.name == "split_unselected") {
+    changes = enredo.split_unselected_links();
+  } else if (pass.name == "resolve_palindromes") {
+    changes = enredo.resolve_small_palindromes();
+  } else if (pass.name == "assimilate") {
+    changes = enredo.assimilate_small_insertions(pass.arg.empty() ? 100000 : number);
+  } else if (pass.name == "split_unbalanced") {
+    changes = enredo.split_unbalanced_links();
+  }
+  this_stats.runs++;
+  this_stats.changes += changes;
+  this_stats.time += get_time() - pass_start_time;
+  last_changes = changes;
+  if (pass.name == "minimize") {
+    needs_minimize = false;
+  } else if (changes) {
+    needs_minimize = true;
+  }
+  trim_spill_file();
+
+  return changes;
+}
+
+
+/*!
+    \fn Pipeline::get_stats(pipeline_pass &pass)
+ */
+enredo_pass_stats& Pipeline::get_stats(pipeline_pass &pass)
+{
+  string name = pass.name;
+  if (!pass.arg.empty()) {
+    name += "(" + pass.arg + ")";
+  }
+  map<string, unsigned int>::iterator it = stats_indexes.find(name);
+  if (it != stats_indexes.end()) {
+    return stats[it->second];
+  }
+  stats_indexes[name] = stats.size();
+  enredo_pass_stats this_stats;
+  this_stats.name = name;
+  this_stats.runs = 0;
+  this_stats.skipped = 0;
+  this_stats.changes = 0;
+  this_stats.time = 0;
+  stats.push_back(this_stats);
+
+  return stats.back();
+}
+
+
+/*!
+    \fn Pipeline::print_stats(ostream &out)
+ */
+void Pipeline::print_stats(ostream &out)
+{
+  ios::fmtflags current_flags = out.flags();
+  streamsize current_precision = out.precision();
+  out.setf(ios::fixed);
+  out.precision(1);
+  for (uint a = 0; a < stats.size(); a++) {
+    out << stats[a].name << ": " << stats[a].runs << " runs";
+    if (stats[a].skipped) {
+      out << " (" << stats[a].skipped << " skipped)";
+    }
+    out << ", " << stats[a].changes << " changes, " << stats[a].time << " s" << endl;
+  }
+  out.flags(current_flags);
+  out.precision(current_precision);
+}
+
+
+/*!
+    \fn Pipeline::get_state()
+    The state is a text with the position (number of levels and, for each of them, the pass, the
+    iterations and the changes), the counters of the run, the stats of each pass, the passes over
+    max_pass_time and, in its last line, the stop_reason.
+ */
+string Pipeline::get_state(void)
+{
+  ostringstream state;
+  state.precision(17);
+  state << position.size();
+  for (uint a = 0; a < position.size(); a++) {
+    state << " " << position[a].pass << " " << position[a].iterations << " " << position[a].changes;
+  }
+  state << "\n" << last_changes << " " << needs_minimize << " " << total_iterations << " "
+      << (get_time() - start_time) << "\n";
+  state << stats.size() << "\n";
+  for (uint a = 0; a < stats.size(); a++) {
+    state << stats[a].name << " " << stats[a].runs << " " << stats[a].skipped << " " << stats[a].changes << " "
+        << stats[a].time << "\n";
+  }
+  state << over_time_passes.size();
+  for (set<string>::iterator it = over_time_passes.begin(); it != over_time_passes.end(); it++) {
+    state << " " << *it;
+  }
+  state << "\n" << stop_reason;
+
+  return state.str();
+}
+
+
+/*!
+    \fn Pipeline::set_state(const string &state)
+    The pipeline must have been parsed already: the position must lead through its repeat() loops.
+ */
+bool Pipeline::set_state(const string &state)
+{
+  istringstream in(state);
+  size_t num = 0;
+  in >> num;
+  position.resize(in ? num : 0);
+  vector<pipeline_pass> *these_passes = &passes;
+  for (uint a = 0; a < position.size() and in; a++) {
+    in >> position[a].pass >> position[a].iterations >> position[a].changes;
+    if (position[a].pass >= these_passes->size()) {
+      in.setstate(ios::failbit);
+    } else if (a + 1 < position.size()) {
+      if ((*these_passes)[position[a].pass].name != "repeat") {
+        in.setstate(ios::failbit);
+      }
+      these_passes = &(*these_passes)[position[a].pass].body;
+    }
+  }
+  in >> last_changes >> needs_minimize >> total_iterations >> start_time;
+  num = 0;
+  in >> num;
+  stats.clear();
+  stats_indexes.clear();
+  for (size_t a = 0; a < num and in; a++) {
+    enredo_pass_stats this_stats;
+    in >> this_stats.name >> this_stats.runs >> this_stats.skipped >> this_stats.changes >> this_stats.time;
+    stats_indexes[this_stats.name] = stats.size();
+    stats.push_back(this_stats);
+  }
+  num = 0;
+  in >> num;
+  over_time_passes.clear();
+  for (size_t a = 0; a < num and in; a++) {
+    string name;
+    in >> name;
+    over_time_passes.insert(name);
+  }
+  bool valid = (in and !position.empty());
+  in.ignore(1);
+  stop_reason = "";
+  getline(in, stop_reason, '\0');
+  if (!valid) {
+    position.clear();
+    return false;
+  }
+  stopped = false;
+  resuming = true;
+
+  return true;
+}
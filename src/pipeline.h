@@ -0,0 +1,99 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <csignal>
+#include "libenredo.h"
+
+//! One pass of a pipeline, or a loop of passes
+
+struct pipeline_pass {
+  std::string name;
+  std::string arg; //!< empty if none
+  std::vector<pipeline_pass> body; //!< passes of a "repeat" loop
+};
+
+//! Where a run_passes() was stopped: the pass it was about to run, and its loop counters
+
+struct pipeline_position {
+  unsigned int pass;
+  unsigned int iterations;
+  unsigned long changes; //!< made so far by the passes of this level
+};
+
+//! Sequence of stages applied to the graph, as given by a pipeline spec
+
+/*!
+    A spec is a list of passes separated by spaces or commas. Each pass is the name of a stage,
+    optionally followed by its argument in brackets: "minimize merge(1) minimize simplify(1)".
+    "repeat(...)" runs the passes inside it again and again until the first one does not change
+    the graph anymore. See the README for the list of stages.
+
+    The number of changes reported by each pass is recorded in stats. A minimize is skipped if
+    no pass has changed the graph since the last minimize (unless skip_idle_minimize is unset).
+    The graph given to run() is taken as not minimized.
+
+    The budgets are checked between passes. A pass over max_pass_time and a loop over
+    max_iterations are skipped from then on; over max_time or max_total_iterations, all the passes
+    left are. In both cases, a last minimize is run if needed and stop_reason says why.
+
+    If interrupt_flag is set, it is checked before each pass too. Once it is not 0, run() returns
+    with interrupted set and the position of the next pass in each level of loops. get_state() then
+    gives everything needed to go on later from there (see set_state).
+ */
+class Pipeline{
+public:
+    Pipeline();
+
+    ~Pipeline();
+    //! Reads a pipeline spec. Returns false (with a message on STDERR) if it is not valid
+    bool parse(std::string spec);
+    //! Returns the spec of the pipeline in its canonical form
+    std::string get_spec(void);
+    //! Applies all the passes to the graph
+    void run(Enredo &enredo, std::ostream &log);
+    //! Prints the number of runs and changes of every pass
+    void print_stats(std::ostream &out);
+    //! Returns the position and counters of an interrupted run()
+    std::string get_state(void);
+    //! Sets a state returned by get_state(). The next run() goes on from there. Returns false if not valid
+    bool set_state(const std::string &state);
+
+    bool skip_idle_minimize;
+    double max_time; //!< in seconds, 0 for no limit (as the other budgets)
+    double max_pass_time;
+    unsigned int max_iterations;
+    unsigned long max_total_iterations;
+    std::vector<enredo_pass_stats> stats; //!< in order of first appearance in the pipeline
+    std::string stop_reason; //!< why some passes have been skipped, empty if none
+    const volatile sig_atomic_t *interrupt_flag; //!< NULL if run() cannot be interrupted
+    bool interrupted; //!< the last run() has been interrupted
+
+  protected:
+    bool parse_passes(std::string &spec, size_t &pos, std::vector<pipeline_pass> &these_passes, bool nested);
+    bool check_pass(pipeline_pass &pass);
+    std::string get_spec(std::vector<pipeline_pass> &these_passes);
+    unsigned long run_passes(Enredo &enredo, std::ostream &log, std::vector<pipeline_pass> &these_passes,
+        bool is_loop);
+    unsigned long run_pass(Enredo &enredo, std::ostream &log, pipeline_pass &pass);
+    enredo_pass_stats& get_stats(pipeline_pass &pass);
+
+    std::vector<pipeline_pass> passes;
+    std::map<std::string, unsigned int> stats_indexes;
+    long last_changes; //!< changes made by the last pass, -1 if unknown
+    bool needs_minimize; //!< the graph may have changed since the last minimize
+    double start_time;
+    unsigned long total_iterations;
+    bool stopped; //!< max_time or max_total_iterations are over
+    std::set<std::string> over_time_passes; //!< passes skipped because of max_pass_time
+    unsigned int depth; //!< of the loop being run
+    std::vector<pipeline_position> position; //!< one per level, from the outermost (see interrupted)
+    bool resuming; //!< the next run() goes on from position (see set_state)
+    void add_stop_reason(const std::string &reason, std::ostream &log);
+};
+
+#endif
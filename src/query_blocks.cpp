@@ -0,0 +1,152 @@
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <iostream>
+#include <fstream>
+#include <cstdlib>
+#include <set>
+#include "index.h"
+
+using namespace std;
+
+void print_help(void);
+bool print_block(ifstream &blocks_file, unsigned long long offset);
+
+int main(int argc, char *argv[])
+{
+  char *filename = NULL;
+  vector<string> queries;
+  bool build = false;
+  bool list = false;
+  bool regions_only = false;
+  bool help = false;
+  string this_arg;
+
+  for (int a = 1; a < argc; a++) {
+    this_arg = argv[a];
+    if ((this_arg == "--build") or (this_arg == "-b")) {
+      build = true;
+    } else if ((this_arg == "--list") or (this_arg == "-l")) {
+      list = true;
+    } else if ((this_arg == "--regions") or (this_arg == "-r")) {
+      regions_only = true;
+    } else if ((this_arg == "--help") or (this_arg == "-h")) {
+      help = true;
+    } else if (!filename) {
+      filename = argv[a];
+    } else {
+      queries.push_back(this_arg);
+    }
+  }
+
+  if (help or !filename or (!build and !list and queries.empty())) {
+    print_help();
+    exit(0);
+  }
+
+  BlockIndex index;
+  if (build) {
+    if (!index.build(filename) or !index.write(BlockIndex::get_filename(filename))) {
+      exit(1);
+    }
+  } else if (!index.read(BlockIndex::get_filename(filename))) {
+    cerr << "Cannot read the index of " << filename << endl;
+    exit(1);
+  }
+
+  if (list) {
+    for (uint a = 0; a < index.sequences.size(); a++) {
+      cout << index.sequences[a].species << "\t" << index.sequences[a].chr << "\t"
+          << index.sequences[a].intervals.size() << endl;
+    }
+  }
+
+  ifstream blocks_file;
+  if (!regions_only and !queries.empty()) {
+    blocks_file.open(filename);
+    if (!blocks_file.is_open()) {
+      cerr << "Cannot open file " << filename << endl;
+      exit(1);
+    }
+  }
+  for (uint a = 0; a < queries.size(); a++) {
+    region this_region;
+    if (!parse_position(queries[a], this_region)) {
+      cerr << "Wrong region: " << queries[a] << endl;
+      exit(1);
+    }
+    unsigned int end = (this_region.end < 0) ? ~0U : this_region.end;
+    vector<block_interval> intervals;
+    index.find(this_region.species, this_region.chr, this_region.start, end, intervals);
+    if (regions_only) {
+      for (vector<block_interval>::iterator it = intervals.begin(); it != intervals.end(); it++) {
+        cout << this_region.species << ":" << this_region.chr << ":" << it->start << ":" << it->end
+            << " [" << it->strand << "] block=" << it->block << endl;
+      }
+      continue;
+    }
+    /* The blocks come in order of position, each one once */
+    set<unsigned int> printed_blocks;
+    for (vector<block_interval>::iterator it = intervals.begin(); it != intervals.end(); it++) {
+      if (!printed_blocks.insert(it->block).second) {
+        continue;
+      }
+      if (!print_block(blocks_file, index.get_offset(it->block))) {
+        cerr << "Cannot read block " << it->block << " from " << filename
+            << ". The index may be out of date (see --build)" << endl;
+        exit(1);
+      }
+    }
+  }
+
+  return EXIT_SUCCESS;
+}
+
+
+/*!
+    \fn print_block(ifstream &blocks_file, unsigned long long offset)
+    Prints the lines of the block, up to the next empty line
+ */
+bool print_block(ifstream &blocks_file, unsigned long long offset)
+{
+  if (offset == NO_OFFSET) {
+    return false;
+  }
+  blocks_file.clear();
+  blocks_file.seekg(offset);
+  string line;
+  if (!getline(blocks_file, line) or line.compare(0, 5, "block") != 0) {
+    return false;
+  }
+  cout << line << endl;
+  while (getline(blocks_file, line) and !line.empty()) {
+    cout << line << endl;
+  }
+  cout << endl;
+
+  return true;
+}
+
+
+void print_help(void)
+{
+  cout << "QueryBlocks v" << VERSION << endl;
+  cout << endl;
+  cout << "Usage: queryblocks [options] enredo_output.txt [region ...]" << endl;
+  cout << endl;
+  cout << "Prints the blocks of an enredo output file that overlap each region, using" << endl;
+  cout << "the index in enredo_output.txt.ebi (see --block-index in enredo). Regions are" << endl;
+  cout << "written as species:chr, species:chr:start-end or species:chr:pos." << endl;
+  cout << endl;
+  cout << "Options:" << endl;
+  cout << " --build: writes the index of an enredo output file first" << endl;
+  cout << " --list: prints the number of regions per species and chromosome in the index" << endl;
+  cout << " --regions: prints only the regions that overlap, with the number of their block" << endl;
+  cout << endl;
+  cout << " --help: prints this help" << endl;
+  cout << endl;
+  cout << "See README file for more details." << endl;
+  cout << endl;
+}
@@ -0,0 +1,186 @@
+#include "reader.h"
+#include <sstream>
+
+using namespace std;
+
+HitReader::HitReader()
+{
+  error = false;
+  path_break = false;
+  comments = NULL;
+  filter = NULL;
+  last_species_is_selected = true;
+  track_offsets = false;
+  line_offset = 0;
+  line_counter = 0;
+}
+
+
+HitReader::~HitReader()
+{
+  close();
+}
+
+
+/*!
+    \fn HitReader::open(char *filename)
+ */
+bool HitReader::open(char *filename)
+{
+  if (!inputfile.open(filename)) {
+    cerr << "Cannot open file " << filename << endl;
+    return false;
+  }
+  error = false;
+  path_break = false;
+  line_counter = 0;
+  return true;
+}
+
+
+/*!
+    \fn HitReader::rewind()
+ */
+bool HitReader::rewind()
+{
+  if (!inputfile.rewind()) {
+    error = true;
+    return false;
+  }
+  error = false;
+  path_break = false;
+  line_counter = 0;
+  return true;
+}
+
+
+/*!
+    \fn HitReader::seek(unsigned long long offset)
+ */
+bool HitReader::seek(unsigned long long offset)
+{
+  if (!inputfile.seek(offset)) {
+    error = true;
+    return false;
+  }
+  error = false;
+  path_break = false;
+  return true;
+}
+
+
+/*!
+    \fn HitReader::close()
+ */
+void HitReader::close()
+{
+  if (inputfile.is_open()) {
+    inputfile.close();
+  }
+}
+
+
+/*!
+    \fn HitReader::next_hit(hit &this_hit)
+    Skips comment lines and "--" lines. The latter are used to tell that the next hit must not be
+    linked to the previous one (see HitReader::path_break).
+ */
+bool HitReader::next_hit(hit &this_hit)
+{
+  path_break = false;
+  while (true) {
+    if (track_offsets) {
+      line_offset = inputfile.tell();
+    }
+    if (!inputfile.getline(line)) {
+      break;
+    } else if (line[0] == '#') {
+      if (comments) {
+        *comments << line << endl;
+      }
+      continue;
+    } else if (line == "--") {
+      path_break = true;
+      continue;
+    } else if (filter and !species_is_selected()) {
+      // The hit is skipped but a previous "--" still applies to the next one
+      continue;
+    }
+    if (!parse_line(this_hit)) {
+      error = true;
+      return false;
+    }
+    line_counter++;
+    return true;
+  }
+  if (inputfile.error) {
+    error = true;
+  }
+
+  return false;
+}
+
+
+/*!
+    \fn HitReader::parse_line(hit &this_hit)
+ */
+bool HitReader::parse_line(hit &this_hit)
+{
+  stringstream streamline;
+  streamline << line;
+  streamline
+      >> this_hit.anchor_id >> this_hit.species >> this_hit.chr
+      >> this_hit.start >> this_hit.end >> this_hit.strand >> this_hit.score;
+  if (streamline.fail()) {
+    cerr << "Error reading line (" << line_counter << ")<" << line << ">" << endl;
+    return false;
+  }
+  if (this_hit.start > this_hit.end) {
+    cerr << "start cannot be larger than end in <" << line << ">" << endl;
+    return false;
+  }
+  if (this_hit.strand != "+" and this_hit.strand != "-") {
+    cerr << "strand must be + or - in <" << line << ">" << endl;
+    return false;
+  }
+
+  return true;
+}
+
+
+/*!
+    \fn HitReader::species_is_selected()
+    Only the species name (second column) is read from the line. Lines without it are left for
+    parse_line() to complain about.
+ */
+bool HitReader::species_is_selected(void)
+{
+  size_t start = line.find_first_of(" \t");
+  if (start != string::npos) {
+    start = line.find_first_not_of(" \t", start);
+  }
+  if (start == string::npos) {
+    return true;
+  }
+  size_t end = line.find_first_of(" \t", start);
+  if (end == string::npos) {
+    end = line.size();
+  }
+  if (line.compare(start, end - start, last_species) != 0 or last_species.empty()) {
+    last_species.assign(line, start, end - start);
+    last_species_is_selected = filter->selects(last_species);
+  }
+
+  return last_species_is_selected;
+}
+
+
+/*!
+    \fn print_hit(hit &this_hit, ostream &out)
+ */
+void print_hit(hit &this_hit, ostream &out)
+{
+  out << this_hit.anchor_id << "\t" << this_hit.species << "\t"
+      << this_hit.chr << "\t" << this_hit.start << "\t" << this_hit.end << "\t"
+      << this_hit.strand << "\t" << this_hit.score << endl;
+}
@@ -0,0 +1,68 @@
+#ifndef READER_H
+#define READER_H
+
+#include <iostream>
+#include <string>
+#include <set>
+#include "input.h"
+
+//! A hit is one line of the anchors file: one Anchor mapped on one genomic region
+
+struct hit {
+  std::string anchor_id;
+  std::string species;
+  std::string chr;
+  int start;
+  int end;
+  std::string strand;
+  float score;
+};
+    void print_hit(hit &this_hit, std::ostream &out = std::cout);
+
+//! The species to be read from an anchors file: all of them if included is empty, but the excluded ones
+
+struct species_filter {
+  std::set<std::string> included;
+  std::set<std::string> excluded;
+
+  bool selects(const std::string &species) const {
+    return (included.empty() or included.count(species)) and !excluded.count(species);
+  }
+};
+
+//! Reads an anchors file, one hit at a time
+
+class HitReader{
+public:
+    HitReader();
+
+    virtual ~HitReader();
+    //! Opens the anchors file (plain text, gzip or bgzip; "-" for STDIN)
+    virtual bool open(char *filename);
+    //! Reads the next hit. Returns false at the end of the file or if the file is not valid (see error)
+    virtual bool next_hit(hit &this_hit);
+    //! Goes back to the first hit of the file
+    bool rewind();
+    //! Goes to a position of the file (see InputStream::seek())
+    bool seek(unsigned long long offset);
+    void close();
+
+    bool error; //!< true when the reading stopped because of an error in the file
+    bool path_break; //!< true when the last hit comes after a "--" line, i.e. it must not be linked to the previous one
+    std::ostream *comments; //!< if set, comment lines are copied to this stream
+    species_filter *filter; //!< if set, hits from other species are skipped before parsing them
+    std::string line; //!< the last line read from the file
+    bool track_offsets; //!< if set, the position of each line in the file is kept in line_offset
+    unsigned long long line_offset; //!< position of the last line in the file (see InputStream::tell())
+
+  protected:
+    bool parse_line(hit &this_hit);
+    bool species_is_selected(void);
+
+    InputStream inputfile;
+    unsigned long long int line_counter;
+    std::string last_species; //!< the species of the last line checked by species_is_selected()
+    bool last_species_is_selected;
+};
+
+#endif
@@ -0,0 +1,338 @@
+#include "server.h"
+#include "index.h"
+#include <sstream>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+
+using namespace std;
+
+Server::Server(Enredo &enredo)
+{
+  this->enredo = &enredo;
+  socket_fd = -1;
+}
+
+
+Server::~Server()
+{
+  close();
+}
+
+
+/*!
+    \fn Server::open(string path)
+    A socket left by a server that did not stop properly is replaced. Any other file is not.
+ */
+bool Server::open(string path)
+{
+  struct sockaddr_un address;
+  if (path.empty() or path.size() >= sizeof(address.sun_path)) {
+    cerr << "Wrong socket name: " << path << endl;
+    return false;
+  }
+  struct stat path_stat;
+  if (lstat(path.c_str(), &path_stat) == 0) {
+    if (!S_ISSOCK(path_stat.st_mode)) {
+      cerr << "Cannot create the socket " << path << ": there is a file with that name" << endl;
+      return false;
+    }
+    unlink(path.c_str());
+  }
+
+  socket_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (socket_fd < 0) {
+    cerr << "Cannot create the socket " << path << ": " << strerror(errno) << endl;
+    return false;
+  }
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+  if (bind(socket_fd, (struct sockaddr*)&address, sizeof(address)) != 0 or listen(socket_fd, 8) != 0) {
+    cerr << "Cannot create the socket " << path << ": " << strerror(errno) << endl;
+    ::close(socket_fd);
+    socket_fd = -1;
+    return false;
+  }
+  this->path = path;
+
+  return true;
+}
+
+
+/*!
+    \fn Server::close()
+ */
+void Server::close(void)
+{
+  if (socket_fd < 0) {
+    return;
+  }
+  ::close(socket_fd);
+  socket_fd = -1;
+  unlink(path.c_str());
+}
+
+
+/*!
+    \fn Server::send(int connection, string text)
+    Returns false if the client has closed the connection
+ */
+bool Server::send(int connection, string text)
+{
+  size_t sent = 0;
+  while (sent < text.size()) {
+    ssize_t length = ::send(connection, text.data() + sent, text.size() - sent, MSG_NOSIGNAL);
+    if (length < 0 and errno == EINTR) {
+      continue;
+    } else if (length <= 0) {
+      return false;
+    }
+    sent += length;
+  }
+
+  return true;
+}
+
+
+/*!
+    \fn Server::serve(ostream &log)
+    The clients are served one at a time, as the graph can only run one request at once. The time
+    taken by each request is written in the log.
+ */
+bool Server::serve(ostream &log)
+{
+  if (socket_fd < 0) {
+    cerr << "The socket is not open" << endl;
+    return false;
+  }
+  log << "Waiting for requests on " << path << endl;
+  bool running = true;
+  while (running) {
+    int connection = accept(socket_fd, NULL, NULL);
+    if (connection < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      cerr << "Cannot accept connections on " << path << ": " << strerror(errno) << endl;
+      return false;
+    }
+    string buffer;
+    char data[4096];
+    bool connected = true;
+    while (connected and running) {
+      size_t line_end = buffer.find('\n');
+      if (line_end == string::npos) {
+        ssize_t length = recv(connection, data, sizeof(data), 0);
+        if (length < 0 and errno == EINTR) {
+          continue;
+        } else if (length <= 0) {
+          break;
+        }
+        buffer.append(data, length);
+        continue;
+      }
+      string request = buffer.substr(0, line_end);
+      buffer.erase(0, line_end + 1);
+      if (!request.empty() and request[request.size() - 1] == '\r') {
+        request.erase(request.size() - 1);
+      }
+      if (request.find_first_not_of(" \t") == string::npos) {
+        continue;
+      }
+
+      struct timeval start_time, end_time;
+      gettimeofday(&start_time, NULL);
+      ostringstream out;
+      if (request == "quit") {
+        out << "## OK" << endl;
+        connected = false;
+      } else {
+        running = answer(request, out, log);
+      }
+      gettimeofday(&end_time, NULL);
+      connected = send(connection, out.str()) and connected;
+      log << "Request: " << request << " ("
+          << (end_time.tv_sec - start_time.tv_sec) * 1000.0 + (end_time.tv_usec - start_time.tv_usec) / 1000.0
+          << " ms)" << endl;
+    }
+    ::close(connection);
+  }
+  log << "Server stopped" << endl;
+
+  return true;
+}
+
+
+/*!
+    \fn Server::answer(string request, ostream &out, ostream &log)
+    The progress messages of the stages run by a "run" request are sent to the client with the
+    answer. The parameters of the blocks set by the options of a request are restored afterwards.
+ */
+bool Server::answer(string request, ostream &out, ostream &log)
+{
+  vector<string> words;
+  istringstream request_stream(request);
+  string word;
+  while (request_stream >> word) {
+    words.push_back(word);
+  }
+  if (words.empty()) {
+    out << "## ERROR empty request" << endl;
+    return true;
+  }
+
+  string error = "";
+  if (words[0] == "blocks" or words[0] == "block") {
+    string species, chr;
+    unsigned int start = 0, end = 0;
+    uint first_option = 1;
+    if (words[0] == "block") {
+      if (words.size() < 2 or !parse_position(words[1], species, chr, start, end)) {
+        out << "## ERROR use: block species:chr:pos or block species:chr:start-end" << endl;
+        return true;
+      }
+      first_option = 2;
+    }
+    enredo_parameters these_parameters = enredo->parameters;
+    if (!parse_options(words, first_option, these_parameters, error)) {
+      out << "## ERROR " << error << endl;
+      return true;
+    }
+    enredo_parameters old_parameters = enredo->parameters;
+    enredo->parameters = these_parameters;
+    unsigned long num_of_blocks;
+    if (words[0] == "block") {
+      num_of_blocks = enredo->print_blocks_at(species, chr, start, end, out);
+    } else {
+      num_of_blocks = enredo->print_blocks(out);
+    }
+    enredo->parameters = old_parameters;
+    out << "## OK " << num_of_blocks << " blocks" << endl;
+  } else if (words[0] == "anchor") {
+    if (words.size() != 2) {
+      out << "## ERROR use: anchor id" << endl;
+    } else if (!enredo->print_anchor(words[1], out)) {
+      out << "## ERROR anchor " << words[1] << " not found" << endl;
+    } else {
+      out << "## OK" << endl;
+    }
+  } else if (words[0] == "run") {
+    string spec = request.substr(request.find("run") + 3);
+    if (spec.find_first_not_of(" \t") == string::npos) {
+      out << "## ERROR use: run pipeline, like run simplify(1) minimize" << endl;
+      return true;
+    }
+    string old_pipeline = enredo->parameters.pipeline;
+    bool old_print_stats = enredo->parameters.print_stats;
+    enredo->parameters.pipeline = spec;
+    enredo->parameters.print_stats = false;
+    enredo->set_log(&out);
+    bool ret = enredo->run();
+    enredo->set_log(&log);
+    enredo->parameters.pipeline = old_pipeline;
+    enredo->parameters.print_stats = old_print_stats;
+    if (!ret) {
+      out << "## ERROR wrong pipeline: " << spec << endl;
+      return true;
+    }
+    unsigned long changes = 0;
+    const vector<enredo_pass_stats> &stats = enredo->get_pass_stats();
+    for (uint a = 0; a < stats.size(); a++) {
+      changes += stats[a].changes;
+    }
+    out << "## OK " << changes << " changes" << endl;
+  } else if (words[0] == "stats") {
+    enredo->set_log(&out);
+    enredo->print_stats();
+    enredo->set_log(&log);
+    out << "## OK" << endl;
+  } else if (words[0] == "help") {
+    out << "blocks [options]" << endl
+        << "block species:chr:pos [options]" << endl
+        << "block species:chr:start-end [options]" << endl
+        << "anchor id" << endl
+        << "run pipeline" << endl
+        << "stats" << endl
+        << "quit" << endl
+        << "shutdown" << endl
+        << "Options: --min-length N, --min-regions N, --min-anchors N, --[no-]bridges, --all" << endl
+        << "## OK" << endl;
+  } else if (words[0] == "shutdown") {
+    out << "## OK" << endl;
+    return false;
+  } else {
+    out << "## ERROR unknown request: " << words[0] << " (try help)" << endl;
+  }
+
+  return true;
+}
+
+
+/*!
+    \fn Server::parse_options(vector<string> &words, unsigned int first, enredo_parameters &these_parameters, string &error)
+    Same options as in the command line. By default, the blocks are selected as in the command line
+    of the server. A limit given in the request cancels --all (if set there) and --all overrides the limits.
+ */
+bool Server::parse_options(vector<string> &words, unsigned int first, enredo_parameters &these_parameters,
+    string &error)
+{
+  bool all = false;
+  for (uint a = first; a < words.size(); a++) {
+    if ((words[a] == "--min-length" or words[a] == "--min-regions" or words[a] == "--min-anchors") and
+        a < words.size() - 1) {
+      if (words[a + 1].find_first_not_of("0123456789") != string::npos) {
+        error = "wrong number: " + words[a + 1];
+        return false;
+      }
+      unsigned int value = atoi(words[a + 1].c_str());
+      if (words[a] == "--min-length") {
+        these_parameters.min_length = value;
+      } else if (words[a] == "--min-regions") {
+        these_parameters.min_regions = value;
+      } else {
+        these_parameters.min_anchors = value;
+      }
+      a++;
+    } else if (words[a] == "--no-bridges" or words[a] == "--nobridges") {
+      these_parameters.allow_bridges = false;
+    } else if (words[a] == "--bridges") {
+      these_parameters.allow_bridges = true;
+    } else if (words[a] == "--all") {
+      all = true;
+    } else {
+      error = "unknown option: " + words[a];
+      return false;
+    }
+    these_parameters.all = false;
+  }
+  if (all) {
+    these_parameters.all = true;
+  }
+
+  return true;
+}
+
+
+/*!
+    \fn Server::parse_position(string text, string &species, string &chr, unsigned int &start, unsigned int &end)
+    A region (species:chr:start-end) or a single position (species:chr:pos), not a whole chromosome
+ */
+bool Server::parse_position(string text, string &species, string &chr, unsigned int &start, unsigned int &end)
+{
+  region this_region;
+  if (!::parse_position(text, this_region) or this_region.end < 0) {
+    return false;
+  }
+  species = this_region.species;
+  chr = this_region.chr;
+  start = this_region.start;
+  end = this_region.end;
+
+  return true;
+}
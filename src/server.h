@@ -0,0 +1,56 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include "libenredo.h"
+
+//! Answers requests about a graph kept in memory through a Unix socket (see the --serve option)
+
+/*!
+    Each request is one line. The answer is followed by a line starting with "## OK" or, if the
+    request cannot be answered, "## ERROR" and the reason. The requests are:
+
+      blocks [options]               blocks of the graph
+      block species:chr:pos [options]
+      block species:chr:start-end [options]
+                                     blocks with a region overlapping this position or region
+      anchor id                      links of this anchor, as in the debug output
+      run pipeline                   applies these stages to the graph (see --pipeline)
+      stats                          stats of the graph (as with --stats)
+      help                           this list
+      quit                           closes the connection
+      shutdown                       closes the connection and stops the server
+
+    The options of blocks and block are the ones of the enredo program for selecting the blocks:
+    --min-length, --min-regions, --min-anchors, --[no-]bridges and --all. They only apply to this
+    request. Requests are answered one after the other, in order of arrival.
+ */
+class Server{
+public:
+    Server(Enredo &enredo);
+
+    ~Server();
+    //! Creates the socket. Returns false (with a message on STDERR) if it is not possible
+    bool open(std::string path);
+    //! Answers the requests until a shutdown request. Progress messages go to log
+    bool serve(std::ostream &log);
+    //! Answers one request. Returns false if it is a shutdown request
+    bool answer(std::string request, std::ostream &out, std::ostream &log);
+    //! Closes and removes the socket
+    void close(void);
+
+  protected:
+    bool parse_options(std::vector<std::string> &words, unsigned int first, enredo_parameters &these_parameters,
+        std::string &error);
+    bool parse_position(std::string text, std::string &species, std::string &chr, unsigned int &start,
+        unsigned int &end);
+    bool send(int connection, std::string text);
+
+    Enredo *enredo;
+    int socket_fd;
+    std::string path;
+};
+
+#endif
@@ -0,0 +1,204 @@
+#include "snapshot.h"
+#include <iostream>
+#include <cstring>
+#include <cerrno>
+
+using namespace std;
+
+#define SNAPSHOT_MAGIC "ENREDOGS"
+//! Limit for the length of the strings read, to reject corrupted files early
+#define SNAPSHOT_MAX_STRING (1U << 30)
+
+SnapshotFile::SnapshotFile()
+{
+  file = NULL;
+  error = false;
+}
+
+
+SnapshotFile::~SnapshotFile()
+{
+  if (file) {
+    fclose(file);
+  }
+}
+
+
+/*!
+    \fn SnapshotFile::create(const string &filename)
+ */
+bool SnapshotFile::create(const string &filename)
+{
+  this->filename = filename;
+  file = fopen(filename.c_str(), "wb");
+  if (!file) {
+    cerr << "Cannot open file " << filename << ": " << strerror(errno) << endl;
+    return false;
+  }
+  error = false;
+  if (fwrite(SNAPSHOT_MAGIC, 1, 8, file) != 8) {
+    error = true;
+  }
+  write_uint(SNAPSHOT_VERSION, 4);
+
+  return !error;
+}
+
+
+/*!
+    \fn SnapshotFile::append(const string &filename)
+ */
+bool SnapshotFile::append(const string &filename)
+{
+  this->filename = filename;
+  file = fopen(filename.c_str(), "ab");
+  if (!file) {
+    cerr << "Cannot open file " << filename << ": " << strerror(errno) << endl;
+    return false;
+  }
+  error = false;
+
+  return true;
+}
+
+
+/*!
+    \fn SnapshotFile::open(const string &filename)
+ */
+bool SnapshotFile::open(const string &filename)
+{
+  this->filename = filename;
+  file = fopen(filename.c_str(), "rb");
+  if (!file) {
+    cerr << "Cannot open file " << filename << ": " << strerror(errno) << endl;
+    return false;
+  }
+  error = false;
+  char magic[8];
+  if (fread(magic, 1, 8, file) != 8 or memcmp(magic, SNAPSHOT_MAGIC, 8) != 0) {
+    cerr << "Not a snapshot file: " << filename << endl;
+    error = true;
+    return false;
+  }
+  if (read_uint(4) != SNAPSHOT_VERSION or error) {
+    cerr << "Wrong version of the snapshot file " << filename << endl;
+    error = true;
+    return false;
+  }
+
+  return true;
+}
+
+
+/*!
+    \fn SnapshotFile::close()
+ */
+bool SnapshotFile::close(void)
+{
+  if (!file) {
+    return false;
+  }
+  if (fclose(file) != 0) {
+    error = true;
+  }
+  file = NULL;
+
+  return !error;
+}
+
+
+/*!
+    \fn SnapshotFile::start_section(snapshot_section section)
+ */
+void SnapshotFile::start_section(snapshot_section section)
+{
+  write_uint(section, 1);
+}
+
+
+/*!
+    \fn SnapshotFile::next_section(snapshot_section &section)
+ */
+bool SnapshotFile::next_section(snapshot_section &section)
+{
+  if (!file or error) {
+    return false;
+  }
+  int kind = fgetc(file);
+  if (kind == EOF) {
+    return false;
+  } else if (kind != SNAPSHOT_INPUT_GRAPH and kind != SNAPSHOT_RESULT_GRAPH and kind != SNAPSHOT_CHECKPOINT) {
+    error = true;
+    return false;
+  }
+  section = (snapshot_section)kind;
+
+  return true;
+}
+
+
+/*!
+    \fn SnapshotFile::write_uint(unsigned long long value, int bytes)
+ */
+void SnapshotFile::write_uint(unsigned long long value, int bytes)
+{
+  unsigned char buffer[8];
+  for (int a = 0; a < bytes; a++) {
+    buffer[a] = (value >> (8 * a)) & 0xff;
+  }
+  if (fwrite(buffer, 1, bytes, file) != (size_t)bytes) {
+    error = true;
+  }
+}
+
+
+/*!
+    \fn SnapshotFile::write_string(const string &value)
+ */
+void SnapshotFile::write_string(const string &value)
+{
+  write_uint(value.size(), 4);
+  if (value.size() and fwrite(value.data(), 1, value.size(), file) != value.size()) {
+    error = true;
+  }
+}
+
+
+/*!
+    \fn SnapshotFile::read_uint(int bytes)
+    Returns 0 and sets error at the end of the file
+ */
+unsigned long long SnapshotFile::read_uint(int bytes)
+{
+  unsigned char buffer[8];
+  if (error or fread(buffer, 1, bytes, file) != (size_t)bytes) {
+    error = true;
+    return 0;
+  }
+  unsigned long long value = 0;
+  for (int a = 0; a < bytes; a++) {
+    value |= (unsigned long long)buffer[a] << (8 * a);
+  }
+
+  return value;
+}
+
+
+/*!
+    \fn SnapshotFile::read_string(string &value)
+ */
+bool SnapshotFile::read_string(string &value)
+{
+  unsigned long long size = read_uint(4);
+  if (error or size > SNAPSHOT_MAX_STRING) {
+    error = true;
+    return false;
+  }
+  value.resize(size);
+  if (size and fread(&value[0], 1, size, file) != size) {
+    error = true;
+    return false;
+  }
+
+  return true;
+}
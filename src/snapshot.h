@@ -0,0 +1,54 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <cstdio>
+#include <string>
+
+//! Version of the format of the snapshot files
+#define SNAPSHOT_VERSION 2
+
+//! Kind of graph saved in a section of a snapshot file
+enum snapshot_section {
+  SNAPSHOT_INPUT_GRAPH = 1, //!< the graph as loaded, before the pipeline
+  SNAPSHOT_RESULT_GRAPH = 2, //!< the graph after the pipeline, preceded by the settings of the pipeline
+  SNAPSHOT_CHECKPOINT = 3 //!< the graph in the middle of the pipeline (see Enredo::load_checkpoint)
+};
+
+//! A file with graphs saved by Enredo::save_graph() (see Graph::write_snapshot)
+
+/*!
+    The file starts with "ENREDOGS" and the version. Then comes one section per graph: its kind
+    (1 byte) and the graph itself. Numbers are little-endian and strings are written as their length
+    (4 bytes) and their characters. Any error while reading or writing sets error.
+ */
+class SnapshotFile{
+public:
+    SnapshotFile();
+
+    ~SnapshotFile();
+    //! Creates a new file and writes its header
+    bool create(const std::string &filename);
+    //! Opens an existing file to add sections at its end
+    bool append(const std::string &filename);
+    //! Opens a file and reads its header
+    bool open(const std::string &filename);
+    //! Returns false if anything could not be read or written
+    bool close(void);
+
+    void start_section(snapshot_section section);
+    //! Reads the kind of the next section. Returns false at the end of the file (or on error)
+    bool next_section(snapshot_section &section);
+
+    void write_uint(unsigned long long value, int bytes);
+    void write_string(const std::string &value);
+    unsigned long long read_uint(int bytes);
+    bool read_string(std::string &value);
+
+    std::string filename;
+    bool error;
+
+  protected:
+    FILE *file;
+};
+
+#endif
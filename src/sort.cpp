@@ -0,0 +1,435 @@
+#include "sort.h"
+#include "threads.h"
+#include <algorithm>
+#include <cstdlib>
+#include <unistd.h>
+
+using namespace std;
+
+#define MIN_MERGE_RECORDS 4096
+
+//! Sorting order of the binary hits: species, chromosome, start, end and position in the file
+
+struct sort_record_less {
+  const vector<unsigned int> *ranks;
+
+  bool operator()(const sort_record &a, const sort_record &b) const {
+    if (a.sequence != b.sequence) {
+      return (*ranks)[a.sequence] < (*ranks)[b.sequence];
+    } else if (a.start != b.start) {
+      return a.start < b.start;
+    } else if (a.end != b.end) {
+      return a.end < b.end;
+    }
+    return a.serial < b.serial;
+  }
+};
+
+//! Sorts one of the chunks of a set of hits (see SortedHitReader::sort_records)
+
+struct chunk_sorter {
+  vector<sort_record> *records;
+  vector<unsigned long> *bounds;
+  sort_record_less less;
+
+  void operator()(unsigned long i) {
+    std::sort(records->begin() + (*bounds)[i], records->begin() + (*bounds)[i + 1], less);
+  }
+};
+
+//! Merges pairs of consecutive sorted chunks (see SortedHitReader::sort_records)
+
+struct chunk_merger {
+  vector<sort_record> *records;
+  vector<unsigned long> *bounds;
+  unsigned long width;
+  sort_record_less less;
+
+  void operator()(unsigned long i) {
+    unsigned long num_chunks = bounds->size() - 1;
+    unsigned long middle = min((2 * i + 1) * width, num_chunks);
+    unsigned long last = min((2 * i + 2) * width, num_chunks);
+    std::inplace_merge(records->begin() + (*bounds)[2 * i * width], records->begin() + (*bounds)[middle],
+        records->begin() + (*bounds)[last], less);
+  }
+};
+
+
+SortedHitReader::SortedHitReader(float min_score, unsigned long max_memory, string tmp_dir)
+{
+  this->min_score = min_score;
+  this->max_memory = max_memory;
+  this->tmp_dir = tmp_dir;
+  log = NULL;
+  buffer_capacity = 0;
+  writer_is_running = false;
+  writer_error = false;
+}
+
+
+SortedHitReader::~SortedHitReader()
+{
+  close();
+}
+
+
+/*!
+    \fn SortedHitReader::open(char *filename)
+ */
+bool SortedHitReader::open(char *filename)
+{
+  if (!HitReader::open(filename)) {
+    return false;
+  }
+  bool ret = read_hits();
+  HitReader::close();
+  if (!ret) {
+    error = true;
+    close();
+  }
+
+  return ret;
+}
+
+
+/*!
+    \fn SortedHitReader::read_hits()
+    Reads all the hits of the file. The memory is split in two buffers: one for the hits being read
+    and one for the hits being sorted and written to disk.
+ */
+bool SortedHitReader::read_hits(void)
+{
+  buffer_capacity = max_memory / 2 / sizeof(sort_record);
+  if (buffer_capacity < MIN_MERGE_RECORDS) {
+    buffer_capacity = MIN_MERGE_RECORDS;
+  }
+  buffer.reserve(buffer_capacity);
+
+  hit this_hit;
+  unsigned long long serial = 0;
+  unsigned int last_sequence = 0;
+  bool last_sequence_is_set = false;
+  while (HitReader::next_hit(this_hit)) {
+    if (this_hit.score < min_score) {
+      continue;
+    }
+    sort_record record;
+    if (!last_sequence_is_set or sequences[last_sequence].first != this_hit.species or
+        sequences[last_sequence].second != this_hit.chr) {
+      pair<string, string> sequence(this_hit.species, this_hit.chr);
+      map<pair<string, string>, unsigned int>::iterator it = sequence_indexes.find(sequence);
+      if (it == sequence_indexes.end()) {
+        it = sequence_indexes.insert(make_pair(sequence, (unsigned int)sequences.size())).first;
+        sequences.push_back(sequence);
+      }
+      last_sequence = it->second;
+      last_sequence_is_set = true;
+    }
+    record.sequence = last_sequence;
+    map<string, unsigned int>::iterator anchor_it = anchor_indexes.find(this_hit.anchor_id);
+    if (anchor_it == anchor_indexes.end()) {
+      anchor_it = anchor_indexes.insert(make_pair(this_hit.anchor_id, (unsigned int)anchor_ids.size())).first;
+      anchor_ids.push_back(this_hit.anchor_id);
+    }
+    record.anchor = anchor_it->second;
+    record.start = this_hit.start;
+    record.end = this_hit.end;
+    record.score = this_hit.score;
+    record.strand = (this_hit.strand == "+") ? 1 : -1;
+    record.serial = serial++;
+    buffer.push_back(record);
+    if (buffer.size() >= buffer_capacity and !flush_buffer()) {
+      return false;
+    }
+  }
+  if (error) {
+    return false;
+  }
+
+  // The last hits stay in memory
+  ranks = get_ranks();
+  sort_records(buffer, ranks);
+  if (!wait_for_writer()) {
+    return false;
+  }
+  runs.push_back(sort_run());
+  runs.back().file = NULL;
+  runs.back().records.swap(buffer);
+  runs.back().pos = 0;
+  vector<sort_record>().swap(writing);
+  if (log and runs.size() > 1) {
+    *log << "Sorted " << serial << " hits using " << runs.size() - 1 << " temporary files" << endl;
+  } else if (log) {
+    *log << "Sorted " << serial << " hits in memory" << endl;
+  }
+
+  // Start merging the runs
+  unsigned long records_per_run = max_memory / 2 / sizeof(sort_record) / runs.size();
+  if (records_per_run < MIN_MERGE_RECORDS) {
+    records_per_run = MIN_MERGE_RECORDS;
+  }
+  heap.clear();
+  for (uint a = 0; a < runs.size(); a++) {
+    if (runs[a].file) {
+      fseek(runs[a].file, 0, SEEK_SET);
+      runs[a].records.resize(records_per_run);
+      if (!fill_run(runs[a])) {
+        continue;
+      }
+    }
+    if (runs[a].pos < runs[a].records.size()) {
+      heap.push_back(a);
+    }
+  }
+  for (int a = heap.size() / 2 - 1; a >= 0; a--) {
+    sift_down(a);
+  }
+
+  return !error;
+}
+
+
+/*!
+    \fn SortedHitReader::flush_buffer()
+    Hands the current buffer over to the writer thread
+ */
+bool SortedHitReader::flush_buffer(void)
+{
+  if (!wait_for_writer()) {
+    return false;
+  }
+  FILE *file = new_temporary_file();
+  if (!file) {
+    return false;
+  }
+  runs.push_back(sort_run());
+  runs.back().file = file;
+  runs.back().pos = 0;
+  writing.swap(buffer);
+  buffer.clear();
+  buffer.reserve(buffer_capacity);
+  writer_thread = std::thread(&SortedHitReader::write_run, this, file, get_ranks());
+  writer_is_running = true;
+
+  return true;
+}
+
+
+/*!
+    \fn SortedHitReader::wait_for_writer()
+ */
+bool SortedHitReader::wait_for_writer(void)
+{
+  if (writer_is_running) {
+    writer_thread.join();
+    writer_is_running = false;
+  }
+  if (writer_error) {
+    cerr << "Cannot write temporary file in " << tmp_dir << endl;
+    return false;
+  }
+
+  return true;
+}
+
+
+/*!
+    \fn SortedHitReader::write_run(FILE *file, vector<unsigned int> ranks)
+    Body of the writer thread. New sequences can be added while the thread is running, but this
+    does not change the relative order of the previous ones.
+ */
+void SortedHitReader::write_run(FILE *file, vector<unsigned int> ranks)
+{
+  sort_records(writing, ranks);
+  if (fwrite(&writing[0], sizeof(sort_record), writing.size(), file) != writing.size() or fflush(file)) {
+    writer_error = true;
+  }
+}
+
+
+/*!
+    \fn SortedHitReader::sort_records(vector<sort_record> &records, vector<unsigned int> &ranks)
+    Sorts one chunk of the records per thread and merges them in pairs, also in parallel
+ */
+void SortedHitReader::sort_records(vector<sort_record> &records, vector<unsigned int> &ranks)
+{
+  unsigned long num_chunks = get_num_threads();
+  if (num_chunks > records.size() / MIN_MERGE_RECORDS) {
+    num_chunks = records.size() / MIN_MERGE_RECORDS;
+  }
+  if (num_chunks < 1) {
+    num_chunks = 1;
+  }
+  vector<unsigned long> bounds;
+  for (unsigned long a = 0; a <= num_chunks; a++) {
+    bounds.push_back(records.size() * a / num_chunks);
+  }
+
+  chunk_sorter sorter;
+  sorter.records = &records;
+  sorter.bounds = &bounds;
+  sorter.less.ranks = &ranks;
+  parallel_for(num_chunks, sorter);
+
+  chunk_merger merger;
+  merger.records = &records;
+  merger.bounds = &bounds;
+  merger.less.ranks = &ranks;
+  for (merger.width = 1; merger.width < num_chunks; merger.width *= 2) {
+    parallel_for((num_chunks + 2 * merger.width - 1) / (2 * merger.width), merger);
+  }
+}
+
+
+/*!
+    \fn SortedHitReader::get_ranks()
+    Returns the position of each sequence when they are sorted by species and chromosome names
+ */
+vector<unsigned int> SortedHitReader::get_ranks(void)
+{
+  vector<pair<pair<string, string>, unsigned int> > sorted_sequences;
+  for (unsigned int a = 0; a < sequences.size(); a++) {
+    sorted_sequences.push_back(make_pair(sequences[a], a));
+  }
+  sort(sorted_sequences.begin(), sorted_sequences.end());
+  vector<unsigned int> these_ranks(sequences.size());
+  for (unsigned int a = 0; a < sorted_sequences.size(); a++) {
+    these_ranks[sorted_sequences[a].second] = a;
+  }
+
+  return these_ranks;
+}
+
+
+/*!
+    \fn SortedHitReader::new_temporary_file()
+    The file is removed as soon as it is created: it disappears when closed or if the program dies
+ */
+FILE* SortedHitReader::new_temporary_file(void)
+{
+  if (tmp_dir.empty()) {
+    char *env_tmp_dir = getenv("TMPDIR");
+    tmp_dir = env_tmp_dir ? env_tmp_dir : "/tmp";
+  }
+  string path = tmp_dir + "/enredo_sort_XXXXXX";
+  vector<char> template_path(path.begin(), path.end());
+  template_path.push_back('\0');
+  int fd = mkstemp(&template_path[0]);
+  if (fd < 0) {
+    cerr << "Cannot create temporary file in " << tmp_dir << endl;
+    return NULL;
+  }
+  unlink(&template_path[0]);
+  FILE *file = fdopen(fd, "w+b");
+  if (!file) {
+    ::close(fd);
+    cerr << "Cannot create temporary file in " << tmp_dir << endl;
+  }
+
+  return file;
+}
+
+
+/*!
+    \fn SortedHitReader::fill_run(sort_run &run)
+    Reads the next records of a run stored in a temporary file
+ */
+bool SortedHitReader::fill_run(sort_run &run)
+{
+  run.records.resize(run.records.capacity());
+  size_t n = fread(&run.records[0], sizeof(sort_record), run.records.size(), run.file);
+  if (ferror(run.file)) {
+    cerr << "Cannot read temporary file in " << tmp_dir << endl;
+    error = true;
+  }
+  run.records.resize(n);
+  run.pos = 0;
+
+  return (n > 0);
+}
+
+
+/*!
+    \fn SortedHitReader::run_is_before(uint run1, uint run2)
+ */
+bool SortedHitReader::run_is_before(uint run1, uint run2)
+{
+  sort_record_less less;
+  less.ranks = &ranks;
+  return less(runs[run1].records[runs[run1].pos], runs[run2].records[runs[run2].pos]);
+}
+
+
+/*!
+    \fn SortedHitReader::sift_down(uint pos)
+    Moves down the run at this position of the heap until its next hit comes before the ones of
+    the runs below it
+ */
+void SortedHitReader::sift_down(uint pos)
+{
+  while (2 * pos + 1 < heap.size()) {
+    uint child = 2 * pos + 1;
+    if (child + 1 < heap.size() and run_is_before(heap[child + 1], heap[child])) {
+      child++;
+    }
+    if (!run_is_before(heap[child], heap[pos])) {
+      break;
+    }
+    swap(heap[pos], heap[child]);
+    pos = child;
+  }
+}
+
+
+/*!
+    \fn SortedHitReader::next_hit(hit &this_hit)
+    Takes the first hit of the run on top of the heap and moves to the next one in that run
+ */
+bool SortedHitReader::next_hit(hit &this_hit)
+{
+  path_break = false;
+  if (heap.empty() or error) {
+    return false;
+  }
+  sort_run &run = runs[heap[0]];
+  sort_record &record = run.records[run.pos];
+  this_hit.anchor_id = anchor_ids[record.anchor];
+  this_hit.species = sequences[record.sequence].first;
+  this_hit.chr = sequences[record.sequence].second;
+  this_hit.start = record.start;
+  this_hit.end = record.end;
+  this_hit.strand = (record.strand == 1) ? "+" : "-";
+  this_hit.score = record.score;
+  line_counter++;
+
+  run.pos++;
+  if (run.pos >= run.records.size() and (!run.file or !fill_run(run))) {
+    heap[0] = heap.back();
+    heap.pop_back();
+  }
+  sift_down(0);
+
+  return !error;
+}
+
+
+/*!
+    \fn SortedHitReader::close()
+ */
+void SortedHitReader::close()
+{
+  if (writer_is_running) {
+    writer_thread.join();
+    writer_is_running = false;
+  }
+  for (uint a = 0; a < runs.size(); a++) {
+    if (runs[a].file) {
+      fclose(runs[a].file);
+    }
+  }
+  runs.clear();
+  heap.clear();
+  vector<sort_record>().swap(buffer);
+  vector<sort_record>().swap(writing);
+  HitReader::close();
+}
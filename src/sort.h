@@ -0,0 +1,101 @@
+#ifndef SORT_H
+#define SORT_H
+
+#include <iostream>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <map>
+#include <thread>
+#include "reader.h"
+
+//! What to do when the anchors file is not sorted by species, chromosome and position
+enum sort_mode {
+  SORT_AUTO, //!< load the file as is, and sort it only if it turns out not to be sorted
+  SORT_ALWAYS, //!< always sort the file before loading it
+  SORT_NEVER //!< never sort the file (unsorted hits are loaded as they come)
+};
+
+//! Default amount of memory used for sorting (in bytes)
+#define DEFAULT_SORT_MEMORY 1073741824UL
+
+//! One hit in binary form, as stored while sorting the anchors file
+
+struct sort_record {
+  unsigned int sequence; //!< index of the species and chromosome (see SortedHitReader::sequences)
+  unsigned int anchor; //!< index of the anchor id (see SortedHitReader::anchor_ids)
+  int start;
+  int end;
+  float score;
+  int strand;
+  unsigned long long serial; //!< position in the input file: equal hits keep their original order
+};
+
+//! A set of sorted hits, either in memory or in a temporary file
+
+struct sort_run {
+  FILE *file; //!< NULL if all the hits are in memory
+  std::vector<sort_record> records;
+  unsigned long pos;
+};
+
+//! Reads an anchors file sorting the hits by species, chromosome and position
+
+/*!
+    The hits are parsed and kept in binary form. When the memory limit is reached, the hits in
+    memory are sorted (using several threads) and written to a temporary file by a separate thread
+    while the next ones are being parsed. All these sorted runs are merged on the fly by
+    next_hit(). Nothing is written to disk if the whole file fits in memory.
+
+    Species and chromosomes are sorted alphabetically, hits by start and end positions. Hits with
+    a score lower than min_score are discarded. The "--" lines lose their meaning once the hits
+    are sorted and are ignored.
+ */
+class SortedHitReader : public HitReader{
+public:
+    SortedHitReader(float min_score = 0.0f, unsigned long max_memory = DEFAULT_SORT_MEMORY,
+        std::string tmp_dir = "");
+
+    ~SortedHitReader();
+    //! Reads and sorts the whole anchors file
+    bool open(char *filename);
+    //! Reads the next hit in sorted order
+    bool next_hit(hit &this_hit);
+    void close();
+
+    std::ostream *log; //!< if set, the progress of the sorting is reported to this stream
+
+  protected:
+    bool read_hits(void);
+    bool flush_buffer(void);
+    bool wait_for_writer(void);
+    void write_run(FILE *file, std::vector<unsigned int> ranks);
+    void sort_records(std::vector<sort_record> &records, std::vector<unsigned int> &ranks);
+    std::vector<unsigned int> get_ranks(void);
+    FILE* new_temporary_file(void);
+    bool fill_run(sort_run &run);
+    bool run_is_before(uint run1, uint run2);
+    void sift_down(uint pos);
+
+    float min_score;
+    unsigned long max_memory;
+    std::string tmp_dir;
+
+    std::vector<std::string> anchor_ids;
+    std::map<std::string, unsigned int> anchor_indexes;
+    std::vector<std::pair<std::string, std::string> > sequences; //!< species and chromosome names
+    std::map<std::pair<std::string, std::string>, unsigned int> sequence_indexes;
+
+    std::vector<sort_record> buffer; //!< hits being read
+    std::vector<sort_record> writing; //!< hits being sorted and written by the writer thread
+    unsigned long buffer_capacity;
+    std::thread writer_thread;
+    bool writer_is_running;
+    bool writer_error;
+
+    std::vector<sort_run> runs;
+    std::vector<unsigned int> ranks; //!< final position of each sequence in the sorted output
+    std::vector<uint> heap; //!< runs, sorted as a heap by their next hit
+};
+
+#endif
@@ -0,0 +1,280 @@
+#include "spill.h"
+#include <iostream>
+#include <vector>
+#include <mutex>
+#include <algorithm>
+#include <cstdlib>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+
+using namespace std;
+
+//! Larger elements are never spilled
+#define SPILL_MAX_SIZE 256
+#define SPILL_ALIGNMENT 8
+
+//! A piece of the spill file mapped in memory
+
+struct spill_chunk {
+  char *start;
+  unsigned long long offset; //!< position in the file
+};
+
+static int spill_fd = -1;
+static bool spill_arena = false; //!< elements taken from the chunks (in the spill file or in memory)
+static string spill_path;
+static unsigned long spill_memory_limit = 0;
+static vector<spill_chunk> spill_chunks; //!< in the order they were added
+static vector<char*> spill_starts; //!< start of the chunks, sorted
+static vector<spill_chunk> spill_old_chunks; //!< chunks in use before start_spill_compaction()
+static vector<char*> spill_old_starts; //!< start of the old chunks, sorted
+static vector<unsigned long long> spill_free_offsets; //!< parts of the file released by finish_spill_compaction()
+static unsigned long long spill_file_size = 0;
+static char *spill_next = NULL; //!< free space at the end of the last chunk
+static char *spill_end = NULL;
+static void *spill_free_lists[SPILL_MAX_SIZE / SPILL_ALIGNMENT + 1];
+static unsigned long long spill_used = 0;
+static mutex spill_mutex;
+
+
+/*!
+    \fn open_spill_file(string tmp_dir, unsigned long memory_limit)
+    From now on, the tags and paths of the Links are taken from a file in tmp_dir (default: $TMPDIR
+    or /tmp). The file is removed as soon as it is created: it disappears when the program ends. The
+    memory_limit (in bytes) is the size of the file kept in memory by trim_spill_file().
+ */
+bool open_spill_file(string tmp_dir, unsigned long memory_limit)
+{
+  lock_guard<mutex> lock(spill_mutex);
+  spill_memory_limit = memory_limit;
+  if (spill_fd >= 0) {
+    return true;
+  }
+  if (tmp_dir.empty()) {
+    char *env_tmp_dir = getenv("TMPDIR");
+    tmp_dir = env_tmp_dir ? env_tmp_dir : "/tmp";
+  }
+  string path = tmp_dir + "/enredo_graph_XXXXXX";
+  vector<char> template_path(path.begin(), path.end());
+  template_path.push_back('\0');
+  spill_fd = mkstemp(&template_path[0]);
+  if (spill_fd < 0) {
+    cerr << "Cannot create temporary file in " << tmp_dir << endl;
+    return false;
+  }
+  unlink(&template_path[0]);
+  spill_path = &template_path[0];
+  spill_arena = true;
+
+  return true;
+}
+
+
+/*!
+    \fn spill_file_is_open()
+ */
+bool spill_file_is_open(void)
+{
+  return spill_fd >= 0;
+}
+
+
+/*!
+    \fn open_memory_arena()
+    Same as the out-of-core mode, with the chunks in memory instead of in a file. The elements of
+    the Graph are kept together and can be moved to new chunks by Graph::compact().
+ */
+void open_memory_arena(void)
+{
+  lock_guard<mutex> lock(spill_mutex);
+  spill_arena = true;
+}
+
+
+/*!
+    \fn add_spill_chunk()
+    Makes the file larger and maps the new part in memory. Without a file, the chunk is taken from
+    the memory.
+ */
+static bool add_spill_chunk(void)
+{
+  void *start;
+  unsigned long long offset = 0;
+  if (spill_fd < 0) {
+    start = mmap(NULL, SPILL_CHUNK_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (start == MAP_FAILED) {
+      cerr << "Cannot allocate " << SPILL_CHUNK_SIZE << " bytes of memory" << endl;
+      return false;
+    }
+  } else {
+    if (!spill_free_offsets.empty()) {
+      offset = spill_free_offsets.back();
+      spill_free_offsets.pop_back();
+    } else {
+      offset = spill_file_size;
+      if (ftruncate(spill_fd, offset + SPILL_CHUNK_SIZE) != 0) {
+        cerr << "Cannot make the file " << spill_path << " larger" << endl;
+        return false;
+      }
+      spill_file_size += SPILL_CHUNK_SIZE;
+    }
+    start = mmap(NULL, SPILL_CHUNK_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, spill_fd, offset);
+    if (start == MAP_FAILED) {
+      cerr << "Cannot map the file " << spill_path << " in memory" << endl;
+      return false;
+    }
+  }
+  spill_chunk this_chunk;
+  this_chunk.start = (char*)start;
+  this_chunk.offset = offset;
+  spill_chunks.push_back(this_chunk);
+  spill_starts.insert(upper_bound(spill_starts.begin(), spill_starts.end(), this_chunk.start), this_chunk.start);
+  spill_next = this_chunk.start;
+  spill_end = this_chunk.start + SPILL_CHUNK_SIZE;
+
+  return true;
+}
+
+
+/*!
+    \fn spill_allocate(size_t size)
+    Elements freed are kept in a list for each size and used again before taking new space
+ */
+void *spill_allocate(size_t size)
+{
+  if (!spill_arena or size == 0 or size > SPILL_MAX_SIZE) {
+    return ::operator new(size);
+  }
+  lock_guard<mutex> lock(spill_mutex);
+  size_t slot = (size + SPILL_ALIGNMENT - 1) / SPILL_ALIGNMENT;
+  size = slot * SPILL_ALIGNMENT;
+  void *pointer = spill_free_lists[slot];
+  if (pointer) {
+    spill_free_lists[slot] = *(void**)pointer;
+  } else {
+    if (spill_next + size > spill_end and !add_spill_chunk()) {
+      throw bad_alloc();
+    }
+    pointer = spill_next;
+    spill_next += size;
+  }
+  spill_used += size;
+
+  return pointer;
+}
+
+
+/*!
+    \fn spill_deallocate(void *pointer, size_t size)
+    The element may have been allocated before starting the out-of-core mode. The ones in the old
+    chunks of a compaction are released all together by finish_spill_compaction().
+ */
+void spill_deallocate(void *pointer, size_t size)
+{
+  if (!spill_arena or size == 0 or size > SPILL_MAX_SIZE) {
+    ::operator delete(pointer);
+    return;
+  }
+  lock_guard<mutex> lock(spill_mutex);
+  if (!spill_old_starts.empty()) {
+    vector<char*>::iterator it = upper_bound(spill_old_starts.begin(), spill_old_starts.end(), (char*)pointer);
+    if (it != spill_old_starts.begin() and (char*)pointer < *(it - 1) + SPILL_CHUNK_SIZE) {
+      return;
+    }
+  }
+  vector<char*>::iterator it = upper_bound(spill_starts.begin(), spill_starts.end(), (char*)pointer);
+  if (it == spill_starts.begin() or (char*)pointer >= *(it - 1) + SPILL_CHUNK_SIZE) {
+    ::operator delete(pointer);
+    return;
+  }
+  size_t slot = (size + SPILL_ALIGNMENT - 1) / SPILL_ALIGNMENT;
+  *(void**)pointer = spill_free_lists[slot];
+  spill_free_lists[slot] = pointer;
+  spill_used -= slot * SPILL_ALIGNMENT;
+}
+
+
+/*!
+    \fn trim_spill_file()
+    Must be called when the graph is not in use (between two passes). If the file is larger than
+    the memory limit, the oldest chunks are written to disk and dropped from memory, so only the
+    newest ones (up to the limit) stay. The ones dropped are read again from the disk when needed.
+ */
+bool trim_spill_file(void)
+{
+  if (spill_fd < 0) {
+    return true;
+  }
+  lock_guard<mutex> lock(spill_mutex);
+  unsigned long kept_chunks = spill_memory_limit / SPILL_CHUNK_SIZE;
+  if (spill_chunks.size() <= kept_chunks) {
+    return true;
+  }
+  bool ret = true;
+  for (unsigned long a = 0; a < spill_chunks.size() - kept_chunks; a++) {
+    if (msync(spill_chunks[a].start, SPILL_CHUNK_SIZE, MS_SYNC) != 0) {
+      cerr << "Cannot write the file " << spill_path << endl;
+      ret = false;
+      continue;
+    }
+    madvise(spill_chunks[a].start, SPILL_CHUNK_SIZE, MADV_DONTNEED);
+    posix_fadvise(spill_fd, spill_chunks[a].offset, SPILL_CHUNK_SIZE, POSIX_FADV_DONTNEED);
+  }
+
+  return ret;
+}
+
+
+/*!
+    \fn get_spill_file_usage(unsigned long long &used, unsigned long long &mapped)
+ */
+void get_spill_file_usage(unsigned long long &used, unsigned long long &mapped)
+{
+  lock_guard<mutex> lock(spill_mutex);
+  used = spill_used;
+  mapped = (unsigned long long)spill_chunks.size() * SPILL_CHUNK_SIZE;
+}
+
+
+/*!
+    \fn start_spill_compaction()
+    The chunks in use become old chunks and the lists of free elements are emptied, so the next
+    elements are taken one after the other from new chunks.
+ */
+void start_spill_compaction(void)
+{
+  lock_guard<mutex> lock(spill_mutex);
+  for (unsigned long a = 0; a < spill_chunks.size(); a++) {
+    spill_old_chunks.push_back(spill_chunks[a]);
+    spill_old_starts.push_back(spill_chunks[a].start);
+  }
+  sort(spill_old_starts.begin(), spill_old_starts.end());
+  spill_chunks.clear();
+  spill_starts.clear();
+  spill_next = NULL;
+  spill_end = NULL;
+  for (unsigned long a = 0; a < SPILL_MAX_SIZE / SPILL_ALIGNMENT + 1; a++) {
+    spill_free_lists[a] = NULL;
+  }
+  spill_used = 0;
+}
+
+
+/*!
+    \fn finish_spill_compaction()
+    The old chunks are removed from memory and their part of the spill file is used again for new chunks
+ */
+void finish_spill_compaction(void)
+{
+  lock_guard<mutex> lock(spill_mutex);
+  for (unsigned long a = 0; a < spill_old_chunks.size(); a++) {
+    munmap(spill_old_chunks[a].start, SPILL_CHUNK_SIZE);
+    if (spill_fd >= 0) {
+      posix_fadvise(spill_fd, spill_old_chunks[a].offset, SPILL_CHUNK_SIZE, POSIX_FADV_DONTNEED);
+      spill_free_offsets.push_back(spill_old_chunks[a].offset);
+    }
+  }
+  spill_old_chunks.clear();
+  spill_old_starts.clear();
+}
@@ -0,0 +1,59 @@
+#ifndef SPILL_H
+#define SPILL_H
+
+#include <cstddef>
+#include <new>
+#include <string>
+
+//! Size of each piece of the spill file mapped in memory (in bytes)
+#define SPILL_CHUNK_SIZE 67108864UL
+
+//! Starts the out-of-core mode: the tags and paths of the Links go to a file mapped in memory
+bool open_spill_file(std::string tmp_dir, unsigned long memory_limit);
+//! Returns true if the out-of-core mode is on
+bool spill_file_is_open(void);
+//! Writes the spill file and drops it from memory if it is larger than the memory limit
+bool trim_spill_file(void);
+//! Returns the number of bytes in use and mapped in the spill file
+void get_spill_file_usage(unsigned long long &used, unsigned long long &mapped);
+//! Takes the tags, paths and Links from chunks of memory from now on (if not in out-of-core mode already)
+void open_memory_arena(void);
+//! The next elements are taken from new chunks, in order (see Graph::compact)
+void start_spill_compaction(void);
+//! Releases the chunks in use before start_spill_compaction(). All their elements must have been moved
+void finish_spill_compaction(void);
+
+void *spill_allocate(size_t size);
+void spill_deallocate(void *pointer, size_t size);
+
+//! Allocator of the tags and paths of the Links (see open_spill_file)
+
+/*!
+    Without the out-of-core mode, this is the same as the standard allocator. In out-of-core mode,
+    the elements are taken from a temporary file (removed as soon as it is created) mapped in
+    memory. The operating system writes the pages of the file to disk and drops them from memory
+    when it runs short of it, and trim_spill_file() does so when the file is larger than the memory
+    limit. This is the case of most of the tags and anchors of the graph, which are not used by a
+    pass most of the time. With open_memory_arena(), the same chunks are taken from the memory.
+ */
+template <class T>
+struct spill_allocator {
+  typedef T value_type;
+
+  spill_allocator() {}
+  template <class U> spill_allocator(const spill_allocator<U> &) {}
+
+  T* allocate(size_t n) {
+    return static_cast<T*>(spill_allocate(n * sizeof(T)));
+  }
+  void deallocate(T *pointer, size_t n) {
+    spill_deallocate(pointer, n * sizeof(T));
+  }
+};
+
+template <class T, class U>
+bool operator==(const spill_allocator<T> &, const spill_allocator<U> &) { return true; }
+template <class T, class U>
+bool operator!=(const spill_allocator<T> &, const spill_allocator<U> &) { return false; }
+
+#endif
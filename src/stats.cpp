@@ -0,0 +1,229 @@
+#include "stats.h"
+#include "anchor.h"
+#include <algorithm>
+
+using namespace std;
+
+species_index::species_index(map<string, string*> &species)
+{
+  for (map<string, string*>::iterator it = species.begin(); it != species.end(); it++) {
+    pointers.push_back(make_pair(it->second, (unsigned int)names.size()));
+    names.push_back(it->first);
+  }
+  sort(pointers.begin(), pointers.end());
+}
+
+
+/*!
+    \fn species_index::get(string *species)
+ */
+int species_index::get(string *species) const
+{
+  vector< pair<string*, unsigned int> >::const_iterator it =
+      lower_bound(pointers.begin(), pointers.end(), make_pair(species, 0u));
+  if (it == pointers.end() or it->first != species) {
+    return -1;
+  }
+
+  return it->second;
+}
+
+
+/*!
+    \fn anchor_stats::init(unsigned int num_species)
+ */
+void anchor_stats::init(unsigned int num_species)
+{
+  hits.clear();
+  anchors_per_species.assign(num_species, 0);
+  species.assign(num_species, 0);
+  patterns.clear();
+}
+
+
+/*!
+    \fn anchor_stats::add(Anchor *this_anchor, const species_index &index)
+ */
+void anchor_stats::add(Anchor *this_anchor, const species_index &index)
+{
+  uint num = this_anchor->num;
+  if (num > hits.size()) {
+    hits.resize(num, 0);
+  }
+  hits[num - 1]++;
+  if (this_anchor->species.empty()) {
+    return;
+  }
+  species[this_anchor->species.size() - 1]++;
+  species_mask pattern((index.size() + 63) / 64, 0);
+  for (set<string*>::iterator it = this_anchor->species.begin(); it != this_anchor->species.end(); it++) {
+    int i = index.get(*it);
+    if (i >= 0) {
+      anchors_per_species[i]++;
+      pattern[i / 64] |= 1ULL << (i % 64);
+    }
+  }
+  patterns[pattern]++;
+}
+
+
+/*!
+    \fn anchor_stats::merge(anchor_stats &other)
+ */
+void anchor_stats::merge(anchor_stats &other)
+{
+  if (other.hits.size() > hits.size()) {
+    hits.resize(other.hits.size(), 0);
+  }
+  for (uint a = 0; a < other.hits.size(); a++) {
+    hits[a] += other.hits[a];
+  }
+  for (uint a = 0; a < species.size(); a++) {
+    anchors_per_species[a] += other.anchors_per_species[a];
+    species[a] += other.species[a];
+  }
+  for (map<species_mask, unsigned long long int>::iterator it = other.patterns.begin(); it != other.patterns.end();
+      it++) {
+    patterns[it->first] += it->second;
+  }
+}
+
+
+/*!
+    \fn link_stats::init(unsigned int num_species, unsigned int histogram_size)
+ */
+void link_stats::init(unsigned int num_species, unsigned int histogram_size)
+{
+  links = 0;
+  hist.assign(histogram_size, 0);
+  tags_per_cardinality.assign(num_species, vector<unsigned long long int>(histogram_size, 0));
+  lengths_per_cardinality.assign(num_species, vector< vector<uint> >(histogram_size));
+  length_per_copies.assign(num_species, vector<unsigned long long int>());
+}
+
+
+/*!
+    \fn link_stats::add(Link *this_link, const species_index &index)
+ */
+void link_stats::add(Link *this_link, const species_index &index)
+{
+  links++;
+  if (this_link->tags.empty()) {
+    return;
+  }
+  uint size = this_link->tags.size();
+  if (size > hist.size()) {
+    size = hist.size();
+  }
+  hist[size - 1]++;
+
+  // Number of copies of each species in this link
+  vector< pair<int, uint> > copies;
+  vector<int> tag_species;
+  tag_species.reserve(this_link->tags.size());
+  for (tag_list::iterator p_tag = this_link->tags.begin(); p_tag != this_link->tags.end(); p_tag++) {
+    int i = index.get(p_tag->get_species());
+    tag_species.push_back(i);
+    if (i < 0) {
+      continue;
+    }
+    tags_per_cardinality[i][size - 1]++;
+    lengths_per_cardinality[i][size - 1].push_back(p_tag->end - p_tag->start + 1);
+    uint c = 0;
+    while (c < copies.size() and copies[c].first != i) {
+      c++;
+    }
+    if (c == copies.size()) {
+      copies.push_back(make_pair(i, 0u));
+    }
+    copies[c].second++;
+  }
+  for (uint c = 0; c < copies.size(); c++) {
+    vector<unsigned long long int> &this_length = length_per_copies[copies[c].first];
+    if (this_length.size() < copies[c].second) {
+      this_length.resize(copies[c].second, 0);
+    }
+  }
+  uint t = 0;
+  for (tag_list::iterator p_tag = this_link->tags.begin(); p_tag != this_link->tags.end(); p_tag++, t++) {
+    int i = tag_species[t];
+    if (i < 0) {
+      continue;
+    }
+    uint c = 0;
+    while (copies[c].first != i) {
+      c++;
+    }
+    length_per_copies[i][copies[c].second - 1] += p_tag->end - p_tag->start + 1;
+  }
+}
+
+
+/*!
+    \fn link_stats::merge(link_stats &other)
+ */
+void link_stats::merge(link_stats &other)
+{
+  links += other.links;
+  for (uint a = 0; a < hist.size(); a++) {
+    hist[a] += other.hist[a];
+  }
+  for (uint s = 0; s < tags_per_cardinality.size(); s++) {
+    for (uint a = 0; a < hist.size(); a++) {
+      tags_per_cardinality[s][a] += other.tags_per_cardinality[s][a];
+      vector<uint> &these_lengths = lengths_per_cardinality[s][a];
+      these_lengths.insert(these_lengths.end(), other.lengths_per_cardinality[s][a].begin(),
+          other.lengths_per_cardinality[s][a].end());
+    }
+    if (other.length_per_copies[s].size() > length_per_copies[s].size()) {
+      length_per_copies[s].resize(other.length_per_copies[s].size(), 0);
+    }
+    for (uint c = 0; c < other.length_per_copies[s].size(); c++) {
+      length_per_copies[s][c] += other.length_per_copies[s][c];
+    }
+  }
+}
+
+
+//! True for the lengths smaller than the pivot
+
+struct smaller_than {
+  uint pivot;
+  smaller_than(uint pivot) : pivot(pivot) {}
+  bool operator()(uint length) const { return length < pivot; }
+};
+
+
+/*!
+    \fn get_n50(vector<uint> &lengths, unsigned long long int total_length, uint &n50)
+    This is a weighted selection instead of a full sort: the lengths are partitioned around a pivot
+    and the search goes on in the part where half the total length is reached. Returns false if
+    the lengths add up to 0.
+ */
+bool get_n50(vector<uint> &lengths, unsigned long long int total_length, uint &n50)
+{
+  vector<uint>::iterator begin = lengths.begin();
+  vector<uint>::iterator end = lengths.end();
+  unsigned long long int below = 0; // sum of the lengths before begin
+  while (begin != end) {
+    uint pivot = *(begin + (end - begin) / 2);
+    vector<uint>::iterator smaller_end = partition(begin, end, smaller_than(pivot));
+    vector<uint>::iterator equal_end = partition(smaller_end, end, smaller_than(pivot + 1));
+    unsigned long long int smaller_sum = 0;
+    for (vector<uint>::iterator it = begin; it != smaller_end; it++) {
+      smaller_sum += *it;
+    }
+    unsigned long long int equal_sum = (unsigned long long int)pivot * (equal_end - smaller_end);
+    if ((below + smaller_sum) * 2 > total_length) {
+      end = smaller_end;
+    } else if ((below + smaller_sum + equal_sum) * 2 > total_length) {
+      n50 = pivot;
+      return true;
+    } else {
+      below += smaller_sum + equal_sum;
+      begin = equal_end;
+    }
+  }
+
+  return false;
+}
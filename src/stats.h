@@ -0,0 +1,64 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+#include "link.h"
+
+typedef class Anchor Anchor;
+
+//! Index (in alphabetical order) of the species of the graph, from the pointers used in the tags and anchors
+
+class species_index {
+public:
+    species_index(std::map<std::string, std::string*> &species);
+    //! Returns the index of this species or -1 if unknown
+    int get(std::string *species) const;
+    unsigned int size(void) const { return names.size(); }
+
+    std::vector<std::string> names; //!< in alphabetical order
+
+protected:
+    std::vector< std::pair<std::string*, unsigned int> > pointers; //!< sorted by pointer
+};
+
+//! Set of species as a bitmask (one bit per species index)
+
+typedef std::vector<unsigned long long int> species_mask;
+
+//! Counts for the histograms of Graph::print_anchors_histogram. Each thread fills its own one
+
+struct anchor_stats {
+  std::vector<unsigned long long int> hits; //!< num. of anchors by number of hits - 1
+  std::vector<unsigned long long int> anchors_per_species;
+  std::vector<unsigned long long int> species; //!< num. of anchors by number of species - 1
+  std::map<species_mask, unsigned long long int> patterns;
+
+  void init(unsigned int num_species);
+  void add(Anchor *this_anchor, const species_index &index);
+  void merge(anchor_stats &other);
+};
+
+//! Counts and lengths for Graph::print_stats. Each thread fills its own one
+
+struct link_stats {
+  unsigned long long int links;
+  std::vector<unsigned long long int> hist; //!< num. of links by number of tags - 1 (the last one is for the rest)
+  //! num. of tags of each species by number of tags in the link
+  std::vector< std::vector<unsigned long long int> > tags_per_cardinality;
+  //! lengths of the tags of each species by number of tags in the link
+  std::vector< std::vector< std::vector<uint> > > lengths_per_cardinality;
+  //! length of each species by number of copies of the species in the link - 1
+  std::vector< std::vector<unsigned long long int> > length_per_copies;
+
+  void init(unsigned int num_species, unsigned int histogram_size);
+  void add(Link *this_link, const species_index &index);
+  void merge(link_stats &other);
+};
+
+//! Gets the N50 (the length at which the sorted lengths add up to more than half the total) reordering the lengths
+bool get_n50(std::vector<uint> &lengths, unsigned long long int total_length, uint &n50);
+
+#endif
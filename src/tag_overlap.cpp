@@ -0,0 +1,135 @@
+#include "tag_overlap.h"
+
+#if defined(__GNUC__) and (defined(__x86_64__) or defined(__i386__))
+#define TAG_OVERLAP_X86
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+//! Sequence of the padding tags: tag::sequence has 30 bits, so no tag is on it
+#define NO_SEQUENCE -1
+#define FLIP_SIGN(value) ((int32_t)((value) ^ 0x80000000U))
+
+typedef uint32_t (*overlap_kernel)(int32_t sequence, int32_t start, int32_t end, const int32_t *sequences,
+    const int32_t *starts, const int32_t *ends);
+
+
+/*!
+    \fn tag_block::assign(tag_list &these_tags)
+ */
+void tag_block::assign(tag_list &these_tags)
+{
+  size_t size = (these_tags.size() + TAG_BLOCK_SIZE - 1) / TAG_BLOCK_SIZE * TAG_BLOCK_SIZE;
+  tags.clear();
+  sequences.assign(size, NO_SEQUENCE);
+  starts.assign(size, FLIP_SIGN(0));
+  ends.assign(size, FLIP_SIGN(0));
+  for (tag_list::iterator p_tag = these_tags.begin(); p_tag != these_tags.end(); p_tag++) {
+    sequences[tags.size()] = p_tag->sequence;
+    starts[tags.size()] = FLIP_SIGN(p_tag->start);
+    ends[tags.size()] = FLIP_SIGN(p_tag->end);
+    tags.push_back(p_tag);
+  }
+}
+
+
+/*!
+    \fn get_overlap_mask_scalar(int32_t sequence, int32_t start, int32_t end, const int32_t *sequences, const int32_t *starts, const int32_t *ends)
+    Same test as in Link::get_matching_tags: start1 < end2 and start2 < end1
+ */
+static uint32_t get_overlap_mask_scalar(int32_t sequence, int32_t start, int32_t end, const int32_t *sequences,
+    const int32_t *starts, const int32_t *ends)
+{
+  uint32_t mask = 0;
+  for (uint a = 0; a < TAG_BLOCK_SIZE; a++) {
+    if (sequences[a] == sequence and start < ends[a] and starts[a] < end) {
+      mask |= (1U << a);
+    }
+  }
+
+  return mask;
+}
+
+
+#ifdef TAG_OVERLAP_X86
+/*!
+    \fn get_overlap_mask_sse2(int32_t sequence, int32_t start, int32_t end, const int32_t *sequences, const int32_t *starts, const int32_t *ends)
+    Four tags at a time
+ */
+__attribute__((target("sse2")))
+static uint32_t get_overlap_mask_sse2(int32_t sequence, int32_t start, int32_t end, const int32_t *sequences,
+    const int32_t *starts, const int32_t *ends)
+{
+  __m128i this_sequence = _mm_set1_epi32(sequence);
+  __m128i this_start = _mm_set1_epi32(start);
+  __m128i this_end = _mm_set1_epi32(end);
+  uint32_t mask = 0;
+  for (uint a = 0; a < TAG_BLOCK_SIZE; a += 4) {
+    __m128i same_sequence = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i*)(sequences + a)), this_sequence);
+    __m128i before_end = _mm_cmpgt_epi32(_mm_loadu_si128((const __m128i*)(ends + a)), this_start);
+    __m128i after_start = _mm_cmpgt_epi32(this_end, _mm_loadu_si128((const __m128i*)(starts + a)));
+    __m128i overlap = _mm_and_si128(same_sequence, _mm_and_si128(before_end, after_start));
+    mask |= (uint32_t)_mm_movemask_ps(_mm_castsi128_ps(overlap)) << a;
+  }
+
+  return mask;
+}
+
+
+/*!
+    \fn get_overlap_mask_avx2(int32_t sequence, int32_t start, int32_t end, const int32_t *sequences, const int32_t *starts, const int32_t *ends)
+    Eight tags at a time
+ */
+__attribute__((target("avx2")))
+static uint32_t get_overlap_mask_avx2(int32_t sequence, int32_t start, int32_t end, const int32_t *sequences,
+    const int32_t *starts, const int32_t *ends)
+{
+  __m256i this_sequence = _mm256_set1_epi32(sequence);
+  __m256i this_start = _mm256_set1_epi32(start);
+  __m256i this_end = _mm256_set1_epi32(end);
+  uint32_t mask = 0;
+  for (uint a = 0; a < TAG_BLOCK_SIZE; a += 8) {
+    __m256i same_sequence = _mm256_cmpeq_epi32(_mm256_loadu_si256((const __m256i*)(sequences + a)), this_sequence);
+    __m256i before_end = _mm256_cmpgt_epi32(_mm256_loadu_si256((const __m256i*)(ends + a)), this_start);
+    __m256i after_start = _mm256_cmpgt_epi32(this_end, _mm256_loadu_si256((const __m256i*)(starts + a)));
+    __m256i overlap = _mm256_and_si256(same_sequence, _mm256_and_si256(before_end, after_start));
+    mask |= (uint32_t)_mm256_movemask_ps(_mm256_castsi256_ps(overlap)) << a;
+  }
+
+  return mask;
+}
+#endif
+
+
+/*!
+    \fn choose_overlap_kernel()
+    The best version the CPU can run
+ */
+static overlap_kernel choose_overlap_kernel(void)
+{
+#ifdef TAG_OVERLAP_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    return get_overlap_mask_avx2;
+  } else if (__builtin_cpu_supports("sse2")) {
+    return get_overlap_mask_sse2;
+  }
+#endif
+  return get_overlap_mask_scalar;
+}
+
+
+// Chosen before main(), so the threads never race to set it
+static const overlap_kernel kernel = choose_overlap_kernel();
+
+
+/*!
+    \fn get_overlap_mask(const tag &this_tag, const tag_block &block, unsigned int first)
+    first must be a multiple of TAG_BLOCK_SIZE
+ */
+uint32_t get_overlap_mask(const tag &this_tag, const tag_block &block, unsigned int first)
+{
+  return kernel(this_tag.sequence, FLIP_SIGN(this_tag.start), FLIP_SIGN(this_tag.end), &block.sequences[first],
+      &block.starts[first], &block.ends[first]);
+}
@@ -0,0 +1,45 @@
+#ifndef TAG_OVERLAP_H
+#define TAG_OVERLAP_H
+
+#include <vector>
+#include <stdint.h>
+#include "link.h"
+
+//! Number of tags tested at once by get_overlap_mask()
+#define TAG_BLOCK_SIZE 32
+
+//! The tags of a Link in arrays, to test one tag against many of them at once
+
+/*!
+    The arrays are padded up to a multiple of TAG_BLOCK_SIZE with tags that never overlap anything.
+    The coordinates are stored with their highest bit flipped, so comparing them as signed numbers
+    gives the same order as comparing the original ones as unsigned.
+ */
+struct tag_block {
+  std::vector<tag_list::iterator> tags;
+  std::vector<int32_t> sequences;
+  std::vector<int32_t> starts;
+  std::vector<int32_t> ends;
+
+  void assign(tag_list &these_tags);
+};
+
+//! Returns a mask with the bit i set if tag i of the block (starting at first) is on the same sequence as this_tag and overlaps it
+uint32_t get_overlap_mask(const tag &this_tag, const tag_block &block, unsigned int first);
+
+//! Returns the index of the lowest bit set in a mask (which must not be 0)
+inline unsigned int get_first_bit(uint32_t mask)
+{
+#ifdef __GNUC__
+  return __builtin_ctz(mask);
+#else
+  unsigned int bit = 0;
+  while (!(mask & 1)) {
+    mask >>= 1;
+    bit++;
+  }
+  return bit;
+#endif
+}
+
+#endif
@@ -0,0 +1,24 @@
+#include "threads.h"
+
+static unsigned int num_threads = 0;
+
+/*!
+    \fn set_num_threads(unsigned int num_threads)
+ */
+void set_num_threads(unsigned int this_num_threads)
+{
+  num_threads = this_num_threads;
+}
+
+
+/*!
+    \fn get_num_threads()
+ */
+unsigned int get_num_threads(void)
+{
+  if (num_threads == 0) {
+    unsigned int num_cores = std::thread::hardware_concurrency();
+    return num_cores ? num_cores : 1;
+  }
+  return num_threads;
+}
@@ -0,0 +1,75 @@
+#ifndef THREADS_H
+#define THREADS_H
+
+#include <thread>
+#include <atomic>
+#include <vector>
+
+//! Sets the number of threads used in the parallel sections (0 means one per available core)
+void set_num_threads(unsigned int num_threads);
+//! Returns the number of threads used in the parallel sections
+unsigned int get_num_threads(void);
+
+
+//! Thread body for parallel_for(): calls the function for the next chunk of indexes until there are no more left
+template <class Function>
+struct parallel_for_worker {
+  Function *function;
+  std::atomic<unsigned long> *next;
+  unsigned long size;
+  unsigned long chunk_size;
+
+  void operator()() {
+    unsigned long first;
+    while ((first = next->fetch_add(chunk_size)) < size) {
+      unsigned long last = first + chunk_size;
+      if (last > size) {
+        last = size;
+      }
+      for (unsigned long i = first; i < last; i++) {
+        (*function)(i);
+      }
+    }
+  }
+};
+
+
+/*!
+    Calls function(i) for every i in [0, size), spreading the calls over get_num_threads() threads.
+    Indexes are handed out in chunks of chunk_size. The calls must be safe to run concurrently:
+    the function object is shared by all the threads.
+ */
+template <class Function>
+void parallel_for(unsigned long size, Function &function, unsigned long chunk_size = 1)
+{
+  unsigned int num_threads = get_num_threads();
+  if (chunk_size == 0) {
+    chunk_size = 1;
+  }
+  if (num_threads > (size + chunk_size - 1) / chunk_size) {
+    num_threads = (size + chunk_size - 1) / chunk_size;
+  }
+  if (num_threads <= 1) {
+    for (unsigned long i = 0; i < size; i++) {
+      function(i);
+    }
+    return;
+  }
+
+  std::atomic<unsigned long> next(0);
+  parallel_for_worker<Function> worker;
+  worker.function = &function;
+  worker.next = &next;
+  worker.size = size;
+  worker.chunk_size = chunk_size;
+  std::vector<std::thread> threads;
+  for (unsigned int a = 1; a < num_threads; a++) {
+    threads.push_back(std::thread(worker));
+  }
+  worker();
+  for (unsigned int a = 0; a < threads.size(); a++) {
+    threads[a].join();
+  }
+}
+
+#endif